@@ -6,6 +6,7 @@
 #include "../../Common/MathHelper.h"
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/GeometryGenerator.h"
+#include "../../Common/Heightfield.h"
 #include "FrameResource.h"
 #include "Waves.h"
 
@@ -138,6 +139,10 @@ private:
 
 	std::unique_ptr<Waves> mWaves;
 
+	// Heights of the land mesh, for placing objects on it and keeping the camera
+	// out of it.
+	std::unique_ptr<Heightfield> mHeightfield;
+
     PassConstants mMainPassCB;
 
 	XMFLOAT3 mEyePos = { 0.0f, 0.0f, 0.0f };
@@ -383,6 +388,22 @@ void TreeBillboardsApp::UpdateCamera(const GameTimer& gt)
 	mEyePos.z = mRadius*sinf(mPhi)*sinf(mTheta);
 	mEyePos.y = mRadius*cosf(mPhi);
 
+	// If a hill is between the camera and the point it looks at, move the camera in
+	// front of the hill.  The ray starts a little way out so that it does not hit the
+	// ground the target sits on.
+	const float nearDist = 1.0f;
+
+	XMVECTOR toEye = XMVector3Normalize(XMLoadFloat3(&mEyePos));
+
+	Heightfield::Ray ray;
+	XMStoreFloat3(&ray.Origin, XMVectorScale(toEye, nearDist));
+	XMStoreFloat3(&ray.Direction, toEye);
+	ray.MaxDist = mRadius - nearDist;
+
+	Heightfield::Hit hit;
+	if(mHeightfield->Raycast(ray, hit))
+		XMStoreFloat3(&mEyePos, XMVectorScale(toEye, MathHelper::Max(nearDist + hit.Distance - 1.0f, nearDist)));
+
 	// Build the view matrix.
 	XMVECTOR pos = XMVectorSet(mEyePos.x, mEyePos.y, mEyePos.z, 1.0f);
 	XMVECTOR target = XMVectorZero();
@@ -729,6 +750,9 @@ void TreeBillboardsApp::BuildLandGeometry()
 		vertices[i].TexC = grid.Vertices[i].TexC;
     }
 
+	mHeightfield = std::make_unique<Heightfield>(160.0f, 160.0f, 50, 50);
+	mHeightfield->SetHeights(&vertices[0].Pos.y, sizeof(Vertex));
+
     const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
 
     std::vector<std::uint16_t> indices = grid.GetIndices16();
@@ -878,12 +902,23 @@ void TreeBillboardsApp::BuildTreeSpritesGeometry()
 	};
 
 	static const int treeCount = 16;
+	std::array<XMFLOAT2, treeCount> treePositions;
+	for(UINT i = 0; i < treeCount; ++i)
+	{
+		treePositions[i].x = MathHelper::RandF(-45.0f, 45.0f);
+		treePositions[i].y = MathHelper::RandF(-45.0f, 45.0f);
+	}
+
+	// Stand the trees on the land as it is drawn.
+	std::array<float, treeCount> heights;
+	mHeightfield->GetHeights(treePositions.data(), treeCount, heights.data());
+
 	std::array<TreeSpriteVertex, 16> vertices;
 	for(UINT i = 0; i < treeCount; ++i)
 	{
-		float x = MathHelper::RandF(-45.0f, 45.0f);
-		float z = MathHelper::RandF(-45.0f, 45.0f);
-		float y = GetHillsHeight(x, z);
+		float x = treePositions[i].x;
+		float z = treePositions[i].y;
+		float y = heights[i];
 
 		// Move tree slightly above land height.
 		y += 8.0f;
@@ -3,6 +3,7 @@
 #include "../../Common/d3dUtil.h"
 #include "../../Common/MathHelper.h"
 #include "../../Common/UploadBuffer.h"
+#include "IndirectArgsBuilder.h"
 
 struct InstanceData
 {
@@ -93,6 +94,15 @@ public:
 	// create a structured buffer large enough to store the instance data for 1000 instances.  
     std::unique_ptr<UploadBuffer<InstanceData>> InstanceBuffer = nullptr;
 
+	// With GPU culling, the draw arguments written by the culling kernel are copied
+	// here so the CPU can read the visible instance count once the frame completes.
+	// Debug builds also copy back the visible instance list and keep the constants
+	// the kernel ran with, to check the kernel against IndirectArgsBuilder::Build.
+	Microsoft::WRL::ComPtr<ID3D12Resource> DrawArgsReadback = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Resource> VisibleInstancesReadback = nullptr;
+	CullConstants DrawArgsConstants;
+	bool DrawArgsWritten = false;
+
     // Fence value to mark commands up to this fence point.  This lets us
     // check if these frame resources are still in use by the GPU.
     UINT64 Fence = 0;
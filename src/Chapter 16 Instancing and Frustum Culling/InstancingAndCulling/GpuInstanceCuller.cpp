@@ -0,0 +1,196 @@
+//***************************************************************************************
+// GpuInstanceCuller.cpp
+//***************************************************************************************
+
+#include "GpuInstanceCuller.h"
+#include <algorithm>
+
+using Microsoft::WRL::ComPtr;
+using namespace DirectX;
+
+static_assert(sizeof(DrawIndexedArgs) == sizeof(D3D12_DRAW_INDEXED_ARGUMENTS),
+	"DrawIndexedArgs must match D3D12_DRAW_INDEXED_ARGUMENTS.");
+
+GpuInstanceCuller::GpuInstanceCuller(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList,
+	const std::vector<CullInstance>& instances, const DrawIndexedArgs& drawArgs)
+{
+	md3dDevice = device;
+	mInstanceCount = (UINT)instances.size();
+	mInstances = instances;
+	mDrawArgsTemplate = drawArgs;
+
+	BuildResources(cmdList, instances, drawArgs);
+	BuildCommandSignature();
+}
+
+UINT GpuInstanceCuller::InstanceCount()const
+{
+	return mInstanceCount;
+}
+
+ID3D12Resource* GpuInstanceCuller::VisibleInstances()
+{
+	return mVisibleInstances.Get();
+}
+
+ID3D12Resource* GpuInstanceCuller::DrawArgs()
+{
+	return mDrawArgs.Get();
+}
+
+ID3D12CommandSignature* GpuInstanceCuller::CommandSignature()
+{
+	return mCommandSignature.Get();
+}
+
+CullConstants GpuInstanceCuller::Execute(
+	ID3D12GraphicsCommandList* cmdList,
+	ID3D12RootSignature* rootSig,
+	ID3D12PipelineState* pso,
+	FXMMATRIX viewProj)
+{
+	CullConstants constants;
+	IndirectArgsBuilder::ExtractFrustumPlanes(viewProj, constants.FrustumPlanes);
+	constants.InstanceCount = mInstanceCount;
+
+	// Start from zero visible instances.
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mDrawArgs.Get(),
+		D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT, D3D12_RESOURCE_STATE_COPY_DEST));
+
+	cmdList->CopyBufferRegion(mDrawArgs.Get(), 0, mDrawArgsReset.Get(), 0, sizeof(DrawIndexedArgs));
+
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mDrawArgs.Get(),
+		D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mVisibleInstances.Get(),
+		D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+
+	cmdList->SetComputeRootSignature(rootSig);
+	cmdList->SetPipelineState(pso);
+
+	cmdList->SetComputeRoot32BitConstants(0, sizeof(CullConstants) / 4, &constants, 0);
+	cmdList->SetComputeRootShaderResourceView(1, mCullInstances->GetGPUVirtualAddress());
+	cmdList->SetComputeRootUnorderedAccessView(2, mVisibleInstances->GetGPUVirtualAddress());
+	cmdList->SetComputeRootUnorderedAccessView(3, mDrawArgs->GetGPUVirtualAddress());
+
+	// How many groups do we need to dispatch to cover the instances, where each
+	// group covers ThreadGroupSize instances (defined as N in the ComputeShader).
+	UINT numGroups = (mInstanceCount + IndirectArgsBuilder::ThreadGroupSize - 1) / IndirectArgsBuilder::ThreadGroupSize;
+	cmdList->Dispatch(numGroups, 1, 1);
+
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mDrawArgs.Get(),
+		D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT));
+
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mVisibleInstances.Get(),
+		D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+
+	return constants;
+}
+
+void GpuInstanceCuller::CopyDrawArgs(ID3D12GraphicsCommandList* cmdList, ID3D12Resource* readback)
+{
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mDrawArgs.Get(),
+		D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT, D3D12_RESOURCE_STATE_COPY_SOURCE));
+
+	cmdList->CopyBufferRegion(readback, 0, mDrawArgs.Get(), 0, sizeof(DrawIndexedArgs));
+
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mDrawArgs.Get(),
+		D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT));
+}
+
+void GpuInstanceCuller::CopyVisibleInstances(ID3D12GraphicsCommandList* cmdList, ID3D12Resource* readback)
+{
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mVisibleInstances.Get(),
+		D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_SOURCE));
+
+	cmdList->CopyBufferRegion(readback, 0, mVisibleInstances.Get(), 0, (UINT64)mInstanceCount * sizeof(UINT));
+
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mVisibleInstances.Get(),
+		D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+}
+
+bool GpuInstanceCuller::CheckResults(const CullConstants& constants, const DrawIndexedArgs& args,
+	const UINT* visibleInstances)const
+{
+	DrawIndexedArgs expectedArgs;
+	std::vector<std::uint32_t> expectedVisible(mInstanceCount);
+	IndirectArgsBuilder::Build(constants, mInstances.data(), mDrawArgsTemplate, expectedArgs, expectedVisible.data());
+
+	if(memcmp(&expectedArgs, &args, sizeof(DrawIndexedArgs)) != 0)
+		return false;
+
+	// The kernel appends with an atomic, so its order varies from run to run.
+	std::vector<std::uint32_t> visible(visibleInstances, visibleInstances + args.InstanceCount);
+	std::sort(visible.begin(), visible.end());
+
+	return std::equal(visible.begin(), visible.end(), expectedVisible.begin());
+}
+
+void GpuInstanceCuller::BuildResources(ID3D12GraphicsCommandList* cmdList,
+	const std::vector<CullInstance>& instances, const DrawIndexedArgs& drawArgs)
+{
+	const UINT64 cullByteSize = (UINT64)instances.size() * sizeof(CullInstance);
+	const UINT64 visibleByteSize = (UINT64)instances.size() * sizeof(UINT);
+
+	// The boxes do not change, so they live in a default buffer.  CreateDefaultBuffer
+	// leaves it in the GENERIC_READ state.
+	mCullInstances = d3dUtil::CreateDefaultBuffer(md3dDevice, cmdList,
+		instances.data(), cullByteSize, mCullInstancesUploader);
+
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(visibleByteSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
+		D3D12_RESOURCE_STATE_COMMON,
+		nullptr,
+		IID_PPV_ARGS(&mVisibleInstances)));
+
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(sizeof(DrawIndexedArgs), D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS),
+		D3D12_RESOURCE_STATE_COMMON,
+		nullptr,
+		IID_PPV_ARGS(&mDrawArgs)));
+
+	// The reset arguments never change, so one upload buffer is shared by all
+	// the frames in flight.
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(sizeof(DrawIndexedArgs)),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&mDrawArgsReset)));
+
+	DrawIndexedArgs resetArgs = drawArgs;
+	resetArgs.InstanceCount = 0;
+
+	BYTE* mappedData = nullptr;
+	ThrowIfFailed(mDrawArgsReset->Map(0, nullptr, reinterpret_cast<void**>(&mappedData)));
+	memcpy(mappedData, &resetArgs, sizeof(DrawIndexedArgs));
+	mDrawArgsReset->Unmap(0, nullptr);
+
+	// Execute() expects these states on entry.
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mVisibleInstances.Get(),
+		D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+
+	cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(mDrawArgs.Get(),
+		D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT));
+}
+
+void GpuInstanceCuller::BuildCommandSignature()
+{
+	// Each command is a single DrawIndexedInstanced; the root arguments stay as
+	// the app sets them.
+	D3D12_INDIRECT_ARGUMENT_DESC argDesc = {};
+	argDesc.Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW_INDEXED;
+
+	D3D12_COMMAND_SIGNATURE_DESC sigDesc = {};
+	sigDesc.ByteStride = sizeof(D3D12_DRAW_INDEXED_ARGUMENTS);
+	sigDesc.NumArgumentDescs = 1;
+	sigDesc.pArgumentDescs = &argDesc;
+
+	ThrowIfFailed(md3dDevice->CreateCommandSignature(&sigDesc, nullptr,
+		IID_PPV_ARGS(&mCommandSignature)));
+}
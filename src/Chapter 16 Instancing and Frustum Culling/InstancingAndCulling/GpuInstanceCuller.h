@@ -0,0 +1,92 @@
+//***************************************************************************************
+// GpuInstanceCuller.h
+//
+// Runs the frustum culling of an instanced render item on the GPU.  The kernel writes
+// the list of visible instance indices and the draw arguments, and the item is then
+// drawn with ExecuteIndirect, so the CPU cost per frame does not depend on the number
+// of instances.  The vertex shader reads its instance index from VisibleInstances().
+//***************************************************************************************
+
+#pragma once
+
+#include "../../Common/d3dUtil.h"
+#include "IndirectArgsBuilder.h"
+
+class GpuInstanceCuller
+{
+public:
+	///<summary>
+	/// Uploads the world space boxes of the instances, which are assumed not to
+	/// move.  drawArgs holds the arguments of the draw with the instance count
+	/// left for the kernel to fill in.
+	///</summary>
+	GpuInstanceCuller(ID3D12Device* device, ID3D12GraphicsCommandList* cmdList,
+		const std::vector<CullInstance>& instances, const DrawIndexedArgs& drawArgs);
+	GpuInstanceCuller(const GpuInstanceCuller& rhs) = delete;
+	GpuInstanceCuller& operator=(const GpuInstanceCuller& rhs) = delete;
+	~GpuInstanceCuller() = default;
+
+	UINT InstanceCount()const;
+
+	ID3D12Resource* VisibleInstances();
+	ID3D12Resource* DrawArgs();
+	ID3D12CommandSignature* CommandSignature();
+
+	///<summary>
+	/// Records the culling dispatch.  Afterwards DrawArgs() is in the indirect
+	/// argument state and VisibleInstances() can be read by the vertex shader.
+	/// Returns the constants the kernel runs with.
+	///</summary>
+	CullConstants Execute(
+		ID3D12GraphicsCommandList* cmdList,
+		ID3D12RootSignature* rootSig,
+		ID3D12PipelineState* pso,
+		DirectX::FXMMATRIX viewProj);
+
+	///<summary>
+	/// Records a copy of the draw arguments into a buffer in a readback heap, so the
+	/// app can report the number of visible instances once the frame has completed.
+	///</summary>
+	void CopyDrawArgs(ID3D12GraphicsCommandList* cmdList, ID3D12Resource* readback);
+
+	///<summary>
+	/// Records a copy of the visible instance list into a buffer in a readback heap
+	/// with room for InstanceCount() indices.
+	///</summary>
+	void CopyVisibleInstances(ID3D12GraphicsCommandList* cmdList, ID3D12Resource* readback);
+
+	///<summary>
+	/// Runs IndirectArgsBuilder::Build with the constants of an earlier Execute and
+	/// compares its results with what the kernel wrote, as read back: the draw
+	/// arguments byte for byte, and the visible instances as a set.
+	///</summary>
+	bool CheckResults(const CullConstants& constants, const DrawIndexedArgs& args,
+		const UINT* visibleInstances)const;
+
+private:
+	void BuildResources(ID3D12GraphicsCommandList* cmdList,
+		const std::vector<CullInstance>& instances, const DrawIndexedArgs& drawArgs);
+	void BuildCommandSignature();
+
+private:
+
+	ID3D12Device* md3dDevice = nullptr;
+
+	UINT mInstanceCount = 0;
+
+	// CPU copies of what was uploaded, for CheckResults.
+	std::vector<CullInstance> mInstances;
+	DrawIndexedArgs mDrawArgsTemplate;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> mCullInstances = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Resource> mCullInstancesUploader = nullptr;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> mVisibleInstances = nullptr;
+
+	// The draw arguments written by the kernel, and the arguments with a zero
+	// instance count that are copied over them before each dispatch.
+	Microsoft::WRL::ComPtr<ID3D12Resource> mDrawArgs = nullptr;
+	Microsoft::WRL::ComPtr<ID3D12Resource> mDrawArgsReset = nullptr;
+
+	Microsoft::WRL::ComPtr<ID3D12CommandSignature> mCommandSignature = nullptr;
+};
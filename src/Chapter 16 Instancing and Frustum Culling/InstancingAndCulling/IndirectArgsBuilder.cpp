@@ -0,0 +1,69 @@
+//***************************************************************************************
+// IndirectArgsBuilder.cpp
+//***************************************************************************************
+
+#include "IndirectArgsBuilder.h"
+#include <cmath>
+
+using namespace DirectX;
+
+void IndirectArgsBuilder::ExtractFrustumPlanes(FXMMATRIX viewProj, XMFLOAT4 planes[6])
+{
+	XMFLOAT4X4 m;
+	XMStoreFloat4x4(&m, viewProj);
+
+	// With row vectors, clip = p*M, so each plane is a sum or difference of the
+	// columns of M.  Direct3D clips z to [0, w], so the near plane is column 2 alone.
+	XMVECTOR col0 = XMVectorSet(m._11, m._21, m._31, m._41);
+	XMVECTOR col1 = XMVectorSet(m._12, m._22, m._32, m._42);
+	XMVECTOR col2 = XMVectorSet(m._13, m._23, m._33, m._43);
+	XMVECTOR col3 = XMVectorSet(m._14, m._24, m._34, m._44);
+
+	XMVECTOR p[6] =
+	{
+		col3 + col0, // left
+		col3 - col0, // right
+		col3 + col1, // bottom
+		col3 - col1, // top
+		col2,        // near
+		col3 - col2  // far
+	};
+
+	for(int i = 0; i < 6; ++i)
+		XMStoreFloat4(&planes[i], XMPlaneNormalize(p[i]));
+}
+
+bool IndirectArgsBuilder::IsVisible(const XMFLOAT4 planes[6], const CullInstance& instance)
+{
+	const XMFLOAT3& c = instance.Center;
+	const XMFLOAT3& e = instance.Extents;
+
+	// Scalar and in the same order as the kernel, whose results are marked precise,
+	// so that both round the same way.  This relies on the compiler not contracting
+	// the multiply-adds, which holds for the default /fp:precise.
+	for(int i = 0; i < 6; ++i)
+	{
+		const XMFLOAT4& p = planes[i];
+
+		float d = ((p.x*c.x + p.y*c.y) + p.z*c.z) + p.w;
+		float r = (std::fabs(p.x)*e.x + std::fabs(p.y)*e.y) + std::fabs(p.z)*e.z;
+
+		if(d + r < 0.0f)
+			return false;
+	}
+
+	return true;
+}
+
+void IndirectArgsBuilder::Build(const CullConstants& constants, const CullInstance* instances,
+	const DrawIndexedArgs& drawArgs, DrawIndexedArgs& args, std::uint32_t* visibleInstances)
+{
+	args = drawArgs;
+	args.InstanceCount = 0;
+
+	for(std::uint32_t i = 0; i < constants.InstanceCount; ++i)
+	{
+		if(IsVisible(constants.FrustumPlanes, instances[i]))
+			visibleInstances[args.InstanceCount++] = i;
+	}
+}
@@ -0,0 +1,78 @@
+//***************************************************************************************
+// IndirectArgsBuilder.h
+//
+// Data shared by the GPU culling kernel (Shaders/CullInstances.hlsl) and its CPU
+// reference.  The kernel tests each instance's world space box against the frustum
+// planes and writes the indices of the visible instances plus the
+// D3D12_DRAW_INDEXED_ARGUMENTS that ExecuteIndirect consumes.  Build() performs the
+// same work on the CPU with the same float operations in the same order, so the
+// argument buffers match byte for byte and the culling logic can be checked without
+// a GPU.
+//
+// Nothing here depends on Direct3D.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <DirectXMath.h>
+
+// World space box of one instance.  Matches CullInstance in CullInstances.hlsl.
+struct CullInstance
+{
+	DirectX::XMFLOAT3 Center;
+	std::uint32_t CullPad0 = 0;
+	DirectX::XMFLOAT3 Extents;
+	std::uint32_t CullPad1 = 0;
+};
+
+// Root constants of the culling kernel.  Matches cbCull in CullInstances.hlsl.
+struct CullConstants
+{
+	// Inward facing planes: left, right, bottom, top, near, far.
+	DirectX::XMFLOAT4 FrustumPlanes[6];
+
+	std::uint32_t InstanceCount = 0;
+	std::uint32_t CullPad0 = 0;
+	std::uint32_t CullPad1 = 0;
+	std::uint32_t CullPad2 = 0;
+};
+
+// Same layout as D3D12_DRAW_INDEXED_ARGUMENTS.
+struct DrawIndexedArgs
+{
+	std::uint32_t IndexCountPerInstance = 0;
+	std::uint32_t InstanceCount = 0;
+	std::uint32_t StartIndexLocation = 0;
+	std::int32_t BaseVertexLocation = 0;
+	std::uint32_t StartInstanceLocation = 0;
+};
+
+class IndirectArgsBuilder
+{
+public:
+
+	// Threads per group of CullInstancesCS.
+	static const std::uint32_t ThreadGroupSize = 64;
+
+	///<summary>
+	/// Extracts the six frustum planes from a view-projection matrix, in world space
+	/// when given view*proj.  The planes are normalized.
+	///</summary>
+	static void ExtractFrustumPlanes(DirectX::FXMMATRIX viewProj, DirectX::XMFLOAT4 planes[6]);
+
+	///<summary>
+	/// The box/plane test of the kernel.  An instance is culled when its box is
+	/// entirely behind one of the planes.
+	///</summary>
+	static bool IsVisible(const DirectX::XMFLOAT4 planes[6], const CullInstance& instance);
+
+	///<summary>
+	/// CPU reference of CullInstancesCS.  args is drawArgs with InstanceCount set to
+	/// the number of visible instances, whose indices are written to visibleInstances
+	/// (room for constants.InstanceCount entries) in increasing order.  The GPU writes
+	/// the same set in an unspecified order.
+	///</summary>
+	static void Build(const CullConstants& constants, const CullInstance* instances,
+		const DrawIndexedArgs& drawArgs, DrawIndexedArgs& args, std::uint32_t* visibleInstances);
+};
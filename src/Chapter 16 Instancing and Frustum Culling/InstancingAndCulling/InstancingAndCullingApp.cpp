@@ -7,7 +7,12 @@
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/GeometryGenerator.h"
 #include "../../Common/Camera.h"
+#include "../../Common/LooseOctree.h"
+#include "../../Common/MeshSimplifier.h"
+#include "../../Common/VertexQuantizer.h"
+#include "../../Common/TextureCache.h"
 #include "FrameResource.h"
+#include "GpuInstanceCuller.h"
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -50,6 +55,28 @@ struct RenderItem
 	BoundingBox Bounds;
 	std::vector<InstanceData> Instances;
 
+	// Takes the quantized positions in Geo's vertex buffer to object space.  The
+	// GPU copy of each instance world matrix is premultiplied by it.
+	XMFLOAT4X4 PositionDequantize = MathHelper::Identity4x4();
+
+	// World space bounds of the instances, keyed by instance index, used to find
+	// the visible instances without testing each one.
+	std::unique_ptr<SpatialIndex> InstanceIndex;
+
+	// GPU culling: every instance in a default buffer, and the culler that writes
+	// the visible instance list and the draw arguments for ExecuteIndirect.
+	ComPtr<ID3D12Resource> AllInstancesGPU = nullptr;
+	ComPtr<ID3D12Resource> AllInstancesUploader = nullptr;
+	std::unique_ptr<GpuInstanceCuller> InstanceCuller;
+
+	// Levels of detail, finest first, and their errors.  Each visible instance
+	// picks a level from its size on screen; the instances of a level are stored
+	// together in the instance buffer and drawn with one call.
+	std::vector<SubmeshGeometry> LodDrawArgs;
+	std::vector<MeshSimplifier::Lod> Lods;
+	std::vector<UINT> LodInstanceStart;
+	std::vector<UINT> LodInstanceCount;
+
     // DrawIndexedInstanced parameters.
     UINT IndexCount = 0;
 	UINT InstanceCount = 0;
@@ -81,9 +108,11 @@ private:
 	void UpdateInstanceData(const GameTimer& gt);
 	void UpdateMaterialBuffer(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
+	void CheckGpuCulling(const DrawIndexedArgs& args);
 
 	void LoadTextures();
     void BuildRootSignature();
+	void BuildCullRootSignature();
 	void BuildDescriptorHeaps();
     void BuildShadersAndInputLayout();
     void BuildSkullGeometry();
@@ -104,6 +133,7 @@ private:
     UINT mCbvSrvDescriptorSize = 0;
 
     ComPtr<ID3D12RootSignature> mRootSignature = nullptr;
+	ComPtr<ID3D12RootSignature> mCullRootSignature = nullptr;
 
 	ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap = nullptr;
 
@@ -124,6 +154,22 @@ private:
 	UINT mInstanceCount = 0;
 
 	bool mFrustumCullingEnabled = true;
+	bool mGpuCullingEnabled = false;
+
+	// Visible instance count of the last completed frame culled on the GPU.
+	UINT mGpuVisibleCount = 0;
+
+	// Scratch list of the instances that pass culling, and their levels of detail.
+	std::vector<std::uint32_t> mVisibleInstances;
+	std::vector<std::uint32_t> mVisibleLods;
+
+	// Levels of detail of the skull.  Only the errors are kept once the indices
+	// are in the index buffer.
+	std::vector<MeshSimplifier::Lod> mSkullLods;
+
+	VertexQuantizer::PositionQuantization mSkullQuantization;
+
+	UINT mTrianglesDrawn = 0;
 
 	BoundingFrustum mCamFrustum;
 
@@ -184,6 +230,7 @@ bool InstancingAndCullingApp::Initialize()
  
 	LoadTextures();
     BuildRootSignature();
+	BuildCullRootSignature();
 	BuildDescriptorHeaps();
     BuildShadersAndInputLayout();
 	BuildSkullGeometry();
@@ -230,6 +277,24 @@ void InstancingAndCullingApp::Update(const GameTimer& gt)
         CloseHandle(eventHandle);
     }
 
+	// The frame that last used this frame resource has completed, so the draw
+	// arguments it copied back can be read.
+	if(mCurrFrameResource->DrawArgsWritten)
+	{
+		DrawIndexedArgs* args = nullptr;
+		ThrowIfFailed(mCurrFrameResource->DrawArgsReadback->Map(0, nullptr, reinterpret_cast<void**>(&args)));
+		mGpuVisibleCount = args->InstanceCount;
+
+#if defined(DEBUG) | defined(_DEBUG)
+		CheckGpuCulling(*args);
+#endif
+
+		D3D12_RANGE emptyRange = { 0, 0 };
+		mCurrFrameResource->DrawArgsReadback->Unmap(0, &emptyRange);
+
+		mCurrFrameResource->DrawArgsWritten = false;
+	}
+
 	AnimateMaterials(gt);
 	UpdateInstanceData(gt);
 	UpdateMaterialBuffer(gt);
@@ -248,6 +313,21 @@ void InstancingAndCullingApp::Draw(const GameTimer& gt)
     // Reusing the command list reuses memory.
     ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), mPSOs["opaque"].Get()));
 
+	// Cull on the GPU first so the draw arguments are ready for ExecuteIndirect.
+	if(mGpuCullingEnabled)
+	{
+		XMMATRIX viewProj = XMMatrixMultiply(mCamera.GetView(), mCamera.GetProj());
+
+		for(auto ri : mOpaqueRitems)
+		{
+			if(ri->InstanceCuller != nullptr)
+			{
+				mCurrFrameResource->DrawArgsConstants = ri->InstanceCuller->Execute(mCommandList.Get(),
+					mCullRootSignature.Get(), mPSOs["cullInstances"].Get(), viewProj);
+			}
+		}
+	}
+
     mCommandList->RSSetViewports(1, &mScreenViewport);
     mCommandList->RSSetScissorRects(1, &mScissorRect);
 
@@ -350,10 +430,22 @@ void InstancingAndCullingApp::OnKeyboardInput(const GameTimer& gt)
 		mCamera.Strafe(20.0f*dt);
 
 	if(GetAsyncKeyState('1') & 0x8000)
+	{
 		mFrustumCullingEnabled = true;
+		mGpuCullingEnabled = false;
+	}
 
 	if(GetAsyncKeyState('2') & 0x8000)
+	{
 		mFrustumCullingEnabled = false;
+		mGpuCullingEnabled = false;
+	}
+
+	if(GetAsyncKeyState('3') & 0x8000)
+	{
+		mFrustumCullingEnabled = true;
+		mGpuCullingEnabled = true;
+	}
 
 	mCamera.UpdateViewMatrix();
 }
@@ -368,47 +460,109 @@ void InstancingAndCullingApp::UpdateInstanceData(const GameTimer& gt)
 	XMMATRIX view = mCamera.GetView();
 	XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
 
+	// Transform the camera frustum from view space to world space once, rather than
+	// into the local space of every instance.
+	BoundingFrustum worldSpaceFrustum;
+	mCamFrustum.Transform(worldSpaceFrustum, invView);
+
+	const float screenHeight = (float)mClientHeight;
+
 	auto currInstanceBuffer = mCurrFrameResource->InstanceBuffer.get();
 	for(auto& e : mAllRitems)
 	{
-		const auto& instanceData = e->Instances;
+		// With GPU culling the kernel picks the instances in Draw().  The count read
+		// back from an earlier frame is only used for the caption, which says so.
+		// Every instance is drawn at full detail.
+		if(mGpuCullingEnabled && e->InstanceCuller != nullptr)
+		{
+			e->InstanceCount = mGpuVisibleCount;
+			mTrianglesDrawn = e->InstanceCount * (e->IndexCount / 3);
+		}
+		else
+		{
+			const auto& instanceData = e->Instances;
 
-		int visibleInstanceCount = 0;
+			mVisibleInstances.clear();
+			if(mFrustumCullingEnabled)
+			{
+				// The index skips whole regions of instances outside the frustum.
+				e->InstanceIndex->QueryFrustum(worldSpaceFrustum, mVisibleInstances);
 
-		for(UINT i = 0; i < (UINT)instanceData.size(); ++i)
-		{
-			XMMATRIX world = XMLoadFloat4x4(&instanceData[i].World);
-			XMMATRIX texTransform = XMLoadFloat4x4(&instanceData[i].TexTransform);
+				// Keep the visible instances in the same order from frame to frame.
+				std::sort(mVisibleInstances.begin(), mVisibleInstances.end());
+			}
+			else
+			{
+				for(UINT i = 0; i < (UINT)instanceData.size(); ++i)
+					mVisibleInstances.push_back(i);
+			}
 
-			XMMATRIX invWorld = XMMatrixInverse(&XMMatrixDeterminant(world), world);
+			// Pick the level of detail of each visible instance from the size of
+			// its bounds on screen, and count the instances of each level.
+			const UINT lodCount = (UINT)e->LodDrawArgs.size();
+			std::fill(e->LodInstanceCount.begin(), e->LodInstanceCount.end(), 0);
 
-			// View space to the object's local space.
-			XMMATRIX viewToLocal = XMMatrixMultiply(invView, invWorld);
- 
-			// Transform the camera frustum from view space to the object's local space.
-			BoundingFrustum localSpaceFrustum;
-			mCamFrustum.Transform(localSpaceFrustum, viewToLocal);
+			mVisibleLods.clear();
+			for(UINT i : mVisibleInstances)
+			{
+				XMMATRIX world = XMLoadFloat4x4(&instanceData[i].World);
 
-			// Perform the box/frustum intersection test in local space.
-			if((localSpaceFrustum.Contains(e->Bounds) != DirectX::DISJOINT) || (mFrustumCullingEnabled==false))
+				XMVECTOR center = XMVector3TransformCoord(XMLoadFloat3(&e->Bounds.Center), world);
+				float scale = XMVectorGetX(XMVector3Length(world.r[0]));
+				scale = MathHelper::Max(scale, XMVectorGetX(XMVector3Length(world.r[1])));
+				scale = MathHelper::Max(scale, XMVectorGetX(XMVector3Length(world.r[2])));
+
+				float pixelsPerUnit = mCamera.GetPixelsPerUnit(center, screenHeight) * scale;
+				UINT lod = MeshSimplifier::SelectLod(e->Lods, pixelsPerUnit);
+
+				mVisibleLods.push_back(lod);
+				e->LodInstanceCount[lod]++;
+			}
+
+			UINT start = 0;
+			mTrianglesDrawn = 0;
+			for(UINT lod = 0; lod < lodCount; ++lod)
 			{
+				e->LodInstanceStart[lod] = start;
+				start += e->LodInstanceCount[lod];
+				mTrianglesDrawn += e->LodInstanceCount[lod] * (e->LodDrawArgs[lod].IndexCount / 3);
+			}
+
+			XMMATRIX dequantize = XMLoadFloat4x4(&e->PositionDequantize);
+
+			for(size_t k = 0; k < mVisibleInstances.size(); ++k)
+			{
+				UINT i = mVisibleInstances[k];
+
+				XMMATRIX world = XMLoadFloat4x4(&instanceData[i].World);
+				XMMATRIX texTransform = XMLoadFloat4x4(&instanceData[i].TexTransform);
+
 				InstanceData data;
-				XMStoreFloat4x4(&data.World, XMMatrixTranspose(world));
+				XMStoreFloat4x4(&data.World, XMMatrixTranspose(dequantize*world));
 				XMStoreFloat4x4(&data.TexTransform, XMMatrixTranspose(texTransform));
 				data.MaterialIndex = instanceData[i].MaterialIndex;
 
-				// Write the instance data to structured buffer for the visible objects.
-				currInstanceBuffer->CopyData(visibleInstanceCount++, data);
+				// Write the instance data to structured buffer for the visible objects,
+				// grouped by level of detail.
+				UINT lod = mVisibleLods[k];
+				currInstanceBuffer->CopyData(e->LodInstanceStart[lod]++, data);
 			}
-		}
 
-		e->InstanceCount = visibleInstanceCount;
+			// Writing moved each start to the end of its level; move them back.
+			for(UINT lod = 0; lod < lodCount; ++lod)
+				e->LodInstanceStart[lod] -= e->LodInstanceCount[lod];
+
+			e->InstanceCount = (UINT)mVisibleInstances.size();
+		}
 
 		std::wostringstream outs;
 		outs.precision(6);
 		outs << L"Instancing and Culling Demo" <<
 			L"    " << e->InstanceCount <<
-			L" objects visible out of " << e->Instances.size();
+			L" objects visible out of " << e->Instances.size() <<
+			L", " << mTrianglesDrawn << L" triangles";
+		if(mGpuCullingEnabled && e->InstanceCuller != nullptr)
+			outs << L" (GPU culled, all at LOD 0, counted " << gNumFrameResources << L" frames ago)";
 		mMainWndCaption = outs.str();
 	}
 }
@@ -475,64 +629,55 @@ void InstancingAndCullingApp::UpdateMainPassCB(const GameTimer& gt)
 	currPassCB->CopyData(0, mMainPassCB);
 }
 
+// Checks the culling kernel against its CPU reference, with the constants of the
+// frame whose draw arguments were just read back.
+void InstancingAndCullingApp::CheckGpuCulling(const DrawIndexedArgs& args)
+{
+	for(auto ri : mOpaqueRitems)
+	{
+		if(ri->InstanceCuller == nullptr)
+			continue;
+
+		UINT* visibleInstances = nullptr;
+		D3D12_RANGE readRange = { 0, args.InstanceCount * sizeof(UINT) };
+		ThrowIfFailed(mCurrFrameResource->VisibleInstancesReadback->Map(0, &readRange,
+			reinterpret_cast<void**>(&visibleInstances)));
+
+		if(!ri->InstanceCuller->CheckResults(mCurrFrameResource->DrawArgsConstants, args, visibleInstances))
+			::OutputDebugStringW(L"GPU culling results differ from IndirectArgsBuilder::Build.\n");
+
+		D3D12_RANGE emptyRange = { 0, 0 };
+		mCurrFrameResource->VisibleInstancesReadback->Unmap(0, &emptyRange);
+	}
+}
+
 void InstancingAndCullingApp::LoadTextures()
 {
-	auto bricksTex = std::make_unique<Texture>();
-	bricksTex->Name = "bricksTex";
-	bricksTex->Filename = L"../../Textures/bricks.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), bricksTex->Filename.c_str(),
-		bricksTex->Resource, bricksTex->UploadHeap));
-
-	auto stoneTex = std::make_unique<Texture>();
-	stoneTex->Name = "stoneTex";
-	stoneTex->Filename = L"../../Textures/stone.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), stoneTex->Filename.c_str(),
-		stoneTex->Resource, stoneTex->UploadHeap));
-
-	auto tileTex = std::make_unique<Texture>();
-	tileTex->Name = "tileTex";
-	tileTex->Filename = L"../../Textures/tile.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), tileTex->Filename.c_str(),
-		tileTex->Resource, tileTex->UploadHeap));
-
-	auto crateTex = std::make_unique<Texture>();
-	crateTex->Name = "crateTex";
-	crateTex->Filename = L"../../Textures/WoodCrate01.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), crateTex->Filename.c_str(),
-		crateTex->Resource, crateTex->UploadHeap));
-
-	auto iceTex = std::make_unique<Texture>();
-	iceTex->Name = "iceTex";
-	iceTex->Filename = L"../../Textures/ice.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), iceTex->Filename.c_str(),
-		iceTex->Resource, iceTex->UploadHeap));
-
-	auto grassTex = std::make_unique<Texture>();
-	grassTex->Name = "grassTex";
-	grassTex->Filename = L"../../Textures/grass.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), grassTex->Filename.c_str(),
-		grassTex->Resource, grassTex->UploadHeap));
-
-	auto defaultTex = std::make_unique<Texture>();
-	defaultTex->Name = "defaultTex";
-	defaultTex->Filename = L"../../Textures/white1x1.dds";
-	ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-		mCommandList.Get(), defaultTex->Filename.c_str(),
-		defaultTex->Resource, defaultTex->UploadHeap));
-
-	mTextures[bricksTex->Name] = std::move(bricksTex);
-	mTextures[stoneTex->Name] = std::move(stoneTex);
-	mTextures[tileTex->Name] = std::move(tileTex);
-	mTextures[crateTex->Name] = std::move(crateTex);
-	mTextures[iceTex->Name] = std::move(iceTex);
-	mTextures[grassTex->Name] = std::move(grassTex);
-	mTextures[defaultTex->Name] = std::move(defaultTex);
+	const std::pair<std::string, std::wstring> textures[] =
+	{
+		{ "bricksTex", L"../../Textures/bricks.dds" },
+		{ "stoneTex", L"../../Textures/stone.dds" },
+		{ "tileTex", L"../../Textures/tile.dds" },
+		{ "crateTex", L"../../Textures/WoodCrate01.dds" },
+		{ "iceTex", L"../../Textures/ice.dds" },
+		{ "grassTex", L"../../Textures/grass.dds" },
+		{ "defaultTex", L"../../Textures/white1x1.dds" },
+	};
+
+	// TextureTool packs src/Textures into Textures.pak when it is built; without
+	// the archive every texture is read from its own file.
+	TextureCache cache(md3dDevice.Get());
+	cache.OpenArchive(L"../../Textures/Textures.pak");
+
+	for(const auto& t : textures)
+	{
+		auto tex = std::make_unique<Texture>();
+		tex->Name = t.first;
+		tex->Filename = t.second;
+		cache.Load(mCommandList.Get(), *tex);
+
+		mTextures[tex->Name] = std::move(tex);
+	}
 }
 
 void InstancingAndCullingApp::BuildRootSignature()
@@ -541,18 +686,19 @@ void InstancingAndCullingApp::BuildRootSignature()
 	texTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 7, 0, 0);
 
     // Root parameter can be a table, root descriptor or root constants.
-    CD3DX12_ROOT_PARAMETER slotRootParameter[4];
+    CD3DX12_ROOT_PARAMETER slotRootParameter[5];
 
 	// Perfomance TIP: Order from most frequent to least frequent.
     slotRootParameter[0].InitAsShaderResourceView(0, 1);
     slotRootParameter[1].InitAsShaderResourceView(1, 1);
     slotRootParameter[2].InitAsConstantBufferView(0);
 	slotRootParameter[3].InitAsDescriptorTable(1, &texTable, D3D12_SHADER_VISIBILITY_PIXEL);
+	slotRootParameter[4].InitAsShaderResourceView(2, 1);
 
 	auto staticSamplers = GetStaticSamplers();
 
     // A root signature is an array of root parameters.
-	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(4, slotRootParameter,
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(5, slotRootParameter,
 		(UINT)staticSamplers.size(), staticSamplers.data(),
 		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
@@ -575,6 +721,40 @@ void InstancingAndCullingApp::BuildRootSignature()
         IID_PPV_ARGS(mRootSignature.GetAddressOf())));
 }
 
+void InstancingAndCullingApp::BuildCullRootSignature()
+{
+	// Root parameter can be a table, root descriptor or root constants.
+	CD3DX12_ROOT_PARAMETER slotRootParameter[4];
+
+	// Perfomance TIP: Order from most frequent to least frequent.
+	slotRootParameter[0].InitAsConstants(sizeof(CullConstants) / 4, 0);
+	slotRootParameter[1].InitAsShaderResourceView(0);
+	slotRootParameter[2].InitAsUnorderedAccessView(0);
+	slotRootParameter[3].InitAsUnorderedAccessView(1);
+
+	// A root signature is an array of root parameters.
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(4, slotRootParameter,
+		0, nullptr,
+		D3D12_ROOT_SIGNATURE_FLAG_NONE);
+
+	ComPtr<ID3DBlob> serializedRootSig = nullptr;
+	ComPtr<ID3DBlob> errorBlob = nullptr;
+	HRESULT hr = D3D12SerializeRootSignature(&rootSigDesc, D3D_ROOT_SIGNATURE_VERSION_1,
+		serializedRootSig.GetAddressOf(), errorBlob.GetAddressOf());
+
+	if(errorBlob != nullptr)
+	{
+		::OutputDebugStringA((char*)errorBlob->GetBufferPointer());
+	}
+	ThrowIfFailed(hr);
+
+	ThrowIfFailed(md3dDevice->CreateRootSignature(
+		0,
+		serializedRootSig->GetBufferPointer(),
+		serializedRootSig->GetBufferSize(),
+		IID_PPV_ARGS(mCullRootSignature.GetAddressOf())));
+}
+
 void InstancingAndCullingApp::BuildDescriptorHeaps()
 {
 	//
@@ -661,12 +841,24 @@ void InstancingAndCullingApp::BuildShadersAndInputLayout()
 
 	mShaders["standardVS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", nullptr, "VS", "vs_5_1");
 	mShaders["opaquePS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", nullptr, "PS", "ps_5_1");
+
+	const D3D_SHADER_MACRO gpuCullingDefines[] =
+	{
+		"GPU_CULLING", "1",
+		NULL, NULL
+	};
+
+	mShaders["gpuCulledVS"] = d3dUtil::CompileShader(L"Shaders\\Default.hlsl", gpuCullingDefines, "VS", "vs_5_1");
+	mShaders["cullInstancesCS"] = d3dUtil::CompileShader(L"Shaders\\CullInstances.hlsl", nullptr, "CullInstancesCS", "cs_5_0");
 	
+	// VertexQuantizer::CompactVertex.  The input assembler expands the quantized
+	// position and texture coordinates to floats; the vertex shader unfolds the
+	// octahedral normal.
     mInputLayout =
     {
-        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-        { "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-		{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+        { "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 8, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_UNORM, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
     };
 }
 
@@ -731,7 +923,7 @@ void InstancingAndCullingApp::BuildSkullGeometry()
 	fin >> ignore;
 	fin >> ignore;
 
-	std::vector<std::int32_t> indices(3 * tcount);
+	std::vector<std::uint32_t> indices(3 * tcount);
 	for(UINT i = 0; i < tcount; ++i)
 	{
 		fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
@@ -739,41 +931,78 @@ void InstancingAndCullingApp::BuildSkullGeometry()
 
 	fin.close();
 
+	//
+	// Build the levels of detail.  They index the same vertices, so only the
+	// indices of each level are added to the index buffer.
+	//
+
+	GeometryGenerator::MeshData skullMesh;
+	skullMesh.Vertices.resize(vertices.size());
+	for(size_t i = 0; i < vertices.size(); ++i)
+		skullMesh.Vertices[i].Position = vertices[i].Pos;
+	skullMesh.Indices32 = std::move(indices);
+	indices.clear();
+
+	MeshSimplifier::BuildLodChain(skullMesh, 5, 0.5f, mSkullLods);
+
+	std::vector<SubmeshGeometry> lodSubmeshes(mSkullLods.size());
+	for(size_t lod = 0; lod < mSkullLods.size(); ++lod)
+	{
+		lodSubmeshes[lod].IndexCount = (UINT)mSkullLods[lod].Indices32.size();
+		lodSubmeshes[lod].StartIndexLocation = (UINT)indices.size();
+		lodSubmeshes[lod].BaseVertexLocation = 0;
+		lodSubmeshes[lod].Bounds = bounds;
+
+		indices.insert(indices.end(), mSkullLods[lod].Indices32.begin(), mSkullLods[lod].Indices32.end());
+
+		mSkullLods[lod].Indices32.clear();
+		mSkullLods[lod].Indices32.shrink_to_fit();
+	}
+
+	//
+	// Quantize the vertices to half their size.  The spherical texture coordinates
+	// are within [0, 1], so unorm keeps them more precisely than half floats.  The
+	// scale is uniform so the dequantize transform can join the world matrix that
+	// also transforms the normals.
+	//
+
+	mSkullQuantization = VertexQuantizer::QuantizationFromBounds(bounds, true);
+
+	std::vector<VertexQuantizer::CompactVertex> compactVertices(vertices.size());
+	VertexQuantizer::Compress(&vertices[0].Pos, &vertices[0].Normal, &vertices[0].TexC, sizeof(Vertex),
+		(UINT)vertices.size(), mSkullQuantization, VertexQuantizer::TexCFormat::Unorm16, compactVertices.data());
+
 	//
 	// Pack the indices of all the meshes into one index buffer.
 	//
 
-	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
+	const UINT vbByteSize = (UINT)compactVertices.size() * sizeof(VertexQuantizer::CompactVertex);
 
-	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::int32_t);
+	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint32_t);
 
 	auto geo = std::make_unique<MeshGeometry>();
 	geo->Name = "skullGeo";
 
 	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), compactVertices.data(), vbByteSize);
 
 	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
 	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
 
 	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+		mCommandList.Get(), compactVertices.data(), vbByteSize, geo->VertexBufferUploader);
 
 	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
 		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
 
-	geo->VertexByteStride = sizeof(Vertex);
+	geo->VertexByteStride = sizeof(VertexQuantizer::CompactVertex);
 	geo->VertexBufferByteSize = vbByteSize;
 	geo->IndexFormat = DXGI_FORMAT_R32_UINT;
 	geo->IndexBufferByteSize = ibByteSize;
 
-	SubmeshGeometry submesh;
-	submesh.IndexCount = (UINT)indices.size();
-	submesh.StartIndexLocation = 0;
-	submesh.BaseVertexLocation = 0;
-	submesh.Bounds = bounds;
-
-	geo->DrawArgs["skull"] = submesh;
+	geo->DrawArgs["skull"] = lodSubmeshes[0];
+	for(size_t lod = 1; lod < lodSubmeshes.size(); ++lod)
+		geo->DrawArgs["skull_lod" + std::to_string(lod)] = lodSubmeshes[lod];
 
 	mGeometries[geo->Name] = std::move(geo);
 }
@@ -809,6 +1038,30 @@ void InstancingAndCullingApp::BuildPSOs()
 	opaquePsoDesc.SampleDesc.Quality = m4xMsaaState ? (m4xMsaaQuality - 1) : 0;
 	opaquePsoDesc.DSVFormat = mDepthStencilFormat;
     ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaquePsoDesc, IID_PPV_ARGS(&mPSOs["opaque"])));
+
+	//
+	// PSO for opaque objects culled on the GPU.
+	//
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC gpuCulledPsoDesc = opaquePsoDesc;
+	gpuCulledPsoDesc.VS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["gpuCulledVS"]->GetBufferPointer()),
+		mShaders["gpuCulledVS"]->GetBufferSize()
+	};
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&gpuCulledPsoDesc, IID_PPV_ARGS(&mPSOs["opaqueGpuCulled"])));
+
+	//
+	// PSO for culling instances.
+	//
+	D3D12_COMPUTE_PIPELINE_STATE_DESC cullPsoDesc = {};
+	cullPsoDesc.pRootSignature = mCullRootSignature.Get();
+	cullPsoDesc.CS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["cullInstancesCS"]->GetBufferPointer()),
+		mShaders["cullInstancesCS"]->GetBufferSize()
+	};
+	cullPsoDesc.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
+	ThrowIfFailed(md3dDevice->CreateComputePipelineState(&cullPsoDesc, IID_PPV_ARGS(&mPSOs["cullInstances"])));
 }
 
 void InstancingAndCullingApp::BuildFrameResources()
@@ -901,6 +1154,14 @@ void InstancingAndCullingApp::BuildRenderItems()
 	skullRitem->StartIndexLocation = skullRitem->Geo->DrawArgs["skull"].StartIndexLocation;
 	skullRitem->BaseVertexLocation = skullRitem->Geo->DrawArgs["skull"].BaseVertexLocation;
 	skullRitem->Bounds = skullRitem->Geo->DrawArgs["skull"].Bounds;
+	XMStoreFloat4x4(&skullRitem->PositionDequantize, VertexQuantizer::DequantizeTransform(mSkullQuantization));
+
+	skullRitem->Lods = mSkullLods;
+	skullRitem->LodDrawArgs.push_back(skullRitem->Geo->DrawArgs["skull"]);
+	for(size_t lod = 1; lod < mSkullLods.size(); ++lod)
+		skullRitem->LodDrawArgs.push_back(skullRitem->Geo->DrawArgs["skull_lod" + std::to_string(lod)]);
+	skullRitem->LodInstanceStart.resize(skullRitem->LodDrawArgs.size(), 0);
+	skullRitem->LodInstanceCount.resize(skullRitem->LodDrawArgs.size(), 0);
 
 	// Generate instance data.
 	const int n = 5;
@@ -938,6 +1199,46 @@ void InstancingAndCullingApp::BuildRenderItems()
 		}
 	}
 
+	// Index the world space bounds of the instances for culling.  The root cell
+	// covers the grid of instances.
+	skullRitem->InstanceIndex = std::make_unique<LooseOctree>(
+		XMFLOAT3(0.0f, 0.0f, 0.0f), 0.5f*(std::max)(width, (std::max)(height, depth)) + 10.0f);
+
+	// The GPU culling path needs every instance in a buffer the vertex shader can
+	// read, and the world space boxes the culling kernel tests.
+	std::vector<InstanceData> allInstances(mInstanceCount);
+	std::vector<CullInstance> cullInstances(mInstanceCount);
+
+	XMMATRIX dequantize = XMLoadFloat4x4(&skullRitem->PositionDequantize);
+
+	for(UINT i = 0; i < mInstanceCount; ++i)
+	{
+		XMMATRIX world = XMLoadFloat4x4(&skullRitem->Instances[i].World);
+		XMMATRIX texTransform = XMLoadFloat4x4(&skullRitem->Instances[i].TexTransform);
+
+		BoundingBox worldBounds;
+		skullRitem->Bounds.Transform(worldBounds, world);
+		skullRitem->InstanceIndex->Insert(i, worldBounds);
+
+		XMStoreFloat4x4(&allInstances[i].World, XMMatrixTranspose(dequantize*world));
+		XMStoreFloat4x4(&allInstances[i].TexTransform, XMMatrixTranspose(texTransform));
+		allInstances[i].MaterialIndex = skullRitem->Instances[i].MaterialIndex;
+
+		cullInstances[i].Center = worldBounds.Center;
+		cullInstances[i].Extents = worldBounds.Extents;
+	}
+
+	skullRitem->AllInstancesGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(), mCommandList.Get(),
+		allInstances.data(), (UINT64)allInstances.size() * sizeof(InstanceData), skullRitem->AllInstancesUploader);
+
+	DrawIndexedArgs drawArgs;
+	drawArgs.IndexCountPerInstance = skullRitem->IndexCount;
+	drawArgs.StartIndexLocation = skullRitem->StartIndexLocation;
+	drawArgs.BaseVertexLocation = skullRitem->BaseVertexLocation;
+
+	skullRitem->InstanceCuller = std::make_unique<GpuInstanceCuller>(md3dDevice.Get(), mCommandList.Get(),
+		cullInstances, drawArgs);
+
 
 	mAllRitems.push_back(std::move(skullRitem));
 	
@@ -957,12 +1258,47 @@ void InstancingAndCullingApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList
         cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
         cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
 
+		if(mGpuCullingEnabled && ri->InstanceCuller != nullptr)
+		{
+			// Bind every instance; the vertex shader finds the visible ones through
+			// the list written by the culling kernel, which also wrote the draw arguments.
+			cmdList->SetPipelineState(mPSOs["opaqueGpuCulled"].Get());
+			cmdList->SetGraphicsRootShaderResourceView(0, ri->AllInstancesGPU->GetGPUVirtualAddress());
+			cmdList->SetGraphicsRootShaderResourceView(4, ri->InstanceCuller->VisibleInstances()->GetGPUVirtualAddress());
+
+			cmdList->ExecuteIndirect(ri->InstanceCuller->CommandSignature(), 1,
+				ri->InstanceCuller->DrawArgs(), 0, nullptr, 0);
+
+			ri->InstanceCuller->CopyDrawArgs(cmdList, mCurrFrameResource->DrawArgsReadback.Get());
+#if defined(DEBUG) | defined(_DEBUG)
+			ri->InstanceCuller->CopyVisibleInstances(cmdList, mCurrFrameResource->VisibleInstancesReadback.Get());
+#endif
+			mCurrFrameResource->DrawArgsWritten = true;
+			continue;
+		}
+
+		cmdList->SetPipelineState(mPSOs["opaque"].Get());
+
 		// Set the instance buffer to use for this render-item.  For structured buffers, we can bypass 
 		// the heap and set as a root descriptor.
 		auto instanceBuffer = mCurrFrameResource->InstanceBuffer->Resource();
-		mCommandList->SetGraphicsRootShaderResourceView(0, instanceBuffer->GetGPUVirtualAddress());
 
-        cmdList->DrawIndexedInstanced(ri->IndexCount, ri->InstanceCount, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+		// Draw the instances of each level of detail.  SV_InstanceID starts at 0 in
+		// every draw regardless of StartInstanceLocation, so offset the root
+		// descriptor to the first instance of the level instead.
+		for(size_t lod = 0; lod < ri->LodDrawArgs.size(); ++lod)
+		{
+			if(ri->LodInstanceCount[lod] == 0)
+				continue;
+
+			D3D12_GPU_VIRTUAL_ADDRESS instanceAddress = instanceBuffer->GetGPUVirtualAddress() +
+				(UINT64)ri->LodInstanceStart[lod] * sizeof(InstanceData);
+			cmdList->SetGraphicsRootShaderResourceView(0, instanceAddress);
+
+			const SubmeshGeometry& lodArgs = ri->LodDrawArgs[lod];
+			cmdList->DrawIndexedInstanced(lodArgs.IndexCount, ri->LodInstanceCount[lod],
+				lodArgs.StartIndexLocation, lodArgs.BaseVertexLocation, 0);
+		}
     }
 }
 
@@ -0,0 +1,100 @@
+//=============================================================================
+// Frustum culls instances on the GPU.  Writes the indices of the visible
+// instances and the instance count of the D3D12_DRAW_INDEXED_ARGUMENTS that
+// ExecuteIndirect reads, so the CPU never looks at individual instances.
+//
+// IndirectArgsBuilder::Build() is the CPU reference of this kernel.
+//=============================================================================
+
+struct CullInstance
+{
+	float3 Center;
+	uint   CullPad0;
+	float3 Extents;
+	uint   CullPad1;
+};
+
+cbuffer cbCull : register(b0)
+{
+	// We cannot have an array entry in a constant buffer that gets mapped onto
+	// root constants, so list each element.
+	float4 gFrustumPlane0;
+	float4 gFrustumPlane1;
+	float4 gFrustumPlane2;
+	float4 gFrustumPlane3;
+	float4 gFrustumPlane4;
+	float4 gFrustumPlane5;
+
+	uint gInstanceCount;
+};
+
+StructuredBuffer<CullInstance> gCullInstances : register(t0);
+
+RWStructuredBuffer<uint> gVisibleInstances : register(u0);
+
+// D3D12_DRAW_INDEXED_ARGUMENTS.  The CPU copies in the arguments with a zero
+// InstanceCount (byte offset 4) before the dispatch.
+RWByteAddressBuffer gDrawArgs : register(u1);
+
+#define N 64
+
+groupshared uint gGroupVisibleCount;
+groupshared uint gGroupFirstSlot;
+
+bool IsVisible(CullInstance inst)
+{
+	float4 planes[6] =
+	{
+		gFrustumPlane0, gFrustumPlane1, gFrustumPlane2,
+		gFrustumPlane3, gFrustumPlane4, gFrustumPlane5
+	};
+
+	[unroll]
+	for(int i = 0; i < 6; ++i)
+	{
+		float4 p = planes[i];
+
+		// Same operations in the same order as IndirectArgsBuilder::IsVisible.
+		// precise stops the compiler from fusing or reordering them.
+		precise float d = ((p.x*inst.Center.x + p.y*inst.Center.y) + p.z*inst.Center.z) + p.w;
+		precise float r = (abs(p.x)*inst.Extents.x + abs(p.y)*inst.Extents.y) + abs(p.z)*inst.Extents.z;
+
+		if(d + r < 0.0f)
+			return false;
+	}
+
+	return true;
+}
+
+[numthreads(N, 1, 1)]
+void CullInstancesCS(int3 groupThreadID : SV_GroupThreadID,
+                     int3 dispatchThreadID : SV_DispatchThreadID)
+{
+	if(groupThreadID.x == 0)
+		gGroupVisibleCount = 0;
+
+	GroupMemoryBarrierWithGroupSync();
+
+	uint instanceIndex = dispatchThreadID.x;
+
+	// Threads past the end still reach the barriers below.
+	bool visible = false;
+	if(instanceIndex < gInstanceCount)
+		visible = IsVisible(gCullInstances[instanceIndex]);
+
+	// Reserve a slot within the group first, so the count in the draw arguments
+	// takes one atomic per group rather than one per visible instance.
+	uint groupSlot = 0;
+	if(visible)
+		InterlockedAdd(gGroupVisibleCount, 1, groupSlot);
+
+	GroupMemoryBarrierWithGroupSync();
+
+	if(groupThreadID.x == 0)
+		gDrawArgs.InterlockedAdd(4, gGroupVisibleCount, gGroupFirstSlot);
+
+	GroupMemoryBarrierWithGroupSync();
+
+	if(visible)
+		gVisibleInstances[gGroupFirstSlot + groupSlot] = instanceIndex;
+}
@@ -49,6 +49,11 @@ Texture2D gDiffuseMap[7] : register(t0);
 StructuredBuffer<InstanceData> gInstanceData : register(t0, space1);
 StructuredBuffer<MaterialData> gMaterialData : register(t1, space1);
 
+#ifdef GPU_CULLING
+// Indices of the visible instances, written by CullInstances.hlsl.
+StructuredBuffer<uint> gVisibleInstances : register(t2, space1);
+#endif
+
 SamplerState gsamPointWrap        : register(s0);
 SamplerState gsamPointClamp       : register(s1);
 SamplerState gsamLinearWrap       : register(s2);
@@ -82,11 +87,13 @@ cbuffer cbPass : register(b0)
     Light gLights[MaxLights];
 };
 
+// Quantized vertex (see VertexQuantizer.h).  PosL is in [0, 1] across the bounds of
+// the mesh; the instance world matrix maps it back to object space first.
 struct VertexIn
 {
-	float3 PosL    : POSITION;
-    float3 NormalL : NORMAL;
-	float2 TexC    : TEXCOORD;
+	float3 PosL      : POSITION;
+    float2 NormalOct : NORMAL;
+	float2 TexC      : TEXCOORD;
 };
 
 struct VertexOut
@@ -101,10 +108,24 @@ struct VertexOut
 	nointerpolation uint MatIndex  : MATINDEX;
 };
 
+// Unfolds a unit vector stored as an octahedral encoding.
+float3 DecodeOctahedral(float2 e)
+{
+	float3 v = float3(e, 1.0f - abs(e.x) - abs(e.y));
+	float t = saturate(-v.z);
+	v.xy += (v.xy >= 0.0f) ? -t : t;
+	return normalize(v);
+}
+
 VertexOut VS(VertexIn vin, uint instanceID : SV_InstanceID)
 {
 	VertexOut vout = (VertexOut)0.0f;
 	
+#ifdef GPU_CULLING
+	// gInstanceData holds every instance; look up which one this is.
+	instanceID = gVisibleInstances[instanceID];
+#endif
+
 	// Fetch the instance data.
 	InstanceData instData = gInstanceData[instanceID];
 	float4x4 world = instData.World;
@@ -121,7 +142,7 @@ VertexOut VS(VertexIn vin, uint instanceID : SV_InstanceID)
     vout.PosW = posW.xyz;
 
     // Assumes nonuniform scaling; otherwise, need to use inverse-transpose of world matrix.
-    vout.NormalW = mul(vin.NormalL, (float3x3)world);
+    vout.NormalW = mul(DecodeOctahedral(vin.NormalOct), (float3x3)world);
 
     // Transform to homogeneous clip space.
     vout.PosH = mul(posW, gViewProj);
@@ -7,6 +7,8 @@
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/GeometryGenerator.h"
 #include "../../Common/Camera.h"
+#include "../../Common/SceneBVH.h"
+#include "../../Common/MeshletBuilder.h"
 #include "FrameResource.h"
 
 using Microsoft::WRL::ComPtr;
@@ -48,6 +50,14 @@ struct RenderItem
 	Material* Mat = nullptr;
 	MeshGeometry* Geo = nullptr;
 
+	// Triangle hierarchy of the submesh this item draws, used for picking.
+	const TriangleBVH* TriangleBvh = nullptr;
+
+	// Meshlets of the submesh, whose triangles are stored in meshlet order, and the
+	// ones that passed culling this frame.  Null to draw the whole submesh.
+	const MeshletBuilder::MeshletData* Meshlets = nullptr;
+	std::vector<std::uint32_t> VisibleMeshlets;
+
     // Primitive topology.
     D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 
@@ -88,6 +98,8 @@ private:
 	void UpdateObjectCBs(const GameTimer& gt);
 	void UpdateMaterialBuffer(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
+	void UpdatePickingScene();
+	void UpdateVisibleMeshlets();
 
 	void LoadTextures();
     void BuildRootSignature();
@@ -120,6 +132,7 @@ private:
 	std::unordered_map<std::string, std::unique_ptr<Texture>> mTextures;
 	std::unordered_map<std::string, ComPtr<ID3DBlob>> mShaders;
 	std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> mPSOs;
+	std::unordered_map<std::string, MeshletBuilder::MeshletData> mMeshlets;
 
     std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
  
@@ -131,10 +144,17 @@ private:
 
 	RenderItem* mPickedRitem = nullptr;
 
+	// Broad phase over the pickable render items.  mPickableRitems[i] is item i of
+	// mPickScene.
+	SceneBVH mPickScene;
+	std::vector<RenderItem*> mPickableRitems;
+
     PassConstants mMainPassCB;
 
 	Camera mCamera;
 
+	BoundingFrustum mCamFrustum;
+
     POINT mLastMousePos;
 };
 
@@ -215,6 +235,8 @@ void PickingApp::OnResize()
     D3DApp::OnResize();
 
 	mCamera.SetLens(0.25f*MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
+
+	BoundingFrustum::CreateFromMatrix(mCamFrustum, mCamera.GetProj());
 }
 
 void PickingApp::Update(const GameTimer& gt)
@@ -236,6 +258,10 @@ void PickingApp::Update(const GameTimer& gt)
     }
 
 	AnimateMaterials(gt);
+
+	// Must run before UpdateObjectCBs() counts down the dirty flags.
+	UpdatePickingScene();
+	UpdateVisibleMeshlets();
 	UpdateObjectCBs(gt);
 	UpdateMaterialBuffer(gt);
 	UpdateMainPassCB(gt);
@@ -399,6 +425,49 @@ void PickingApp::UpdateObjectCBs(const GameTimer& gt)
 	}
 }
 
+void PickingApp::UpdatePickingScene()
+{
+	for(size_t i = 0; i < mPickableRitems.size(); ++i)
+	{
+		RenderItem* ri = mPickableRitems[i];
+
+		// An item is marked dirty with NumFramesDirty = gNumFrameResources, and
+		// UpdateObjectCBs() counts it down from there.  So each change is seen here
+		// exactly once, and items that did not change cost nothing.
+		if(ri->NumFramesDirty == gNumFrameResources)
+			mPickScene.SetWorld((UINT)i, XMLoadFloat4x4(&ri->World));
+
+		mPickScene.SetEnabled((UINT)i, ri->Visible);
+	}
+
+	// Refit the hierarchy above the items that moved.
+	mPickScene.Update();
+}
+
+void PickingApp::UpdateVisibleMeshlets()
+{
+	XMMATRIX view = mCamera.GetView();
+	XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
+
+	for(auto ri : mRitemLayer[(int)RenderLayer::Opaque])
+	{
+		if(ri->Meshlets == nullptr)
+			continue;
+
+		XMMATRIX world = XMLoadFloat4x4(&ri->World);
+		XMMATRIX invWorld = XMMatrixInverse(&XMMatrixDeterminant(world), world);
+
+		// Cull in the local space of the mesh, where the meshlet bounds are.
+		BoundingFrustum localSpaceFrustum;
+		mCamFrustum.Transform(localSpaceFrustum, invView*invWorld);
+
+		XMVECTOR localEyePos = XMVector3TransformCoord(mCamera.GetPosition(), invWorld);
+
+		ri->VisibleMeshlets.clear();
+		MeshletBuilder::Cull(*ri->Meshlets, localSpaceFrustum, localEyePos, ri->VisibleMeshlets);
+	}
+}
+
 void PickingApp::UpdateMaterialBuffer(const GameTimer& gt)
 {
 	auto currMaterialBuffer = mCurrFrameResource->MaterialBuffer.get();
@@ -607,7 +676,7 @@ void PickingApp::BuildCarGeometry()
 	fin >> ignore;
 	fin >> ignore;
 
-	std::vector<std::int32_t> indices(3 * tcount);
+	std::vector<std::uint32_t> indices(3 * tcount);
 	for(UINT i = 0; i < tcount; ++i)
 	{
 		fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
@@ -615,13 +684,20 @@ void PickingApp::BuildCarGeometry()
 
 	fin.close();
 
+	// Split the car into meshlets and store its triangles in meshlet order, so the
+	// meshlets that pass culling are ranges of the index buffer.
+	auto& meshlets = mMeshlets["car"];
+	MeshletBuilder::Build(indices.data(), (UINT)indices.size(), 0, vcount,
+		&vertices[0].Pos, sizeof(Vertex), meshlets);
+	MeshletBuilder::BuildIndexList(meshlets, indices);
+
 	//
 	// Pack the indices of all the meshes into one index buffer.
 	//
 
 	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
 
-	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::int32_t);
+	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint32_t);
 
 	auto geo = std::make_unique<MeshGeometry>();
 	geo->Name = "carGeo";
@@ -651,6 +727,11 @@ void PickingApp::BuildCarGeometry()
 
 	geo->DrawArgs["car"] = submesh;
 
+	// Build the picking hierarchy once here instead of testing every triangle per pick.
+	auto bvh = std::make_unique<TriangleBVH>();
+	bvh->Build(&vertices[0].Pos, sizeof(Vertex), indices.data(), tcount);
+	geo->TriangleBvhs["car"] = std::move(bvh);
+
 	mGeometries[geo->Name] = std::move(geo);
 }
 
@@ -760,6 +841,8 @@ void PickingApp::BuildRenderItems()
 	carRitem->IndexCount = carRitem->Geo->DrawArgs["car"].IndexCount;
 	carRitem->StartIndexLocation = carRitem->Geo->DrawArgs["car"].StartIndexLocation;
 	carRitem->BaseVertexLocation = carRitem->Geo->DrawArgs["car"].BaseVertexLocation;
+	carRitem->TriangleBvh = carRitem->Geo->TriangleBvhs["car"].get();
+	carRitem->Meshlets = &mMeshlets["car"];
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(carRitem.get());
 
 	auto pickedRitem = std::make_unique<RenderItem>();
@@ -783,6 +866,18 @@ void PickingApp::BuildRenderItems()
 
 	mAllRitems.push_back(std::move(carRitem));
 	mAllRitems.push_back(std::move(pickedRitem));
+
+	// Only opaque items with picking data can be picked.  A real app might keep a
+	// separate "picking list" of objects that can be selected.
+	for(auto ri : mRitemLayer[(int)RenderLayer::Opaque])
+	{
+		if(ri->TriangleBvh == nullptr)
+			continue;
+
+		mPickScene.AddItem(ri->Bounds, ri->TriangleBvh, XMLoadFloat4x4(&ri->World));
+		mPickableRitems.push_back(ri);
+	}
+	mPickScene.Update();
 }
 
 void PickingApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
@@ -807,7 +902,33 @@ void PickingApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::
 
 		cmdList->SetGraphicsRootConstantBufferView(0, objCBAddress);
 
-        cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+		if(ri->Meshlets == nullptr)
+		{
+			cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+			continue;
+		}
+
+		// Draw the visible meshlets, merging neighbours in the index buffer into
+		// one draw.
+		const auto& meshlets = ri->Meshlets->Meshlets;
+		for(size_t j = 0; j < ri->VisibleMeshlets.size(); )
+		{
+			const auto& first = meshlets[ri->VisibleMeshlets[j]];
+			UINT triangleStart = first.TriangleOffset;
+			UINT triangleEnd = first.TriangleOffset + first.TriangleCount;
+
+			for(++j; j < ri->VisibleMeshlets.size(); ++j)
+			{
+				const auto& next = meshlets[ri->VisibleMeshlets[j]];
+				if(next.TriangleOffset != triangleEnd)
+					break;
+
+				triangleEnd += next.TriangleCount;
+			}
+
+			cmdList->DrawIndexedInstanced(3 * (triangleEnd - triangleStart), 1,
+				ri->StartIndexLocation + 3 * triangleStart, ri->BaseVertexLocation, 0);
+		}
     }
 }
 
@@ -883,82 +1004,32 @@ void PickingApp::Pick(int sx, int sy)
 	XMMATRIX V = mCamera.GetView();
 	XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(V), V);
 
+	// Transform the ray to world space once.  The scene moves it into the local space
+	// of each item it reaches with the cached inverse world matrix.
+	XMVECTOR worldOrigin = XMVector3TransformCoord(rayOrigin, invView);
+	XMVECTOR worldDir = XMVector3Normalize(XMVector3TransformNormal(rayDir, invView));
+
 	// Assume nothing is picked to start, so the picked render-item is invisible.
 	mPickedRitem->Visible = false;
 
-	// Check if we picked an opaque render item.  A real app might keep a separate "picking list"
-	// of objects that can be selected.   
-	for(auto ri : mRitemLayer[(int)RenderLayer::Opaque])
+	// Invisible render-items are disabled in the scene and never hit.  The broad phase
+	// only visits the items whose world bounds the ray passes through.
+	float tmin = 0.0f;
+	UINT item = 0;
+	UINT triangle = 0;
+	if(mPickScene.Intersects(worldOrigin, worldDir, tmin, item, triangle))
 	{
-		auto geo = ri->Geo;
-
-		// Skip invisible render-items.
-		if(ri->Visible == false)
-			continue;
-
-		XMMATRIX W = XMLoadFloat4x4(&ri->World);
-		XMMATRIX invWorld = XMMatrixInverse(&XMMatrixDeterminant(W), W);
+		RenderItem* ri = mPickableRitems[item];
 
-		// Tranform ray to vi space of Mesh.
-		XMMATRIX toLocal = XMMatrixMultiply(invView, invWorld);
+		mPickedRitem->Visible = true;
+		mPickedRitem->IndexCount = 3;
+		mPickedRitem->BaseVertexLocation = ri->BaseVertexLocation;
 
-		rayOrigin = XMVector3TransformCoord(rayOrigin, toLocal);
-		rayDir = XMVector3TransformNormal(rayDir, toLocal);
+		// Picked render item needs same world matrix as object picked.
+		mPickedRitem->World = ri->World;
+		mPickedRitem->NumFramesDirty = gNumFrameResources;
 
-		// Make the ray direction unit length for the intersection tests.
-		rayDir = XMVector3Normalize(rayDir);
-
-		// If we hit the bounding box of the Mesh, then we might have picked a Mesh triangle,
-		// so do the ray/triangle tests.
-		//
-		// If we did not hit the bounding box, then it is impossible that we hit 
-		// the Mesh, so do not waste effort doing ray/triangle tests.
-		float tmin = 0.0f;
-		if(ri->Bounds.Intersects(rayOrigin, rayDir, tmin))
-		{
-			// NOTE: For the demo, we know what to cast the vertex/index data to.  If we were mixing
-			// formats, some metadata would be needed to figure out what to cast it to.
-			auto vertices = (Vertex*)geo->VertexBufferCPU->GetBufferPointer();
-			auto indices = (std::uint32_t*)geo->IndexBufferCPU->GetBufferPointer();
-			UINT triCount = ri->IndexCount / 3;
-
-			// Find the nearest ray/triangle intersection.
-			tmin = MathHelper::Infinity;
-			for(UINT i = 0; i < triCount; ++i)
-			{
-				// Indices for this triangle.
-				UINT i0 = indices[i * 3 + 0];
-				UINT i1 = indices[i * 3 + 1];
-				UINT i2 = indices[i * 3 + 2];
-
-				// Vertices for this triangle.
-				XMVECTOR v0 = XMLoadFloat3(&vertices[i0].Pos);
-				XMVECTOR v1 = XMLoadFloat3(&vertices[i1].Pos);
-				XMVECTOR v2 = XMLoadFloat3(&vertices[i2].Pos);
-
-				// We have to iterate over all the triangles in order to find the nearest intersection.
-				float t = 0.0f;
-				if(TriangleTests::Intersects(rayOrigin, rayDir, v0, v1, v2, t))
-				{
-					if(t < tmin)
-					{
-						// This is the new nearest picked triangle.
-						tmin = t;
-						UINT pickedTriangle = i;
-
-						mPickedRitem->Visible = true;
-						mPickedRitem->IndexCount = 3;
-						mPickedRitem->BaseVertexLocation = 0;
-
-						// Picked render item needs same world matrix as object picked.
-						mPickedRitem->World = ri->World;
-						mPickedRitem->NumFramesDirty = gNumFrameResources;
-
-						// Offset to the picked triangle in the mesh index buffer.
-						mPickedRitem->StartIndexLocation = 3 * pickedTriangle;
-					}
-				}
-			}
-		}
+		// Offset to the picked triangle in the mesh index buffer.
+		mPickedRitem->StartIndexLocation = ri->StartIndexLocation + 3 * triangle;
 	}
 }
\ No newline at end of file
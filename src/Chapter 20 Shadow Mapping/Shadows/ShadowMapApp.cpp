@@ -6,6 +6,7 @@
 #include "../../Common/MathHelper.h"
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/GeometryGenerator.h"
+#include "../../Common/TangentGenerator.h"
 #include "../../Common/Camera.h"
 #include "FrameResource.h"
 #include "ShadowMap.h"
@@ -972,34 +973,17 @@ void ShadowMapApp::BuildSkullGeometry()
     XMVECTOR vMin = XMLoadFloat3(&vMinf3);
     XMVECTOR vMax = XMLoadFloat3(&vMaxf3);
 
-    std::vector<Vertex> vertices(vcount);
+    GeometryGenerator::MeshData skull;
+    skull.Vertices.resize(vcount);
     for (UINT i = 0; i < vcount; ++i)
     {
-        fin >> vertices[i].Pos.x >> vertices[i].Pos.y >> vertices[i].Pos.z;
-        fin >> vertices[i].Normal.x >> vertices[i].Normal.y >> vertices[i].Normal.z;
-
-        vertices[i].TexC = { 0.0f, 0.0f };
-
-        XMVECTOR P = XMLoadFloat3(&vertices[i].Pos);
-
-        XMVECTOR N = XMLoadFloat3(&vertices[i].Normal);
-
-        // Generate a tangent vector so normal mapping works.  We aren't applying
-        // a texture map to the skull, so we just need any tangent vector so that
-        // the math works out to give us the original interpolated vertex normal.
-        XMVECTOR up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
-        if(fabsf(XMVectorGetX(XMVector3Dot(N, up))) < 1.0f - 0.001f)
-        {
-            XMVECTOR T = XMVector3Normalize(XMVector3Cross(up, N));
-            XMStoreFloat3(&vertices[i].TangentU, T);
-        }
-        else
-        {
-            up = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
-            XMVECTOR T = XMVector3Normalize(XMVector3Cross(N, up));
-            XMStoreFloat3(&vertices[i].TangentU, T);
-        }
-        
+        GeometryGenerator::Vertex& v = skull.Vertices[i];
+        fin >> v.Position.x >> v.Position.y >> v.Position.z;
+        fin >> v.Normal.x >> v.Normal.y >> v.Normal.z;
+
+        v.TexC = { 0.0f, 0.0f };
+
+        XMVECTOR P = XMLoadFloat3(&v.Position);
 
         vMin = XMVectorMin(vMin, P);
         vMax = XMVectorMax(vMax, P);
@@ -1013,21 +997,38 @@ void ShadowMapApp::BuildSkullGeometry()
     fin >> ignore;
     fin >> ignore;
 
-    std::vector<std::int32_t> indices(3 * tcount);
+    skull.Indices32.resize(3 * tcount);
     for (UINT i = 0; i < tcount; ++i)
     {
-        fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
+        fin >> skull.Indices32[i * 3 + 0] >> skull.Indices32[i * 3 + 1] >> skull.Indices32[i * 3 + 2];
     }
 
     fin.close();
 
+    // Generate tangent vectors so normal mapping works.  We aren't applying a
+    // texture map to the skull, so every texture coordinate is zero and the
+    // generator just picks a tangent perpendicular to each normal, which makes the
+    // math give back the original interpolated vertex normal.
+    TangentGenerator::ComputeTangents(skull);
+
+    std::vector<Vertex> vertices(skull.Vertices.size());
+    for (size_t i = 0; i < skull.Vertices.size(); ++i)
+    {
+        vertices[i].Pos = skull.Vertices[i].Position;
+        vertices[i].Normal = skull.Vertices[i].Normal;
+        vertices[i].TexC = skull.Vertices[i].TexC;
+        vertices[i].TangentU = skull.Vertices[i].TangentU;
+    }
+
+    const std::vector<std::uint32_t>& indices = skull.Indices32;
+
     //
     // Pack the indices of all the meshes into one index buffer.
     //
 
     const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
 
-    const UINT ibByteSize = (UINT)indices.size() * sizeof(std::int32_t);
+    const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint32_t);
 
     auto geo = std::make_unique<MeshGeometry>();
     geo->Name = "skullGeo";
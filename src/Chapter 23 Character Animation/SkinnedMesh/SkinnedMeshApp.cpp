@@ -7,6 +7,9 @@
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/GeometryGenerator.h"
 #include "../../Common/Camera.h"
+#include "../../Common/MeshOptimizer.h"
+#include "../../Common/TextureStreamer.h"
+#include "../../Common/MipResidency.h"
 #include "FrameResource.h"
 #include "ShadowMap.h"
 #include "Ssao.h"
@@ -19,6 +22,9 @@ using namespace DirectX::PackedVector;
 
 const int gNumFrameResources = 3;
 
+// Streamed textures start out with their mips no larger than this.
+const UINT gTextureTailSize = 64;
+
 struct SkinnedModelInstance
 {
     SkinnedData* SkinnedInfo = nullptr;
@@ -57,6 +63,11 @@ struct RenderItem
 
 	XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
 
+	// World space bounds, and texture coordinate units per world unit, from which
+	// the mip its textures need at a given distance follows.
+	DirectX::BoundingSphere Bounds;
+	float UvDensity = 0.0f;
+
 	// Dirty flag indicating the object data has changed and we need to update the constant buffer.
 	// Because we have an object cbuffer for each FrameResource, we have to apply the
 	// update to each FrameResource.  Thus, when we modify obect data we should set 
@@ -122,11 +133,14 @@ private:
 	void UpdateMainPassCB(const GameTimer& gt);
     void UpdateShadowPassCB(const GameTimer& gt);
     void UpdateSsaoCB(const GameTimer& gt);
+    void UpdateTextureResidency(const GameTimer& gt);
 
 	void LoadTextures();
+	void OnTextureLoaded(Texture& texture, const DDSParser::TextureDesc& file);
     void BuildRootSignature();
     void BuildSsaoRootSignature();
 	void BuildDescriptorHeaps();
+	void BuildLoadingSkyTable();
     void BuildShadersAndInputLayout();
     void BuildShapeGeometry();
 	void LoadSkinnedModel();
@@ -134,12 +148,14 @@ private:
     void BuildFrameResources();
     void BuildMaterials();
     void BuildRenderItems();
+    void ComputeTexelDensity(RenderItem* ri);
     void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
     void DrawSceneToShadowMap();
 	void DrawNormalsAndDepth();
 
     CD3DX12_CPU_DESCRIPTOR_HANDLE GetCpuSrv(int index)const;
     CD3DX12_GPU_DESCRIPTOR_HANDLE GetGpuSrv(int index)const;
+    UINT GetTexSrvIndex(UINT index)const;
     CD3DX12_CPU_DESCRIPTOR_HANDLE GetDsv(int index)const;
     CD3DX12_CPU_DESCRIPTOR_HANDLE GetRtv(int index)const;
 
@@ -176,10 +192,28 @@ private:
     UINT mSsaoHeapIndexStart = 0;
     UINT mSsaoAmbientMapIndex = 0;
 
+    // Texture behind each texture SRV slot, and the slot actually used for it: its
+    // placeholder's until the texture has streamed in, then the slot itself or its
+    // alternate, taking turns each time the texture's mips change.
+    std::vector<std::string> mTexSrvNames;
+    std::vector<UINT> mTexSrvIndices;
+    std::unordered_map<std::string, std::string> mTexturePlaceholders;
+    UINT mTexSrvAltStart = 0;
+
+    // Streamed 2D textures by MipResidency id, and their ids by name.
+    std::vector<Texture*> mResidentTextures;
+    std::unordered_map<std::string, UINT> mResidencyIds;
+
     UINT mNullCubeSrvIndex = 0;
     UINT mNullTexSrvIndex1 = 0;
     UINT mNullTexSrvIndex2 = 0;
 
+    // A copy of the sky, shadow map and SSAO map table with the null cube map in
+    // the sky's place.  Draw binds it until the sky has streamed in, so the sky's
+    // own slot is written while no frame reads it.
+    UINT mLoadingSkyTableIndex = 0;
+    bool mSkyLoaded = false;
+
     CD3DX12_GPU_DESCRIPTOR_HANDLE mNullSrv;
 
     PassConstants mMainPassCB;  // index 0 of pass cbuffer.
@@ -199,6 +233,9 @@ private:
 
     std::unique_ptr<Ssao> mSsao;
 
+    std::unique_ptr<TextureStreamer> mTextureStreamer;
+    std::unique_ptr<MipResidency> mMipResidency;
+
     DirectX::BoundingSphere mSceneBounds;
 
     float mLightNearZ = 0.0f;
@@ -277,6 +314,13 @@ bool SkinnedMeshApp::Initialize()
         mCommandList.Get(),
         mClientWidth, mClientHeight);
 
+    mTextureStreamer = std::make_unique<TextureStreamer>(md3dDevice.Get(), gNumFrameResources);
+
+    MipResidency::Settings residencySettings;
+    residencySettings.Budget = 32ull * 1024 * 1024;
+    residencySettings.ChangeDelay = gNumFrameResources;
+    mMipResidency = std::make_unique<MipResidency>(residencySettings);
+
     LoadSkinnedModel();
 	LoadTextures();
     BuildRootSignature();
@@ -335,6 +379,8 @@ void SkinnedMeshApp::OnResize()
 
         // Resources changed, so need to rebuild descriptors.
         mSsao->RebuildDescriptors(mDepthStencilBuffer.Get());
+        if(!mSkyLoaded)
+            BuildLoadingSkyTable();
     }
 }
 
@@ -378,6 +424,7 @@ void SkinnedMeshApp::Update(const GameTimer& gt)
 	UpdateMainPassCB(gt);
     UpdateShadowPassCB(gt);
     UpdateSsaoCB(gt);
+    UpdateTextureResidency(gt);
 }
 
 void SkinnedMeshApp::Draw(const GameTimer& gt)
@@ -392,6 +439,9 @@ void SkinnedMeshApp::Draw(const GameTimer& gt)
     // Reusing the command list reuses memory.
     ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), mPSOs["opaque"].Get()));
 
+    // Upload the textures that finished loading since the last frame.
+    mTextureStreamer->Update(mCommandList.Get());
+
     ID3D12DescriptorHeap* descriptorHeaps[] = { mSrvDescriptorHeap.Get() };
     mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
 
@@ -471,7 +521,7 @@ void SkinnedMeshApp::Draw(const GameTimer& gt)
     // index into an array of cube maps.
 
     CD3DX12_GPU_DESCRIPTOR_HANDLE skyTexDescriptor(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-    skyTexDescriptor.Offset(mSkyTexHeapIndex, mCbvSrvUavDescriptorSize);
+    skyTexDescriptor.Offset(mSkyLoaded ? mSkyTexHeapIndex : mLoadingSkyTableIndex, mCbvSrvUavDescriptorSize);
     mCommandList->SetGraphicsRootDescriptorTable(4, skyTexDescriptor);
 
     mCommandList->SetPipelineState(mPSOs["opaque"].Get());
@@ -621,8 +671,8 @@ void SkinnedMeshApp::UpdateMaterialBuffer(const GameTimer& gt)
 			matData.FresnelR0 = mat->FresnelR0;
 			matData.Roughness = mat->Roughness;
 			XMStoreFloat4x4(&matData.MatTransform, XMMatrixTranspose(matTransform));
-			matData.DiffuseMapIndex = mat->DiffuseSrvHeapIndex;
-			matData.NormalMapIndex = mat->NormalSrvHeapIndex;
+			matData.DiffuseMapIndex = GetTexSrvIndex(mat->DiffuseSrvHeapIndex);
+			matData.NormalMapIndex = GetTexSrvIndex(mat->NormalSrvHeapIndex);
 
 			currMaterialBuffer->CopyData(mat->MatCBIndex, matData);
 
@@ -784,6 +834,46 @@ void SkinnedMeshApp::UpdateSsaoCB(const GameTimer& gt)
     currSsaoCB->CopyData(0, ssaoCB);
 }
 
+void SkinnedMeshApp::UpdateTextureResidency(const GameTimer& gt)
+{
+    // World units a pixel covers per world unit of distance from the camera.
+    float pixelSpread = 2.0f*tanf(0.5f*mCamera.GetFovY()) / mClientHeight;
+    XMVECTOR eyePos = mCamera.GetPosition();
+
+    for(int layer : { (int)RenderLayer::Opaque, (int)RenderLayer::SkinnedOpaque })
+    {
+        for(auto ri : mRitemLayer[layer])
+        {
+            if(ri->UvDensity <= 0.0f)
+                continue;
+
+            // The nearest point of the bounds decides, but never nearer than the near plane.
+            float distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&ri->Bounds.Center) - eyePos)) - ri->Bounds.Radius;
+            float uvPerPixel = ri->UvDensity*pixelSpread*std::max(distance, mCamera.GetNearZ());
+
+            for(int srvIndex : { ri->Mat->DiffuseSrvHeapIndex, ri->Mat->NormalSrvHeapIndex })
+            {
+                if(srvIndex < 0 || srvIndex >= (int)mTexSrvNames.size())
+                    continue;
+
+                auto it = mResidencyIds.find(mTexSrvNames[srvIndex]);
+                if(it != mResidencyIds.end())
+                    mMipResidency->ReportUsage(it->second, uvPerPixel);
+            }
+        }
+    }
+
+    mMipResidency->Update();
+
+    // Mip changes queue behind the first loads of the textures still missing.
+    for(const auto& change : mMipResidency->GetChanges())
+    {
+        mTextureStreamer->Load(mResidentTextures[change.Texture], -1,
+            [this](Texture& texture, const DDSParser::TextureDesc& file) { OnTextureLoaded(texture, file); },
+            change.MaxSize);
+    }
+}
+
 void SkinnedMeshApp::LoadTextures()
 {
 	std::vector<std::string> texNames = 
@@ -808,6 +898,24 @@ void SkinnedMeshApp::LoadTextures()
 		L"../../Textures/desertcube1024.dds"
 	};
 
+	// Textures with a placeholder stream in on worker threads, highest priority
+	// first, and materials show the placeholder until they arrive.  The sky shows
+	// the null cube map.  Textures with no placeholder are loaded right away.
+	// Streamed 2D textures only bring their tail mips; UpdateTextureResidency
+	// loads finer ones as the camera needs them.
+	std::vector<std::string> texPlaceholders =
+	{
+		"defaultDiffuseMap",
+		"defaultNormalMap",
+		"defaultDiffuseMap",
+		"defaultNormalMap",
+		"",
+		"",
+		""
+	};
+
+	std::vector<int> texPriorities = { 2, 0, 2, 0, 0, 0, 1 };
+
     // Add skinned model textures to list so we can reference by name later.
     for(UINT i = 0; i < mSkinnedMats.size(); ++i)
     {
@@ -824,10 +932,14 @@ void SkinnedMeshApp::LoadTextures()
         mSkinnedTextureNames.push_back(diffuseName);
         texNames.push_back(diffuseName);
         texFilenames.push_back(diffuseFilename);
+        texPlaceholders.push_back("defaultDiffuseMap");
+        texPriorities.push_back(3);
 
         mSkinnedTextureNames.push_back(normalName);
         texNames.push_back(normalName);
         texFilenames.push_back(normalFilename);
+        texPlaceholders.push_back("defaultNormalMap");
+        texPriorities.push_back(0);
     }
 	
 	for(int i = 0; i < (int)texNames.size(); ++i)
@@ -838,15 +950,80 @@ void SkinnedMeshApp::LoadTextures()
             auto texMap = std::make_unique<Texture>();
             texMap->Name = texNames[i];
             texMap->Filename = texFilenames[i];
-            ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
-                mCommandList.Get(), texMap->Filename.c_str(),
-                texMap->Resource, texMap->UploadHeap));
+
+            if(texNames[i] == "skyCubeMap" || !texPlaceholders[i].empty())
+            {
+                mTexturePlaceholders[texMap->Name] = texPlaceholders[i];
+                mTextureStreamer->Load(texMap.get(), texPriorities[i],
+                    [this](Texture& texture, const DDSParser::TextureDesc& file) { OnTextureLoaded(texture, file); },
+                    texNames[i] == "skyCubeMap" ? 0 : gTextureTailSize);
+            }
+            else
+            {
+                ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(md3dDevice.Get(),
+                    mCommandList.Get(), texMap->Filename.c_str(),
+                    texMap->Resource, texMap->UploadHeap));
+            }
 
             mTextures[texMap->Name] = std::move(texMap);
         }
 	}		
 }
 
+void SkinnedMeshApp::OnTextureLoaded(Texture& texture, const DDSParser::TextureDesc& file)
+{
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.Format = texture.Resource->GetDesc().Format;
+
+	if(texture.Name == "skyCubeMap")
+	{
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
+		srvDesc.TextureCube.MostDetailedMip = 0;
+		srvDesc.TextureCube.MipLevels = texture.Resource->GetDesc().MipLevels;
+		srvDesc.TextureCube.ResourceMinLODClamp = 0.0f;
+		md3dDevice->CreateShaderResourceView(texture.Resource.Get(), &srvDesc, GetCpuSrv(mSkyTexHeapIndex));
+
+		// No frame has bound the sky's table yet; from now on Draw binds it.
+		mSkyLoaded = true;
+		return;
+	}
+
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MostDetailedMip = 0;
+	srvDesc.Texture2D.MipLevels = texture.Resource->GetDesc().MipLevels;
+	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
+
+	// The first load brings the tail, the rest are changes MipResidency asked for.
+	auto it = mResidencyIds.find(texture.Name);
+	if(it == mResidencyIds.end())
+	{
+		UINT firstMip = file.MipLevels - texture.Resource->GetDesc().MipLevels;
+		mResidencyIds[texture.Name] = mMipResidency->AddTexture(file, firstMip);
+		mResidentTextures.push_back(&texture);
+	}
+	else
+	{
+		mMipResidency->CompleteChange(it->second);
+	}
+
+	// Write the slot not in use.  The last frame to read it was drawn at least
+	// ChangeDelay frames ago, so no frame still in flight can be reading it.
+	for(UINT i = 0; i < (UINT)mTexSrvNames.size(); ++i)
+	{
+		if(mTexSrvNames[i] == texture.Name)
+		{
+			UINT slot = mTexSrvIndices[i] == i ? mTexSrvAltStart + i : i;
+			md3dDevice->CreateShaderResourceView(texture.Resource.Get(), &srvDesc, GetCpuSrv(slot));
+			mTexSrvIndices[i] = slot;
+		}
+	}
+
+	// Rewrite the material buffer of every frame resource with the new indices.
+	for(auto& e : mMaterials)
+		e.second->NumFramesDirty = gNumFrameResources;
+}
+
 void SkinnedMeshApp::BuildRootSignature()
 {
 	CD3DX12_DESCRIPTOR_RANGE texTable0;
@@ -986,27 +1163,33 @@ void SkinnedMeshApp::BuildDescriptorHeaps()
 	//
 	CD3DX12_CPU_DESCRIPTOR_HANDLE hDescriptor(mSrvDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
 
-	std::vector<ComPtr<ID3D12Resource>> tex2DList = 
+	mTexSrvNames = 
 	{
-		mTextures["bricksDiffuseMap"]->Resource,
-		mTextures["bricksNormalMap"]->Resource,
-		mTextures["tileDiffuseMap"]->Resource,
-		mTextures["tileNormalMap"]->Resource,
-		mTextures["defaultDiffuseMap"]->Resource,
-		mTextures["defaultNormalMap"]->Resource
+		"bricksDiffuseMap",
+		"bricksNormalMap",
+		"tileDiffuseMap",
+		"tileNormalMap",
+		"defaultDiffuseMap",
+		"defaultNormalMap"
 	};
 
-    mSkinnedSrvHeapStart = (UINT)tex2DList.size();
+    mSkinnedSrvHeapStart = (UINT)mTexSrvNames.size();
 
-    for(UINT i = 0; i < (UINT)mSkinnedTextureNames.size(); ++i)
-    {
-        auto texResource = mTextures[mSkinnedTextureNames[i]]->Resource;
-        assert(texResource != nullptr);
-        tex2DList.push_back(texResource);
-    }
-	
+    mTexSrvNames.insert(mTexSrvNames.end(),
+        mSkinnedTextureNames.begin(), mSkinnedTextureNames.end());
+
+	mSkyTexHeapIndex = (UINT)mTexSrvNames.size();
+    mShadowMapHeapIndex = mSkyTexHeapIndex + 1;
+    mSsaoHeapIndexStart = mShadowMapHeapIndex + 1;
+    mSsaoAmbientMapIndex = mSsaoHeapIndexStart + 3;
+    mNullCubeSrvIndex = mSsaoHeapIndexStart + 5;
+    mNullTexSrvIndex1 = mNullCubeSrvIndex + 1;
+    mNullTexSrvIndex2 = mNullTexSrvIndex1 + 1;
+    mLoadingSkyTableIndex = mNullTexSrvIndex2 + 1;
+    mTexSrvAltStart = mLoadingSkyTableIndex + 3;
 
-	auto skyCubeMap = mTextures["skyCubeMap"]->Resource;
+    // Material indices reach the alternate slots through gTextureMaps[48].
+    assert(mTexSrvAltStart + mTexSrvNames.size() <= 48);
 
 	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
@@ -1014,30 +1197,36 @@ void SkinnedMeshApp::BuildDescriptorHeaps()
 	srvDesc.Texture2D.MostDetailedMip = 0;
 	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
 	
-	for(UINT i = 0; i < (UINT)tex2DList.size(); ++i)
+	// Only the placeholders are loaded yet.  The slots of streamed textures get
+	// their descriptors in OnTextureLoaded; until then they redirect to the
+	// placeholder's slot.
+	for(UINT i = 0; i < (UINT)mTexSrvNames.size(); ++i)
 	{
-		srvDesc.Format = tex2DList[i]->GetDesc().Format;
-		srvDesc.Texture2D.MipLevels = tex2DList[i]->GetDesc().MipLevels;
-		md3dDevice->CreateShaderResourceView(tex2DList[i].Get(), &srvDesc, hDescriptor);
+		auto texResource = mTextures[mTexSrvNames[i]]->Resource;
+		if(texResource == nullptr)
+		{
+			const std::string& placeholder = mTexturePlaceholders[mTexSrvNames[i]];
+			auto it = std::find(mTexSrvNames.begin(), mTexSrvNames.end(), placeholder);
+			assert(it != mTexSrvNames.end());
+			mTexSrvIndices.push_back((UINT)(it - mTexSrvNames.begin()));
+		}
+		else
+		{
+			srvDesc.Format = texResource->GetDesc().Format;
+			srvDesc.Texture2D.MipLevels = texResource->GetDesc().MipLevels;
+			md3dDevice->CreateShaderResourceView(texResource.Get(), &srvDesc, hDescriptor);
+			mTexSrvIndices.push_back(i);
+		}
 
 		// next descriptor
 		hDescriptor.Offset(1, mCbvSrvUavDescriptorSize);
 	}
-	
+
 	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
 	srvDesc.TextureCube.MostDetailedMip = 0;
-	srvDesc.TextureCube.MipLevels = skyCubeMap->GetDesc().MipLevels;
+	srvDesc.TextureCube.MipLevels = 1;
 	srvDesc.TextureCube.ResourceMinLODClamp = 0.0f;
-	srvDesc.Format = skyCubeMap->GetDesc().Format;
-	md3dDevice->CreateShaderResourceView(skyCubeMap.Get(), &srvDesc, hDescriptor);
-	
-	mSkyTexHeapIndex = (UINT)tex2DList.size();
-    mShadowMapHeapIndex = mSkyTexHeapIndex + 1;
-    mSsaoHeapIndexStart = mShadowMapHeapIndex + 1;
-    mSsaoAmbientMapIndex = mSsaoHeapIndexStart + 3;
-    mNullCubeSrvIndex = mSsaoHeapIndexStart + 5;
-    mNullTexSrvIndex1 = mNullCubeSrvIndex + 1;
-    mNullTexSrvIndex2 = mNullTexSrvIndex1 + 1;
+	srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
 
     auto nullSrv = GetCpuSrv(mNullCubeSrvIndex);
     mNullSrv = GetGpuSrv(mNullCubeSrvIndex);
@@ -1067,6 +1256,37 @@ void SkinnedMeshApp::BuildDescriptorHeaps()
         GetRtv(SwapChainBufferCount),
         mCbvSrvUavDescriptorSize,
         mRtvDescriptorSize);
+
+    BuildLoadingSkyTable();
+}
+
+void SkinnedMeshApp::BuildLoadingSkyTable()
+{
+	// The same views the null SRVs, ShadowMap::BuildDescriptors and
+	// Ssao::RebuildDescriptors create.
+	auto hDescriptor = GetCpuSrv(mLoadingSkyTableIndex);
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
+	srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	srvDesc.TextureCube.MostDetailedMip = 0;
+	srvDesc.TextureCube.MipLevels = 1;
+	srvDesc.TextureCube.ResourceMinLODClamp = 0.0f;
+	md3dDevice->CreateShaderResourceView(nullptr, &srvDesc, hDescriptor);
+	hDescriptor.Offset(1, mCbvSrvUavDescriptorSize);
+
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Format = DXGI_FORMAT_R24_UNORM_X8_TYPELESS;
+	srvDesc.Texture2D.MostDetailedMip = 0;
+	srvDesc.Texture2D.MipLevels = 1;
+	srvDesc.Texture2D.ResourceMinLODClamp = 0.0f;
+	srvDesc.Texture2D.PlaneSlice = 0;
+	md3dDevice->CreateShaderResourceView(mShadowMap->Resource(), &srvDesc, hDescriptor);
+	hDescriptor.Offset(1, mCbvSrvUavDescriptorSize);
+
+	srvDesc.Format = Ssao::AmbientMapFormat;
+	md3dDevice->CreateShaderResourceView(mSsao->AmbientMap(), &srvDesc, hDescriptor);
 }
 
 void SkinnedMeshApp::BuildShadersAndInputLayout()
@@ -1135,6 +1355,12 @@ void SkinnedMeshApp::BuildShapeGeometry()
 	GeometryGenerator::MeshData sphere = geoGen.CreateSphere(0.5f, 20, 20);
 	GeometryGenerator::MeshData cylinder = geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20);
     GeometryGenerator::MeshData quad = geoGen.CreateQuad(0.0f, 0.0f, 1.0f, 1.0f, 0.0f);
+
+	// Reorder the triangles and vertices for the post-transform vertex cache.
+	MeshOptimizer::OptimizeMesh(box);
+	MeshOptimizer::OptimizeMesh(grid);
+	MeshOptimizer::OptimizeMesh(sphere);
+	MeshOptimizer::OptimizeMesh(cylinder);
     
 	//
 	// We are concatenating all the geometry into one big vertex/index buffer.  So
@@ -1283,6 +1509,20 @@ void SkinnedMeshApp::LoadSkinnedModel()
 	m3dLoader.LoadM3d(mSkinnedModelFilename, vertices, indices, 
         mSkinnedSubsets, mSkinnedMats, mSkinnedInfo);
 
+	// Reorder each subset for the post-transform vertex cache and overdraw.  The
+	// subsets keep their vertex and index ranges.  "GeometryTool mesh-stats"
+	// reports the cache statistics of the model before and after.
+	for(const auto& subset : mSkinnedSubsets)
+	{
+		std::vector<std::uint32_t> remap;
+
+		MeshOptimizer::OptimizeSubset(&indices[subset.FaceStart * 3], subset.FaceCount * 3,
+			subset.VertexStart, subset.VertexCount,
+			&vertices[0].Pos, sizeof(M3DLoader::SkinnedVertex), remap);
+
+		MeshOptimizer::RemapVertices(vertices, subset.VertexStart, remap);
+	}
+
     mSkinnedModelInst = std::make_unique<SkinnedModelInstance>();
     mSkinnedModelInst->SkinnedInfo = &mSkinnedInfo;
     mSkinnedModelInst->FinalTransforms.resize(mSkinnedInfo.BoneCount());
@@ -1758,6 +1998,52 @@ void SkinnedMeshApp::BuildRenderItems()
         mRitemLayer[(int)RenderLayer::SkinnedOpaque].push_back(ritem.get());
         mAllRitems.push_back(std::move(ritem));
     }
+
+    for(auto ri : mRitemLayer[(int)RenderLayer::Opaque])
+        ComputeTexelDensity(ri);
+    for(auto ri : mRitemLayer[(int)RenderLayer::SkinnedOpaque])
+        ComputeTexelDensity(ri);
+}
+
+void SkinnedMeshApp::ComputeTexelDensity(RenderItem* ri)
+{
+    static_assert(offsetof(Vertex, Pos) == offsetof(SkinnedVertex, Pos) &&
+        offsetof(Vertex, TexC) == offsetof(SkinnedVertex, TexC),
+        "Both vertex types must keep positions and texture coordinates in the same place.");
+
+    // Both geometries keep a CPU copy of their 16-bit indices and vertices.
+    auto vertices = reinterpret_cast<const BYTE*>(ri->Geo->VertexBufferCPU->GetBufferPointer()) +
+        ri->BaseVertexLocation*ri->Geo->VertexByteStride;
+    auto indices = reinterpret_cast<const std::uint16_t*>(ri->Geo->IndexBufferCPU->GetBufferPointer()) +
+        ri->StartIndexLocation;
+    auto positions = reinterpret_cast<const XMFLOAT3*>(vertices + offsetof(Vertex, Pos));
+    auto texCoords = reinterpret_cast<const XMFLOAT2*>(vertices + offsetof(Vertex, TexC));
+
+    XMMATRIX world = XMLoadFloat4x4(&ri->World);
+    XMMATRIX texTransform = XMLoadFloat4x4(&ri->TexTransform);
+
+    // Average scale of the world transform, and of the texture transform's area.
+    float worldScale = powf(fabsf(XMVectorGetX(XMMatrixDeterminant(world))), 1.0f/3.0f);
+    float texScale = sqrtf(fabsf(XMVectorGetX(XMMatrixDeterminant(texTransform))));
+    if(worldScale <= 0.0f)
+        return;
+
+    ri->UvDensity = MipResidency::ComputeUvDensity(positions, texCoords,
+        ri->Geo->VertexByteStride, indices, ri->IndexCount) * texScale / worldScale;
+
+    XMVECTOR vMin = XMVectorReplicate(+MathHelper::Infinity);
+    XMVECTOR vMax = XMVectorReplicate(-MathHelper::Infinity);
+    for(UINT i = 0; i < ri->IndexCount; ++i)
+    {
+        auto p = reinterpret_cast<const XMFLOAT3*>(vertices + indices[i]*ri->Geo->VertexByteStride);
+        vMin = XMVectorMin(vMin, XMLoadFloat3(p));
+        vMax = XMVectorMax(vMax, XMLoadFloat3(p));
+    }
+
+    BoundingBox bounds;
+    BoundingBox::CreateFromPoints(bounds, vMin, vMax);
+    bounds.Transform(bounds, world);
+    BoundingSphere::CreateFromBoundingBox(ri->Bounds, bounds);
 }
 
 void SkinnedMeshApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
@@ -1876,6 +2162,11 @@ CD3DX12_GPU_DESCRIPTOR_HANDLE SkinnedMeshApp::GetGpuSrv(int index)const
     return srv;
 }
 
+UINT SkinnedMeshApp::GetTexSrvIndex(UINT index)const
+{
+    return index < (UINT)mTexSrvIndices.size() ? mTexSrvIndices[index] : index;
+}
+
 CD3DX12_CPU_DESCRIPTOR_HANDLE SkinnedMeshApp::GetDsv(int index)const
 {
     auto dsv = CD3DX12_CPU_DESCRIPTOR_HANDLE(mDsvHeap->GetCPUDescriptorHandleForHeapStart());
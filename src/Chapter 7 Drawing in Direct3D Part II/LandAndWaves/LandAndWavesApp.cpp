@@ -2,12 +2,14 @@
 // LandAndWavesApp.cpp by Frank Luna (C) 2015 All Rights Reserved.
 //
 // Hold down '1' key to view scene in wireframe mode.
+// Use the arrow keys to move over the terrain, which streams in around the camera.
 //***************************************************************************************
 
 #include "../../Common/d3dApp.h"
 #include "../../Common/MathHelper.h"
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/GeometryGenerator.h"
+#include "../../Common/TerrainStreamer.h"
 #include "FrameResource.h"
 #include "Waves.h"
 
@@ -78,6 +80,7 @@ private:
 	void UpdateObjectCBs(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
 	void UpdateWaves(const GameTimer& gt);
+	void UpdateTerrain(const GameTimer& gt);
 
     void BuildRootSignature();
     void BuildShadersAndInputLayout();
@@ -87,6 +90,7 @@ private:
     void BuildFrameResources();
     void BuildRenderItems();
 	void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
+	void DrawTerrain(ID3D12GraphicsCommandList* cmdList);
 
     float GetHillsHeight(float x, float z)const;
     XMFLOAT3 GetHillsNormal(float x, float z)const;
@@ -108,6 +112,7 @@ private:
 	std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
 
 	RenderItem* mWavesRitem = nullptr;
+	RenderItem* mTerrainRitem = nullptr;
 
 	// List of all the render items.
 	std::vector<std::unique_ptr<RenderItem>> mAllRitems;
@@ -117,11 +122,18 @@ private:
 
 	std::unique_ptr<Waves> mWaves;
 
+	// Terrain chunks are generated into the streamer's slots and copied to the
+	// matching range of this buffer, which holds every slot.
+	std::unique_ptr<TerrainStreamer> mTerrain;
+	std::unique_ptr<UploadBuffer<Vertex>> mTerrainVB;
+	BoundingFrustum mCamFrustum;
+
     PassConstants mMainPassCB;
 
     bool mIsWireframe = false;
 
 	XMFLOAT3 mEyePos = { 0.0f, 0.0f, 0.0f };
+	XMFLOAT3 mTarget = { 0.0f, 0.0f, 0.0f };
 	XMFLOAT4X4 mView = MathHelper::Identity4x4();
 	XMFLOAT4X4 mProj = MathHelper::Identity4x4();
 
@@ -206,6 +218,8 @@ void LandAndWavesApp::OnResize()
     // The window resized, so update the aspect ratio and recompute the projection matrix.
     XMMATRIX P = XMMatrixPerspectiveFovLH(0.25f*MathHelper::Pi, AspectRatio(), 1.0f, 1000.0f);
     XMStoreFloat4x4(&mProj, P);
+
+	BoundingFrustum::CreateFromMatrix(mCamFrustum, P);
 }
 
 void LandAndWavesApp::Update(const GameTimer& gt)
@@ -230,6 +244,7 @@ void LandAndWavesApp::Update(const GameTimer& gt)
 	UpdateObjectCBs(gt);
 	UpdateMainPassCB(gt);
 	UpdateWaves(gt);
+	UpdateTerrain(gt);
 }
 
 void LandAndWavesApp::Draw(const GameTimer& gt)
@@ -272,6 +287,7 @@ void LandAndWavesApp::Draw(const GameTimer& gt)
 	mCommandList->SetGraphicsRootConstantBufferView(1, passCB->GetGPUVirtualAddress());
 
 	DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
+	DrawTerrain(mCommandList.Get());
 
 	// Indicate a state transition on the resource usage.
 	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
@@ -348,18 +364,39 @@ void LandAndWavesApp::OnKeyboardInput(const GameTimer& gt)
         mIsWireframe = true;
     else
         mIsWireframe = false;
+
+	// Move the point the camera orbits over the xz-plane, relative to where the
+	// camera faces, and keep it on the ground.
+	const float dt = gt.DeltaTime();
+	const float speed = 100.0f;
+
+	XMFLOAT2 forward(-cosf(mTheta), -sinf(mTheta));
+	XMFLOAT2 move(0.0f, 0.0f);
+
+	if(GetAsyncKeyState(VK_UP) & 0x8000)
+		move = XMFLOAT2(move.x + forward.x, move.y + forward.y);
+	if(GetAsyncKeyState(VK_DOWN) & 0x8000)
+		move = XMFLOAT2(move.x - forward.x, move.y - forward.y);
+	if(GetAsyncKeyState(VK_LEFT) & 0x8000)
+		move = XMFLOAT2(move.x - forward.y, move.y + forward.x);
+	if(GetAsyncKeyState(VK_RIGHT) & 0x8000)
+		move = XMFLOAT2(move.x + forward.y, move.y - forward.x);
+
+	mTarget.x += speed*dt*move.x;
+	mTarget.z += speed*dt*move.y;
+	mTarget.y = MathHelper::Max(GetHillsHeight(mTarget.x, mTarget.z), 0.0f);
 }
 
 void LandAndWavesApp::UpdateCamera(const GameTimer& gt)
 {
 	// Convert Spherical to Cartesian coordinates.
-	mEyePos.x = mRadius*sinf(mPhi)*cosf(mTheta);
-	mEyePos.z = mRadius*sinf(mPhi)*sinf(mTheta);
-	mEyePos.y = mRadius*cosf(mPhi);
+	mEyePos.x = mTarget.x + mRadius*sinf(mPhi)*cosf(mTheta);
+	mEyePos.z = mTarget.z + mRadius*sinf(mPhi)*sinf(mTheta);
+	mEyePos.y = mTarget.y + mRadius*cosf(mPhi);
 
 	// Build the view matrix.
 	XMVECTOR pos = XMVectorSet(mEyePos.x, mEyePos.y, mEyePos.z, 1.0f);
-	XMVECTOR target = XMVectorZero();
+	XMVECTOR target = XMLoadFloat3(&mTarget);
 	XMVECTOR up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
 
 	XMMATRIX view = XMMatrixLookAtLH(pos, target, up);
@@ -451,6 +488,54 @@ void LandAndWavesApp::UpdateWaves(const GameTimer& gt)
 	mWavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
 }
 
+void LandAndWavesApp::UpdateTerrain(const GameTimer& gt)
+{
+	mTerrain->Update(mEyePos);
+
+	// Copy the chunks that finished into their slots.  A slot is only refilled
+	// gNumFrameResources updates after its chunk was last drawn, so no frame in
+	// flight reads it.
+	UINT verticesPerChunk = mTerrain->GetVerticesPerChunk();
+	for(UINT slot : mTerrain->GetUpdatedSlots())
+	{
+		const TerrainStreamer::Vertex* src = mTerrain->GetSlotVertices(slot);
+		for(UINT i = 0; i < verticesPerChunk; ++i)
+		{
+			Vertex v;
+			v.Pos = src[i].Pos;
+
+			// Color the vertex based on its height.
+			if(v.Pos.y < -10.0f)
+			{
+				// Sandy beach color.
+				v.Color = XMFLOAT4(1.0f, 0.96f, 0.62f, 1.0f);
+			}
+			else if(v.Pos.y < 5.0f)
+			{
+				// Light yellow-green.
+				v.Color = XMFLOAT4(0.48f, 0.77f, 0.46f, 1.0f);
+			}
+			else if(v.Pos.y < 12.0f)
+			{
+				// Dark yellow-green.
+				v.Color = XMFLOAT4(0.1f, 0.48f, 0.19f, 1.0f);
+			}
+			else if(v.Pos.y < 20.0f)
+			{
+				// Dark brown.
+				v.Color = XMFLOAT4(0.45f, 0.39f, 0.34f, 1.0f);
+			}
+			else
+			{
+				// White snow.
+				v.Color = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+			}
+
+			mTerrainVB->CopyData(slot*verticesPerChunk + i, v);
+		}
+	}
+}
+
 void LandAndWavesApp::BuildRootSignature()
 {
     // Root parameter can be a table, root descriptor or root constants.
@@ -496,82 +581,50 @@ void LandAndWavesApp::BuildShadersAndInputLayout()
 
 void LandAndWavesApp::BuildLandGeometry()
 {
-	GeometryGenerator geoGen;
-	GeometryGenerator::MeshData grid = geoGen.CreateGrid(160.0f, 160.0f, 50, 50);
-
 	//
-	// Extract the vertex elements we are interested and apply the height function to
-	// each vertex.  In addition, color the vertices based on their height so we have
-	// sandy looking beaches, grassy low hills, and snow mountain peaks.
+	// Stream the hills in chunks around the camera.  Chunks are 64 units across
+	// with 32 quads along each side at full detail, and drop a level of detail
+	// every two rings of chunks out to 8 rings.
 	//
 
-	std::vector<Vertex> vertices(grid.Vertices.size());
-	for(size_t i = 0; i < grid.Vertices.size(); ++i)
-	{
-		auto& p = grid.Vertices[i].Position;
-		vertices[i].Pos = p;
-		vertices[i].Pos.y = GetHillsHeight(p.x, p.z);
-
-        // Color the vertex based on its height.
-        if(vertices[i].Pos.y < -10.0f)
-        {
-            // Sandy beach color.
-            vertices[i].Color = XMFLOAT4(1.0f, 0.96f, 0.62f, 1.0f);
-        }
-        else if(vertices[i].Pos.y < 5.0f)
-        {
-            // Light yellow-green.
-            vertices[i].Color = XMFLOAT4(0.48f, 0.77f, 0.46f, 1.0f);
-        }
-        else if(vertices[i].Pos.y < 12.0f)
-        {
-            // Dark yellow-green.
-            vertices[i].Color = XMFLOAT4(0.1f, 0.48f, 0.19f, 1.0f);
-        }
-        else if(vertices[i].Pos.y < 20.0f)
-        {
-            // Dark brown.
-            vertices[i].Color = XMFLOAT4(0.45f, 0.39f, 0.34f, 1.0f);
-        }
-        else
-        {
-            // White snow.
-            vertices[i].Color = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
-        }
-	}
-    
-	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
+	TerrainStreamer::Settings settings;
+	settings.ChunkSize = 64.0f;
+	settings.QuadsPerChunk = 32;
+	settings.LodCount = 4;
+	settings.LodRingWidth = 2;
+	settings.ViewRadius = 8;
+	settings.RecycleDelay = gNumFrameResources;
 
-	std::vector<std::uint16_t> indices = grid.GetIndices16();
+	mTerrain = std::make_unique<TerrainStreamer>(settings,
+		[this](float x, float z) { return GetHillsHeight(x, z); });
+
+	// One vertex buffer covers every slot.  The GPU reads it from the upload heap,
+	// like the waves, since only newly streamed chunks are written.
+	const UINT vertexCount = mTerrain->GetSlotCount()*mTerrain->GetVerticesPerChunk();
+	mTerrainVB = std::make_unique<UploadBuffer<Vertex>>(md3dDevice.Get(), vertexCount, false);
+
+	// The index patterns for every level of detail and stitching are static.
+	const std::vector<std::uint16_t>& indices = mTerrain->GetIndices();
 	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
 
 	auto geo = std::make_unique<MeshGeometry>();
 	geo->Name = "landGeo";
 
-	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+	// Set dynamically.
+	geo->VertexBufferCPU = nullptr;
+	geo->VertexBufferGPU = mTerrainVB->Resource();
 
 	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
 	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
 
-	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
-
 	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
 		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
 
 	geo->VertexByteStride = sizeof(Vertex);
-	geo->VertexBufferByteSize = vbByteSize;
+	geo->VertexBufferByteSize = vertexCount * sizeof(Vertex);
 	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
 	geo->IndexBufferByteSize = ibByteSize;
 
-	SubmeshGeometry submesh;
-	submesh.IndexCount = (UINT)indices.size();
-	submesh.StartIndexLocation = 0;
-	submesh.BaseVertexLocation = 0;
-
-	geo->DrawArgs["grid"] = submesh;
-
 	mGeometries["landGeo"] = std::move(geo);
 }
 
@@ -696,16 +749,15 @@ void LandAndWavesApp::BuildRenderItems()
 
 	mRitemLayer[(int)RenderLayer::Opaque].push_back(wavesRitem.get());
 
+	// The terrain chunks are in world space and drawn by DrawTerrain, which takes
+	// the draw arguments of each chunk from the streamer.
 	auto gridRitem = std::make_unique<RenderItem>();
 	gridRitem->World = MathHelper::Identity4x4();
 	gridRitem->ObjCBIndex = 1;
 	gridRitem->Geo = mGeometries["landGeo"].get();
 	gridRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	gridRitem->IndexCount = gridRitem->Geo->DrawArgs["grid"].IndexCount;
-	gridRitem->StartIndexLocation = gridRitem->Geo->DrawArgs["grid"].StartIndexLocation;
-	gridRitem->BaseVertexLocation = gridRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
 
-	mRitemLayer[(int)RenderLayer::Opaque].push_back(gridRitem.get());
+	mTerrainRitem = gridRitem.get();
 
 	mAllRitems.push_back(std::move(wavesRitem));
 	mAllRitems.push_back(std::move(gridRitem));
@@ -735,6 +787,41 @@ void LandAndWavesApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const
 	}
 }
 
+void LandAndWavesApp::DrawTerrain(ID3D12GraphicsCommandList* cmdList)
+{
+	UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
+
+	auto objectCB = mCurrFrameResource->ObjectCB->Resource();
+	auto ri = mTerrainRitem;
+
+	cmdList->IASetVertexBuffers(0, 1, &ri->Geo->VertexBufferView());
+	cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
+	cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+
+	D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = objectCB->GetGPUVirtualAddress();
+	objCBAddress += ri->ObjCBIndex*objCBByteSize;
+
+	cmdList->SetGraphicsRootConstantBufferView(0, objCBAddress);
+
+	// The chunks are in world space, so cull them against the frustum in world space.
+	XMMATRIX view = XMLoadFloat4x4(&mView);
+	XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
+
+	BoundingFrustum worldFrustum;
+	mCamFrustum.Transform(worldFrustum, invView);
+
+	UINT verticesPerChunk = mTerrain->GetVerticesPerChunk();
+	for(const TerrainStreamer::Chunk& chunk : mTerrain->GetChunks())
+	{
+		if(worldFrustum.Contains(chunk.Bounds) == DirectX::DISJOINT)
+			continue;
+
+		TerrainStreamer::DrawRange range = mTerrain->GetDrawRange(chunk.Lod, chunk.StitchMask);
+		cmdList->DrawIndexedInstanced(range.IndexCount, 1, range.StartIndexLocation,
+			chunk.Slot*verticesPerChunk, 0);
+	}
+}
+
 float LandAndWavesApp::GetHillsHeight(float x, float z)const
 {
     return 0.3f*(z*sinf(0.1f*x) + x*cosf(0.1f*z));
@@ -8,6 +8,7 @@
 #include "../../Common/MathHelper.h"
 #include "../../Common/UploadBuffer.h"
 #include "../../Common/GeometryGenerator.h"
+#include "../../Common/IndexBufferBuilder.h"
 #include "FrameResource.h"
 
 using Microsoft::WRL::ComPtr;
@@ -543,34 +544,34 @@ void ShapesApp::BuildShapeGeometry()
 	UINT sphereVertexOffset = gridVertexOffset + (UINT)grid.Vertices.size();
 	UINT cylinderVertexOffset = sphereVertexOffset + (UINT)sphere.Vertices.size();
 
-	// Cache the starting index for each object in the concatenated index buffer.
-	UINT boxIndexOffset = 0;
-	UINT gridIndexOffset = (UINT)box.Indices32.size();
-	UINT sphereIndexOffset = gridIndexOffset + (UINT)grid.Indices32.size();
-	UINT cylinderIndexOffset = sphereIndexOffset + (UINT)sphere.Indices32.size();
-
-    // Define the SubmeshGeometry that cover different 
-    // regions of the vertex/index buffers.
-
-	SubmeshGeometry boxSubmesh;
-	boxSubmesh.IndexCount = (UINT)box.Indices32.size();
-	boxSubmesh.StartIndexLocation = boxIndexOffset;
-	boxSubmesh.BaseVertexLocation = boxVertexOffset;
-
-	SubmeshGeometry gridSubmesh;
-	gridSubmesh.IndexCount = (UINT)grid.Indices32.size();
-	gridSubmesh.StartIndexLocation = gridIndexOffset;
-	gridSubmesh.BaseVertexLocation = gridVertexOffset;
-
-	SubmeshGeometry sphereSubmesh;
-	sphereSubmesh.IndexCount = (UINT)sphere.Indices32.size();
-	sphereSubmesh.StartIndexLocation = sphereIndexOffset;
-	sphereSubmesh.BaseVertexLocation = sphereVertexOffset;
+	// Queue the index lists against their vertex offsets; the builder picks the
+	// index format and lays out the concatenated index buffer, freeing Indices32.
+	IndexBufferBuilder indexBuilder;
+	UINT boxSubmeshIndex = indexBuilder.AddSubmesh(box, boxVertexOffset);
+	UINT gridSubmeshIndex = indexBuilder.AddSubmesh(grid, gridVertexOffset);
+	UINT sphereSubmeshIndex = indexBuilder.AddSubmesh(sphere, sphereVertexOffset);
+	UINT cylinderSubmeshIndex = indexBuilder.AddSubmesh(cylinder, cylinderVertexOffset);
+	indexBuilder.Build();
+
+	// Define the SubmeshGeometry that cover different regions of the vertex/index
+	// buffers.  Each shape has far fewer than 65536 vertices, so it is drawn with
+	// a single range.
+	auto toSubmesh = [&indexBuilder](UINT submeshIndex)
+	{
+		const auto& ranges = indexBuilder.GetDrawRanges(submeshIndex);
+		assert(ranges.size() == 1);
+
+		SubmeshGeometry submesh;
+		submesh.IndexCount = ranges[0].IndexCount;
+		submesh.StartIndexLocation = ranges[0].StartIndexLocation;
+		submesh.BaseVertexLocation = ranges[0].BaseVertexLocation;
+		return submesh;
+	};
 
-	SubmeshGeometry cylinderSubmesh;
-	cylinderSubmesh.IndexCount = (UINT)cylinder.Indices32.size();
-	cylinderSubmesh.StartIndexLocation = cylinderIndexOffset;
-	cylinderSubmesh.BaseVertexLocation = cylinderVertexOffset;
+	SubmeshGeometry boxSubmesh = toSubmesh(boxSubmeshIndex);
+	SubmeshGeometry gridSubmesh = toSubmesh(gridSubmeshIndex);
+	SubmeshGeometry sphereSubmesh = toSubmesh(sphereSubmeshIndex);
+	SubmeshGeometry cylinderSubmesh = toSubmesh(cylinderSubmeshIndex);
 
 	//
 	// Extract the vertex elements we are interested in and pack the
@@ -610,14 +611,8 @@ void ShapesApp::BuildShapeGeometry()
 		vertices[k].Color = XMFLOAT4(DirectX::Colors::SteelBlue);
 	}
 
-	std::vector<std::uint16_t> indices;
-	indices.insert(indices.end(), std::begin(box.GetIndices16()), std::end(box.GetIndices16()));
-	indices.insert(indices.end(), std::begin(grid.GetIndices16()), std::end(grid.GetIndices16()));
-	indices.insert(indices.end(), std::begin(sphere.GetIndices16()), std::end(sphere.GetIndices16()));
-	indices.insert(indices.end(), std::begin(cylinder.GetIndices16()), std::end(cylinder.GetIndices16()));
-
     const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
-    const UINT ibByteSize = (UINT)indices.size()  * sizeof(std::uint16_t);
+    const UINT ibByteSize = indexBuilder.GetByteSize();
 
 	auto geo = std::make_unique<MeshGeometry>();
 	geo->Name = "shapeGeo";
@@ -626,17 +621,17 @@ void ShapesApp::BuildShapeGeometry()
 	CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
 
 	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indexBuilder.GetData(), ibByteSize);
 
 	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
 		mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
 
 	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+		mCommandList.Get(), indexBuilder.GetData(), ibByteSize, geo->IndexBufferUploader);
 
 	geo->VertexByteStride = sizeof(Vertex);
 	geo->VertexBufferByteSize = vbByteSize;
-	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
+	geo->IndexFormat = indexBuilder.Is16Bit() ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
 	geo->IndexBufferByteSize = ibByteSize;
 
 	geo->DrawArgs["box"] = boxSubmesh;
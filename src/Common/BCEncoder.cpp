@@ -0,0 +1,981 @@
+//***************************************************************************************
+// BCEncoder.cpp
+//***************************************************************************************
+
+#include "BCEncoder.h"
+#include <ppl.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+using uint8 = BCEncoder::uint8;
+using uint32 = BCEncoder::uint32;
+
+namespace
+{
+	// A block's pixels channel by channel, so the loops over its 16 pixels vectorize.
+	struct BlockPixels
+	{
+		float Channel[4][16];
+	};
+
+	void LoadBlock(const uint8* pixels, BlockPixels& block)
+	{
+		for(int i = 0; i < 16; ++i)
+		{
+			for(int c = 0; c < 4; ++c)
+				block.Channel[c][i] = pixels[4*i + c];
+		}
+	}
+
+	int Clamp(int value, int lo, int hi)
+	{
+		return std::min(std::max(value, lo), hi);
+	}
+
+	float Square(float x)
+	{
+		return x*x;
+	}
+
+	///<summary>
+	/// Mean and principal axis of the first channelCount channels of the given
+	/// pixels.  The axis is unit length, or zero when the pixels are all equal;
+	/// unused channels are zero in both.
+	///</summary>
+	void PrincipalAxis(const BlockPixels& block, const int* pixels, int count, int channelCount,
+		float mean[4], float axis[4])
+	{
+		for(int c = 0; c < 4; ++c)
+		{
+			mean[c] = 0.0f;
+			axis[c] = 0.0f;
+		}
+
+		for(int c = 0; c < channelCount; ++c)
+		{
+			for(int i = 0; i < count; ++i)
+				mean[c] += block.Channel[c][pixels[i]];
+			mean[c] /= count;
+		}
+
+		float cov[4][4] = {};
+		for(int i = 0; i < count; ++i)
+		{
+			float d[4];
+			for(int c = 0; c < channelCount; ++c)
+				d[c] = block.Channel[c][pixels[i]] - mean[c];
+
+			for(int a = 0; a < channelCount; ++a)
+			{
+				for(int b = a; b < channelCount; ++b)
+					cov[a][b] += d[a]*d[b];
+			}
+		}
+
+		for(int a = 0; a < channelCount; ++a)
+		{
+			for(int b = 0; b < a; ++b)
+				cov[a][b] = cov[b][a];
+		}
+
+		// Power iteration, starting from the channel that varies most.
+		int start = 0;
+		for(int c = 1; c < channelCount; ++c)
+		{
+			if(cov[c][c] > cov[start][start])
+				start = c;
+		}
+
+		if(cov[start][start] <= 0.0f)
+			return;
+
+		float v[4] = {};
+		v[start] = 1.0f;
+		for(int iteration = 0; iteration < 8; ++iteration)
+		{
+			float w[4] = {};
+			float largest = 0.0f;
+			for(int a = 0; a < channelCount; ++a)
+			{
+				for(int b = 0; b < channelCount; ++b)
+					w[a] += cov[a][b]*v[b];
+				largest = std::max(largest, std::fabs(w[a]));
+			}
+
+			if(largest <= 0.0f)
+				break;
+
+			for(int c = 0; c < channelCount; ++c)
+				v[c] = w[c] / largest;
+		}
+
+		float length = 0.0f;
+		for(int c = 0; c < channelCount; ++c)
+			length += v[c]*v[c];
+		length = std::sqrt(length);
+
+		for(int c = 0; c < channelCount; ++c)
+			axis[c] = v[c] / length;
+	}
+
+	///<summary>
+	/// Endpoints at the extremes of the pixels' projections onto the axis through
+	/// mean.
+	///</summary>
+	void LineEndpoints(const BlockPixels& block, const int* pixels, int count, int channelCount,
+		const float mean[4], const float axis[4], float e0[4], float e1[4])
+	{
+		float lo = FLT_MAX;
+		float hi = -FLT_MAX;
+		for(int i = 0; i < count; ++i)
+		{
+			float t = 0.0f;
+			for(int c = 0; c < channelCount; ++c)
+				t += (block.Channel[c][pixels[i]] - mean[c])*axis[c];
+			lo = std::min(lo, t);
+			hi = std::max(hi, t);
+		}
+
+		for(int c = 0; c < 4; ++c)
+		{
+			e0[c] = mean[c] + lo*axis[c];
+			e1[c] = mean[c] + hi*axis[c];
+		}
+	}
+
+	///<summary>
+	/// Least squares endpoints for pixels whose reconstruction is
+	/// e0 + weight[i]*(e1 - e0).  Returns false, leaving the endpoints alone, when
+	/// every pixel has the same weight.
+	///</summary>
+	bool FitEndpoints(const BlockPixels& block, const int* pixels, int count, int channelCount,
+		const float* weights, float e0[4], float e1[4])
+	{
+		float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		float xa[4] = {}, xb[4] = {};
+		for(int i = 0; i < count; ++i)
+		{
+			float b = weights[i];
+			float a = 1.0f - b;
+			aa += a*a;
+			ab += a*b;
+			bb += b*b;
+			for(int c = 0; c < channelCount; ++c)
+			{
+				xa[c] += a*block.Channel[c][pixels[i]];
+				xb[c] += b*block.Channel[c][pixels[i]];
+			}
+		}
+
+		float det = aa*bb - ab*ab;
+		if(std::fabs(det) < 1e-6f)
+			return false;
+
+		for(int c = 0; c < channelCount; ++c)
+		{
+			e0[c] = std::min(std::max((bb*xa[c] - ab*xb[c]) / det, 0.0f), 255.0f);
+			e1[c] = std::min(std::max((aa*xb[c] - ab*xa[c]) / det, 0.0f), 255.0f);
+		}
+
+		return true;
+	}
+
+	// Writes bits least significant first, the order every BC format is read in.
+	struct BitWriter
+	{
+		uint8* Out;
+		int Position;
+
+		void Write(uint32 value, int bits)
+		{
+			for(int b = 0; b < bits; ++b, ++Position)
+			{
+				if((value >> b) & 1)
+					Out[Position >> 3] |= uint8(1 << (Position & 7));
+			}
+		}
+	};
+
+	//
+	// BC1 colors, also the color half of BC3.
+	//
+
+	uint32 Quantize565(const float rgb[3])
+	{
+		int r = Clamp((int)(rgb[0]*31.0f / 255.0f + 0.5f), 0, 31);
+		int g = Clamp((int)(rgb[1]*63.0f / 255.0f + 0.5f), 0, 63);
+		int b = Clamp((int)(rgb[2]*31.0f / 255.0f + 0.5f), 0, 31);
+		return uint32((r << 11) | (g << 5) | b);
+	}
+
+	void Unpack565(uint32 color, int rgb[3])
+	{
+		int r = (color >> 11) & 31;
+		int g = (color >> 5) & 63;
+		int b = color & 31;
+		rgb[0] = (r << 3) | (r >> 2);
+		rgb[1] = (g << 2) | (g >> 4);
+		rgb[2] = (b << 3) | (b >> 2);
+	}
+
+	///<summary>
+	/// Encodes a block's colors into 8 bytes.  With allowTransparent, pixels with
+	/// alpha below 128 use the three color mode's transparent index; BC3 passes
+	/// false because its color block always decodes four colors.
+	///</summary>
+	void EncodeColorBlock(const BlockPixels& block, bool allowTransparent, uint8* out, uint8* decoded)
+	{
+		int opaque[16];
+		int opaqueCount = 0;
+		bool transparent[16];
+		for(int i = 0; i < 16; ++i)
+		{
+			transparent[i] = allowTransparent && block.Channel[3][i] < 128.0f;
+			if(!transparent[i])
+				opaque[opaqueCount++] = i;
+		}
+
+		const bool threeColor = opaqueCount < 16;
+
+		uint32 best0 = 0;
+		uint32 best1 = 0;
+		uint8 bestIndex[16];
+		std::fill(bestIndex, bestIndex + 16, uint8(3));
+		int bestPalette[4][3] = {};
+
+		if(opaqueCount > 0)
+		{
+			float mean[4], axis[4], e0[4], e1[4];
+			PrincipalAxis(block, opaque, opaqueCount, 3, mean, axis);
+			LineEndpoints(block, opaque, opaqueCount, 3, mean, axis, e1, e0);
+
+			float bestError = FLT_MAX;
+			for(int iteration = 0; iteration < 3; ++iteration)
+			{
+				uint32 c0 = Quantize565(e0);
+				uint32 c1 = Quantize565(e1);
+
+				// The order of the endpoints selects the mode.
+				if(threeColor ? c0 > c1 : c0 < c1)
+				{
+					std::swap(c0, c1);
+					std::swap(e0, e1);
+				}
+
+				int palette[4][3];
+				Unpack565(c0, palette[0]);
+				Unpack565(c1, palette[1]);
+
+				// Equal endpoints decode in three color mode; index 0 is then the
+				// only safe choice for an opaque block.
+				int choices = threeColor ? 3 : (c0 == c1 ? 1 : 4);
+				for(int c = 0; c < 3; ++c)
+				{
+					if(threeColor)
+					{
+						palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+						palette[3][c] = 0;
+					}
+					else
+					{
+						palette[2][c] = (2*palette[0][c] + palette[1][c]) / 3;
+						palette[3][c] = (palette[0][c] + 2*palette[1][c]) / 3;
+					}
+				}
+
+				uint8 index[16];
+				std::fill(index, index + 16, uint8(3));
+				float error = 0.0f;
+				for(int i = 0; i < opaqueCount; ++i)
+				{
+					int p = opaque[i];
+					float bestPixel = FLT_MAX;
+					for(int k = 0; k < choices; ++k)
+					{
+						float e = Square(block.Channel[0][p] - palette[k][0]) +
+							Square(block.Channel[1][p] - palette[k][1]) +
+							Square(block.Channel[2][p] - palette[k][2]);
+						if(e < bestPixel)
+						{
+							bestPixel = e;
+							index[p] = uint8(k);
+						}
+					}
+					error += bestPixel;
+				}
+
+				if(error < bestError)
+				{
+					bestError = error;
+					best0 = c0;
+					best1 = c1;
+					std::copy(index, index + 16, bestIndex);
+					std::memcpy(bestPalette, palette, sizeof(palette));
+				}
+
+				if(error == 0.0f || choices == 1)
+					break;
+
+				const float fourColorWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+				const float threeColorWeights[3] = { 0.0f, 1.0f, 0.5f };
+				float weights[16];
+				for(int i = 0; i < opaqueCount; ++i)
+					weights[i] = threeColor ? threeColorWeights[index[opaque[i]]] : fourColorWeights[index[opaque[i]]];
+
+				if(!FitEndpoints(block, opaque, opaqueCount, 3, weights, e0, e1))
+					break;
+			}
+		}
+
+		uint32 indices = 0;
+		for(int i = 0; i < 16; ++i)
+			indices |= uint32(bestIndex[i]) << (2*i);
+
+		out[0] = uint8(best0);
+		out[1] = uint8(best0 >> 8);
+		out[2] = uint8(best1);
+		out[3] = uint8(best1 >> 8);
+		for(int b = 0; b < 4; ++b)
+			out[4 + b] = uint8(indices >> (8*b));
+
+		if(decoded)
+		{
+			for(int i = 0; i < 16; ++i)
+			{
+				bool clear = threeColor && bestIndex[i] == 3;
+				for(int c = 0; c < 3; ++c)
+					decoded[4*i + c] = uint8(clear ? 0 : bestPalette[bestIndex[i]][c]);
+				decoded[4*i + 3] = uint8(clear ? 0 : 255);
+			}
+		}
+	}
+
+	//
+	// Single channel blocks: BC3 alpha and the two halves of BC5.
+	//
+
+	void BuildChannelPalette(int a0, int a1, int palette[8])
+	{
+		palette[0] = a0;
+		palette[1] = a1;
+		if(a0 > a1)
+		{
+			for(int i = 1; i < 7; ++i)
+				palette[i + 1] = ((7 - i)*a0 + i*a1) / 7;
+		}
+		else
+		{
+			for(int i = 1; i < 5; ++i)
+				palette[i + 1] = ((5 - i)*a0 + i*a1) / 5;
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+	}
+
+	///<summary>
+	/// Encodes one channel of a block into 8 bytes.  When decoded is not null, the
+	/// channel's byte of each of its 16 RGBA pixels is written.
+	///</summary>
+	void EncodeChannelBlock(const BlockPixels& block, int channel, uint8* out, uint8* decoded)
+	{
+		int values[16];
+		int lo = 255, hi = 0;
+		int innerLo = 255, innerHi = 0;
+		for(int i = 0; i < 16; ++i)
+		{
+			values[i] = (int)block.Channel[channel][i];
+			lo = std::min(lo, values[i]);
+			hi = std::max(hi, values[i]);
+			if(values[i] != 0 && values[i] != 255)
+			{
+				innerLo = std::min(innerLo, values[i]);
+				innerHi = std::max(innerHi, values[i]);
+			}
+		}
+
+		int bestA0 = lo;
+		int bestA1 = lo;
+		uint8 bestIndex[16] = {};
+		int bestError = lo == hi ? 0 : INT32_MAX;
+
+		auto tryEndpoints = [&](int a0, int a1)
+		{
+			int palette[8];
+			BuildChannelPalette(a0, a1, palette);
+
+			uint8 index[16];
+			int error = 0;
+			for(int i = 0; i < 16; ++i)
+			{
+				int bestPixel = INT32_MAX;
+				for(int k = 0; k < 8; ++k)
+				{
+					int e = (values[i] - palette[k])*(values[i] - palette[k]);
+					if(e < bestPixel)
+					{
+						bestPixel = e;
+						index[i] = uint8(k);
+					}
+				}
+				error += bestPixel;
+			}
+
+			if(error < bestError)
+			{
+				bestError = error;
+				bestA0 = a0;
+				bestA1 = a1;
+				std::copy(index, index + 16, bestIndex);
+			}
+		};
+
+		if(lo != hi)
+		{
+			// Eight interpolated values, with the range pulled in a little, since
+			// the end values are often better spent on the pixels near them.
+			for(int dl = 0; dl < 4; ++dl)
+			{
+				for(int dh = 0; dh < 4; ++dh)
+				{
+					if(hi - dh > lo + dl)
+						tryEndpoints(hi - dh, lo + dl);
+				}
+			}
+
+			// Six values plus exact 0 and 255.
+			if(innerLo <= innerHi)
+				tryEndpoints(innerLo, innerHi);
+			else
+				tryEndpoints(0, 0);
+		}
+
+		std::uint64_t indices = 0;
+		for(int i = 0; i < 16; ++i)
+			indices |= std::uint64_t(bestIndex[i]) << (3*i);
+
+		out[0] = uint8(bestA0);
+		out[1] = uint8(bestA1);
+		for(int b = 0; b < 6; ++b)
+			out[2 + b] = uint8(indices >> (8*b));
+
+		if(decoded)
+		{
+			int palette[8];
+			BuildChannelPalette(bestA0, bestA1, palette);
+			for(int i = 0; i < 16; ++i)
+				decoded[4*i + channel] = uint8(palette[bestIndex[i]]);
+		}
+	}
+
+	//
+	// BC7.
+	//
+
+	const int Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+	const int Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	// Two subset partitions: bit i is the subset of pixel i.
+	const std::uint16_t Partitions2[64] =
+	{
+		0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+		0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+		0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+		0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+		0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a,
+		0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+		0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c,
+		0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22
+	};
+
+	// The pixel of subset 1 whose index drops its top bit, per partition.
+	const uint8 Anchors2[64] =
+	{
+		15, 15, 15, 15, 15, 15, 15, 15,
+		15, 15, 15, 15, 15, 15, 15, 15,
+		15,  2,  8,  2,  2,  8,  8, 15,
+		 2,  8,  2,  2,  8,  8,  2,  2,
+		15, 15,  6,  8,  2,  8, 15, 15,
+		 2,  8,  2,  2,  2, 15, 15,  6,
+		 6,  2,  6,  8, 15, 15,  2,  2,
+		15, 15, 15, 15, 15,  2,  2, 15
+	};
+
+	struct Bc7Mode
+	{
+		int Number;
+		int Channels;     // 3 for RGB, whose alpha decodes as 255, or 4.
+		int EndpointBits; // Per channel, before the p-bit.
+		bool SharedPBit;  // One p-bit per subset rather than per endpoint.
+		int IndexBits;
+	};
+
+	const Bc7Mode Mode1 = { 1, 3, 6, true, 3 };
+	const Bc7Mode Mode6 = { 6, 4, 7, false, 4 };
+
+	// An endpoint value with its p-bit, widened to 8 bits the way decoders do.
+	int Unquantize(int value, int pbit, int bits)
+	{
+		int q = (value << 1) | pbit;
+		int n = bits + 1;
+		return n == 8 ? q : (q << (8 - n)) | (q >> (2*n - 8));
+	}
+
+	int QuantizeChannel(float v, int pbit, int bits)
+	{
+		const int top = (1 << bits) - 1;
+		int guess = Clamp((int)std::floor((v*((2 << bits) - 1) / 255.0f - pbit)*0.5f + 0.5f), 0, top);
+
+		int best = guess;
+		float bestError = FLT_MAX;
+		for(int c = std::max(guess - 1, 0); c <= std::min(guess + 1, top); ++c)
+		{
+			float e = std::fabs(Unquantize(c, pbit, bits) - v);
+			if(e < bestError)
+			{
+				bestError = e;
+				best = c;
+			}
+		}
+
+		return best;
+	}
+
+	struct SubsetFit
+	{
+		int Endpoint[2][4];  // Quantized, without p-bits; alpha unused for RGB modes.
+		int PBit[2];
+		uint8 Index[16];     // By pixel; only the subset's pixels are set.
+		float Error = FLT_MAX;
+	};
+
+	void SubsetPalette(const SubsetFit& fit, const Bc7Mode& mode, int palette[16][4])
+	{
+		int e[2][4];
+		for(int k = 0; k < 2; ++k)
+		{
+			for(int c = 0; c < 4; ++c)
+				e[k][c] = c < mode.Channels ? Unquantize(fit.Endpoint[k][c], fit.PBit[k], mode.EndpointBits) : 255;
+		}
+
+		const int* weights = mode.IndexBits == 3 ? Weights3 : Weights4;
+		for(int i = 0; i < (1 << mode.IndexBits); ++i)
+		{
+			for(int c = 0; c < 4; ++c)
+				palette[i][c] = ((64 - weights[i])*e[0][c] + weights[i]*e[1][c] + 32) >> 6;
+		}
+	}
+
+	///<summary>
+	/// Fits one subset's endpoints, p-bits and indices, returning the squared
+	/// error over the mode's channels.
+	///</summary>
+	float FitSubset(const BlockPixels& block, const int* pixels, int count, const Bc7Mode& mode, SubsetFit& best)
+	{
+		float mean[4], axis[4], e0[4], e1[4];
+		PrincipalAxis(block, pixels, count, mode.Channels, mean, axis);
+		LineEndpoints(block, pixels, count, mode.Channels, mean, axis, e0, e1);
+
+		const int paletteSize = 1 << mode.IndexBits;
+		const int* weights = mode.IndexBits == 3 ? Weights3 : Weights4;
+		const int pbitCombinations = mode.SharedPBit ? 2 : 4;
+
+		best.Error = FLT_MAX;
+		for(int iteration = 0; iteration < 3; ++iteration)
+		{
+			for(int p = 0; p < pbitCombinations; ++p)
+			{
+				SubsetFit fit;
+				fit.PBit[0] = p & 1;
+				fit.PBit[1] = mode.SharedPBit ? (p & 1) : (p >> 1);
+				for(int c = 0; c < 4; ++c)
+				{
+					fit.Endpoint[0][c] = c < mode.Channels ? QuantizeChannel(e0[c], fit.PBit[0], mode.EndpointBits) : 0;
+					fit.Endpoint[1][c] = c < mode.Channels ? QuantizeChannel(e1[c], fit.PBit[1], mode.EndpointBits) : 0;
+				}
+
+				int palette[16][4];
+				SubsetPalette(fit, mode, palette);
+
+				// The weights are close to evenly spaced, so projecting a pixel onto
+				// the line between the end entries finds its nearest entry to within
+				// one step.
+				float dir[4] = {};
+				float length = 0.0f;
+				for(int c = 0; c < mode.Channels; ++c)
+				{
+					dir[c] = float(palette[paletteSize - 1][c] - palette[0][c]);
+					length += dir[c]*dir[c];
+				}
+				const float scale = length > 0.0f ? (paletteSize - 1) / length : 0.0f;
+
+				fit.Error = 0.0f;
+				for(int i = 0; i < count; ++i)
+				{
+					int px = pixels[i];
+
+					float t = 0.0f;
+					for(int c = 0; c < mode.Channels; ++c)
+						t += (block.Channel[c][px] - palette[0][c])*dir[c];
+					int nearest = Clamp((int)(t*scale + 0.5f), 0, paletteSize - 1);
+
+					float bestPixel = FLT_MAX;
+					for(int k = std::max(nearest - 1, 0); k <= std::min(nearest + 1, paletteSize - 1); ++k)
+					{
+						float e = 0.0f;
+						for(int c = 0; c < mode.Channels; ++c)
+							e += Square(block.Channel[c][px] - palette[k][c]);
+						if(e < bestPixel)
+						{
+							bestPixel = e;
+							fit.Index[px] = uint8(k);
+						}
+					}
+					fit.Error += bestPixel;
+				}
+
+				if(fit.Error < best.Error)
+					best = fit;
+			}
+
+			if(best.Error == 0.0f)
+				break;
+
+			float t[16];
+			for(int i = 0; i < count; ++i)
+				t[i] = weights[best.Index[pixels[i]]] / 64.0f;
+
+			if(!FitEndpoints(block, pixels, count, mode.Channels, t, e0, e1))
+				break;
+		}
+
+		return best.Error;
+	}
+
+	// Swaps a subset's endpoints when its anchor index has the top bit set, which
+	// the format leaves out.
+	void FixAnchor(SubsetFit& fit, const Bc7Mode& mode, const int* pixels, int count, int anchor)
+	{
+		const int top = (1 << mode.IndexBits) - 1;
+		if(fit.Index[anchor] <= top / 2)
+			return;
+
+		for(int c = 0; c < 4; ++c)
+			std::swap(fit.Endpoint[0][c], fit.Endpoint[1][c]);
+		std::swap(fit.PBit[0], fit.PBit[1]);
+
+		for(int i = 0; i < count; ++i)
+			fit.Index[pixels[i]] = uint8(top - fit.Index[pixels[i]]);
+	}
+
+	// Sums of a set of pixels' RGB and of its products (rr, rg, rb, gg, gb, bb), from
+	// which the covariance follows without visiting the pixels again.
+	struct Moments
+	{
+		float Count = 0.0f;
+		float Sum[3] = {};
+		float Product[6] = {};
+
+		void Add(const BlockPixels& block, int i)
+		{
+			const float r = block.Channel[0][i], g = block.Channel[1][i], b = block.Channel[2][i];
+			Count += 1.0f;
+			Sum[0] += r; Sum[1] += g; Sum[2] += b;
+			Product[0] += r*r; Product[1] += r*g; Product[2] += r*b;
+			Product[3] += g*g; Product[4] += g*b; Product[5] += b*b;
+		}
+
+		Moments operator-(const Moments& rhs)const
+		{
+			Moments m;
+			m.Count = Count - rhs.Count;
+			for(int c = 0; c < 3; ++c)
+				m.Sum[c] = Sum[c] - rhs.Sum[c];
+			for(int c = 0; c < 6; ++c)
+				m.Product[c] = Product[c] - rhs.Product[c];
+			return m;
+		}
+	};
+
+	///<summary>
+	/// How far the pixels summed in m lie from the line through them: their total
+	/// squared distance from the mean minus the part along the principal axis.
+	/// Used to rank partitions before fitting any.
+	///</summary>
+	float LineResidual(const Moments& m)
+	{
+		if(m.Count <= 1.0f)
+			return 0.0f;
+
+		const int pair[3][3] = { { 0, 1, 2 }, { 1, 3, 4 }, { 2, 4, 5 } };
+		float cov[3][3];
+		for(int a = 0; a < 3; ++a)
+		{
+			for(int b = 0; b < 3; ++b)
+				cov[a][b] = m.Product[pair[a][b]] - m.Sum[a]*m.Sum[b] / m.Count;
+		}
+
+		const float trace = cov[0][0] + cov[1][1] + cov[2][2];
+		if(trace <= 0.0f)
+			return 0.0f;
+
+		// A few power iterations from the channel that varies most; the
+		// Rayleigh quotient converges faster than the vector.
+		int start = cov[1][1] > cov[0][0] ? 1 : 0;
+		start = cov[2][2] > cov[start][start] ? 2 : start;
+		float v[3] = { cov[0][start], cov[1][start], cov[2][start] };
+		for(int iteration = 0; iteration < 3; ++iteration)
+		{
+			float w[3];
+			for(int a = 0; a < 3; ++a)
+				w[a] = cov[a][0]*v[0] + cov[a][1]*v[1] + cov[a][2]*v[2];
+			float largest = std::max(std::max(std::fabs(w[0]), std::fabs(w[1])), std::fabs(w[2]));
+			if(largest <= 0.0f)
+				return trace;
+			for(int a = 0; a < 3; ++a)
+				v[a] = w[a] / largest;
+		}
+
+		float vv = v[0]*v[0] + v[1]*v[1] + v[2]*v[2];
+		float vcv = 0.0f;
+		for(int a = 0; a < 3; ++a)
+			vcv += v[a]*(cov[a][0]*v[0] + cov[a][1]*v[1] + cov[a][2]*v[2]);
+
+		return std::max(trace - vcv / vv, 0.0f);
+	}
+
+	void EncodeBC7Block(const BlockPixels& block, uint8* out, uint8* decoded)
+	{
+		int all[16];
+		bool opaque = true;
+		for(int i = 0; i < 16; ++i)
+		{
+			all[i] = i;
+			opaque = opaque && block.Channel[3][i] == 255.0f;
+		}
+
+		SubsetFit fit6;
+		float error6 = FitSubset(block, all, 16, Mode6, fit6);
+		FixAnchor(fit6, Mode6, all, 16, 0);
+
+		// Mode 1 only for opaque blocks, over the few partitions whose subsets
+		// lie closest to lines.
+		int bestPartition = -1;
+		SubsetFit fit1[2];
+		int subsetPixels[2][16];
+		int subsetCount[2] = {};
+
+		if(opaque && error6 > 0.0f)
+		{
+			const int Candidates = 4;
+			Moments whole;
+			for(int i = 0; i < 16; ++i)
+				whole.Add(block, i);
+
+			std::pair<float, int> ranked[64];
+			for(int p = 0; p < 64; ++p)
+			{
+				Moments second;
+				for(int i = 0; i < 16; ++i)
+				{
+					if((Partitions2[p] >> i) & 1)
+						second.Add(block, i);
+				}
+				ranked[p] = std::make_pair(LineResidual(whole - second) + LineResidual(second), p);
+			}
+			std::partial_sort(ranked, ranked + Candidates, ranked + 64);
+
+			float bestError = error6;
+			for(int r = 0; r < Candidates; ++r)
+			{
+				int p = ranked[r].second;
+				int pixels[2][16];
+				int count[2] = {};
+				for(int i = 0; i < 16; ++i)
+				{
+					int s = (Partitions2[p] >> i) & 1;
+					pixels[s][count[s]++] = i;
+				}
+
+				SubsetFit fits[2];
+				float error = FitSubset(block, pixels[0], count[0], Mode1, fits[0]);
+				if(error >= bestError)
+					continue;
+				error += FitSubset(block, pixels[1], count[1], Mode1, fits[1]);
+				if(error >= bestError)
+					continue;
+
+				bestError = error;
+				bestPartition = p;
+				fit1[0] = fits[0];
+				fit1[1] = fits[1];
+				std::memcpy(subsetPixels, pixels, sizeof(pixels));
+				std::memcpy(subsetCount, count, sizeof(count));
+			}
+		}
+
+		std::memset(out, 0, 16);
+		BitWriter writer = { out, 0 };
+		int palette[2][16][4];
+		uint8 subsetOf[16] = {};
+		uint8 index[16];
+
+		if(bestPartition < 0)
+		{
+			writer.Write(1 << 6, 7);
+			for(int c = 0; c < 4; ++c)
+			{
+				writer.Write(fit6.Endpoint[0][c], 7);
+				writer.Write(fit6.Endpoint[1][c], 7);
+			}
+			writer.Write(fit6.PBit[0], 1);
+			writer.Write(fit6.PBit[1], 1);
+			for(int i = 0; i < 16; ++i)
+				writer.Write(fit6.Index[i], i == 0 ? 3 : 4);
+
+			SubsetPalette(fit6, Mode6, palette[0]);
+			std::copy(fit6.Index, fit6.Index + 16, index);
+		}
+		else
+		{
+			const int anchor = Anchors2[bestPartition];
+			FixAnchor(fit1[0], Mode1, subsetPixels[0], subsetCount[0], 0);
+			FixAnchor(fit1[1], Mode1, subsetPixels[1], subsetCount[1], anchor);
+
+			writer.Write(1 << 1, 2);
+			writer.Write(bestPartition, 6);
+			for(int c = 0; c < 3; ++c)
+			{
+				for(int s = 0; s < 2; ++s)
+				{
+					writer.Write(fit1[s].Endpoint[0][c], 6);
+					writer.Write(fit1[s].Endpoint[1][c], 6);
+				}
+			}
+			writer.Write(fit1[0].PBit[0], 1);
+			writer.Write(fit1[1].PBit[0], 1);
+
+			for(int i = 0; i < 16; ++i)
+			{
+				subsetOf[i] = uint8((Partitions2[bestPartition] >> i) & 1);
+				index[i] = fit1[subsetOf[i]].Index[i];
+				writer.Write(index[i], i == 0 || i == anchor ? 2 : 3);
+			}
+
+			SubsetPalette(fit1[0], Mode1, palette[0]);
+			SubsetPalette(fit1[1], Mode1, palette[1]);
+		}
+
+		if(decoded)
+		{
+			for(int i = 0; i < 16; ++i)
+			{
+				for(int c = 0; c < 4; ++c)
+					decoded[4*i + c] = uint8(palette[subsetOf[i]][index[i]][c]);
+			}
+		}
+	}
+}
+
+bool BCEncoder::IsSupported(DXGI_FORMAT format)
+{
+	switch(format)
+	{
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_BC5_UNORM:
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		return true;
+	default:
+		return false;
+	}
+}
+
+uint32 BCEncoder::BlockSize(DXGI_FORMAT format)
+{
+	return format == DXGI_FORMAT_BC1_UNORM || format == DXGI_FORMAT_BC1_UNORM_SRGB ? 8 : 16;
+}
+
+void BCEncoder::EncodeBlock(DXGI_FORMAT format, const uint8* pixels, uint8* block, uint8* decoded)
+{
+	BlockPixels p;
+	LoadBlock(pixels, p);
+
+	switch(format)
+	{
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+		EncodeColorBlock(p, true, block, decoded);
+		break;
+
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+		// The color block decodes alpha as 255; the alpha block then overwrites it.
+		EncodeColorBlock(p, false, block + 8, decoded);
+		EncodeChannelBlock(p, 3, block, decoded);
+		break;
+
+	case DXGI_FORMAT_BC5_UNORM:
+		EncodeChannelBlock(p, 0, block, decoded);
+		EncodeChannelBlock(p, 1, block + 8, decoded);
+		if(decoded)
+		{
+			for(int i = 0; i < 16; ++i)
+			{
+				decoded[4*i + 2] = 0;
+				decoded[4*i + 3] = 255;
+			}
+		}
+		break;
+
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		EncodeBC7Block(p, block, decoded);
+		break;
+
+	default:
+		break;
+	}
+}
+
+void BCEncoder::EncodeSurface(DXGI_FORMAT format, const uint8* pixels, uint32 width, uint32 height,
+	std::size_t rowPitch, uint8* blocks, std::size_t blockRowPitch,
+	uint8* decoded, std::size_t decodedRowPitch)
+{
+	const uint32 blocksWide = std::max((width + 3) / 4, 1u);
+	const uint32 blocksHigh = std::max((height + 3) / 4, 1u);
+	const uint32 blockSize = BlockSize(format);
+
+	concurrency::parallel_for(0u, blocksHigh, [&](uint32 by)
+	{
+		uint8 source[64];
+		uint8 result[64];
+		for(uint32 bx = 0; bx < blocksWide; ++bx)
+		{
+			for(uint32 y = 0; y < 4; ++y)
+			{
+				uint32 sy = std::min(by*4 + y, height - 1);
+				for(uint32 x = 0; x < 4; ++x)
+				{
+					uint32 sx = std::min(bx*4 + x, width - 1);
+					std::memcpy(source + 4*(4*y + x), pixels + sy*rowPitch + 4*sx, 4);
+				}
+			}
+
+			EncodeBlock(format, source, blocks + by*blockRowPitch + bx*blockSize, decoded ? result : nullptr);
+
+			if(decoded)
+			{
+				for(uint32 y = 0; y < 4 && by*4 + y < height; ++y)
+				{
+					for(uint32 x = 0; x < 4 && bx*4 + x < width; ++x)
+						std::memcpy(decoded + (by*4 + y)*decodedRowPitch + 4*(bx*4 + x), result + 4*(4*y + x), 4);
+				}
+			}
+		}
+	});
+}
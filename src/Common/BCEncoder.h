@@ -0,0 +1,63 @@
+//***************************************************************************************
+// BCEncoder.h
+//
+// Compresses 8-bit RGBA images to the block compressed formats the GPU samples
+// directly: BC1 (RGB, optionally with 1-bit alpha), BC3 (RGBA), BC5 (two channels,
+// for normal maps) and BC7 (high quality RGB or RGBA).  Each 4x4 block is encoded
+// on its own, so a surface's rows of blocks are spread across cores.
+//
+// BC1 and the colors of BC3 fit a line through the block's colors along their
+// principal axis and refine its endpoints by least squares against the chosen
+// indices.  Single channel blocks (BC3 alpha, both halves of BC5) search endpoints
+// around the block's range in both the 8 and 6 value modes.  BC7 tries mode 6 (one
+// line through RGBA) on every block and, for opaque blocks, mode 1 (two lines
+// through RGB) over the partitions whose colors fit two lines best.  The other BC7
+// modes are never written; they trade speed for a little more quality.
+//
+// The encoder can return the pixels a decoder will reconstruct from what it wrote,
+// which is how tools measure the loss.  The code only depends on the standard
+// library, PPL and dxgiformat.h.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <dxgiformat.h>
+
+class BCEncoder
+{
+public:
+
+    using uint8 = std::uint8_t;
+    using uint32 = std::uint32_t;
+
+	///<summary>
+	/// True for the UNORM and UNORM_SRGB variants of BC1, BC3, BC5 (UNORM only)
+	/// and BC7.  sRGB variants store the same bits; the encoder works on the
+	/// values as stored.
+	///</summary>
+	static bool IsSupported(DXGI_FORMAT format);
+
+	// Bytes per 4x4 block: 8 for BC1, 16 for the others.
+	static uint32 BlockSize(DXGI_FORMAT format);
+
+	///<summary>
+	/// Encodes 16 RGBA pixels, row by row, into one block of format.  BC1 keeps
+	/// pixels with alpha below 128 transparent and ignores alpha otherwise; BC5
+	/// encodes red and green.  When decoded is not null it receives the 16 RGBA
+	/// pixels a decoder produces from the block; BC5 decodes with blue 0 and
+	/// alpha 255, BC1 with alpha 0 or 255.
+	///</summary>
+	static void EncodeBlock(DXGI_FORMAT format, const uint8* pixels, uint8* block, uint8* decoded = nullptr);
+
+	///<summary>
+	/// Encodes a width by height RGBA image whose rows are rowPitch bytes apart into
+	/// rows of blocks blockRowPitch bytes apart.  Partial blocks at the right and
+	/// bottom edges repeat the last column and row.  When decoded is not null it
+	/// receives the reconstructed image, decodedRowPitch bytes per row.
+	///</summary>
+	static void EncodeSurface(DXGI_FORMAT format, const uint8* pixels, uint32 width, uint32 height,
+		std::size_t rowPitch, uint8* blocks, std::size_t blockRowPitch,
+		uint8* decoded = nullptr, std::size_t decodedRowPitch = 0);
+};
@@ -113,6 +113,17 @@ float Camera::GetFarWindowHeight()const
 	return mFarWindowHeight;
 }
 
+float Camera::GetPixelsPerUnit(FXMVECTOR pos, float screenHeight)const
+{
+	// Use the distance rather than the view depth, so the result does not change
+	// as the camera turns.
+	float dist = XMVectorGetX(XMVector3Length(pos - XMLoadFloat3(&mPosition)));
+	dist = MathHelper::Max(dist, mNearZ);
+
+	// The near window spans screenHeight pixels at distance mNearZ.
+	return screenHeight*mNearZ / (mNearWindowHeight*dist);
+}
+
 void Camera::SetLens(float fovY, float aspect, float zn, float zf)
 {
 	// cache properties
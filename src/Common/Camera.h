@@ -46,6 +46,10 @@ public:
 	float GetNearWindowHeight()const;
 	float GetFarWindowWidth()const;
 	float GetFarWindowHeight()const;
+
+	// Size in pixels of one world unit at the given world space point, for a back
+	// buffer of the given height.  Used to pick the level of detail of a mesh.
+	float GetPixelsPerUnit(DirectX::FXMVECTOR pos, float screenHeight)const;
 	
 	// Set frustum.
 	void SetLens(float fovY, float aspect, float zn, float zf);
@@ -0,0 +1,869 @@
+//***************************************************************************************
+// DDSParser.cpp
+//***************************************************************************************
+
+#include "DDSParser.h"
+#include <algorithm>
+#include <cstring>
+
+using uint32 = DDSParser::uint32;
+using uint64 = DDSParser::uint64;
+
+namespace
+{
+	//
+	// DDS file structures.  See DDS.h in the 'Texconv' sample and the 'DirectXTex'
+	// library.  They are copied out of the file rather than cast in place, so the
+	// input needs no particular alignment.
+	//
+
+	constexpr uint32 MakeFourCC(char c0, char c1, char c2, char c3)
+	{
+		return uint32(std::uint8_t(c0)) | (uint32(std::uint8_t(c1)) << 8) |
+			(uint32(std::uint8_t(c2)) << 16) | (uint32(std::uint8_t(c3)) << 24);
+	}
+
+	const uint32 DDS_MAGIC = 0x20534444; // "DDS "
+
+	const uint32 DDS_FOURCC = 0x00000004;    // DDPF_FOURCC
+	const uint32 DDS_RGB = 0x00000040;       // DDPF_RGB
+	const uint32 DDS_LUMINANCE = 0x00020000; // DDPF_LUMINANCE
+	const uint32 DDS_ALPHA = 0x00000002;     // DDPF_ALPHA
+
+	const uint32 DDS_HEADER_FLAGS_TEXTURE = 0x00001007;    // DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT
+	const uint32 DDS_HEADER_FLAGS_MIPMAP = 0x00020000;     // DDSD_MIPMAPCOUNT
+	const uint32 DDS_HEADER_FLAGS_VOLUME = 0x00800000;     // DDSD_DEPTH
+	const uint32 DDS_HEADER_FLAGS_PITCH = 0x00000008;      // DDSD_PITCH
+	const uint32 DDS_HEADER_FLAGS_LINEARSIZE = 0x00080000; // DDSD_LINEARSIZE
+	const uint32 DDS_HEIGHT = 0x00000002;                  // DDSD_HEIGHT
+
+	const uint32 DDS_SURFACE_FLAGS_TEXTURE = 0x00001000; // DDSCAPS_TEXTURE
+	const uint32 DDS_SURFACE_FLAGS_MIPMAP = 0x00400008;  // DDSCAPS_COMPLEX | DDSCAPS_MIPMAP
+	const uint32 DDS_SURFACE_FLAGS_CUBEMAP = 0x00000008; // DDSCAPS_COMPLEX
+	const uint32 DDS_FLAGS_VOLUME = 0x00200000;          // DDSCAPS2_VOLUME
+
+	const uint32 DDS_CUBEMAP = 0x00000200;          // DDSCAPS2_CUBEMAP
+	const uint32 DDS_CUBEMAP_ALLFACES = 0x0000fe00; // DDSCAPS2_CUBEMAP | all six DDSCAPS2_CUBEMAP_*
+
+	const uint32 DDS_MISC_FLAGS2_ALPHA_MODE_MASK = 0x7;
+	const uint32 RESOURCE_MISC_TEXTURECUBE = 0x4; // D3D11_RESOURCE_MISC_TEXTURECUBE
+
+	// Resource dimensions as written in the DX10 header.
+	const uint32 DIMENSION_TEXTURE1D = 2;
+	const uint32 DIMENSION_TEXTURE2D = 3;
+	const uint32 DIMENSION_TEXTURE3D = 4;
+
+	// Direct3D 12 hardware limits (D3D12_REQ_*).
+	const uint32 MaxMipLevels = 15;
+	const uint32 MaxTexture1DArraySize = 2048;
+	const uint32 MaxTexture1DWidth = 16384;
+	const uint32 MaxTexture2DArraySize = 2048;
+	const uint32 MaxTexture2DSize = 16384;
+	const uint32 MaxTextureCubeSize = 16384;
+	const uint32 MaxTexture3DSize = 2048;
+
+#pragma pack(push, 1)
+
+	struct DDS_PIXELFORMAT
+	{
+		uint32 size;
+		uint32 flags;
+		uint32 fourCC;
+		uint32 RGBBitCount;
+		uint32 RBitMask;
+		uint32 GBitMask;
+		uint32 BBitMask;
+		uint32 ABitMask;
+	};
+
+	struct DDS_HEADER
+	{
+		uint32 size;
+		uint32 flags;
+		uint32 height;
+		uint32 width;
+		uint32 pitchOrLinearSize;
+		uint32 depth; // only if DDS_HEADER_FLAGS_VOLUME is set in flags
+		uint32 mipMapCount;
+		uint32 reserved1[11];
+		DDS_PIXELFORMAT ddspf;
+		uint32 caps;
+		uint32 caps2;
+		uint32 caps3;
+		uint32 caps4;
+		uint32 reserved2;
+	};
+
+	struct DDS_HEADER_DXT10
+	{
+		uint32 dxgiFormat;
+		uint32 resourceDimension;
+		uint32 miscFlag; // see D3D11_RESOURCE_MISC_FLAG
+		uint32 arraySize;
+		uint32 miscFlags2;
+	};
+
+#pragma pack(pop)
+
+	static_assert(sizeof(DDS_PIXELFORMAT) == 32, "DDS_PIXELFORMAT is 32 bytes in the file");
+	static_assert(sizeof(DDS_HEADER) == 124, "DDS_HEADER is 124 bytes in the file");
+	static_assert(sizeof(DDS_HEADER_DXT10) == 20, "DDS_HEADER_DXT10 is 20 bytes in the file");
+
+	bool IsBitMask(const DDS_PIXELFORMAT& ddpf, uint32 r, uint32 g, uint32 b, uint32 a)
+	{
+		return ddpf.RBitMask == r && ddpf.GBitMask == g && ddpf.BBitMask == b && ddpf.ABitMask == a;
+	}
+
+	DXGI_FORMAT GetDXGIFormat(const DDS_PIXELFORMAT& ddpf)
+	{
+		if(ddpf.flags & DDS_RGB)
+		{
+			// Note that sRGB formats are written using the "DX10" extended header.
+			switch(ddpf.RGBBitCount)
+			{
+			case 32:
+				if(IsBitMask(ddpf, 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000))
+					return DXGI_FORMAT_R8G8B8A8_UNORM;
+				if(IsBitMask(ddpf, 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000))
+					return DXGI_FORMAT_B8G8R8A8_UNORM;
+				if(IsBitMask(ddpf, 0x00ff0000, 0x0000ff00, 0x000000ff, 0x00000000))
+					return DXGI_FORMAT_B8G8R8X8_UNORM;
+
+				// Many DDS writers, D3DX included, swap the red and blue masks of
+				// 10:10:10:2 formats, so the 'backwards' mask is taken to mean
+				// R10G10B10A2.  Files that need to be unambiguous use the DX10 header.
+				if(IsBitMask(ddpf, 0x3ff00000, 0x000ffc00, 0x000003ff, 0xc0000000))
+					return DXGI_FORMAT_R10G10B10A2_UNORM;
+
+				if(IsBitMask(ddpf, 0x0000ffff, 0xffff0000, 0x00000000, 0x00000000))
+					return DXGI_FORMAT_R16G16_UNORM;
+
+				// Only 32-bit color channel format in D3D9 was R32F.
+				if(IsBitMask(ddpf, 0xffffffff, 0x00000000, 0x00000000, 0x00000000))
+					return DXGI_FORMAT_R32_FLOAT;
+				break;
+
+			case 16:
+				if(IsBitMask(ddpf, 0x7c00, 0x03e0, 0x001f, 0x8000))
+					return DXGI_FORMAT_B5G5R5A1_UNORM;
+				if(IsBitMask(ddpf, 0xf800, 0x07e0, 0x001f, 0x0000))
+					return DXGI_FORMAT_B5G6R5_UNORM;
+				if(IsBitMask(ddpf, 0x0f00, 0x00f0, 0x000f, 0xf000))
+					return DXGI_FORMAT_B4G4R4A4_UNORM;
+				break;
+			}
+		}
+		else if(ddpf.flags & DDS_LUMINANCE)
+		{
+			if(ddpf.RGBBitCount == 8 && IsBitMask(ddpf, 0x000000ff, 0x00000000, 0x00000000, 0x00000000))
+				return DXGI_FORMAT_R8_UNORM;
+
+			if(ddpf.RGBBitCount == 16)
+			{
+				if(IsBitMask(ddpf, 0x0000ffff, 0x00000000, 0x00000000, 0x00000000))
+					return DXGI_FORMAT_R16_UNORM;
+				if(IsBitMask(ddpf, 0x000000ff, 0x00000000, 0x00000000, 0x0000ff00))
+					return DXGI_FORMAT_R8G8_UNORM;
+			}
+		}
+		else if(ddpf.flags & DDS_ALPHA)
+		{
+			if(ddpf.RGBBitCount == 8)
+				return DXGI_FORMAT_A8_UNORM;
+		}
+		else if(ddpf.flags & DDS_FOURCC)
+		{
+			switch(ddpf.fourCC)
+			{
+			case MakeFourCC('D', 'X', 'T', '1'): return DXGI_FORMAT_BC1_UNORM;
+			case MakeFourCC('D', 'X', 'T', '3'): return DXGI_FORMAT_BC2_UNORM;
+			case MakeFourCC('D', 'X', 'T', '5'): return DXGI_FORMAT_BC3_UNORM;
+
+			// Premultiplied alpha has no DXGI format of its own, but the data is
+			// the same as these BC formats.
+			case MakeFourCC('D', 'X', 'T', '2'): return DXGI_FORMAT_BC2_UNORM;
+			case MakeFourCC('D', 'X', 'T', '4'): return DXGI_FORMAT_BC3_UNORM;
+
+			case MakeFourCC('A', 'T', 'I', '1'): return DXGI_FORMAT_BC4_UNORM;
+			case MakeFourCC('B', 'C', '4', 'U'): return DXGI_FORMAT_BC4_UNORM;
+			case MakeFourCC('B', 'C', '4', 'S'): return DXGI_FORMAT_BC4_SNORM;
+
+			case MakeFourCC('A', 'T', 'I', '2'): return DXGI_FORMAT_BC5_UNORM;
+			case MakeFourCC('B', 'C', '5', 'U'): return DXGI_FORMAT_BC5_UNORM;
+			case MakeFourCC('B', 'C', '5', 'S'): return DXGI_FORMAT_BC5_SNORM;
+
+			// BC6H and BC7 are written using the "DX10" extended header.
+
+			case MakeFourCC('R', 'G', 'B', 'G'): return DXGI_FORMAT_R8G8_B8G8_UNORM;
+			case MakeFourCC('G', 'R', 'G', 'B'): return DXGI_FORMAT_G8R8_G8B8_UNORM;
+			case MakeFourCC('Y', 'U', 'Y', '2'): return DXGI_FORMAT_YUY2;
+
+			// D3DFORMAT values stored in the FourCC.
+			case 36:  return DXGI_FORMAT_R16G16B16A16_UNORM; // D3DFMT_A16B16G16R16
+			case 110: return DXGI_FORMAT_R16G16B16A16_SNORM; // D3DFMT_Q16W16V16U16
+			case 111: return DXGI_FORMAT_R16_FLOAT;          // D3DFMT_R16F
+			case 112: return DXGI_FORMAT_R16G16_FLOAT;       // D3DFMT_G16R16F
+			case 113: return DXGI_FORMAT_R16G16B16A16_FLOAT; // D3DFMT_A16B16G16R16F
+			case 114: return DXGI_FORMAT_R32_FLOAT;          // D3DFMT_R32F
+			case 115: return DXGI_FORMAT_R32G32_FLOAT;       // D3DFMT_G32R32F
+			case 116: return DXGI_FORMAT_R32G32B32A32_FLOAT; // D3DFMT_A32B32G32R32F
+			}
+		}
+
+		return DXGI_FORMAT_UNKNOWN;
+	}
+
+	DDSParser::AlphaMode GetAlphaMode(const DDS_HEADER& header, const DDS_HEADER_DXT10* dxt10)
+	{
+		if(dxt10)
+		{
+			auto mode = static_cast<DDSParser::AlphaMode>(dxt10->miscFlags2 & DDS_MISC_FLAGS2_ALPHA_MODE_MASK);
+			switch(mode)
+			{
+			case DDSParser::AlphaMode::Straight:
+			case DDSParser::AlphaMode::Premultiplied:
+			case DDSParser::AlphaMode::Opaque:
+			case DDSParser::AlphaMode::Custom:
+				return mode;
+			default:
+				return DDSParser::AlphaMode::Unknown;
+			}
+		}
+
+		if((header.ddspf.flags & DDS_FOURCC) &&
+			(header.ddspf.fourCC == MakeFourCC('D', 'X', 'T', '2') ||
+			 header.ddspf.fourCC == MakeFourCC('D', 'X', 'T', '4')))
+		{
+			return DDSParser::AlphaMode::Premultiplied;
+		}
+
+		return DDSParser::AlphaMode::Unknown;
+	}
+
+	// Bytes of one mip level: all its depth slices.
+	uint64 MipSize(uint32 width, uint32 height, uint32 depth, DXGI_FORMAT format)
+	{
+		uint64 numBytes = 0;
+		DDSParser::GetSurfaceInfo(width, height, format, &numBytes, nullptr, nullptr);
+		return numBytes * depth;
+	}
+
+	uint32 NextMipSize(uint32 size)
+	{
+		return std::max<uint32>(size >> 1, 1);
+	}
+}
+
+DDSParser::Result DDSParser::Parse(const void* data, std::size_t size, TextureDesc& desc)
+{
+	if(data == nullptr || size < sizeof(uint32) + sizeof(DDS_HEADER))
+		return Result::InvalidFile;
+
+	auto bytes = static_cast<const std::uint8_t*>(data);
+
+	// DDS files always start with the same magic number ("DDS ").
+	uint32 magic = 0;
+	std::memcpy(&magic, bytes, sizeof(uint32));
+	if(magic != DDS_MAGIC)
+		return Result::InvalidFile;
+
+	DDS_HEADER header;
+	std::memcpy(&header, bytes + sizeof(uint32), sizeof(DDS_HEADER));
+	if(header.size != sizeof(DDS_HEADER) || header.ddspf.size != sizeof(DDS_PIXELFORMAT))
+		return Result::InvalidFile;
+
+	TextureDesc result;
+	result.DataOffset = sizeof(uint32) + sizeof(DDS_HEADER);
+	result.Width = header.width;
+	result.Height = header.height;
+	result.Depth = header.depth;
+	result.MipLevels = std::max<uint32>(header.mipMapCount, 1);
+
+	// Multiplied by 6 for cube maps, so kept wide enough not to wrap.
+	uint64 arraySize = 1;
+
+	DDS_HEADER_DXT10 dxt10;
+	bool hasDxt10 = (header.ddspf.flags & DDS_FOURCC) && header.ddspf.fourCC == MakeFourCC('D', 'X', '1', '0');
+	if(hasDxt10)
+	{
+		if(size < result.DataOffset + sizeof(DDS_HEADER_DXT10))
+			return Result::InvalidFile;
+
+		std::memcpy(&dxt10, bytes + result.DataOffset, sizeof(DDS_HEADER_DXT10));
+		result.DataOffset += sizeof(DDS_HEADER_DXT10);
+
+		arraySize = dxt10.arraySize;
+		if(arraySize == 0)
+			return Result::InvalidData;
+
+		auto format = static_cast<DXGI_FORMAT>(dxt10.dxgiFormat);
+		switch(format)
+		{
+		case DXGI_FORMAT_AI44:
+		case DXGI_FORMAT_IA44:
+		case DXGI_FORMAT_P8:
+		case DXGI_FORMAT_A8P8:
+			return Result::NotSupported;
+
+		default:
+			if(BitsPerPixel(format) == 0)
+				return Result::NotSupported;
+		}
+		result.Format = format;
+
+		switch(dxt10.resourceDimension)
+		{
+		case DIMENSION_TEXTURE1D:
+			// D3DX writes 1D textures with a fixed Height of 1.
+			if((header.flags & DDS_HEIGHT) && result.Height != 1)
+				return Result::InvalidData;
+			result.Height = result.Depth = 1;
+			result.Dimension = ResourceDimension::Texture1D;
+			break;
+
+		case DIMENSION_TEXTURE2D:
+			if(dxt10.miscFlag & RESOURCE_MISC_TEXTURECUBE)
+			{
+				arraySize *= 6;
+				result.IsCubeMap = true;
+			}
+			result.Depth = 1;
+			result.Dimension = ResourceDimension::Texture2D;
+			break;
+
+		case DIMENSION_TEXTURE3D:
+			if(!(header.flags & DDS_HEADER_FLAGS_VOLUME))
+				return Result::InvalidData;
+			if(arraySize > 1)
+				return Result::NotSupported;
+			result.Dimension = ResourceDimension::Texture3D;
+			break;
+
+		default:
+			return Result::NotSupported;
+		}
+	}
+	else
+	{
+		result.Format = GetDXGIFormat(header.ddspf);
+		if(result.Format == DXGI_FORMAT_UNKNOWN)
+			return Result::NotSupported;
+
+		if(header.flags & DDS_HEADER_FLAGS_VOLUME)
+		{
+			result.Dimension = ResourceDimension::Texture3D;
+		}
+		else
+		{
+			if(header.caps2 & DDS_CUBEMAP)
+			{
+				// All six faces have to be there.
+				if((header.caps2 & DDS_CUBEMAP_ALLFACES) != DDS_CUBEMAP_ALLFACES)
+					return Result::NotSupported;
+
+				arraySize = 6;
+				result.IsCubeMap = true;
+			}
+
+			// A legacy Direct3D 9 DDS has no way to express a 1D texture.
+			result.Depth = 1;
+			result.Dimension = ResourceDimension::Texture2D;
+		}
+	}
+
+	// File metadata larger than the hardware limits is not trusted.
+	if(result.MipLevels > MaxMipLevels)
+		return Result::NotSupported;
+
+	switch(result.Dimension)
+	{
+	case ResourceDimension::Texture1D:
+		if(arraySize > MaxTexture1DArraySize || result.Width > MaxTexture1DWidth)
+			return Result::NotSupported;
+		break;
+
+	case ResourceDimension::Texture2D:
+		if(result.IsCubeMap)
+		{
+			// arraySize counts faces, so this is the right bound.
+			if(arraySize > MaxTexture2DArraySize ||
+				result.Width > MaxTextureCubeSize || result.Height > MaxTextureCubeSize)
+				return Result::NotSupported;
+		}
+		else if(arraySize > MaxTexture2DArraySize ||
+			result.Width > MaxTexture2DSize || result.Height > MaxTexture2DSize)
+		{
+			return Result::NotSupported;
+		}
+		break;
+
+	default: // ResourceDimension::Texture3D
+		if(arraySize > 1 || result.Width > MaxTexture3DSize ||
+			result.Height > MaxTexture3DSize || result.Depth > MaxTexture3DSize)
+			return Result::NotSupported;
+		break;
+	}
+
+	result.ArraySize = static_cast<uint32>(arraySize);
+
+	uint32 w = result.Width;
+	uint32 h = result.Height;
+	uint32 d = result.Depth;
+	for(uint32 i = 0; i < result.MipLevels; ++i)
+	{
+		result.SliceSize += MipSize(w, h, d, result.Format);
+		w = NextMipSize(w);
+		h = NextMipSize(h);
+		d = NextMipSize(d);
+	}
+
+	// The bounds above keep this product far from overflowing 64 bits.
+	if(result.SliceSize * result.ArraySize > size - result.DataOffset)
+		return Result::EndOfFile;
+
+	result.Alpha = GetAlphaMode(header, hasDxt10 ? &dxt10 : nullptr);
+
+	desc = result;
+	return Result::Ok;
+}
+
+DDSParser::Result DDSParser::InitFile(TextureDesc& desc, std::vector<std::uint8_t>& file)
+{
+	if(desc.Width == 0 || desc.Height == 0 || desc.Depth == 0 || desc.MipLevels == 0 || desc.ArraySize == 0 ||
+		(desc.IsCubeMap && desc.ArraySize % 6 != 0))
+		return Result::InvalidData;
+
+	uint64 topBytes = 0;
+	uint32 topRowBytes = 0;
+	GetSurfaceInfo(desc.Width, desc.Height, desc.Format, &topBytes, &topRowBytes, nullptr);
+	if(topBytes == 0)
+		return Result::NotSupported;
+
+	DDS_HEADER header = {};
+	header.size = sizeof(DDS_HEADER);
+	header.flags = DDS_HEADER_FLAGS_TEXTURE | DDS_HEADER_FLAGS_MIPMAP;
+	header.width = desc.Width;
+	header.height = desc.Height;
+	header.mipMapCount = desc.MipLevels;
+	header.caps = DDS_SURFACE_FLAGS_TEXTURE;
+
+	if(IsBlockCompressed(desc.Format))
+	{
+		header.flags |= DDS_HEADER_FLAGS_LINEARSIZE;
+		header.pitchOrLinearSize = static_cast<uint32>(topBytes);
+	}
+	else
+	{
+		header.flags |= DDS_HEADER_FLAGS_PITCH;
+		header.pitchOrLinearSize = topRowBytes;
+	}
+
+	if(desc.MipLevels > 1)
+		header.caps |= DDS_SURFACE_FLAGS_MIPMAP;
+
+	header.ddspf.size = sizeof(DDS_PIXELFORMAT);
+	header.ddspf.flags = DDS_FOURCC;
+	header.ddspf.fourCC = MakeFourCC('D', 'X', '1', '0');
+
+	DDS_HEADER_DXT10 dxt10 = {};
+	dxt10.dxgiFormat = desc.Format;
+	dxt10.arraySize = desc.ArraySize;
+	dxt10.miscFlags2 = static_cast<uint32>(desc.Alpha);
+
+	switch(desc.Dimension)
+	{
+	case ResourceDimension::Texture1D:
+		dxt10.resourceDimension = DIMENSION_TEXTURE1D;
+		break;
+
+	case ResourceDimension::Texture2D:
+		dxt10.resourceDimension = DIMENSION_TEXTURE2D;
+		if(desc.IsCubeMap)
+		{
+			header.caps |= DDS_SURFACE_FLAGS_CUBEMAP;
+			header.caps2 = DDS_CUBEMAP_ALLFACES;
+			dxt10.miscFlag = RESOURCE_MISC_TEXTURECUBE;
+			dxt10.arraySize = desc.ArraySize / 6;
+		}
+		break;
+
+	case ResourceDimension::Texture3D:
+		dxt10.resourceDimension = DIMENSION_TEXTURE3D;
+		header.flags |= DDS_HEADER_FLAGS_VOLUME;
+		header.caps2 = DDS_FLAGS_VOLUME;
+		header.depth = desc.Depth;
+		break;
+
+	default:
+		return Result::InvalidData;
+	}
+
+	desc.DataOffset = sizeof(uint32) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10);
+	desc.SliceSize = 0;
+
+	uint32 w = desc.Width;
+	uint32 h = desc.Height;
+	uint32 d = desc.Depth;
+	for(uint32 i = 0; i < desc.MipLevels; ++i)
+	{
+		desc.SliceSize += MipSize(w, h, d, desc.Format);
+		w = NextMipSize(w);
+		h = NextMipSize(h);
+		d = NextMipSize(d);
+	}
+
+	// Sizes past the hardware limits are rejected by Parse below, but must not
+	// be allocated first.
+	const uint64 maxBytes = uint64(1) << 36;
+	if(desc.ArraySize > MaxTexture2DArraySize || desc.SliceSize > maxBytes / desc.ArraySize)
+		return Result::NotSupported;
+
+	file.assign(static_cast<std::size_t>(desc.DataOffset + desc.SliceSize * desc.ArraySize), 0);
+	std::memcpy(file.data(), &DDS_MAGIC, sizeof(uint32));
+	std::memcpy(file.data() + sizeof(uint32), &header, sizeof(DDS_HEADER));
+	std::memcpy(file.data() + sizeof(uint32) + sizeof(DDS_HEADER), &dxt10, sizeof(DDS_HEADER_DXT10));
+
+	TextureDesc written;
+	Result result = Parse(file.data(), file.size(), written);
+	if(result != Result::Ok)
+		file.clear();
+	return result;
+}
+
+DDSParser::Subresource DDSParser::GetSubresource(const TextureDesc& desc, uint32 mip, uint32 arraySlice)
+{
+	Subresource sub;
+	sub.Offset = desc.DataOffset + arraySlice * desc.SliceSize;
+	sub.Width = desc.Width;
+	sub.Height = desc.Height;
+	sub.Depth = desc.Depth;
+
+	for(uint32 i = 0; i < mip; ++i)
+	{
+		sub.Offset += MipSize(sub.Width, sub.Height, sub.Depth, desc.Format);
+		sub.Width = NextMipSize(sub.Width);
+		sub.Height = NextMipSize(sub.Height);
+		sub.Depth = NextMipSize(sub.Depth);
+	}
+
+	GetSurfaceInfo(sub.Width, sub.Height, desc.Format, &sub.SlicePitch, &sub.RowPitch, &sub.RowCount);
+	return sub;
+}
+
+uint32 DDSParser::GetSubresources(const TextureDesc& desc, std::size_t maxSize, Subresource* subresources)
+{
+	uint32 skipMips = 0;
+	uint32 index = 0;
+	for(uint32 j = 0; j < desc.ArraySize; ++j)
+	{
+		Subresource sub;
+		sub.Offset = desc.DataOffset + j * desc.SliceSize;
+		sub.Width = desc.Width;
+		sub.Height = desc.Height;
+		sub.Depth = desc.Depth;
+
+		for(uint32 i = 0; i < desc.MipLevels; ++i)
+		{
+			GetSurfaceInfo(sub.Width, sub.Height, desc.Format, &sub.SlicePitch, &sub.RowPitch, &sub.RowCount);
+
+			if(desc.MipLevels <= 1 || maxSize == 0 ||
+				(sub.Width <= maxSize && sub.Height <= maxSize && sub.Depth <= maxSize))
+			{
+				subresources[index++] = sub;
+			}
+			else if(j == 0)
+			{
+				// Levels left out are counted once, on the first slice.
+				++skipMips;
+			}
+
+			sub.Offset += sub.SlicePitch * sub.Depth;
+			sub.Width = NextMipSize(sub.Width);
+			sub.Height = NextMipSize(sub.Height);
+			sub.Depth = NextMipSize(sub.Depth);
+		}
+	}
+
+	return skipMips;
+}
+
+void DDSParser::GetSurfaceInfo(uint32 width, uint32 height, DXGI_FORMAT format,
+	uint64* outNumBytes, uint32* outRowBytes, uint32* outNumRows)
+{
+	uint64 numBytes = 0;
+	uint64 rowBytes = 0;
+	uint64 numRows = 0;
+
+	bool bc = false;
+	bool packed = false;
+	bool planar = false;
+	uint64 bpe = 0;
+	switch(format)
+	{
+	case DXGI_FORMAT_BC1_TYPELESS:
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC4_TYPELESS:
+	case DXGI_FORMAT_BC4_UNORM:
+	case DXGI_FORMAT_BC4_SNORM:
+		bc = true;
+		bpe = 8;
+		break;
+
+	case DXGI_FORMAT_BC2_TYPELESS:
+	case DXGI_FORMAT_BC2_UNORM:
+	case DXGI_FORMAT_BC2_UNORM_SRGB:
+	case DXGI_FORMAT_BC3_TYPELESS:
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_BC5_TYPELESS:
+	case DXGI_FORMAT_BC5_UNORM:
+	case DXGI_FORMAT_BC5_SNORM:
+	case DXGI_FORMAT_BC6H_TYPELESS:
+	case DXGI_FORMAT_BC6H_UF16:
+	case DXGI_FORMAT_BC6H_SF16:
+	case DXGI_FORMAT_BC7_TYPELESS:
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		bc = true;
+		bpe = 16;
+		break;
+
+	case DXGI_FORMAT_R8G8_B8G8_UNORM:
+	case DXGI_FORMAT_G8R8_G8B8_UNORM:
+	case DXGI_FORMAT_YUY2:
+		packed = true;
+		bpe = 4;
+		break;
+
+	case DXGI_FORMAT_Y210:
+	case DXGI_FORMAT_Y216:
+		packed = true;
+		bpe = 8;
+		break;
+
+	case DXGI_FORMAT_NV12:
+	case DXGI_FORMAT_420_OPAQUE:
+		planar = true;
+		bpe = 2;
+		break;
+
+	case DXGI_FORMAT_P010:
+	case DXGI_FORMAT_P016:
+		planar = true;
+		bpe = 4;
+		break;
+
+	default:
+		break;
+	}
+
+	if(bc)
+	{
+		uint64 numBlocksWide = width > 0 ? std::max<uint64>(1, (uint64(width) + 3) / 4) : 0;
+		uint64 numBlocksHigh = height > 0 ? std::max<uint64>(1, (uint64(height) + 3) / 4) : 0;
+		rowBytes = numBlocksWide * bpe;
+		numRows = numBlocksHigh;
+		numBytes = rowBytes * numBlocksHigh;
+	}
+	else if(packed)
+	{
+		rowBytes = ((uint64(width) + 1) >> 1) * bpe;
+		numRows = height;
+		numBytes = rowBytes * height;
+	}
+	else if(format == DXGI_FORMAT_NV11)
+	{
+		// Direct3D makes this simplifying assumption, although it is larger than the 4:1:1 data.
+		rowBytes = ((uint64(width) + 3) >> 2) * 4;
+		numRows = uint64(height) * 2;
+		numBytes = rowBytes * numRows;
+	}
+	else if(planar)
+	{
+		rowBytes = ((uint64(width) + 1) >> 1) * bpe;
+		numBytes = (rowBytes * height) + ((rowBytes * height + 1) >> 1);
+		numRows = height + ((uint64(height) + 1) >> 1);
+	}
+	else
+	{
+		// Round up to the nearest byte.
+		rowBytes = (uint64(width) * BitsPerPixel(format) + 7) / 8;
+		numRows = height;
+		numBytes = rowBytes * height;
+	}
+
+	if(outNumBytes)
+		*outNumBytes = numBytes;
+	if(outRowBytes)
+		*outRowBytes = static_cast<uint32>(rowBytes);
+	if(outNumRows)
+		*outNumRows = static_cast<uint32>(numRows);
+}
+
+uint32 DDSParser::BitsPerPixel(DXGI_FORMAT format)
+{
+	switch(format)
+	{
+	case DXGI_FORMAT_R32G32B32A32_TYPELESS:
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:
+	case DXGI_FORMAT_R32G32B32A32_UINT:
+	case DXGI_FORMAT_R32G32B32A32_SINT:
+		return 128;
+
+	case DXGI_FORMAT_R32G32B32_TYPELESS:
+	case DXGI_FORMAT_R32G32B32_FLOAT:
+	case DXGI_FORMAT_R32G32B32_UINT:
+	case DXGI_FORMAT_R32G32B32_SINT:
+		return 96;
+
+	case DXGI_FORMAT_R16G16B16A16_TYPELESS:
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:
+	case DXGI_FORMAT_R16G16B16A16_UNORM:
+	case DXGI_FORMAT_R16G16B16A16_UINT:
+	case DXGI_FORMAT_R16G16B16A16_SNORM:
+	case DXGI_FORMAT_R16G16B16A16_SINT:
+	case DXGI_FORMAT_R32G32_TYPELESS:
+	case DXGI_FORMAT_R32G32_FLOAT:
+	case DXGI_FORMAT_R32G32_UINT:
+	case DXGI_FORMAT_R32G32_SINT:
+	case DXGI_FORMAT_R32G8X24_TYPELESS:
+	case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+	case DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS:
+	case DXGI_FORMAT_X32_TYPELESS_G8X24_UINT:
+	case DXGI_FORMAT_Y416:
+	case DXGI_FORMAT_Y210:
+	case DXGI_FORMAT_Y216:
+		return 64;
+
+	case DXGI_FORMAT_R10G10B10A2_TYPELESS:
+	case DXGI_FORMAT_R10G10B10A2_UNORM:
+	case DXGI_FORMAT_R10G10B10A2_UINT:
+	case DXGI_FORMAT_R11G11B10_FLOAT:
+	case DXGI_FORMAT_R8G8B8A8_TYPELESS:
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+	case DXGI_FORMAT_R8G8B8A8_UINT:
+	case DXGI_FORMAT_R8G8B8A8_SNORM:
+	case DXGI_FORMAT_R8G8B8A8_SINT:
+	case DXGI_FORMAT_R16G16_TYPELESS:
+	case DXGI_FORMAT_R16G16_FLOAT:
+	case DXGI_FORMAT_R16G16_UNORM:
+	case DXGI_FORMAT_R16G16_UINT:
+	case DXGI_FORMAT_R16G16_SNORM:
+	case DXGI_FORMAT_R16G16_SINT:
+	case DXGI_FORMAT_R32_TYPELESS:
+	case DXGI_FORMAT_D32_FLOAT:
+	case DXGI_FORMAT_R32_FLOAT:
+	case DXGI_FORMAT_R32_UINT:
+	case DXGI_FORMAT_R32_SINT:
+	case DXGI_FORMAT_R24G8_TYPELESS:
+	case DXGI_FORMAT_D24_UNORM_S8_UINT:
+	case DXGI_FORMAT_R24_UNORM_X8_TYPELESS:
+	case DXGI_FORMAT_X24_TYPELESS_G8_UINT:
+	case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
+	case DXGI_FORMAT_R8G8_B8G8_UNORM:
+	case DXGI_FORMAT_G8R8_G8B8_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_B8G8R8X8_UNORM:
+	case DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_TYPELESS:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+	case DXGI_FORMAT_B8G8R8X8_TYPELESS:
+	case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+	case DXGI_FORMAT_AYUV:
+	case DXGI_FORMAT_Y410:
+	case DXGI_FORMAT_YUY2:
+		return 32;
+
+	case DXGI_FORMAT_P010:
+	case DXGI_FORMAT_P016:
+		return 24;
+
+	case DXGI_FORMAT_R8G8_TYPELESS:
+	case DXGI_FORMAT_R8G8_UNORM:
+	case DXGI_FORMAT_R8G8_UINT:
+	case DXGI_FORMAT_R8G8_SNORM:
+	case DXGI_FORMAT_R8G8_SINT:
+	case DXGI_FORMAT_R16_TYPELESS:
+	case DXGI_FORMAT_R16_FLOAT:
+	case DXGI_FORMAT_D16_UNORM:
+	case DXGI_FORMAT_R16_UNORM:
+	case DXGI_FORMAT_R16_UINT:
+	case DXGI_FORMAT_R16_SNORM:
+	case DXGI_FORMAT_R16_SINT:
+	case DXGI_FORMAT_B5G6R5_UNORM:
+	case DXGI_FORMAT_B5G5R5A1_UNORM:
+	case DXGI_FORMAT_A8P8:
+	case DXGI_FORMAT_B4G4R4A4_UNORM:
+		return 16;
+
+	case DXGI_FORMAT_NV12:
+	case DXGI_FORMAT_420_OPAQUE:
+	case DXGI_FORMAT_NV11:
+		return 12;
+
+	case DXGI_FORMAT_R8_TYPELESS:
+	case DXGI_FORMAT_R8_UNORM:
+	case DXGI_FORMAT_R8_UINT:
+	case DXGI_FORMAT_R8_SNORM:
+	case DXGI_FORMAT_R8_SINT:
+	case DXGI_FORMAT_A8_UNORM:
+	case DXGI_FORMAT_AI44:
+	case DXGI_FORMAT_IA44:
+	case DXGI_FORMAT_P8:
+		return 8;
+
+	case DXGI_FORMAT_R1_UNORM:
+		return 1;
+
+	case DXGI_FORMAT_BC1_TYPELESS:
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC4_TYPELESS:
+	case DXGI_FORMAT_BC4_UNORM:
+	case DXGI_FORMAT_BC4_SNORM:
+		return 4;
+
+	case DXGI_FORMAT_BC2_TYPELESS:
+	case DXGI_FORMAT_BC2_UNORM:
+	case DXGI_FORMAT_BC2_UNORM_SRGB:
+	case DXGI_FORMAT_BC3_TYPELESS:
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_BC5_TYPELESS:
+	case DXGI_FORMAT_BC5_UNORM:
+	case DXGI_FORMAT_BC5_SNORM:
+	case DXGI_FORMAT_BC6H_TYPELESS:
+	case DXGI_FORMAT_BC6H_UF16:
+	case DXGI_FORMAT_BC6H_SF16:
+	case DXGI_FORMAT_BC7_TYPELESS:
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		return 8;
+
+	default:
+		return 0;
+	}
+}
+
+bool DDSParser::IsBlockCompressed(DXGI_FORMAT format)
+{
+	return (format >= DXGI_FORMAT_BC1_TYPELESS && format <= DXGI_FORMAT_BC5_SNORM) ||
+		(format >= DXGI_FORMAT_BC6H_TYPELESS && format <= DXGI_FORMAT_BC7_UNORM_SRGB);
+}
+
+DXGI_FORMAT DDSParser::MakeSRGB(DXGI_FORMAT format)
+{
+	switch(format)
+	{
+	case DXGI_FORMAT_R8G8B8A8_UNORM: return DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+	case DXGI_FORMAT_BC1_UNORM:      return DXGI_FORMAT_BC1_UNORM_SRGB;
+	case DXGI_FORMAT_BC2_UNORM:      return DXGI_FORMAT_BC2_UNORM_SRGB;
+	case DXGI_FORMAT_BC3_UNORM:      return DXGI_FORMAT_BC3_UNORM_SRGB;
+	case DXGI_FORMAT_B8G8R8A8_UNORM: return DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;
+	case DXGI_FORMAT_B8G8R8X8_UNORM: return DXGI_FORMAT_B8G8R8X8_UNORM_SRGB;
+	case DXGI_FORMAT_BC7_UNORM:      return DXGI_FORMAT_BC7_UNORM_SRGB;
+	default:                         return format;
+	}
+}
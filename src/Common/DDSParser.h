@@ -0,0 +1,155 @@
+//***************************************************************************************
+// DDSParser.h
+//
+// Reads the layout of a DDS file held in memory: its format, dimensions, mip and array
+// counts, and where each subresource lies in the file.  It does not open files or
+// create resources, so tools that only need a texture's metadata, or that want to
+// place its pixels somewhere other than a D3D12 upload heap, can use it on any
+// platform.  DDSTextureLoader parses through it before it creates anything.
+//
+// A file is accepted or rejected exactly as DDSTextureLoader always did: headers are
+// validated, sizes are bounded by the Direct3D 12 hardware limits, and the data must
+// hold every mip level of every array slice.  Once Parse succeeds, any subresource
+// offset it reports lies inside the buffer, so malformed or truncated files are
+// caught up front rather than while copying.
+//
+// InitFile goes the other way and lays out a new file, so tools can write what the
+// loader reads.
+//
+// The code only depends on the standard library and dxgiformat.h, which declares
+// nothing but the DXGI_FORMAT enum.  Outside the Windows SDK it comes with the
+// DirectX-Headers package.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <dxgiformat.h>
+
+class DDSParser
+{
+public:
+
+    using uint32 = std::uint32_t;
+    using uint64 = std::uint64_t;
+
+	enum class Result
+	{
+		Ok,
+		InvalidFile,   // Not a DDS file: too short, bad magic number or header sizes.
+		InvalidData,   // A DDS file whose header contradicts itself.
+		NotSupported,  // A valid DDS file this parser, or Direct3D 12, cannot use.
+		EndOfFile      // The pixel data is shorter than the header says.
+	};
+
+	// Same values as D3D12_RESOURCE_DIMENSION and D3D11_RESOURCE_DIMENSION.
+	enum class ResourceDimension
+	{
+		Unknown = 0,
+		Texture1D = 2,
+		Texture2D = 3,
+		Texture3D = 4
+	};
+
+	// Same values as DirectX::DDS_ALPHA_MODE.
+	enum class AlphaMode
+	{
+		Unknown = 0,
+		Straight = 1,
+		Premultiplied = 2,
+		Opaque = 3,
+		Custom = 4
+	};
+
+	struct TextureDesc
+	{
+		DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+		ResourceDimension Dimension = ResourceDimension::Unknown;
+		AlphaMode Alpha = AlphaMode::Unknown;
+		uint32 Width = 0;
+		uint32 Height = 0;
+		uint32 Depth = 0;
+		uint32 MipLevels = 0;
+
+		// Counts faces for cube maps, so a single cube has 6.
+		uint32 ArraySize = 0;
+		bool IsCubeMap = false;
+
+		// Byte offset of the pixel data from the start of the file.
+		uint64 DataOffset = 0;
+
+		// Bytes taken by one array slice with all its mip levels.
+		uint64 SliceSize = 0;
+	};
+
+	struct Subresource
+	{
+		// Byte offset from the start of the file.
+		uint64 Offset = 0;
+		uint32 Width = 0;
+		uint32 Height = 0;
+		uint32 Depth = 0;
+
+		// Bytes per row of pixels, or of 4x4 blocks for block compressed formats.
+		uint32 RowPitch = 0;
+		uint32 RowCount = 0;
+
+		// Bytes per depth slice; the subresource takes SlicePitch*Depth bytes.
+		uint64 SlicePitch = 0;
+	};
+
+	///<summary>
+	/// Validates the size bytes of a DDS file at data and describes the texture.
+	/// desc is only written on success.
+	///</summary>
+	static Result Parse(const void* data, std::size_t size, TextureDesc& desc);
+
+	///<summary>
+	/// The reverse of Parse, for tools that write textures.  Resizes file to hold a
+	/// DDS file for desc, always with the DX10 header, writes the header and zeroes
+	/// the pixel data.  desc.DataOffset and desc.SliceSize are filled in, so
+	/// GetSubresource then says where each subresource goes in file.  ArraySize
+	/// counts faces for cube maps, as Parse reports it.  Returns what Parse says of
+	/// the file, so a desc that Parse would reject is reported the same way.
+	///</summary>
+	static Result InitFile(TextureDesc& desc, std::vector<std::uint8_t>& file);
+
+	///<summary>
+	/// Layout of one mip level of one array slice (or cube face).
+	///</summary>
+	static Subresource GetSubresource(const TextureDesc& desc, uint32 mip, uint32 arraySlice);
+
+	///<summary>
+	/// Writes the layout of every subresource, array slice by array slice with mips
+	/// in order inside each, the order D3D12 numbers subresources in.  When maxSize
+	/// is nonzero and the texture has mips, levels with a dimension above maxSize
+	/// are left out.  Returns how many top levels were left out; subresources must
+	/// have room for (MipLevels - that count) * ArraySize entries, so MipLevels *
+	/// ArraySize is always enough.
+	///</summary>
+	static uint32 GetSubresources(const TextureDesc& desc, std::size_t maxSize, Subresource* subresources);
+
+	///<summary>
+	/// Size of a width by height surface: total bytes, bytes per row and row count.
+	/// Rows are rows of blocks for block compressed formats and include the chroma
+	/// rows of planar video formats.  All are zero for formats the parser does not
+	/// support.
+	///</summary>
+	static void GetSurfaceInfo(uint32 width, uint32 height, DXGI_FORMAT format,
+		uint64* numBytes, uint32* rowBytes, uint32* numRows);
+
+	static uint32 BitsPerPixel(DXGI_FORMAT format);
+
+	///<summary>
+	/// True for the BC1-BC7 formats, which store 4x4 blocks.  Direct3D 12 requires
+	/// the top level of such a texture to have sides that are multiples of 4.
+	///</summary>
+	static bool IsBlockCompressed(DXGI_FORMAT format);
+
+	///<summary>
+	/// The _SRGB twin of a UNORM format, or the format itself when it has none.
+	///</summary>
+	static DXGI_FORMAT MakeSRGB(DXGI_FORMAT format);
+};
@@ -3,10 +3,102 @@
 //***************************************************************************************
 
 #include "GeometryGenerator.h"
+#include <ppl.h>
 #include <algorithm>
+#include <cstring>
 
 using namespace DirectX;
 
+const GeometryGenerator::uint32 GeometryGenerator::MaxSubdivisions;
+const GeometryGenerator::uint32 GeometryGenerator::VertexLayout::NotPresent;
+
+namespace
+{
+	using uint32 = GeometryGenerator::uint32;
+
+	// Vertices per parallel task.  Smaller meshes are generated on the calling thread.
+	const uint32 VerticesPerTask = 16384;
+
+	///<summary>
+	/// Calls buildRows(firstRow, lastRow) over [0, rowCount) in chunks of about
+	/// VerticesPerTask vertices, in parallel when there is more than one chunk.
+	/// Each row must write only its own part of the output.
+	///</summary>
+	template<typename F>
+	void ForEachRowChunk(uint32 rowCount, uint32 rowSize, const F& buildRows)
+	{
+		uint32 rowsPerTask = std::max(1u, VerticesPerTask / std::max(1u, rowSize));
+		uint32 taskCount = (rowCount + rowsPerTask - 1) / rowsPerTask;
+
+		auto buildTask = [&](uint32 task)
+		{
+			uint32 firstRow = task*rowsPerTask;
+			buildRows(firstRow, std::min(firstRow + rowsPerTask, rowCount));
+		};
+
+		if(taskCount == 1)
+			buildTask(0);
+		else if(taskCount > 1)
+			concurrency::parallel_for(0u, taskCount, buildTask);
+	}
+
+	// Writes vertices into an array of Vertex.
+	struct VertexArrayWriter
+	{
+		void Write(uint32 index, const GeometryGenerator::Vertex& v)const
+		{
+			Vertices[index] = v;
+		}
+
+		GeometryGenerator::Vertex* Vertices;
+	};
+
+	// Writes the attributes a VertexLayout has into an interleaved vertex buffer.
+	struct VertexLayoutWriter
+	{
+		void Write(uint32 index, const GeometryGenerator::Vertex& v)const
+		{
+			char* vertex = Vertices + (size_t)index*Layout.Stride;
+			WriteAttribute(vertex, Layout.PositionOffset, v.Position);
+			WriteAttribute(vertex, Layout.NormalOffset, v.Normal);
+			WriteAttribute(vertex, Layout.TangentUOffset, v.TangentU);
+			WriteAttribute(vertex, Layout.TexCOffset, v.TexC);
+		}
+
+		template<typename T>
+		static void WriteAttribute(char* vertex, uint32 offset, const T& value)
+		{
+			if(offset != GeometryGenerator::VertexLayout::NotPresent)
+				std::memcpy(vertex + offset, &value, sizeof(T));
+		}
+
+		GeometryGenerator::VertexLayout Layout;
+		char* Vertices;
+	};
+
+	///<summary>
+	/// Calls writeVertices with the writer for the layout, so that the vertex loops
+	/// are compiled once for plain Vertex arrays, which are copied whole, and once
+	/// for other layouts, instead of testing the layout per vertex.
+	///</summary>
+	template<typename F>
+	void WithVertexWriter(const GeometryGenerator::VertexLayout& layout, void* vertices, const F& writeVertices)
+	{
+		GeometryGenerator::VertexLayout vertexLayout;
+		bool isVertex =
+			layout.Stride == vertexLayout.Stride &&
+			layout.PositionOffset == vertexLayout.PositionOffset &&
+			layout.NormalOffset == vertexLayout.NormalOffset &&
+			layout.TangentUOffset == vertexLayout.TangentUOffset &&
+			layout.TexCOffset == vertexLayout.TexCOffset;
+
+		if(isVertex)
+			writeVertices(VertexArrayWriter{ static_cast<GeometryGenerator::Vertex*>(vertices) });
+		else
+			writeVertices(VertexLayoutWriter{ layout, static_cast<char*>(vertices) });
+	}
+}
+
 GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float height, float depth, uint32 numSubdivisions)
 {
     MeshData meshData;
@@ -92,7 +184,7 @@ GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float heig
 	meshData.Indices32.assign(&i[0], &i[36]);
 
     // Put a cap on the number of subdivisions.
-    numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
+    numSubdivisions = std::min<uint32>(numSubdivisions, MaxSubdivisions);
 
     for(uint32 i = 0; i < numSubdivisions; ++i)
         Subdivide(meshData);
@@ -103,71 +195,115 @@ GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float heig
 GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount)
 {
     MeshData meshData;
+	meshData.Vertices.resize(GetSphereVertexCount(sliceCount, stackCount));
+	meshData.Indices32.resize(GetSphereIndexCount(sliceCount, stackCount));
 
-	//
-	// Compute the vertices stating at the top pole and moving down the stacks.
-	//
+	CreateSphere(radius, sliceCount, stackCount, VertexLayout(),
+		meshData.Vertices.data(), meshData.Indices32.data());
+
+    return meshData;
+}
+
+GeometryGenerator::uint32 GeometryGenerator::GetSphereVertexCount(uint32 sliceCount, uint32 stackCount)
+{
+	return (stackCount-1)*(sliceCount+1) + 2;
+}
 
-	// Poles: note that there will be texture coordinate distortion as there is
-	// not a unique point on the texture map to assign to the pole when mapping
-	// a rectangular texture onto a sphere.
-	Vertex topVertex(0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
-	Vertex bottomVertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+GeometryGenerator::uint32 GeometryGenerator::GetSphereIndexCount(uint32 sliceCount, uint32 stackCount)
+{
+	return 6*sliceCount*(stackCount-1);
+}
 
-	meshData.Vertices.push_back( topVertex );
+void GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount,
+	const VertexLayout& layout, void* vertices, uint32* indices)
+{
+	uint32 ringVertexCount = sliceCount + 1;
+	uint32 vertexCount = GetSphereVertexCount(sliceCount, stackCount);
 
 	float phiStep   = XM_PI/stackCount;
 	float thetaStep = 2.0f*XM_PI/sliceCount;
 
-	// Compute vertices for each stack ring (do not count the poles as rings).
-	for(uint32 i = 1; i <= stackCount-1; ++i)
+	if(vertices != nullptr)
 	{
-		float phi = i*phiStep;
+		//
+		// Compute the vertices stating at the top pole and moving down the stacks.
+		//
 
-		// Vertices of ring.
-        for(uint32 j = 0; j <= sliceCount; ++j)
+		// Every ring has the same slice angles, so take their sines and cosines once,
+		// four at a time.
+		std::vector<XMFLOAT4A> sinTheta((ringVertexCount + 3) / 4);
+		std::vector<XMFLOAT4A> cosTheta(sinTheta.size());
+		for(uint32 j = 0; j < (uint32)sinTheta.size(); ++j)
 		{
-			float theta = j*thetaStep;
-
-			Vertex v;
-
-			// spherical to cartesian
-			v.Position.x = radius*sinf(phi)*cosf(theta);
-			v.Position.y = radius*cosf(phi);
-			v.Position.z = radius*sinf(phi)*sinf(theta);
+			XMVECTOR theta = XMVectorSet(4.0f*j, 4.0f*j + 1.0f, 4.0f*j + 2.0f, 4.0f*j + 3.0f) * thetaStep;
 
-			// Partial derivative of P with respect to theta
-			v.TangentU.x = -radius*sinf(phi)*sinf(theta);
-			v.TangentU.y = 0.0f;
-			v.TangentU.z = +radius*sinf(phi)*cosf(theta);
-
-			XMVECTOR T = XMLoadFloat3(&v.TangentU);
-			XMStoreFloat3(&v.TangentU, XMVector3Normalize(T));
-
-			XMVECTOR p = XMLoadFloat3(&v.Position);
-			XMStoreFloat3(&v.Normal, XMVector3Normalize(p));
+			XMVECTOR s, c;
+			XMVectorSinCos(&s, &c, theta);
+			XMStoreFloat4A(&sinTheta[j], s);
+			XMStoreFloat4A(&cosTheta[j], c);
+		}
 
-			v.TexC.x = theta / XM_2PI;
-			v.TexC.y = phi / XM_PI;
+		const float* sinThetas = &sinTheta[0].x;
+		const float* cosThetas = &cosTheta[0].x;
 
-			meshData.Vertices.push_back( v );
-		}
+		WithVertexWriter(layout, vertices, [&](const auto& writer)
+		{
+			// Poles: note that there will be texture coordinate distortion as there is
+			// not a unique point on the texture map to assign to the pole when mapping
+			// a rectangular texture onto a sphere.
+			writer.Write(0, Vertex(0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f));
+			writer.Write(vertexCount-1, Vertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f));
+
+			// Compute vertices for each stack ring (do not count the poles as rings).
+			ForEachRowChunk(stackCount-1, ringVertexCount, [&](uint32 firstRing, uint32 lastRing)
+			{
+				for(uint32 ring = firstRing; ring < lastRing; ++ring)
+				{
+					float phi = (ring+1)*phiStep;
+
+					float sinPhi, cosPhi;
+					XMScalarSinCos(&sinPhi, &cosPhi, phi);
+
+					// Vertices of ring.
+					for(uint32 j = 0; j <= sliceCount; ++j)
+					{
+						float theta = j*thetaStep;
+
+						// Spherical to cartesian.  The normal is the unit position, and
+						// the partial derivative of P with respect to theta, normalized,
+						// reduces to (-sin(theta), 0, cos(theta)).
+						float nx = sinPhi*cosThetas[j];
+						float nz = sinPhi*sinThetas[j];
+
+						Vertex v(
+							radius*nx, radius*cosPhi, radius*nz,
+							nx, cosPhi, nz,
+							-sinThetas[j], 0.0f, cosThetas[j],
+							theta / XM_2PI, phi / XM_PI);
+
+						writer.Write(1 + ring*ringVertexCount + j, v);
+					}
+				}
+			});
+		});
 	}
 
-	meshData.Vertices.push_back( bottomVertex );
+	if(indices == nullptr)
+		return;
 
 	//
 	// Compute indices for top stack.  The top stack was written first to the vertex buffer
 	// and connects the top pole to the first ring.
 	//
 
+	uint32 k = 0;
     for(uint32 i = 1; i <= sliceCount; ++i)
 	{
-		meshData.Indices32.push_back(0);
-		meshData.Indices32.push_back(i+1);
-		meshData.Indices32.push_back(i);
+		indices[k++] = 0;
+		indices[k++] = i+1;
+		indices[k++] = i;
 	}
-	
+
 	//
 	// Compute indices for inner stacks (not connected to poles).
 	//
@@ -175,20 +311,25 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 	// Offset the indices to the index of the first vertex in the first ring.
 	// This is just skipping the top pole vertex.
     uint32 baseIndex = 1;
-    uint32 ringVertexCount = sliceCount + 1;
-	for(uint32 i = 0; i < stackCount-2; ++i)
+	uint32* innerIndices = indices + k;
+	ForEachRowChunk(stackCount-2, ringVertexCount, [&](uint32 firstStack, uint32 lastStack)
 	{
-		for(uint32 j = 0; j < sliceCount; ++j)
+		for(uint32 i = firstStack; i < lastStack; ++i)
 		{
-			meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j);
-			meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j+1);
-			meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j);
-
-			meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j);
-			meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j+1);
-			meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j+1);
+			uint32* quad = innerIndices + 6*i*sliceCount;
+			for(uint32 j = 0; j < sliceCount; ++j, quad += 6)
+			{
+				quad[0] = baseIndex + i*ringVertexCount + j;
+				quad[1] = baseIndex + i*ringVertexCount + j+1;
+				quad[2] = baseIndex + (i+1)*ringVertexCount + j;
+
+				quad[3] = baseIndex + (i+1)*ringVertexCount + j;
+				quad[4] = baseIndex + i*ringVertexCount + j+1;
+				quad[5] = baseIndex + (i+1)*ringVertexCount + j+1;
+			}
 		}
-	}
+	});
+	k += 6*(stackCount-2)*sliceCount;
 
 	//
 	// Compute indices for bottom stack.  The bottom stack was written last to the vertex buffer
@@ -196,30 +337,21 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 	//
 
 	// South pole vertex was added last.
-	uint32 southPoleIndex = (uint32)meshData.Vertices.size()-1;
+	uint32 southPoleIndex = vertexCount-1;
 
 	// Offset the indices to the index of the first vertex in the last ring.
 	baseIndex = southPoleIndex - ringVertexCount;
-	
+
 	for(uint32 i = 0; i < sliceCount; ++i)
 	{
-		meshData.Indices32.push_back(southPoleIndex);
-		meshData.Indices32.push_back(baseIndex+i);
-		meshData.Indices32.push_back(baseIndex+i+1);
+		indices[k++] = southPoleIndex;
+		indices[k++] = baseIndex+i;
+		indices[k++] = baseIndex+i+1;
 	}
-
-    return meshData;
 }
  
 void GeometryGenerator::Subdivide(MeshData& meshData)
 {
-	// Save a copy of the input geometry.
-	MeshData inputCopy = meshData;
-
-
-	meshData.Vertices.resize(0);
-	meshData.Indices32.resize(0);
-
 	//       v1
 	//       *
 	//      / \
@@ -230,48 +362,112 @@ void GeometryGenerator::Subdivide(MeshData& meshData)
 	// *-----*-----*
 	// v0    m2     v2
 
-	uint32 numTris = (uint32)inputCopy.Indices32.size()/3;
-	for(uint32 i = 0; i < numTris; ++i)
+	uint32 numVerts = (uint32)meshData.Vertices.size();
+	uint32 numTris = (uint32)meshData.Indices32.size()/3;
+	uint32 numHalfEdges = numTris*3;
+
+	const std::vector<uint32>& indices = meshData.Indices32;
+
+	//
+	// Find the unique edges.  Each edge is stored once, in the bucket of its lower
+	// vertex index, so triangles that share an edge share its midpoint.  Vertices
+	// split along a seam have different indices, so seams stay split.
+	//
+
+	std::vector<uint32> bucketStart(numVerts + 1, 0);
+	for(uint32 i = 0; i < numHalfEdges; ++i)
 	{
-		Vertex v0 = inputCopy.Vertices[ inputCopy.Indices32[i*3+0] ];
-		Vertex v1 = inputCopy.Vertices[ inputCopy.Indices32[i*3+1] ];
-		Vertex v2 = inputCopy.Vertices[ inputCopy.Indices32[i*3+2] ];
+		uint32 a = indices[i];
+		uint32 b = indices[i - i%3 + (i+1)%3];
+		++bucketStart[std::min(a, b) + 1];
+	}
 
-		//
-		// Generate the midpoints.
-		//
+	for(uint32 i = 0; i < numVerts; ++i)
+		bucketStart[i+1] += bucketStart[i];
 
-        Vertex m0 = MidPoint(v0, v1);
-        Vertex m1 = MidPoint(v1, v2);
-        Vertex m2 = MidPoint(v0, v2);
+	// The higher vertex index of the edge in each bucket slot, and the slot each
+	// half-edge went into.
+	std::vector<uint32> slotHigh(numHalfEdges);
+	std::vector<uint32> halfEdgeSlot(numHalfEdges);
+	std::vector<uint32> bucketEnd(bucketStart.begin(), bucketStart.end() - 1);
 
-		//
-		// Add new geometry.
-		//
+	for(uint32 i = 0; i < numHalfEdges; ++i)
+	{
+		uint32 a = indices[i];
+		uint32 b = indices[i - i%3 + (i+1)%3];
 
-		meshData.Vertices.push_back(v0); // 0
-		meshData.Vertices.push_back(v1); // 1
-		meshData.Vertices.push_back(v2); // 2
-		meshData.Vertices.push_back(m0); // 3
-		meshData.Vertices.push_back(m1); // 4
-		meshData.Vertices.push_back(m2); // 5
- 
-		meshData.Indices32.push_back(i*6+0);
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+5);
+		uint32 slot = bucketEnd[std::min(a, b)]++;
+		slotHigh[slot] = std::max(a, b);
+		halfEdgeSlot[i] = slot;
+	}
+
+	// Give each unique edge the index of its midpoint vertex.  The new vertices go
+	// after the existing ones, which keep their indices.  Buckets are small (the
+	// vertex valence), so a linear search for duplicates is cheap.
+	std::vector<uint32> slotMidPoint(numHalfEdges);
+	std::vector<uint32> edgeVerts;
+	edgeVerts.reserve(numHalfEdges);
+
+	uint32 numEdges = 0;
+	for(uint32 v = 0; v < numVerts; ++v)
+	{
+		for(uint32 slot = bucketStart[v]; slot < bucketStart[v+1]; ++slot)
+		{
+			uint32 first = slot;
+			for(uint32 j = bucketStart[v]; j < slot; ++j)
+			{
+				if(slotHigh[j] == slotHigh[slot])
+				{
+					first = j;
+					break;
+				}
+			}
+
+			if(first == slot)
+			{
+				slotMidPoint[slot] = numVerts + numEdges++;
+				edgeVerts.push_back(v);
+				edgeVerts.push_back(slotHigh[slot]);
+			}
+			else
+			{
+				slotMidPoint[slot] = slotMidPoint[first];
+			}
+		}
+	}
+
+	//
+	// Add new geometry.  The output sizes are known exactly at this point.
+	//
+
+	meshData.Vertices.resize(numVerts + numEdges);
+	for(uint32 i = 0; i < numEdges; ++i)
+	{
+		meshData.Vertices[numVerts + i] = MidPoint(
+			meshData.Vertices[edgeVerts[i*2+0]],
+			meshData.Vertices[edgeVerts[i*2+1]]);
+	}
 
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+4);
-		meshData.Indices32.push_back(i*6+5);
+	std::vector<uint32> newIndices(numTris*12);
+	for(uint32 i = 0; i < numTris; ++i)
+	{
+		uint32 v0 = indices[i*3+0];
+		uint32 v1 = indices[i*3+1];
+		uint32 v2 = indices[i*3+2];
 
-		meshData.Indices32.push_back(i*6+5);
-		meshData.Indices32.push_back(i*6+4);
-		meshData.Indices32.push_back(i*6+2);
+		uint32 m0 = slotMidPoint[halfEdgeSlot[i*3+0]]; // v0-v1
+		uint32 m1 = slotMidPoint[halfEdgeSlot[i*3+1]]; // v1-v2
+		uint32 m2 = slotMidPoint[halfEdgeSlot[i*3+2]]; // v2-v0
 
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+1);
-		meshData.Indices32.push_back(i*6+4);
+		uint32* tri = &newIndices[i*12];
+
+		tri[0] = v0; tri[1]  = m0; tri[2]  = m2;
+		tri[3] = m0; tri[4]  = m1; tri[5]  = m2;
+		tri[6] = m2; tri[7]  = m1; tri[8]  = v2;
+		tri[9] = m0; tri[10] = v1; tri[11] = m1;
 	}
+
+	meshData.Indices32.swap(newIndices);
 }
 
 GeometryGenerator::Vertex GeometryGenerator::MidPoint(const Vertex& v0, const Vertex& v1)
@@ -309,7 +505,7 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uin
     MeshData meshData;
 
 	// Put a cap on the number of subdivisions.
-    numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
+    numSubdivisions = std::min<uint32>(numSubdivisions, MaxSubdivisions);
 
 	// Approximate a sphere by tessellating an icosahedron.
 
@@ -551,10 +747,28 @@ void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadi
 GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float depth, uint32 m, uint32 n)
 {
     MeshData meshData;
+	meshData.Vertices.resize(GetGridVertexCount(m, n));
+	meshData.Indices32.resize(GetGridIndexCount(m, n));
+
+	CreateGrid(width, depth, m, n, VertexLayout(),
+		meshData.Vertices.data(), meshData.Indices32.data());
 
-	uint32 vertexCount = m*n;
-	uint32 faceCount   = (m-1)*(n-1)*2;
+    return meshData;
+}
 
+GeometryGenerator::uint32 GeometryGenerator::GetGridVertexCount(uint32 m, uint32 n)
+{
+	return m*n;
+}
+
+GeometryGenerator::uint32 GeometryGenerator::GetGridIndexCount(uint32 m, uint32 n)
+{
+	return (m-1)*(n-1)*6; // 3 indices per face, 2 faces per quad
+}
+
+void GeometryGenerator::CreateGrid(float width, float depth, uint32 m, uint32 n,
+	const VertexLayout& layout, void* vertices, uint32* indices)
+{
 	//
 	// Create the vertices.
 	//
@@ -568,49 +782,58 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float dep
 	float du = 1.0f / (n-1);
 	float dv = 1.0f / (m-1);
 
-	meshData.Vertices.resize(vertexCount);
-	for(uint32 i = 0; i < m; ++i)
+	if(vertices != nullptr)
 	{
-		float z = halfDepth - i*dz;
-		for(uint32 j = 0; j < n; ++j)
+		WithVertexWriter(layout, vertices, [&](const auto& writer)
 		{
-			float x = -halfWidth + j*dx;
-
-			meshData.Vertices[i*n+j].Position = XMFLOAT3(x, 0.0f, z);
-			meshData.Vertices[i*n+j].Normal   = XMFLOAT3(0.0f, 1.0f, 0.0f);
-			meshData.Vertices[i*n+j].TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
-
-			// Stretch texture over grid.
-			meshData.Vertices[i*n+j].TexC.x = j*du;
-			meshData.Vertices[i*n+j].TexC.y = i*dv;
-		}
+			ForEachRowChunk(m, n, [&](uint32 firstRow, uint32 lastRow)
+			{
+				for(uint32 i = firstRow; i < lastRow; ++i)
+				{
+					float z = halfDepth - i*dz;
+					for(uint32 j = 0; j < n; ++j)
+					{
+						float x = -halfWidth + j*dx;
+
+						// Stretch texture over grid.
+						Vertex v(
+							x, 0.0f, z,
+							0.0f, 1.0f, 0.0f,
+							1.0f, 0.0f, 0.0f,
+							j*du, i*dv);
+
+						writer.Write(i*n+j, v);
+					}
+				}
+			});
+		});
 	}
- 
+
     //
 	// Create the indices.
 	//
 
-	meshData.Indices32.resize(faceCount*3); // 3 indices per face
+	if(indices == nullptr)
+		return;
 
 	// Iterate over each quad and compute indices.
-	uint32 k = 0;
-	for(uint32 i = 0; i < m-1; ++i)
+	ForEachRowChunk(m-1, n, [&](uint32 firstRow, uint32 lastRow)
 	{
-		for(uint32 j = 0; j < n-1; ++j)
+		for(uint32 i = firstRow; i < lastRow; ++i)
 		{
-			meshData.Indices32[k]   = i*n+j;
-			meshData.Indices32[k+1] = i*n+j+1;
-			meshData.Indices32[k+2] = (i+1)*n+j;
-
-			meshData.Indices32[k+3] = (i+1)*n+j;
-			meshData.Indices32[k+4] = i*n+j+1;
-			meshData.Indices32[k+5] = (i+1)*n+j+1;
-
-			k += 6; // next quad
+			uint32* quad = indices + 6*i*(n-1);
+			for(uint32 j = 0; j < n-1; ++j, quad += 6)
+			{
+				quad[0] = i*n+j;
+				quad[1] = i*n+j+1;
+				quad[2] = (i+1)*n+j;
+
+				quad[3] = (i+1)*n+j;
+				quad[4] = i*n+j+1;
+				quad[5] = (i+1)*n+j+1;
+			}
 		}
-	}
-
-    return meshData;
+	});
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateQuad(float x, float y, float w, float h, float depth)
@@ -14,6 +14,8 @@
 
 #pragma once
 
+#include <cassert>
+#include <cstddef>
 #include <cstdint>
 #include <DirectXMath.h>
 #include <vector>
@@ -25,6 +27,10 @@ public:
     using uint16 = std::uint16_t;
     using uint32 = std::uint32_t;
 
+	// Each subdivision level quadruples the triangle count.  Past this level the
+	// 3*20*4^n indices of a geosphere no longer fit in a 32-bit count.
+	static const uint32 MaxSubdivisions = 13;
+
 	struct Vertex
 	{
 		Vertex(){}
@@ -53,18 +59,38 @@ public:
         DirectX::XMFLOAT2 TexC;
 	};
 
+	// Where the generators that write into caller buffers put each attribute of a
+	// vertex, in bytes from its start.  Attributes at NotPresent are skipped, so a
+	// vertex structure need only have the members it uses.  The default describes
+	// Vertex.
+	struct VertexLayout
+	{
+		static const uint32 NotPresent = 0xffffffff;
+
+		uint32 Stride = sizeof(Vertex);
+		uint32 PositionOffset = offsetof(Vertex, Position);
+		uint32 NormalOffset = offsetof(Vertex, Normal);
+		uint32 TangentUOffset = offsetof(Vertex, TangentU);
+		uint32 TexCOffset = offsetof(Vertex, TexC);
+	};
+
 	struct MeshData
 	{
 		std::vector<Vertex> Vertices;
         std::vector<uint32> Indices32;
 
+        // Keeps a 16-bit copy alongside Indices32, and only holds for meshes of at
+        // most 65536 vertices.  IndexBufferBuilder checks, splits and frees instead.
         std::vector<uint16>& GetIndices16()
         {
 			if(mIndices16.empty())
 			{
 				mIndices16.resize(Indices32.size());
 				for(size_t i = 0; i < Indices32.size(); ++i)
+				{
+					assert(Indices32[i] <= 0xffff);
 					mIndices16[i] = static_cast<uint16>(Indices32[i]);
+				}
 			}
 
 			return mIndices16;
@@ -86,9 +112,21 @@ public:
 	///</summary>
     MeshData CreateSphere(float radius, uint32 sliceCount, uint32 stackCount);
 
+	///<summary>
+	/// Writes the sphere CreateSphere makes straight into caller buffers with room
+	/// for GetSphereVertexCount vertices, laid out as layout describes, and
+	/// GetSphereIndexCount indices.  Either buffer may be null to skip it.  Large
+	/// spheres are generated in parallel chunks of rings.
+	///</summary>
+    void CreateSphere(float radius, uint32 sliceCount, uint32 stackCount,
+		const VertexLayout& layout, void* vertices, uint32* indices);
+	static uint32 GetSphereVertexCount(uint32 sliceCount, uint32 stackCount);
+	static uint32 GetSphereIndexCount(uint32 sliceCount, uint32 stackCount);
+
 	///<summary>
 	/// Creates a geosphere centered at the origin with the given radius.  The
-	/// depth controls the level of tessellation.
+	/// depth controls the level of tessellation.  Each vertex is shared by all the
+	/// triangles that touch it, so level n has 10*4^n + 2 vertices.
 	///</summary>
     MeshData CreateGeosphere(float radius, uint32 numSubdivisions);
 
@@ -105,6 +143,17 @@ public:
 	///</summary>
     MeshData CreateGrid(float width, float depth, uint32 m, uint32 n);
 
+	///<summary>
+	/// Writes the grid CreateGrid makes straight into caller buffers with room for
+	/// m*n vertices, laid out as layout describes, and GetGridIndexCount indices.
+	/// Either buffer may be null to skip it.  Large grids are generated in
+	/// parallel chunks of rows.
+	///</summary>
+    void CreateGrid(float width, float depth, uint32 m, uint32 n,
+		const VertexLayout& layout, void* vertices, uint32* indices);
+	static uint32 GetGridVertexCount(uint32 m, uint32 n);
+	static uint32 GetGridIndexCount(uint32 m, uint32 n);
+
 	///<summary>
 	/// Creates a quad aligned with the screen.  This is useful for postprocessing and screen effects.
 	///</summary>
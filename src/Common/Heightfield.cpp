@@ -0,0 +1,424 @@
+//***************************************************************************************
+// Heightfield.cpp
+//***************************************************************************************
+
+#include "Heightfield.h"
+#include <ppl.h>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+	using uint32 = Heightfield::uint32;
+
+	// Enough for a quadtree over any grid addressable with 32-bit indices.
+	const int MaxStackDepth = 128;
+
+	// Ray in grid space, where cells are unit squares.  Axis 0 is u, which runs
+	// along +x, axis 1 is v, which runs along -z like the rows, and axis 2 is y.
+	struct GridRay
+	{
+		float Origin[3];
+		float Dir[3];
+		float InvDir[3];
+		float MaxDist;
+	};
+
+	struct StackEntry
+	{
+		uint32 Level;
+		uint32 Row;
+		uint32 Col;
+	};
+
+	bool RayBoxTest(const GridRay& ray, const float boxMin[3], const float boxMax[3],
+		float& tEnter, float& tExit)
+	{
+		tEnter = 0.0f;
+		tExit = ray.MaxDist;
+
+		for(int axis = 0; axis < 3; ++axis)
+		{
+			float t0 = (boxMin[axis] - ray.Origin[axis])*ray.InvDir[axis];
+			float t1 = (boxMax[axis] - ray.Origin[axis])*ray.InvDir[axis];
+			if(t0 > t1)
+				std::swap(t0, t1);
+
+			tEnter = std::max(tEnter, t0);
+			tExit = std::min(tExit, t1);
+		}
+
+		return tEnter <= tExit;
+	}
+
+	// Smallest s in [0, length] with c0 + c1*s + c2*s^2 = 0, or -1 if there is none.
+	// Roots a hair outside the interval are kept so that a ray crossing the surface
+	// exactly on a cell border is not lost between the two cells.
+	double FirstRoot(double c0, double c1, double c2, double length)
+	{
+		if(c0 == 0.0)
+			return 0.0;
+
+		const double tolerance = 1e-5*(1.0 + length);
+
+		double roots[2];
+		int rootCount = 0;
+
+		if(std::fabs(c2) <= 1e-12*(std::fabs(c1) + std::fabs(c0)))
+		{
+			if(c1 != 0.0)
+				roots[rootCount++] = -c0 / c1;
+		}
+		else
+		{
+			double disc = c1*c1 - 4.0*c2*c0;
+			if(disc < 0.0)
+				return -1.0;
+
+			// Numerically stable form of the quadratic formula.
+			double q = -0.5*(c1 + (c1 >= 0.0 ? std::sqrt(disc) : -std::sqrt(disc)));
+			roots[rootCount++] = q / c2;
+			if(q != 0.0)
+				roots[rootCount++] = c0 / q;
+		}
+
+		double best = -1.0;
+		for(int i = 0; i < rootCount; ++i)
+		{
+			if(roots[i] >= -tolerance && roots[i] <= length + tolerance && (best < 0.0 || roots[i] < best))
+				best = roots[i];
+		}
+
+		return best < 0.0 ? best : std::min(std::max(best, 0.0), length);
+	}
+
+	// Runs query(i) for i in [0, count), split across cores when count is large.
+	template<typename Query>
+	void ForEachQuery(uint32 count, const Query& query)
+	{
+		const uint32 perTask = Heightfield::QueriesPerTask;
+
+		auto runRange = [&](uint32 task)
+		{
+			uint32 first = task*perTask;
+			uint32 last = std::min(count, first + perTask);
+			for(uint32 i = first; i < last; ++i)
+				query(i);
+		};
+
+		uint32 taskCount = (count + perTask - 1) / perTask;
+		if(taskCount <= 1)
+		{
+			if(taskCount == 1)
+				runRange(0);
+		}
+		else
+		{
+			// Each task writes a disjoint range of results, so no synchronization is needed.
+			concurrency::parallel_for(0u, taskCount, runRange);
+		}
+	}
+}
+
+const Heightfield::uint32 Heightfield::QueriesPerTask;
+
+Heightfield::Heightfield(float width, float depth, uint32 m, uint32 n) :
+	mWidth(width),
+	mDepth(depth),
+	mRowCount(m),
+	mColumnCount(n)
+{
+	assert(m >= 2 && n >= 2);
+
+	mDx = width / (n - 1);
+	mDz = depth / (m - 1);
+
+	mHeights.resize(m*n, 0.0f);
+	BuildTree();
+}
+
+void Heightfield::SetHeights(const float* heights, uint32 stride)
+{
+	const char* src = reinterpret_cast<const char*>(heights);
+	for(size_t i = 0; i < mHeights.size(); ++i)
+		std::memcpy(&mHeights[i], src + i*stride, sizeof(float));
+
+	BuildTree();
+}
+
+void Heightfield::SetHeights(const HeightFunction& height)
+{
+	concurrency::parallel_for(0u, mRowCount, [&](uint32 i)
+	{
+		float z = 0.5f*mDepth - i*mDz;
+		for(uint32 j = 0; j < mColumnCount; ++j)
+		{
+			float x = -0.5f*mWidth + j*mDx;
+			mHeights[i*mColumnCount + j] = height(x, z);
+		}
+	});
+
+	BuildTree();
+}
+
+void Heightfield::BuildTree()
+{
+	mLevels.clear();
+
+	Level cells;
+	cells.RowCount = mRowCount - 1;
+	cells.ColumnCount = mColumnCount - 1;
+	cells.Ranges.resize(cells.RowCount*cells.ColumnCount);
+
+	for(uint32 i = 0; i < cells.RowCount; ++i)
+	{
+		const float* row0 = &mHeights[i*mColumnCount];
+		const float* row1 = row0 + mColumnCount;
+
+		for(uint32 j = 0; j < cells.ColumnCount; ++j)
+		{
+			HeightRange& range = cells.Ranges[i*cells.ColumnCount + j];
+			range.Min = std::min(std::min(row0[j], row0[j+1]), std::min(row1[j], row1[j+1]));
+			range.Max = std::max(std::max(row0[j], row0[j+1]), std::max(row1[j], row1[j+1]));
+		}
+	}
+
+	mLevels.push_back(std::move(cells));
+
+	while(mLevels.back().RowCount > 1 || mLevels.back().ColumnCount > 1)
+	{
+		const Level& below = mLevels.back();
+
+		Level level;
+		level.RowCount = (below.RowCount + 1) / 2;
+		level.ColumnCount = (below.ColumnCount + 1) / 2;
+		level.Ranges.resize(level.RowCount*level.ColumnCount);
+
+		for(uint32 i = 0; i < level.RowCount; ++i)
+		{
+			for(uint32 j = 0; j < level.ColumnCount; ++j)
+			{
+				HeightRange& range = level.Ranges[i*level.ColumnCount + j];
+				range.Min = FLT_MAX;
+				range.Max = -FLT_MAX;
+
+				// The last row or column of a level may cover only one of the level below.
+				for(uint32 bi = 2*i; bi < std::min(2*i + 2, below.RowCount); ++bi)
+				{
+					for(uint32 bj = 2*j; bj < std::min(2*j + 2, below.ColumnCount); ++bj)
+					{
+						const HeightRange& b = below.Ranges[bi*below.ColumnCount + bj];
+						range.Min = std::min(range.Min, b.Min);
+						range.Max = std::max(range.Max, b.Max);
+					}
+				}
+			}
+		}
+
+		mLevels.push_back(std::move(level));
+	}
+}
+
+void Heightfield::GridCoordinates(float x, float z, float& u, float& v, uint32& row, uint32& col)const
+{
+	u = (x + 0.5f*mWidth) / mDx;
+	v = (0.5f*mDepth - z) / mDz;
+
+	u = std::min(std::max(u, 0.0f), (float)(mColumnCount - 1));
+	v = std::min(std::max(v, 0.0f), (float)(mRowCount - 1));
+
+	col = std::min((uint32)u, mColumnCount - 2);
+	row = std::min((uint32)v, mRowCount - 2);
+
+	u -= col;
+	v -= row;
+}
+
+float Heightfield::GetHeight(float x, float z)const
+{
+	float u, v;
+	uint32 row, col;
+	GridCoordinates(x, z, u, v, row, col);
+
+	const float* h = &mHeights[row*mColumnCount + col];
+
+	float top = h[0] + u*(h[1] - h[0]);
+	float bottom = h[mColumnCount] + u*(h[mColumnCount + 1] - h[mColumnCount]);
+
+	return top + v*(bottom - top);
+}
+
+XMFLOAT3 Heightfield::GetNormal(float x, float z)const
+{
+	float u, v;
+	uint32 row, col;
+	GridCoordinates(x, z, u, v, row, col);
+
+	const float* h = &mHeights[row*mColumnCount + col];
+	float h00 = h[0];
+	float h01 = h[1];
+	float h10 = h[mColumnCount];
+	float h11 = h[mColumnCount + 1];
+
+	// Derivatives of the bilinear patch; v runs along -z.
+	float dhdu = (h01 - h00) + v*(h00 - h01 - h10 + h11);
+	float dhdv = (h10 - h00) + u*(h00 - h01 - h10 + h11);
+
+	// n = (-dh/dx, 1, -dh/dz)
+	XMFLOAT3 n(-dhdu / mDx, 1.0f, dhdv / mDz);
+
+	XMVECTOR unitNormal = XMVector3Normalize(XMLoadFloat3(&n));
+	XMStoreFloat3(&n, unitNormal);
+
+	return n;
+}
+
+void Heightfield::GetHeights(const XMFLOAT2* xz, uint32 count, float* heights)const
+{
+	ForEachQuery(count, [&](uint32 i)
+	{
+		heights[i] = GetHeight(xz[i].x, xz[i].y);
+	});
+}
+
+bool Heightfield::Raycast(const Ray& ray, Hit& hit)const
+{
+	hit = Hit();
+
+	// Move the ray into grid space.  Only the u and v axes are scaled, so distances
+	// along the ray are unchanged.
+	GridRay gridRay;
+	gridRay.Origin[0] = (ray.Origin.x + 0.5f*mWidth) / mDx;
+	gridRay.Origin[1] = (0.5f*mDepth - ray.Origin.z) / mDz;
+	gridRay.Origin[2] = ray.Origin.y;
+	gridRay.Dir[0] = ray.Direction.x / mDx;
+	gridRay.Dir[1] = -ray.Direction.z / mDz;
+	gridRay.Dir[2] = ray.Direction.y;
+	gridRay.MaxDist = ray.MaxDist;
+
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		// Avoid 0*inf = NaN in the slab test for axis-aligned rays.
+		float safeDir = std::fabs(gridRay.Dir[axis]) > 1e-20f ? gridRay.Dir[axis] : 1e-20f;
+		gridRay.InvDir[axis] = 1.0f / safeDir;
+	}
+
+	const uint32 cellRows = mRowCount - 1;
+	const uint32 cellCols = mColumnCount - 1;
+
+	// Box of a quadtree node in grid space.
+	auto nodeBox = [&](uint32 level, uint32 row, uint32 col, float boxMin[3], float boxMax[3])
+	{
+		const HeightRange& range = mLevels[level].Ranges[row*mLevels[level].ColumnCount + col];
+
+		boxMin[0] = (float)(col << level);
+		boxMax[0] = (float)std::min((col + 1) << level, cellCols);
+		boxMin[1] = (float)(row << level);
+		boxMax[1] = (float)std::min((row + 1) << level, cellRows);
+		boxMin[2] = range.Min;
+		boxMax[2] = range.Max;
+	};
+
+	StackEntry stack[MaxStackDepth];
+	int stackSize = 0;
+
+	float boxMin[3];
+	float boxMax[3];
+	float tEnter;
+	float tExit;
+
+	uint32 top = (uint32)mLevels.size() - 1;
+	nodeBox(top, 0, 0, boxMin, boxMax);
+	if(!RayBoxTest(gridRay, boxMin, boxMax, tEnter, tExit))
+		return false;
+
+	stack[stackSize++] = { top, 0, 0 };
+
+	// Children are visited in the order the ray passes through them, which follows
+	// from the signs of its direction, so the first cell the ray meets the surface
+	// in holds the nearest hit.
+	const uint32 nearCol = gridRay.Dir[0] < 0.0f ? 1 : 0;
+	const uint32 nearRow = gridRay.Dir[1] < 0.0f ? 1 : 0;
+
+	while(stackSize > 0)
+	{
+		StackEntry e = stack[--stackSize];
+
+		if(e.Level == 0)
+		{
+			nodeBox(0, e.Row, e.Col, boxMin, boxMax);
+			RayBoxTest(gridRay, boxMin, boxMax, tEnter, tExit);
+
+			const float* h = &mHeights[e.Row*mColumnCount + e.Col];
+			double a = h[0];
+			double b = h[1] - h[0];
+			double c = h[mColumnCount] - h[0];
+			double d = h[0] - h[1] - h[mColumnCount] + h[mColumnCount + 1];
+
+			// Position in the cell where the ray enters it, and the height along the
+			// ray from there as a quadratic in s = t - tEnter.
+			double u0 = gridRay.Origin[0] + gridRay.Dir[0]*tEnter - e.Col;
+			double v0 = gridRay.Origin[1] + gridRay.Dir[1]*tEnter - e.Row;
+			double y0 = gridRay.Origin[2] + gridRay.Dir[2]*tEnter;
+			double du = gridRay.Dir[0];
+			double dv = gridRay.Dir[1];
+
+			double h0 = a + b*u0 + c*v0 + d*u0*v0;
+			double h1 = b*du + c*dv + d*(u0*dv + v0*du);
+			double h2 = d*du*dv;
+
+			double s = FirstRoot(y0 - h0, gridRay.Dir[2] - h1, -h2, tExit - tEnter);
+			if(s < 0.0)
+				continue;
+
+			float t = tEnter + (float)s;
+
+			XMVECTOR origin = XMLoadFloat3(&ray.Origin);
+			XMVECTOR dir = XMLoadFloat3(&ray.Direction);
+			XMStoreFloat3(&hit.Position, XMVectorMultiplyAdd(dir, XMVectorReplicate(t), origin));
+
+			hit.Distance = t;
+			hit.Normal = GetNormal(hit.Position.x, hit.Position.z);
+			return true;
+		}
+
+		// Push the up to four children the ray passes through, farthest first.
+		const Level& below = mLevels[e.Level - 1];
+
+		for(int k = 3; k >= 0; --k)
+		{
+			uint32 i = 2*e.Row + (nearRow ^ (k >> 1));
+			uint32 j = 2*e.Col + (nearCol ^ (k & 1));
+			if(i >= below.RowCount || j >= below.ColumnCount)
+				continue;
+
+			nodeBox(e.Level - 1, i, j, boxMin, boxMax);
+			if(RayBoxTest(gridRay, boxMin, boxMax, tEnter, tExit))
+				stack[stackSize++] = { e.Level - 1, i, j };
+		}
+	}
+
+	return false;
+}
+
+void Heightfield::Raycast(const Ray* rays, uint32 rayCount, Hit* hits)const
+{
+	ForEachQuery(rayCount, [&](uint32 i)
+	{
+		Raycast(rays[i], hits[i]);
+	});
+}
+
+float Heightfield::GetMinHeight()const
+{
+	return mLevels.back().Ranges[0].Min;
+}
+
+float Heightfield::GetMaxHeight()const
+{
+	return mLevels.back().Ranges[0].Max;
+}
@@ -0,0 +1,128 @@
+//***************************************************************************************
+// Heightfield.h
+//
+// Ground height, normal and ray queries against a regular grid of height samples,
+// such as the hills the demos build with GeometryGenerator::CreateGrid.  Between
+// samples the surface is bilinear, and every query, rays included, sees that same
+// surface.  It differs from the two triangles a grid draws per cell by a fraction
+// of the cell's height range, which is usually well below what gameplay notices.
+//
+// Rays are marched down a min/max quadtree: level 0 stores the lowest and highest
+// height of each cell, and every level above stores the range of a 2x2 block of
+// the level below.  A ray skips any block it passes entirely above or below, so a
+// query touches a handful of cells near the hit instead of every cell it crosses.
+//
+// Batches of queries are split across cores.  All queries are const and may run
+// concurrently with each other, but not with SetHeights.
+//***************************************************************************************
+
+#pragma once
+
+#include <cfloat>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <DirectXMath.h>
+
+class Heightfield
+{
+public:
+
+    using uint32 = std::uint32_t;
+
+	// World space ray.  Distances are measured in multiples of Direction, so pass
+	// a unit length direction to get world space distances back.
+	struct Ray
+	{
+		DirectX::XMFLOAT3 Origin = { 0.0f, 0.0f, 0.0f };
+		float MaxDist = FLT_MAX;
+		DirectX::XMFLOAT3 Direction = { 0.0f, 0.0f, 1.0f };
+	};
+
+	// Distance is FLT_MAX when the ray misses.
+	struct Hit
+	{
+		float Distance = FLT_MAX;
+		DirectX::XMFLOAT3 Position = { 0.0f, 0.0f, 0.0f };
+		DirectX::XMFLOAT3 Normal = { 0.0f, 1.0f, 0.0f };
+	};
+
+	using HeightFunction = std::function<float(float x, float z)>;
+
+	///<summary>
+	/// A width by depth field of m by n samples centered at the origin and laid
+	/// out like GeometryGenerator::CreateGrid: row i lies at z = depth/2 - i*dz and
+	/// column j at x = -width/2 + j*dx.  All heights start at zero.
+	///</summary>
+	Heightfield(float width, float depth, uint32 m, uint32 n);
+
+	///<summary>
+	/// Copies the m*n heights in row order, stride bytes apart, so they can be read
+	/// straight out of a vertex array (pass &vertices[0].Pos.y and sizeof(Vertex)),
+	/// and rebuilds the quadtree.
+	///</summary>
+	void SetHeights(const float* heights, uint32 stride = sizeof(float));
+
+	///<summary>
+	/// Samples height at every grid point, in parallel, and rebuilds the quadtree.
+	/// The function must be thread safe.
+	///</summary>
+	void SetHeights(const HeightFunction& height);
+
+	///<summary>
+	/// Height and unit normal of the surface above (x, z).  Points outside the
+	/// field take the height of the nearest edge.
+	///</summary>
+	float GetHeight(float x, float z)const;
+	DirectX::XMFLOAT3 GetNormal(float x, float z)const;
+
+	///<summary>
+	/// GetHeight for count points, with x and z in the x and y of each XMFLOAT2.
+	///</summary>
+	void GetHeights(const DirectX::XMFLOAT2* xz, uint32 count, float* heights)const;
+
+	///<summary>
+	/// Finds where the ray first meets the surface inside the field.  A ray that
+	/// starts below the surface hits where it comes back up through it.
+	///</summary>
+	bool Raycast(const Ray& ray, Hit& hit)const;
+	void Raycast(const Ray* rays, uint32 rayCount, Hit* hits)const;
+
+	uint32 GetRowCount()const { return mRowCount; }
+	uint32 GetColumnCount()const { return mColumnCount; }
+	float GetMinHeight()const;
+	float GetMaxHeight()const;
+
+	// Queries per parallel task.  Smaller batches run on the calling thread.
+	static const uint32 QueriesPerTask = 256;
+
+private:
+	struct HeightRange
+	{
+		float Min = 0.0f;
+		float Max = 0.0f;
+	};
+
+	struct Level
+	{
+		uint32 RowCount = 0;
+		uint32 ColumnCount = 0;
+		std::vector<HeightRange> Ranges;
+	};
+
+	void BuildTree();
+	void GridCoordinates(float x, float z, float& u, float& v, uint32& row, uint32& col)const;
+
+private:
+	float mWidth = 0.0f;
+	float mDepth = 0.0f;
+	uint32 mRowCount = 0;
+	uint32 mColumnCount = 0;
+	float mDx = 0.0f;
+	float mDz = 0.0f;
+
+	std::vector<float> mHeights;
+
+	// mLevels[0] has a range per cell; the last level has one for the whole field.
+	std::vector<Level> mLevels;
+};
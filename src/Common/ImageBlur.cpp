@@ -0,0 +1,310 @@
+//***************************************************************************************
+// ImageBlur.cpp
+//***************************************************************************************
+
+#include "ImageBlur.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <ppl.h>
+
+using namespace std;
+
+namespace
+{
+	using uint8 = uint8_t;
+	using uint16 = uint16_t;
+	using uint32 = ImageBlur::uint32;
+
+	// The vertical pass works on strips this many pixels wide: the 11 rows of taps
+	// a strip reads are then 45 KB, which stays in cache while it moves down.
+	const uint32 StripWidth = 256;
+	const uint32 RowsPerTask = 16;
+
+	float HalfToFloat(uint16 h)
+	{
+		const uint32 sign = uint32(h & 0x8000) << 16;
+		const uint32 exponent = (h >> 10) & 0x1f;
+		const uint32 mantissa = h & 0x3ff;
+
+		uint32 bits;
+		if(exponent == 0)
+		{
+			// Zero or subnormal: mantissa * 2^-24.
+			float f = mantissa*(1.0f / 16777216.0f);
+			memcpy(&bits, &f, sizeof(bits));
+			bits |= sign;
+		}
+		else if(exponent == 31)
+			bits = sign | 0x7f800000 | (mantissa << 13);
+		else
+			bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+
+		float f;
+		memcpy(&f, &bits, sizeof(f));
+		return f;
+	}
+
+	// Rounds to nearest even, as the GPU converts shader output for a 16-bit
+	// float UAV.
+	uint16 FloatToHalf(float f)
+	{
+		uint32 bits;
+		memcpy(&bits, &f, sizeof(bits));
+		const uint32 sign = (bits >> 16) & 0x8000;
+		const uint32 magnitude = bits & 0x7fffffff;
+
+		if(magnitude >= 0x7f800000)
+			return uint16(sign | (magnitude > 0x7f800000 ? 0x7e00 : 0x7c00));
+		if(magnitude >= 0x477ff000) // 65520 and up round to infinity.
+			return uint16(sign | 0x7c00);
+
+		if(magnitude < 0x38800000)
+		{
+			// Below the smallest normal half, 2^-14.
+			const uint32 exponent = magnitude >> 23;
+			if(exponent < 102)
+				return uint16(sign);
+
+			const uint32 mantissa = (magnitude & 0x7fffff) | 0x800000;
+			const uint32 shift = 126 - exponent;
+			uint32 h = mantissa >> shift;
+			const uint32 rest = mantissa & ((1u << shift) - 1);
+			const uint32 halfway = 1u << (shift - 1);
+			if(rest > halfway || (rest == halfway && (h & 1)))
+				++h;
+			return uint16(sign | h);
+		}
+
+		uint32 h = (magnitude - 0x38000000) >> 13;
+		const uint32 rest = magnitude & 0x1fff;
+		if(rest > 0x1000 || (rest == 0x1000 && (h & 1)))
+			++h;
+		return uint16(sign | h);
+	}
+
+	bool IsHalf(DXGI_FORMAT format)
+	{
+		return format == DXGI_FORMAT_R16G16B16A16_FLOAT;
+	}
+
+	// What a store to the format followed by a load gives back.
+	void Round(DXGI_FORMAT format, float* values, size_t count)
+	{
+		if(IsHalf(format))
+		{
+			for(size_t i = 0; i < count; ++i)
+				values[i] = HalfToFloat(FloatToHalf(values[i]));
+		}
+		else
+		{
+			// Truncating the clamped, offset value rounds it without a call to floor.
+			for(size_t i = 0; i < count; ++i)
+				values[i] = float(int(min(max(values[i], 0.0f), 1.0f)*255.0f + 0.5f)) / 255.0f;
+		}
+	}
+
+	void Load(DXGI_FORMAT format, const uint8* pixels, uint32 width, uint32 height, size_t rowPitch, float* image)
+	{
+		float unorm[256];
+		for(int i = 0; i < 256; ++i)
+			unorm[i] = i / 255.0f;
+
+		concurrency::parallel_for(uint32(0), height, [&](uint32 y)
+		{
+			const uint8* row = pixels + y*rowPitch;
+			float* out = image + size_t(y)*width*4;
+			if(IsHalf(format))
+			{
+				for(size_t i = 0; i < size_t(width)*4; ++i)
+				{
+					uint16 h;
+					memcpy(&h, row + 2*i, sizeof(h));
+					out[i] = HalfToFloat(h);
+				}
+			}
+			else
+			{
+				for(size_t i = 0; i < size_t(width)*4; ++i)
+					out[i] = unorm[row[i]];
+			}
+		});
+	}
+
+	void Store(DXGI_FORMAT format, const float* image, uint32 width, uint32 height, uint8* pixels, size_t rowPitch)
+	{
+		concurrency::parallel_for(uint32(0), height, [&](uint32 y)
+		{
+			uint8* row = pixels + y*rowPitch;
+			const float* in = image + size_t(y)*width*4;
+			if(IsHalf(format))
+			{
+				for(size_t i = 0; i < size_t(width)*4; ++i)
+				{
+					uint16 h = FloatToHalf(in[i]);
+					memcpy(row + 2*i, &h, sizeof(h));
+				}
+			}
+			else
+			{
+				for(size_t i = 0; i < size_t(width)*4; ++i)
+					row[i] = uint8(in[i]*255.0f + 0.5f);
+			}
+		});
+	}
+
+	// Sums taps[k][i]*weights[k] over the taps, in order, for count values and
+	// writes them rounded to format.  Runs of Chunk values add up in a local array
+	// that cannot alias the inputs, so every tap becomes one vectorized loop.
+	const size_t Chunk = 64;
+
+	void Convolve(DXGI_FORMAT format, const float* const* taps, const vector<float>& weights, size_t count, float* out)
+	{
+		size_t i = 0;
+		for(; i + Chunk <= count; i += Chunk)
+		{
+			float sum[Chunk];
+			for(size_t j = 0; j < Chunk; ++j)
+				sum[j] = weights[0]*taps[0][i + j];
+
+			for(size_t k = 1; k < weights.size(); ++k)
+			{
+				const float w = weights[k];
+				const float* p = taps[k] + i;
+				for(size_t j = 0; j < Chunk; ++j)
+					sum[j] += w*p[j];
+			}
+
+			Round(format, sum, Chunk);
+			memcpy(out + i, sum, sizeof(sum));
+		}
+
+		for(; i < count; ++i)
+		{
+			float sum = weights[0]*taps[0][i];
+			for(size_t k = 1; k < weights.size(); ++k)
+				sum += weights[k]*taps[k][i];
+
+			Round(format, &sum, 1);
+			out[i] = sum;
+		}
+	}
+
+	void HorizontalPass(DXGI_FORMAT format, const float* src, float* dst, uint32 width, uint32 height,
+		const vector<float>& weights)
+	{
+		const uint32 radius = uint32(weights.size() / 2);
+		const size_t count = size_t(width)*4;
+
+		concurrency::parallel_for(uint32(0), (height + RowsPerTask - 1) / RowsPerTask, [&](uint32 task)
+		{
+			// The row with radius copies of its edge pixels on each side, the
+			// values the shader's clamped loads put in its cache.
+			vector<float> padded(count + 8*radius);
+
+			const uint32 lastRow = min(height, (task + 1)*RowsPerTask);
+			for(uint32 y = task*RowsPerTask; y < lastRow; ++y)
+			{
+				const float* in = src + y*count;
+				for(uint32 i = 0; i < radius; ++i)
+				{
+					memcpy(&padded[4*i], in, 4*sizeof(float));
+					memcpy(&padded[count + 4*(radius + i)], in + count - 4, 4*sizeof(float));
+				}
+				memcpy(&padded[4*radius], in, count*sizeof(float));
+
+				// Tap k of pixel x is pixel x + k - radius, k pixels into the padded row.
+				const float* taps[2*ImageBlur::MaxBlurRadius + 1];
+				for(size_t k = 0; k < weights.size(); ++k)
+					taps[k] = padded.data() + 4*k;
+
+				Convolve(format, taps, weights, count, dst + y*count);
+			}
+		});
+	}
+
+	void VerticalPass(DXGI_FORMAT format, const float* src, float* dst, uint32 width, uint32 height,
+		const vector<float>& weights)
+	{
+		const int radius = int(weights.size() / 2);
+		const uint32 strips = (width + StripWidth - 1) / StripWidth;
+		const uint32 bands = (height + RowsPerTask - 1) / RowsPerTask;
+
+		concurrency::parallel_for(uint32(0), strips*bands, [&](uint32 task)
+		{
+			const uint32 x0 = (task % strips)*StripWidth;
+			const size_t count = size_t(min(StripWidth, width - x0))*4;
+
+			const uint32 lastRow = min(height, (task / strips + 1)*RowsPerTask);
+			for(uint32 y = (task / strips)*RowsPerTask; y < lastRow; ++y)
+			{
+				// Rows past the edges clamp, as the shader's loads do.
+				const float* taps[2*ImageBlur::MaxBlurRadius + 1];
+				for(size_t k = 0; k < weights.size(); ++k)
+				{
+					const int row = min(max(int(y) + int(k) - radius, 0), int(height) - 1);
+					taps[k] = src + (size_t(row)*width + x0)*4;
+				}
+
+				Convolve(format, taps, weights, count, dst + (size_t(y)*width + x0)*4);
+			}
+		});
+	}
+}
+
+vector<float> ImageBlur::CalcGaussWeights(float sigma)
+{
+	float twoSigma2 = 2.0f*sigma*sigma;
+
+	int blurRadius = (int)ceil(2.0f * sigma);
+
+	assert(blurRadius <= MaxBlurRadius);
+
+	vector<float> weights(2 * blurRadius + 1);
+
+	float weightSum = 0.0f;
+	for(int i = -blurRadius; i <= blurRadius; ++i)
+	{
+		float x = (float)i;
+
+		weights[i + blurRadius] = expf(-x*x / twoSigma2);
+
+		weightSum += weights[i + blurRadius];
+	}
+
+	for(size_t i = 0; i < weights.size(); ++i)
+		weights[i] /= weightSum;
+
+	return weights;
+}
+
+bool ImageBlur::IsSupported(DXGI_FORMAT format)
+{
+	return format == DXGI_FORMAT_R8G8B8A8_UNORM || format == DXGI_FORMAT_B8G8R8A8_UNORM ||
+		format == DXGI_FORMAT_R16G16B16A16_FLOAT;
+}
+
+void ImageBlur::Blur(DXGI_FORMAT format, void* pixels, uint32 width, uint32 height, size_t rowPitch,
+	const vector<float>& weights, int blurCount)
+{
+	assert(IsSupported(format));
+	assert(weights.size() % 2 == 1 && weights.size() <= size_t(2*MaxBlurRadius + 1));
+
+	if(width == 0 || height == 0 || blurCount <= 0)
+		return;
+
+	// Two images to ping-pong between, as BlurFilter's two blur maps.
+	vector<float> image0(size_t(width)*height*4);
+	vector<float> image1(image0.size());
+
+	Load(format, (const uint8*)pixels, width, height, rowPitch, image0.data());
+
+	for(int i = 0; i < blurCount; ++i)
+	{
+		HorizontalPass(format, image0.data(), image1.data(), width, height, weights);
+		VerticalPass(format, image1.data(), image0.data(), width, height, weights);
+	}
+
+	Store(format, image0.data(), width, height, (uint8*)pixels, rowPitch);
+}
@@ -0,0 +1,52 @@
+//***************************************************************************************
+// ImageBlur.h
+//
+// The Blur demo's separable Gaussian blur (BlurFilter and Blur.hlsl) on the CPU, for
+// checking the shaders and for tools that run without a GPU.  It follows the
+// shaders step for step: taps outside the image clamp to the edge, each pass sums
+// its taps in the same order, and each pass's result is rounded to the image's
+// format as the UAV store between the passes rounds it.  Results match the GPU's to
+// within the last bit of rounding.
+//
+// Passes work in 32-bit float.  The horizontal pass slides its window along a
+// padded copy of each row; the vertical pass adds whole rows of taps at a time in
+// strips narrow enough that all the rows it reads stay in cache.  Both passes are
+// spread across cores with PPL.  The code only depends on the standard library,
+// PPL and dxgiformat.h.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <dxgiformat.h>
+
+class ImageBlur
+{
+public:
+
+    using uint32 = std::uint32_t;
+
+	// The largest radius Blur.hlsl supports.
+	static const int MaxBlurRadius = 5;
+
+	///<summary>
+	/// The weights BlurFilter::CalcGaussWeights computes: a Gaussian over
+	/// 2*ceil(2*sigma) + 1 taps, normalized to add up to one.  sigma must be at
+	/// most 2.5 so the radius fits MaxBlurRadius.
+	///</summary>
+	static std::vector<float> CalcGaussWeights(float sigma);
+
+	// R8G8B8A8_UNORM, B8G8R8A8_UNORM and R16G16B16A16_FLOAT.
+	static bool IsSupported(DXGI_FORMAT format);
+
+	///<summary>
+	/// Blurs a width by height image, rows rowPitch bytes apart, in place:
+	/// blurCount horizontal and vertical pass pairs with weights, as
+	/// BlurFilter::Execute runs them.  weights must have an odd count of at most
+	/// 2*MaxBlurRadius + 1.
+	///</summary>
+	static void Blur(DXGI_FORMAT format, void* pixels, uint32 width, uint32 height, std::size_t rowPitch,
+		const std::vector<float>& weights, int blurCount);
+};
@@ -0,0 +1,155 @@
+//***************************************************************************************
+// ImageSobel.cpp
+//***************************************************************************************
+
+#include "ImageSobel.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <ppl.h>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+	using uint8 = uint8_t;
+	using uint32 = ImageSobel::uint32;
+
+	const uint32 RowsPerTask = 16;
+	const size_t Chunk = 64;
+
+	// Where the format keeps red and blue, which CalcLuminance weights differently.
+	struct Channels
+	{
+		int Red;
+		int Blue;
+	};
+
+	// Converts a row to floats, after the one zero pixel that starts every padded
+	// row; the zero pixel after it is never written.
+	void LoadRow(const float* unorm, const uint8* row, uint32 width, float* padded)
+	{
+		for(size_t i = 0; i < size_t(width)*4; ++i)
+			padded[4 + i] = unorm[row[i]];
+	}
+
+	uint8 EncodeUnorm(float c)
+	{
+		return uint8(min(max(c, 0.0f), 1.0f)*255.0f + 0.5f);
+	}
+
+	// Filters one row from the padded rows above, at and below it.  The sums follow
+	// Sobel.hlsl term for term so the results round the way the shader's do.
+	void FilterRow(const float* const* rows, uint32 width, Channels channels, const float* unorm, bool composite,
+		uint8* out)
+	{
+		const size_t count = size_t(width)*4;
+		for(size_t i = 0; i < count; i += Chunk)
+		{
+			const size_t n = min(Chunk, count - i);
+
+			// Pixel x's neighbours are at offsets 0, 4 and 8 from i in the padded rows.
+			const float* r0 = rows[0] + i;
+			const float* r1 = rows[1] + i;
+			const float* r2 = rows[2] + i;
+
+			float magnitude[Chunk];
+			for(size_t j = 0; j < n; ++j)
+			{
+				float gx = -r0[j] - 2.0f*r1[j] - r2[j] + r0[j + 8] + 2.0f*r1[j + 8] + r2[j + 8];
+				float gy = -r2[j] - 2.0f*r2[j + 4] - r2[j + 4] + r0[j] + 2.0f*r0[j + 4] + r0[j + 8];
+				magnitude[j] = sqrt(gx*gx + gy*gy);
+			}
+
+			// One edge value per channel, so the composite below is a plain loop too.
+			float edges[Chunk];
+			for(size_t j = 0; j < n; j += 4)
+			{
+				float luminance = magnitude[j + channels.Red]*0.299f + magnitude[j + 1]*0.587f +
+					magnitude[j + channels.Blue]*0.114f;
+
+				// Composite.hlsl samples the stored edge map, so keep its 8-bit value.
+				float edge = unorm[EncodeUnorm(1.0f - min(max(luminance, 0.0f), 1.0f))];
+				for(int c = 0; c < 4; ++c)
+					edges[j + c] = edge;
+			}
+
+			uint8* pixels = out + i;
+			if(composite)
+			{
+				for(size_t j = 0; j < n; ++j)
+					pixels[j] = EncodeUnorm(r1[j + 4]*edges[j]);
+			}
+			else
+			{
+				for(size_t j = 0; j < n; ++j)
+					pixels[j] = EncodeUnorm(edges[j]);
+			}
+		}
+	}
+
+	void Filter(DXGI_FORMAT format, const uint8* pixels, uint32 width, uint32 height, size_t rowPitch,
+		bool composite, uint8* output, size_t outputRowPitch)
+	{
+		assert(ImageSobel::IsSupported(format));
+
+		if(width == 0 || height == 0)
+			return;
+
+		const Channels channels = format == DXGI_FORMAT_B8G8R8A8_UNORM ? Channels{ 2, 0 } : Channels{ 0, 2 };
+
+		float unorm[256];
+		for(int i = 0; i < 256; ++i)
+			unorm[i] = i / 255.0f;
+
+		concurrency::parallel_for(uint32(0), (height + RowsPerTask - 1) / RowsPerTask, [&](uint32 task)
+		{
+			// Three rows of the image with a zero pixel on each side, reused as the
+			// band moves down, and a row of zeros for the rows past the edges: the
+			// shader's loads outside the texture return zero.
+			const size_t padded = size_t(width)*4 + 8;
+			vector<float> buffer(4*padded, 0.0f);
+
+			auto row = [&](int y)
+			{
+				return y < 0 || y >= int(height) ? &buffer[3*padded] : &buffer[(y % 3)*padded];
+			};
+
+			auto load = [&](int y)
+			{
+				if(y >= 0 && y < int(height))
+					LoadRow(unorm, pixels + y*rowPitch, width, row(y));
+			};
+
+			const int firstRow = int(task*RowsPerTask);
+			const int lastRow = int(min(height, (task + 1)*RowsPerTask));
+			load(firstRow - 1);
+			load(firstRow);
+
+			for(int y = firstRow; y < lastRow; ++y)
+			{
+				load(y + 1);
+				const float* rows[3] = { row(y - 1), row(y), row(y + 1) };
+				FilterRow(rows, width, channels, unorm, composite, output + y*outputRowPitch);
+			}
+		});
+	}
+}
+
+bool ImageSobel::IsSupported(DXGI_FORMAT format)
+{
+	return format == DXGI_FORMAT_R8G8B8A8_UNORM || format == DXGI_FORMAT_B8G8R8A8_UNORM;
+}
+
+void ImageSobel::EdgeMap(DXGI_FORMAT format, const void* pixels, uint32 width, uint32 height, size_t rowPitch,
+	void* edges, size_t edgesRowPitch)
+{
+	Filter(format, (const uint8*)pixels, width, height, rowPitch, false, (uint8*)edges, edgesRowPitch);
+}
+
+void ImageSobel::Composite(DXGI_FORMAT format, const void* pixels, uint32 width, uint32 height, size_t rowPitch,
+	void* output, size_t outputRowPitch)
+{
+	Filter(format, (const uint8*)pixels, width, height, rowPitch, true, (uint8*)output, outputRowPitch);
+}
@@ -0,0 +1,53 @@
+//***************************************************************************************
+// ImageSobel.h
+//
+// The SobelFilter demo's edge detection (SobelFilter and Sobel.hlsl) on the CPU, for
+// checking the shader and for tools that post-process screenshots without a GPU.
+// Like the shader it computes the per channel gradient of each pixel's 3x3
+// neighbourhood, reads pixels outside the image as zero, and turns the luminance
+// of the gradient magnitude into an edge value, black on edges and white elsewhere.
+// Sobel.hlsl's vertical gradient takes its bottom row as c[2][0], c[2][1], c[2][1]
+// rather than ending with c[2][2]; this code does the same so its results match
+// what the demo shows.
+//
+// Composite also does the demo's second step, Composite.hlsl multiplying the image
+// by the edge map, while the edge values are still in registers, so the edge map
+// is never written out.  Values are rounded to 8 bits where the GPU stores them:
+// the edge map the compute shader writes and the composite's render target.
+//
+// Rows are filtered a chunk of values at a time in loops the compiler vectorizes,
+// and bands of rows are spread across cores with PPL.  The code only depends on the
+// standard library, PPL and dxgiformat.h.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <dxgiformat.h>
+
+class ImageSobel
+{
+public:
+
+    using uint32 = std::uint32_t;
+
+	// R8G8B8A8_UNORM and B8G8R8A8_UNORM.
+	static bool IsSupported(DXGI_FORMAT format);
+
+	///<summary>
+	/// Writes the edge map of a width by height image, rows rowPitch bytes apart,
+	/// to edges, rows edgesRowPitch bytes apart, as SobelFilter::Execute does.
+	/// Every channel of an edge pixel, alpha included, holds the edge value.  edges
+	/// must not overlap pixels.
+	///</summary>
+	static void EdgeMap(DXGI_FORMAT format, const void* pixels, uint32 width, uint32 height, std::size_t rowPitch,
+		void* edges, std::size_t edgesRowPitch);
+
+	///<summary>
+	/// Writes the image multiplied by its edge map to output, the frame SobelApp
+	/// draws.  output must not overlap pixels.
+	///</summary>
+	static void Composite(DXGI_FORMAT format, const void* pixels, uint32 width, uint32 height, std::size_t rowPitch,
+		void* output, std::size_t outputRowPitch);
+};
@@ -0,0 +1,182 @@
+//***************************************************************************************
+// IndexBufferBuilder.cpp
+//***************************************************************************************
+
+#include "IndexBufferBuilder.h"
+#include <algorithm>
+#include <cassert>
+
+namespace
+{
+	// A 16-bit index addresses 65536 vertices past the base vertex.
+	const IndexBufferBuilder::uint32 MaxVertexSpan16 = 0x10000;
+}
+
+IndexBufferBuilder::uint32 IndexBufferBuilder::AddSubmesh(std::vector<uint32>&& indices, int baseVertexLocation)
+{
+	assert(indices.size() % 3 == 0);
+
+	PendingSubmesh submesh;
+	submesh.Indices = std::move(indices);
+	submesh.BaseVertexLocation = baseVertexLocation;
+	mPending.push_back(std::move(submesh));
+
+	return (uint32)(mPending.size() - 1);
+}
+
+IndexBufferBuilder::uint32 IndexBufferBuilder::AddSubmesh(GeometryGenerator::MeshData& meshData, int baseVertexLocation)
+{
+	return AddSubmesh(std::move(meshData.Indices32), baseVertexLocation);
+}
+
+bool IndexBufferBuilder::SplitBySpan(const uint32* indices, uint32 indexCount, uint32 maxVertexSpan,
+	std::vector<DrawRange>& runs)
+{
+	runs.clear();
+
+	DrawRange run;
+	uint32 runMax = 0;
+
+	for(uint32 i = 0; i + 2 < indexCount; i += 3)
+	{
+		uint32 triMin = std::min(indices[i], std::min(indices[i+1], indices[i+2]));
+		uint32 triMax = std::max(indices[i], std::max(indices[i+1], indices[i+2]));
+		if(triMax - triMin >= maxVertexSpan)
+			return false;
+
+		if(run.IndexCount > 0)
+		{
+			uint32 newMin = std::min((uint32)run.BaseVertexLocation, triMin);
+			uint32 newMax = std::max(runMax, triMax);
+			if(newMax - newMin < maxVertexSpan)
+			{
+				run.BaseVertexLocation = (int)newMin;
+				runMax = newMax;
+				run.IndexCount += 3;
+				continue;
+			}
+
+			runs.push_back(run);
+			run.StartIndexLocation = i;
+		}
+
+		run.IndexCount = 3;
+		run.BaseVertexLocation = (int)triMin;
+		runMax = triMax;
+	}
+
+	if(run.IndexCount > 0)
+		runs.push_back(run);
+
+	return true;
+}
+
+void IndexBufferBuilder::Build(bool allow16Bit)
+{
+	// Split everything first: one triangle that does not fit makes the whole buffer
+	// 32-bit, since a view has a single format.
+	std::vector<std::vector<DrawRange>> runs(mPending.size());
+
+	mIs16Bit = allow16Bit;
+	for(size_t s = 0; s < mPending.size() && mIs16Bit; ++s)
+	{
+		const PendingSubmesh& submesh = mPending[s];
+		mIs16Bit = SplitBySpan(submesh.Indices.data(), (uint32)submesh.Indices.size(), MaxVertexSpan16, runs[s]);
+	}
+
+	mIndices16.clear();
+	mIndices32.clear();
+	mDrawRanges.clear();
+	mDrawRanges.resize(mPending.size());
+
+	size_t totalIndexCount = 0;
+	for(const PendingSubmesh& submesh : mPending)
+		totalIndexCount += submesh.Indices.size();
+
+	if(mIs16Bit)
+		mIndices16.reserve(totalIndexCount);
+	else
+		mIndices32.reserve(totalIndexCount);
+
+	for(size_t s = 0; s < mPending.size(); ++s)
+	{
+		PendingSubmesh& submesh = mPending[s];
+
+		if(mIs16Bit)
+		{
+			for(const DrawRange& run : runs[s])
+			{
+				DrawRange range;
+				range.IndexCount = run.IndexCount;
+				range.StartIndexLocation = (uint32)mIndices16.size();
+				range.BaseVertexLocation = submesh.BaseVertexLocation + run.BaseVertexLocation;
+
+				uint32 rebase = (uint32)run.BaseVertexLocation;
+				for(uint32 i = run.StartIndexLocation; i < run.StartIndexLocation + run.IndexCount; ++i)
+					mIndices16.push_back((uint16)(submesh.Indices[i] - rebase));
+
+				mDrawRanges[s].push_back(range);
+			}
+		}
+		else if(!submesh.Indices.empty())
+		{
+			DrawRange range;
+			range.IndexCount = (uint32)submesh.Indices.size();
+			range.StartIndexLocation = (uint32)mIndices32.size();
+			range.BaseVertexLocation = submesh.BaseVertexLocation;
+
+			mIndices32.insert(mIndices32.end(), submesh.Indices.begin(), submesh.Indices.end());
+			mDrawRanges[s].push_back(range);
+		}
+
+		// Release the 32-bit list as soon as it has been copied.
+		std::vector<uint32>().swap(submesh.Indices);
+	}
+
+	mPending.clear();
+}
+
+bool IndexBufferBuilder::Is16Bit()const
+{
+	return mIs16Bit;
+}
+
+IndexBufferBuilder::uint32 IndexBufferBuilder::GetIndexSize()const
+{
+	return mIs16Bit ? sizeof(uint16) : sizeof(uint32);
+}
+
+IndexBufferBuilder::uint32 IndexBufferBuilder::GetIndexCount()const
+{
+	return (uint32)(mIs16Bit ? mIndices16.size() : mIndices32.size());
+}
+
+IndexBufferBuilder::uint32 IndexBufferBuilder::GetByteSize()const
+{
+	return GetIndexCount()*GetIndexSize();
+}
+
+const void* IndexBufferBuilder::GetData()const
+{
+	return mIs16Bit ? (const void*)mIndices16.data() : (const void*)mIndices32.data();
+}
+
+const std::vector<IndexBufferBuilder::uint16>& IndexBufferBuilder::GetIndices16()const
+{
+	return mIndices16;
+}
+
+const std::vector<IndexBufferBuilder::uint32>& IndexBufferBuilder::GetIndices32()const
+{
+	return mIndices32;
+}
+
+IndexBufferBuilder::uint32 IndexBufferBuilder::GetSubmeshCount()const
+{
+	return (uint32)mDrawRanges.size();
+}
+
+const std::vector<IndexBufferBuilder::DrawRange>& IndexBufferBuilder::GetDrawRanges(uint32 submesh)const
+{
+	return mDrawRanges[submesh];
+}
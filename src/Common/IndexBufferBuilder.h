@@ -0,0 +1,92 @@
+//***************************************************************************************
+// IndexBufferBuilder.h
+//
+// Concatenates the index lists of several submeshes into one index buffer, picking
+// 16-bit indices whenever they are safe instead of truncating the way
+// MeshData::GetIndices16 would.
+//
+// Submesh indices are relative to a base vertex, as DrawIndexedInstanced takes them.
+// A submesh whose indices span more than 65536 vertices is split into draw ranges,
+// each rebased to the smallest vertex it uses, so that every range fits 16 bits on
+// its own.  Only when a single triangle spans more than that does the whole buffer
+// fall back to 32-bit indices.  The 32-bit lists are released as they are packed,
+// so the indices are never held in both widths at once.
+//
+// The code only depends on the standard library.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "GeometryGenerator.h"
+
+class IndexBufferBuilder
+{
+public:
+
+    using uint16 = std::uint16_t;
+    using uint32 = std::uint32_t;
+
+	// The arguments of one DrawIndexedInstanced call.
+	struct DrawRange
+	{
+		uint32 IndexCount = 0;
+		uint32 StartIndexLocation = 0;
+		int BaseVertexLocation = 0;
+	};
+
+	///<summary>
+	/// Queues the triangle list of a submesh whose indices are relative to
+	/// baseVertexLocation, and returns the submesh's number.  indices is moved from,
+	/// so its memory is released when the buffer is built.
+	///</summary>
+	uint32 AddSubmesh(std::vector<uint32>&& indices, int baseVertexLocation);
+	uint32 AddSubmesh(GeometryGenerator::MeshData& meshData, int baseVertexLocation);
+
+	///<summary>
+	/// Packs the queued submeshes, in order, into 16-bit indices if allow16Bit and
+	/// every submesh can be split to fit, and into 32-bit indices otherwise.  The
+	/// result replaces that of any earlier Build.
+	///</summary>
+	void Build(bool allow16Bit = true);
+
+	bool Is16Bit()const;
+	uint32 GetIndexSize()const;
+	uint32 GetIndexCount()const;
+	uint32 GetByteSize()const;
+	const void* GetData()const;
+
+	const std::vector<uint16>& GetIndices16()const;
+	const std::vector<uint32>& GetIndices32()const;
+
+	uint32 GetSubmeshCount()const;
+
+	///<summary>
+	/// The draws that together cover a submesh; a single one unless it was split.
+	///</summary>
+	const std::vector<DrawRange>& GetDrawRanges(uint32 submesh)const;
+
+	///<summary>
+	/// Splits a triangle list, in order, into runs whose indices span at most
+	/// maxVertexSpan vertices.  A run's StartIndexLocation is its first index in the
+	/// list and its BaseVertexLocation the smallest index it uses.  Returns false if
+	/// a single triangle spans more than maxVertexSpan.
+	///</summary>
+	static bool SplitBySpan(const uint32* indices, uint32 indexCount, uint32 maxVertexSpan,
+		std::vector<DrawRange>& runs);
+
+private:
+	struct PendingSubmesh
+	{
+		std::vector<uint32> Indices;
+		int BaseVertexLocation = 0;
+	};
+
+	std::vector<PendingSubmesh> mPending;
+
+	bool mIs16Bit = false;
+	std::vector<uint16> mIndices16;
+	std::vector<uint32> mIndices32;
+	std::vector<std::vector<DrawRange>> mDrawRanges;
+};
@@ -0,0 +1,306 @@
+//***************************************************************************************
+// IndexCodec.cpp
+//***************************************************************************************
+
+#include "IndexCodec.h"
+#include <limits>
+
+namespace
+{
+	using uint8 = IndexCodec::uint8;
+	using uint32 = IndexCodec::uint32;
+
+	// High nibble of a triangle that shares no recent edge.
+	const uint32 NoEdge = 15;
+
+	// Vertex codes; in the low nibble only ExplicitVertex and below are used, and as a
+	// varint anything from ExplicitVertex up carries the zigzagged difference.
+	const uint32 NextVertex = 0;
+	const uint32 ExplicitVertex = 15;
+
+	const uint32 FifoSize = 16;
+
+	// Encoder and decoder step through the same state, so they agree on every code.
+	struct CodecState
+	{
+		CodecState()
+		{
+			for(uint32 i = 0; i < FifoSize; ++i)
+			{
+				EdgeFifo[i][0] = EdgeFifo[i][1] = 0xffffffff;
+				VertexFifo[i] = 0xffffffff;
+			}
+		}
+
+		// Edge i back from the most recent one.
+		const uint32* Edge(uint32 i)const
+		{
+			return EdgeFifo[(EdgeHead - 1 - i) & (FifoSize - 1)];
+		}
+
+		uint32 Vertex(uint32 i)const
+		{
+			return VertexFifo[(VertexHead - 1 - i) & (FifoSize - 1)];
+		}
+
+		void PushEdge(uint32 a, uint32 b)
+		{
+			EdgeFifo[EdgeHead][0] = a;
+			EdgeFifo[EdgeHead][1] = b;
+			EdgeHead = (EdgeHead + 1) & (FifoSize - 1);
+		}
+
+		void PushVertex(uint32 v)
+		{
+			VertexFifo[VertexHead] = v;
+			VertexHead = (VertexHead + 1) & (FifoSize - 1);
+		}
+
+		// Updates the state for a vertex that was coded with the given code.
+		void Visit(uint32 v, uint32 code)
+		{
+			if(code == NextVertex || code >= ExplicitVertex)
+				PushVertex(v);
+
+			if(code >= ExplicitVertex)
+				Last = v;
+
+			if(v >= Next)
+				Next = v + 1;
+		}
+
+		uint32 EdgeFifo[FifoSize][2];
+		uint32 EdgeHead = 0;
+
+		uint32 VertexFifo[FifoSize];
+		uint32 VertexHead = 0;
+
+		// Vertex following the highest one seen, and the last one coded explicitly.
+		uint32 Next = 0;
+		uint32 Last = 0;
+	};
+
+	void WriteVarint(uint32 v, std::vector<uint8>& out)
+	{
+		while(v >= 0x80)
+		{
+			out.push_back((uint8)(v | 0x80));
+			v >>= 7;
+		}
+		out.push_back((uint8)v);
+	}
+
+	bool ReadVarint(const uint8* data, size_t size, size_t& pos, uint32& v)
+	{
+		v = 0;
+		for(uint32 shift = 0; shift < 35; shift += 7)
+		{
+			if(pos >= size)
+				return false;
+
+			uint8 b = data[pos++];
+			v |= (uint32)(b & 0x7f) << shift;
+			if((b & 0x80) == 0)
+				return true;
+		}
+
+		return false;
+	}
+
+	uint32 Zigzag(uint32 delta)
+	{
+		return (delta << 1) ^ (uint32)((int32_t)delta >> 31);
+	}
+
+	uint32 Unzigzag(uint32 v)
+	{
+		return (v >> 1) ^ (0u - (v & 1));
+	}
+
+	// Short code for v, or ExplicitVertex if it has none.
+	uint32 VertexCode(const CodecState& state, uint32 v)
+	{
+		if(v == state.Next)
+			return NextVertex;
+
+		for(uint32 i = 0; i < ExplicitVertex - 1; ++i)
+		{
+			if(state.Vertex(i) == v)
+				return i + 1;
+		}
+
+		return ExplicitVertex;
+	}
+
+	uint32 VertexFromCode(const CodecState& state, uint32 code, uint32 delta)
+	{
+		if(code == NextVertex)
+			return state.Next;
+
+		if(code < ExplicitVertex)
+			return state.Vertex(code - 1);
+
+		return state.Last + delta;
+	}
+
+	template<typename Index>
+	void EncodeImpl(const Index* indices, uint32 indexCount, std::vector<uint8>& out)
+	{
+		CodecState state;
+
+		for(uint32 t = 0; t + 2 < indexCount; t += 3)
+		{
+			uint32 tri[3] = { indices[t], indices[t+1], indices[t+2] };
+
+			// Look for a recent edge among the three rotations of the triangle.
+			uint32 edge = NoEdge;
+			for(uint32 e = 0; e < NoEdge && edge == NoEdge; ++e)
+			{
+				const uint32* shared = state.Edge(e);
+				for(uint32 r = 0; r < 3; ++r)
+				{
+					if(tri[r] == shared[0] && tri[(r+1) % 3] == shared[1])
+					{
+						uint32 rotated[3] = { tri[r], tri[(r+1) % 3], tri[(r+2) % 3] };
+						tri[0] = rotated[0];
+						tri[1] = rotated[1];
+						tri[2] = rotated[2];
+						edge = e;
+						break;
+					}
+				}
+			}
+
+			uint32 a = tri[0];
+			uint32 b = tri[1];
+			uint32 c = tri[2];
+
+			if(edge != NoEdge)
+			{
+				uint32 code = VertexCode(state, c);
+				out.push_back((uint8)(edge << 4 | code));
+				if(code == ExplicitVertex)
+					WriteVarint(Zigzag(c - state.Last), out);
+
+				state.Visit(c, code);
+
+				state.PushEdge(c, b);
+				state.PushEdge(a, c);
+			}
+			else
+			{
+				out.push_back((uint8)(NoEdge << 4));
+
+				for(uint32 v : tri)
+				{
+					uint32 code = VertexCode(state, v);
+					WriteVarint(code < ExplicitVertex ? code : ExplicitVertex + Zigzag(v - state.Last), out);
+					state.Visit(v, code);
+				}
+
+				state.PushEdge(b, a);
+				state.PushEdge(c, b);
+				state.PushEdge(a, c);
+			}
+		}
+	}
+
+	template<typename Index>
+	bool DecodeImpl(const uint8* data, size_t size, uint32 indexCount, Index* indices)
+	{
+		if(indexCount % 3 != 0)
+			return false;
+
+		CodecState state;
+		size_t pos = 0;
+
+		for(uint32 t = 0; t < indexCount; t += 3)
+		{
+			if(pos >= size)
+				return false;
+
+			uint8 header = data[pos++];
+			uint32 edge = header >> 4;
+			uint32 tri[3];
+
+			if(edge != NoEdge)
+			{
+				const uint32* shared = state.Edge(edge);
+				tri[0] = shared[0];
+				tri[1] = shared[1];
+
+				uint32 code = header & 0xf;
+				uint32 delta = 0;
+				if(code == ExplicitVertex)
+				{
+					uint32 v;
+					if(!ReadVarint(data, size, pos, v))
+						return false;
+					delta = Unzigzag(v);
+				}
+
+				tri[2] = VertexFromCode(state, code, delta);
+				state.Visit(tri[2], code);
+
+				state.PushEdge(tri[2], tri[1]);
+				state.PushEdge(tri[0], tri[2]);
+			}
+			else
+			{
+				if((header & 0xf) != 0)
+					return false;
+
+				for(uint32 i = 0; i < 3; ++i)
+				{
+					uint32 code;
+					if(!ReadVarint(data, size, pos, code))
+						return false;
+
+					uint32 delta = 0;
+					if(code >= ExplicitVertex)
+					{
+						delta = Unzigzag(code - ExplicitVertex);
+						code = ExplicitVertex;
+					}
+
+					tri[i] = VertexFromCode(state, code, delta);
+					state.Visit(tri[i], code);
+				}
+
+				state.PushEdge(tri[1], tri[0]);
+				state.PushEdge(tri[2], tri[1]);
+				state.PushEdge(tri[0], tri[2]);
+			}
+
+			for(uint32 i = 0; i < 3; ++i)
+			{
+				if(tri[i] > std::numeric_limits<Index>::max())
+					return false;
+
+				indices[t + i] = (Index)tri[i];
+			}
+		}
+
+		return pos == size;
+	}
+}
+
+void IndexCodec::Encode(const uint32* indices, uint32 indexCount, std::vector<uint8>& out)
+{
+	EncodeImpl(indices, indexCount, out);
+}
+
+void IndexCodec::Encode(const uint16* indices, uint32 indexCount, std::vector<uint8>& out)
+{
+	EncodeImpl(indices, indexCount, out);
+}
+
+bool IndexCodec::Decode(const uint8* data, size_t size, uint32 indexCount, uint32* indices)
+{
+	return DecodeImpl(data, size, indexCount, indices);
+}
+
+bool IndexCodec::Decode(const uint8* data, size_t size, uint32 indexCount, uint16* indices)
+{
+	return DecodeImpl(data, size, indexCount, indices);
+}
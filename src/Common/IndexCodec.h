@@ -0,0 +1,50 @@
+//***************************************************************************************
+// IndexCodec.h
+//
+// Compact encoding of triangle lists for storage and streaming.  It relies on what
+// a vertex cache optimized list (see MeshOptimizer) looks like: consecutive
+// triangles share edges, and vertices are first used roughly in order.
+//
+// Each triangle starts with a code byte.  Its high nibble names one of the last 15
+// edges, reversed, when the triangle shares it with an earlier triangle; then only
+// the third vertex follows, and its low nibble says whether that vertex is the next
+// unused one, one of the last 14 vertices seen, or coded explicitly as a varint
+// difference from the last explicit vertex.  A triangle sharing no recent edge has
+// a high nibble of 15 and three vertices coded the same way, each as a varint.
+//
+// Triangles keep their order and winding, but may be rotated, which only changes
+// the provoking vertex.  A cache optimized mesh typically takes 1.5 to 2.5 bytes a
+// triangle, against 6 for 16-bit and 12 for 32-bit indices.  Decoding is a single
+// pass over the bytes with no allocation.
+//
+// The code only depends on the standard library.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class IndexCodec
+{
+public:
+
+    using uint8 = std::uint8_t;
+    using uint16 = std::uint16_t;
+    using uint32 = std::uint32_t;
+
+	///<summary>
+	/// Appends the encoding of a triangle list to out.  indexCount must be a
+	/// multiple of 3.
+	///</summary>
+	static void Encode(const uint32* indices, uint32 indexCount, std::vector<uint8>& out);
+	static void Encode(const uint16* indices, uint32 indexCount, std::vector<uint8>& out);
+
+	///<summary>
+	/// Decodes indexCount indices from size bytes of data.  Returns false if the data
+	/// is truncated, malformed, or, for 16-bit output, holds an index past 65535.
+	///</summary>
+	static bool Decode(const uint8* data, size_t size, uint32 indexCount, uint32* indices);
+	static bool Decode(const uint8* data, size_t size, uint32 indexCount, uint16* indices);
+};
@@ -0,0 +1,297 @@
+//***************************************************************************************
+// LooseOctree.cpp
+//***************************************************************************************
+
+#include "LooseOctree.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+const LooseOctree::uint32 LooseOctree::NoIndex;
+
+namespace
+{
+	float MaxExtent(const BoundingBox& b)
+	{
+		return (std::max)(b.Extents.x, (std::max)(b.Extents.y, b.Extents.z));
+	}
+
+	bool InsideCell(const XMFLOAT3& p, const XMFLOAT3& center, float halfSize)
+	{
+		return std::fabs(p.x - center.x) <= halfSize &&
+			std::fabs(p.y - center.y) <= halfSize &&
+			std::fabs(p.z - center.z) <= halfSize;
+	}
+}
+
+LooseOctree::LooseOctree(const XMFLOAT3& center, float rootHalfSize, uint32 maxDepth)
+	: mMaxDepth(maxDepth)
+{
+	Node root;
+	root.Center = center;
+	root.HalfSize = rootHalfSize;
+	std::fill(root.Children, root.Children + 8, NoIndex);
+
+	mNodes.push_back(root);
+}
+
+void LooseOctree::Insert(uint32 item, const BoundingBox& worldBounds)
+{
+	if(item >= (uint32)mItems.size())
+		mItems.resize(item + 1);
+
+	mItems[item].Bounds = worldBounds;
+	Link(item, FindNode(worldBounds));
+
+	mItemCount++;
+}
+
+void LooseOctree::Move(uint32 item, const BoundingBox& worldBounds)
+{
+	ItemEntry& e = mItems[item];
+	e.Bounds = worldBounds;
+
+	// Small moves leave the item in its node, which is the common case.
+	if(FitsNode(e.Node, worldBounds))
+		return;
+
+	uint32 oldNode = e.Node;
+	Unlink(item);
+	Link(item, FindNode(worldBounds));
+	PruneNode(oldNode);
+}
+
+void LooseOctree::Remove(uint32 item)
+{
+	uint32 oldNode = mItems[item].Node;
+	Unlink(item);
+	PruneNode(oldNode);
+
+	mItemCount--;
+}
+
+bool LooseOctree::Contains(uint32 item)const
+{
+	return item < (uint32)mItems.size() && mItems[item].Node != NoIndex;
+}
+
+void LooseOctree::QueryFrustum(const BoundingFrustum& worldFrustum, std::vector<uint32>& items)const
+{
+	Query([&](const BoundingBox& box) { return worldFrustum.Contains(box); }, items);
+}
+
+void LooseOctree::QuerySphere(const BoundingSphere& worldSphere, std::vector<uint32>& items)const
+{
+	Query([&](const BoundingBox& box) { return worldSphere.Contains(box); }, items);
+}
+
+void LooseOctree::QueryRay(FXMVECTOR rayOrigin, FXMVECTOR rayDir, float maxDist, std::vector<uint32>& items)const
+{
+	XMVECTOR origin = rayOrigin;
+	XMVECTOR dir = rayDir;
+
+	Query([&](const BoundingBox& box)
+	{
+		float dist = 0.0f;
+		if(box.Intersects(origin, dir, dist) && dist <= maxDist)
+			return INTERSECTS;
+		return DISJOINT;
+	}, items);
+}
+
+template<typename Test>
+void LooseOctree::Query(const Test& test, std::vector<uint32>& items)const
+{
+	struct StackEntry
+	{
+		uint32 Node;
+
+		// The node's loose bounds are inside the query volume, so everything below
+		// it is too and no more tests are needed.
+		bool Inside;
+	};
+
+	std::vector<StackEntry> stack;
+	stack.reserve(8*mMaxDepth + 8);
+
+	// The root is always visited since it also holds the items outside its cell.
+	stack.push_back({ 0, false });
+	while(!stack.empty())
+	{
+		StackEntry s = stack.back();
+		stack.pop_back();
+
+		const Node& node = mNodes[s.Node];
+
+		for(uint32 i = node.FirstItem; i != NoIndex; i = mItems[i].Next)
+		{
+			if(s.Inside || test(mItems[i].Bounds) != DISJOINT)
+				items.push_back(i);
+		}
+
+		if(node.ChildCount == 0)
+			continue;
+
+		for(int c = 0; c < 8; ++c)
+		{
+			uint32 child = node.Children[c];
+			if(child == NoIndex)
+				continue;
+
+			if(s.Inside)
+			{
+				stack.push_back({ child, true });
+				continue;
+			}
+
+			ContainmentType ct = test(GetLooseBounds(child));
+			if(ct != DISJOINT)
+				stack.push_back({ child, ct == CONTAINS });
+		}
+	}
+}
+
+LooseOctree::uint32 LooseOctree::FindNode(const BoundingBox& bounds)
+{
+	const XMFLOAT3& c = bounds.Center;
+	const float r = MaxExtent(bounds);
+
+	uint32 nodeIndex = 0;
+	if(!InsideCell(c, mNodes[0].Center, mNodes[0].HalfSize))
+		return nodeIndex;
+
+	// Descend toward the center while the child cell is still at least as large
+	// as the item.
+	while(mNodes[nodeIndex].Depth < mMaxDepth && 0.5f*mNodes[nodeIndex].HalfSize >= r)
+	{
+		const Node& node = mNodes[nodeIndex];
+
+		uint32 octant =
+			(c.x >= node.Center.x ? 1 : 0) |
+			(c.y >= node.Center.y ? 2 : 0) |
+			(c.z >= node.Center.z ? 4 : 0);
+
+		uint32 child = node.Children[octant];
+		if(child == NoIndex)
+			child = AllocNode(nodeIndex, octant);
+
+		nodeIndex = child;
+	}
+
+	return nodeIndex;
+}
+
+bool LooseOctree::FitsNode(uint32 nodeIndex, const BoundingBox& bounds)const
+{
+	const Node& node = mNodes[nodeIndex];
+	const float r = MaxExtent(bounds);
+
+	const bool inside = InsideCell(bounds.Center, node.Center, node.HalfSize);
+	const bool tooLargeForChild = node.Depth == mMaxDepth || 0.5f*node.HalfSize < r;
+
+	// Same rule FindNode uses.  The root also takes items outside its cell and
+	// items of any size.
+	if(nodeIndex == 0)
+		return !inside || tooLargeForChild;
+
+	return inside && r <= node.HalfSize && tooLargeForChild;
+}
+
+LooseOctree::uint32 LooseOctree::AllocNode(uint32 parent, uint32 octant)
+{
+	Node node;
+	node.HalfSize = 0.5f*mNodes[parent].HalfSize;
+	node.Depth = mNodes[parent].Depth + 1;
+	node.Parent = parent;
+	node.Center = mNodes[parent].Center;
+	node.Center.x += (octant & 1) ? node.HalfSize : -node.HalfSize;
+	node.Center.y += (octant & 2) ? node.HalfSize : -node.HalfSize;
+	node.Center.z += (octant & 4) ? node.HalfSize : -node.HalfSize;
+	std::fill(node.Children, node.Children + 8, NoIndex);
+
+	uint32 nodeIndex;
+	if(!mFreeNodes.empty())
+	{
+		nodeIndex = mFreeNodes.back();
+		mFreeNodes.pop_back();
+		mNodes[nodeIndex] = node;
+	}
+	else
+	{
+		nodeIndex = (uint32)mNodes.size();
+		mNodes.push_back(node);
+	}
+
+	mNodes[parent].Children[octant] = nodeIndex;
+	mNodes[parent].ChildCount++;
+
+	return nodeIndex;
+}
+
+void LooseOctree::Link(uint32 item, uint32 nodeIndex)
+{
+	ItemEntry& e = mItems[item];
+	Node& node = mNodes[nodeIndex];
+
+	e.Node = nodeIndex;
+	e.Prev = NoIndex;
+	e.Next = node.FirstItem;
+	if(node.FirstItem != NoIndex)
+		mItems[node.FirstItem].Prev = item;
+	node.FirstItem = item;
+}
+
+void LooseOctree::Unlink(uint32 item)
+{
+	ItemEntry& e = mItems[item];
+
+	if(e.Prev != NoIndex)
+		mItems[e.Prev].Next = e.Next;
+	else
+		mNodes[e.Node].FirstItem = e.Next;
+
+	if(e.Next != NoIndex)
+		mItems[e.Next].Prev = e.Prev;
+
+	e.Node = NoIndex;
+	e.Prev = NoIndex;
+	e.Next = NoIndex;
+}
+
+void LooseOctree::PruneNode(uint32 nodeIndex)
+{
+	// Release empty leaves up the tree so the octree does not keep the cells of
+	// every place an item has ever been.  The root is never released.
+	while(nodeIndex != 0)
+	{
+		Node& node = mNodes[nodeIndex];
+		if(node.FirstItem != NoIndex || node.ChildCount > 0)
+			return;
+
+		uint32 parent = node.Parent;
+		Node& p = mNodes[parent];
+		for(int c = 0; c < 8; ++c)
+		{
+			if(p.Children[c] == nodeIndex)
+			{
+				p.Children[c] = NoIndex;
+				break;
+			}
+		}
+		p.ChildCount--;
+
+		node.Parent = NoIndex;
+		mFreeNodes.push_back(nodeIndex);
+
+		nodeIndex = parent;
+	}
+}
+
+BoundingBox LooseOctree::GetLooseBounds(uint32 nodeIndex)const
+{
+	const Node& node = mNodes[nodeIndex];
+	float loose = 2.0f*node.HalfSize;
+
+	return BoundingBox(node.Center, XMFLOAT3(loose, loose, loose));
+}
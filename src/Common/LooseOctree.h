@@ -0,0 +1,93 @@
+//***************************************************************************************
+// LooseOctree.h
+//
+// Octree whose nodes are "loose": the bounds used to cull a node are twice the size of
+// the cell it subdivides.  An item is stored in exactly one node, chosen from the
+// item's size and the position of its center, so inserting and moving an item never
+// splits or merges its bounds across nodes and costs O(depth).
+//
+// An item of half size r with its center in a cell of half size h >= r lies
+// entirely inside the cell's loose bounds (half size 2h), which is what lets a query
+// skip every item under a node whose loose bounds it misses.
+//***************************************************************************************
+
+#pragma once
+
+#include "SpatialIndex.h"
+
+class LooseOctree : public SpatialIndex
+{
+public:
+
+	///<summary>
+	/// The root cell is the cube of half size rootHalfSize around center.  Items
+	/// whose center is outside it are kept in the root node and still found by
+	/// every query; size the root to cover the world to keep that rare.
+	///</summary>
+	LooseOctree(const DirectX::XMFLOAT3& center, float rootHalfSize, uint32 maxDepth = 8);
+	LooseOctree(const LooseOctree& rhs) = delete;
+	LooseOctree& operator=(const LooseOctree& rhs) = delete;
+
+	virtual void Insert(uint32 item, const DirectX::BoundingBox& worldBounds)override;
+	virtual void Move(uint32 item, const DirectX::BoundingBox& worldBounds)override;
+	virtual void Remove(uint32 item)override;
+
+	virtual bool Contains(uint32 item)const override;
+	virtual uint32 GetItemCount()const override { return mItemCount; }
+
+	virtual void QueryFrustum(const DirectX::BoundingFrustum& worldFrustum, std::vector<uint32>& items)const override;
+	virtual void QuerySphere(const DirectX::BoundingSphere& worldSphere, std::vector<uint32>& items)const override;
+	virtual void QueryRay(DirectX::FXMVECTOR rayOrigin, DirectX::FXMVECTOR rayDir, float maxDist,
+		std::vector<uint32>& items)const override;
+
+	uint32 GetNodeCount()const { return (uint32)mNodes.size() - (uint32)mFreeNodes.size(); }
+
+private:
+	static const uint32 NoIndex = 0xffffffff;
+
+	struct Node
+	{
+		DirectX::XMFLOAT3 Center;
+		float HalfSize = 0.0f;
+
+		uint32 Depth = 0;
+		uint32 Parent = NoIndex;
+		uint32 Children[8];
+
+		// Head of the intrusive list of items stored in this node.
+		uint32 FirstItem = NoIndex;
+
+		// Nonzero children.
+		uint32 ChildCount = 0;
+	};
+
+	struct ItemEntry
+	{
+		DirectX::BoundingBox Bounds;
+		uint32 Node = NoIndex;
+		uint32 Prev = NoIndex;
+		uint32 Next = NoIndex;
+	};
+
+	uint32 FindNode(const DirectX::BoundingBox& bounds);
+	bool FitsNode(uint32 nodeIndex, const DirectX::BoundingBox& bounds)const;
+	uint32 AllocNode(uint32 parent, uint32 octant);
+	void Link(uint32 item, uint32 nodeIndex);
+	void Unlink(uint32 item);
+	void PruneNode(uint32 nodeIndex);
+	DirectX::BoundingBox GetLooseBounds(uint32 nodeIndex)const;
+
+	// Visits the nodes whose loose bounds pass the test and appends the items
+	// that pass it too.  Test returns the ContainmentType of a box.
+	template<typename Test>
+	void Query(const Test& test, std::vector<uint32>& items)const;
+
+private:
+	std::vector<Node> mNodes;
+	std::vector<uint32> mFreeNodes;
+
+	std::vector<ItemEntry> mItems;
+	uint32 mItemCount = 0;
+
+	uint32 mMaxDepth = 8;
+};
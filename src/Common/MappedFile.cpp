@@ -0,0 +1,215 @@
+//***************************************************************************************
+// MappedFile.cpp
+//***************************************************************************************
+
+#include "MappedFile.h"
+#include <cstdint>
+#include <utility>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cwchar>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(MappedFile&& rhs) noexcept
+{
+	*this = std::move(rhs);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& rhs) noexcept
+{
+	if(this != &rhs)
+	{
+		Close();
+		std::swap(mData, rhs.mData);
+		std::swap(mSize, rhs.mSize);
+		std::swap(mIsOpen, rhs.mIsOpen);
+	}
+
+	return *this;
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::Open(const std::wstring& fileName)
+{
+	Close();
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+	HANDLE file = CreateFile2(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, nullptr);
+#else
+	HANDLE file = CreateFileW(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+#endif
+	if(file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize = {};
+	if(!GetFileSizeEx(file, &fileSize))
+	{
+		DWORD error = GetLastError();
+		CloseHandle(file);
+		SetLastError(error);
+		return false;
+	}
+
+	if(static_cast<std::uint64_t>(fileSize.QuadPart) > SIZE_MAX)
+	{
+		CloseHandle(file);
+		SetLastError(ERROR_FILE_TOO_LARGE);
+		return false;
+	}
+
+	// Empty files cannot be mapped.
+	if(fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+		mIsOpen = true;
+		return true;
+	}
+
+	// The mapping keeps the file open and the view keeps the mapping alive, so
+	// neither handle is needed once the view exists.
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	DWORD error = GetLastError();
+	CloseHandle(file);
+	if(mapping == nullptr)
+	{
+		SetLastError(error);
+		return false;
+	}
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	error = GetLastError();
+	CloseHandle(mapping);
+	if(view == nullptr)
+	{
+		SetLastError(error);
+		return false;
+	}
+
+	mData = static_cast<const std::uint8_t*>(view);
+	mSize = static_cast<std::size_t>(fileSize.QuadPart);
+	mIsOpen = true;
+
+#if (_WIN32_WINNT >= _WIN32_WINNT_WIN8)
+	// Callers read the whole file right away, so have it read in large requests
+	// rather than one page fault at a time.  This is only a hint.
+	WIN32_MEMORY_RANGE_ENTRY range = { view, mSize };
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if(mData)
+		UnmapViewOfFile(mData);
+
+	mData = nullptr;
+	mSize = 0;
+	mIsOpen = false;
+}
+
+MappedFile::NativePath MappedFile::ToNativePath(const std::wstring& fileName)
+{
+	return fileName;
+}
+
+#else
+
+bool MappedFile::Open(const std::wstring& fileName)
+{
+	Close();
+
+	std::string path = ToNativePath(fileName);
+	if(path.empty())
+		return false;
+
+	int file = open(path.c_str(), O_RDONLY);
+	if(file < 0)
+		return false;
+
+	struct stat fileInfo;
+	if(fstat(file, &fileInfo) != 0)
+	{
+		int error = errno;
+		close(file);
+		errno = error;
+		return false;
+	}
+
+	if(static_cast<std::uint64_t>(fileInfo.st_size) > SIZE_MAX)
+	{
+		close(file);
+		errno = EFBIG;
+		return false;
+	}
+
+	// Empty files cannot be mapped.
+	if(fileInfo.st_size == 0)
+	{
+		close(file);
+		mIsOpen = true;
+		return true;
+	}
+
+	// The mapping keeps the file open.
+	std::size_t size = static_cast<std::size_t>(fileInfo.st_size);
+	void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+	int error = errno;
+	close(file);
+	if(view == MAP_FAILED)
+	{
+		errno = error;
+		return false;
+	}
+
+	// Callers read the whole file right away, so have it read in large requests
+	// rather than one page fault at a time.  This is only a hint.
+	madvise(view, size, MADV_WILLNEED);
+
+	mData = static_cast<const std::uint8_t*>(view);
+	mSize = size;
+	mIsOpen = true;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if(mData)
+		munmap(const_cast<std::uint8_t*>(mData), mSize);
+
+	mData = nullptr;
+	mSize = 0;
+	mIsOpen = false;
+}
+
+MappedFile::NativePath MappedFile::ToNativePath(const std::wstring& fileName)
+{
+	std::mbstate_t state = {};
+	const wchar_t* src = fileName.c_str();
+	std::size_t length = std::wcsrtombs(nullptr, &src, 0, &state);
+	if(length == static_cast<std::size_t>(-1))
+		return std::string();
+
+	std::string path(length, '\0');
+	state = {};
+	src = fileName.c_str();
+	std::wcsrtombs(&path[0], &src, length, &state);
+	return path;
+}
+
+#endif
@@ -0,0 +1,60 @@
+//***************************************************************************************
+// MappedFile.h
+//
+// Maps a whole file read-only into the address space.  Reading a file through a
+// mapping hands out pointers straight into the operating system's file cache: no
+// buffer has to be allocated for it, and data is only copied when the caller copies
+// it, for instance into an upload heap.  Pages are faulted in as they are touched and
+// the OS may drop them again under memory pressure, since they can be read back.
+//
+// Uses CreateFileMapping on Windows and mmap elsewhere.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile& rhs) = delete;
+	MappedFile& operator=(const MappedFile& rhs) = delete;
+	MappedFile(MappedFile&& rhs) noexcept;
+	MappedFile& operator=(MappedFile&& rhs) noexcept;
+	~MappedFile();
+
+	///<summary>
+	/// Maps fileName, closing any file mapped before.  Returns false when the file
+	/// cannot be opened or mapped; GetLastError (errno outside Windows) says why.
+	/// An empty file opens successfully with no data.
+	///</summary>
+	bool Open(const std::wstring& fileName);
+	void Close();
+
+	bool IsOpen()const { return mIsOpen; }
+
+#if defined(_WIN32)
+	using NativePath = std::wstring;
+#else
+	using NativePath = std::string;
+#endif
+
+	///<summary>
+	/// fileName as the operating system's file calls and the standard file streams
+	/// take it: unchanged on Windows, converted to the locale's narrow encoding
+	/// elsewhere.  Empty when it does not convert.
+	///</summary>
+	static NativePath ToNativePath(const std::wstring& fileName);
+
+	// Valid until the file is closed.
+	const std::uint8_t* GetData()const { return mData; }
+	std::size_t GetSize()const { return mSize; }
+
+private:
+	const std::uint8_t* mData = nullptr;
+	std::size_t mSize = 0;
+	bool mIsOpen = false;
+};
@@ -0,0 +1,551 @@
+//***************************************************************************************
+// MeshOptimizer.cpp
+//***************************************************************************************
+
+#include "MeshOptimizer.h"
+#include <algorithm>
+
+using namespace DirectX;
+
+const MeshOptimizer::uint32 MeshOptimizer::DefaultCacheSize;
+
+namespace
+{
+	using uint32 = MeshOptimizer::uint32;
+
+	const uint32 NoVertex = 0xffffffff;
+
+	// The triangles that use each vertex, stored as compressed rows: the triangles
+	// of vertex v are Triangles[Offsets[v]] to Triangles[Offsets[v+1]-1].
+	struct Adjacency
+	{
+		std::vector<uint32> Offsets;
+		std::vector<uint32> Triangles;
+	};
+
+	template<typename Index>
+	void BuildAdjacency(const Index* indices, uint32 indexCount,
+		uint32 vertexStart, uint32 vertexCount, Adjacency& adj)
+	{
+		adj.Offsets.assign(vertexCount + 1, 0);
+		for(uint32 i = 0; i < indexCount; ++i)
+			++adj.Offsets[indices[i] - vertexStart + 1];
+
+		for(uint32 v = 0; v < vertexCount; ++v)
+			adj.Offsets[v+1] += adj.Offsets[v];
+
+		std::vector<uint32> cursor(adj.Offsets.begin(), adj.Offsets.end() - 1);
+
+		adj.Triangles.resize(indexCount);
+		for(uint32 i = 0; i < indexCount; ++i)
+			adj.Triangles[cursor[indices[i] - vertexStart]++] = i / 3;
+	}
+
+	// A FIFO cache simulated with time stamps.  The time advances on every miss,
+	// so a vertex is still cached if it missed within the last cacheSize misses.
+	// Bumping the time by cacheSize flushes the cache.
+	struct FifoCache
+	{
+		FifoCache(uint32 vertexCount, uint32 cacheSize) :
+			CacheTime(vertexCount, 0),
+			Time(cacheSize + 1),
+			CacheSize(cacheSize){}
+
+		bool IsCached(uint32 v)const { return Time - CacheTime[v] <= CacheSize; }
+
+		// Returns true on a miss.
+		bool Access(uint32 v)
+		{
+			if(IsCached(v))
+				return false;
+
+			CacheTime[v] = Time++;
+			return true;
+		}
+
+		void Flush() { Time += CacheSize; }
+
+		std::vector<uint32> CacheTime;
+		uint32 Time;
+		uint32 CacheSize;
+	};
+
+	template<typename Index>
+	MeshOptimizer::CacheStats AnalyzeVertexCacheImpl(const Index* indices, uint32 indexCount,
+		uint32 vertexStart, uint32 vertexCount, uint32 cacheSize)
+	{
+		MeshOptimizer::CacheStats stats;
+		stats.TriangleCount = indexCount / 3;
+
+		FifoCache cache(vertexCount, cacheSize);
+		std::vector<bool> referenced(vertexCount, false);
+		uint32 referencedCount = 0;
+
+		for(uint32 i = 0; i < indexCount; ++i)
+		{
+			uint32 v = indices[i] - vertexStart;
+
+			if(cache.Access(v))
+				++stats.TransformCount;
+
+			if(!referenced[v])
+			{
+				referenced[v] = true;
+				++referencedCount;
+			}
+		}
+
+		if(stats.TriangleCount > 0)
+			stats.Acmr = (float)stats.TransformCount / stats.TriangleCount;
+
+		if(referencedCount > 0)
+			stats.Atvr = (float)stats.TransformCount / referencedCount;
+
+		return stats;
+	}
+
+	///<summary>
+	/// Tipsify.  Fans around one vertex at a time, emitting all its remaining
+	/// triangles, then moves to the neighbour that has been in the cache longest but
+	/// will still be cached after its own fan.  triOrder receives the triangles in
+	/// the new order.  If clusterStarts is given it receives the position in
+	/// triOrder after each dead end, where the order jumps to an unrelated part of
+	/// the mesh.
+	///</summary>
+	template<typename Index>
+	void Tipsify(const Index* indices, uint32 indexCount,
+		uint32 vertexStart, uint32 vertexCount, uint32 cacheSize,
+		std::vector<uint32>& triOrder, std::vector<uint32>* clusterStarts)
+	{
+		uint32 triCount = indexCount / 3;
+
+		triOrder.clear();
+		triOrder.reserve(triCount);
+
+		if(triCount == 0)
+			return;
+
+		Adjacency adj;
+		BuildAdjacency(indices, triCount*3, vertexStart, vertexCount, adj);
+
+		// Number of triangles of each vertex not emitted yet.
+		std::vector<uint32> liveCount(vertexCount);
+		for(uint32 v = 0; v < vertexCount; ++v)
+			liveCount[v] = adj.Offsets[v+1] - adj.Offsets[v];
+
+		std::vector<bool> emitted(triCount, false);
+
+		FifoCache cache(vertexCount, cacheSize);
+
+		// Recently used vertices, to restart from after a dead end.
+		std::vector<uint32> deadEndStack;
+		deadEndStack.reserve(triCount*3);
+
+		std::vector<uint32> candidates;
+
+		// Next vertex to consider when the dead end stack runs dry.
+		uint32 cursor = 0;
+
+		uint32 fan = NoVertex;
+		while(cursor < vertexCount && fan == NoVertex)
+		{
+			if(liveCount[cursor] > 0)
+				fan = cursor;
+			else
+				++cursor;
+		}
+
+		if(clusterStarts != nullptr)
+			clusterStarts->push_back(0);
+
+		while(fan != NoVertex)
+		{
+			candidates.clear();
+
+			for(uint32 j = adj.Offsets[fan]; j < adj.Offsets[fan+1]; ++j)
+			{
+				uint32 t = adj.Triangles[j];
+				if(emitted[t])
+					continue;
+
+				for(uint32 k = 0; k < 3; ++k)
+				{
+					uint32 v = indices[t*3+k] - vertexStart;
+
+					deadEndStack.push_back(v);
+					candidates.push_back(v);
+
+					--liveCount[v];
+					cache.Access(v);
+				}
+
+				emitted[t] = true;
+				triOrder.push_back(t);
+			}
+
+			// Prefer the candidate that entered the cache earliest, provided its fan
+			// (at most two new vertices per triangle) will not push it out.
+			uint32 next = NoVertex;
+			int bestPriority = -1;
+			for(uint32 v : candidates)
+			{
+				if(liveCount[v] == 0)
+					continue;
+
+				int priority = 0;
+				uint32 age = cache.Time - cache.CacheTime[v];
+				if(age + 2*liveCount[v] <= cacheSize)
+					priority = (int)age;
+
+				if(priority > bestPriority)
+				{
+					bestPriority = priority;
+					next = v;
+				}
+			}
+
+			if(next == NoVertex)
+			{
+				// Dead end: fall back to a recently used vertex, else to any vertex
+				// with triangles left.
+				while(!deadEndStack.empty() && next == NoVertex)
+				{
+					uint32 v = deadEndStack.back();
+					deadEndStack.pop_back();
+
+					if(liveCount[v] > 0)
+						next = v;
+				}
+
+				while(cursor < vertexCount && next == NoVertex)
+				{
+					if(liveCount[cursor] > 0)
+						next = cursor;
+					else
+						++cursor;
+				}
+
+				if(next != NoVertex && clusterStarts != nullptr)
+					clusterStarts->push_back((uint32)triOrder.size());
+			}
+
+			fan = next;
+		}
+	}
+
+	template<typename Index>
+	void OptimizeVertexCacheImpl(Index* indices, uint32 indexCount,
+		uint32 vertexStart, uint32 vertexCount, uint32 cacheSize)
+	{
+		std::vector<uint32> triOrder;
+		Tipsify(indices, indexCount, vertexStart, vertexCount, cacheSize, triOrder, nullptr);
+
+		std::vector<Index> oldIndices(indices, indices + triOrder.size()*3);
+		for(size_t i = 0; i < triOrder.size(); ++i)
+		{
+			uint32 t = triOrder[i];
+			indices[i*3+0] = oldIndices[t*3+0];
+			indices[i*3+1] = oldIndices[t*3+1];
+			indices[i*3+2] = oldIndices[t*3+2];
+		}
+	}
+
+	template<typename Index>
+	void OptimizeOverdrawImpl(Index* indices, uint32 indexCount,
+		uint32 vertexStart, uint32 vertexCount,
+		const XMFLOAT3* positions, uint32 positionStride,
+		uint32 cacheSize, float threshold)
+	{
+		uint32 triCount = indexCount / 3;
+		if(triCount == 0)
+			return;
+
+		std::vector<uint32> triOrder;
+		std::vector<uint32> hardStarts;
+		Tipsify(indices, indexCount, vertexStart, vertexCount, cacheSize, triOrder, &hardStarts);
+
+		std::vector<Index> sorted(triCount*3);
+		for(uint32 i = 0; i < triCount; ++i)
+		{
+			uint32 t = triOrder[i];
+			sorted[i*3+0] = indices[t*3+0];
+			sorted[i*3+1] = indices[t*3+1];
+			sorted[i*3+2] = indices[t*3+2];
+		}
+
+		//
+		// Split each Tipsify cluster further wherever the part so far is at least as
+		// cache efficient as threshold times the whole cluster.  Each part starts
+		// with a cold cache, so the parts can be drawn in any order.
+		//
+
+		std::vector<uint32> clusterStarts;
+		FifoCache cache(vertexCount, cacheSize);
+
+		hardStarts.push_back(triCount);
+		for(size_t c = 0; c + 1 < hardStarts.size(); ++c)
+		{
+			uint32 clusterStart = hardStarts[c];
+			uint32 clusterEnd = hardStarts[c+1];
+
+			uint32 misses = 0;
+			cache.Flush();
+			for(uint32 i = clusterStart*3; i < clusterEnd*3; ++i)
+			{
+				if(cache.Access(sorted[i] - vertexStart))
+					++misses;
+			}
+
+			float clusterThreshold = threshold*misses / (clusterEnd - clusterStart);
+
+			uint32 first = clusterStart;
+			misses = 0;
+
+			clusterStarts.push_back(first);
+			cache.Flush();
+
+			for(uint32 t = first; t < clusterEnd; ++t)
+			{
+				for(uint32 k = 0; k < 3; ++k)
+				{
+					if(cache.Access(sorted[t*3+k] - vertexStart))
+						++misses;
+				}
+
+				if(t + 1 < clusterEnd && misses <= clusterThreshold*(t - first + 1))
+				{
+					first = t + 1;
+					misses = 0;
+
+					clusterStarts.push_back(first);
+					cache.Flush();
+				}
+			}
+		}
+
+		clusterStarts.push_back(triCount);
+
+		//
+		// Area weighted centroid and normal of each cluster and of the whole mesh.
+		//
+
+		uint32 clusterCount = (uint32)clusterStarts.size() - 1;
+
+		std::vector<XMFLOAT3> clusterCentroids(clusterCount);
+		std::vector<XMFLOAT3> clusterNormals(clusterCount);
+
+		XMVECTOR meshCentroid = XMVectorZero();
+		float meshArea = 0.0f;
+
+		auto Position = [&](Index index)
+		{
+			const char* p = reinterpret_cast<const char*>(positions) + (size_t)index*positionStride;
+			return XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(p));
+		};
+
+		for(uint32 c = 0; c < clusterCount; ++c)
+		{
+			XMVECTOR centroid = XMVectorZero();
+			XMVECTOR normal = XMVectorZero();
+			float area = 0.0f;
+
+			for(uint32 t = clusterStarts[c]; t < clusterStarts[c+1]; ++t)
+			{
+				XMVECTOR p0 = Position(sorted[t*3+0]);
+				XMVECTOR p1 = Position(sorted[t*3+1]);
+				XMVECTOR p2 = Position(sorted[t*3+2]);
+
+				// Twice the area times the unit normal.
+				XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+				float triArea = XMVectorGetX(XMVector3Length(n));
+
+				centroid += (triArea / 3.0f)*(p0 + p1 + p2);
+				normal += n;
+				area += triArea;
+			}
+
+			meshCentroid += centroid;
+			meshArea += area;
+
+			if(area > 0.0f)
+				centroid /= area;
+
+			XMStoreFloat3(&clusterCentroids[c], centroid);
+			XMStoreFloat3(&clusterNormals[c], XMVector3Normalize(normal));
+		}
+
+		if(meshArea > 0.0f)
+			meshCentroid /= meshArea;
+
+		//
+		// Draw the clusters that face away from the center first.  On a roughly
+		// convex mesh they are the ones in front, so they occlude the others.
+		//
+
+		std::vector<float> sortKeys(clusterCount);
+		std::vector<uint32> clusterOrder(clusterCount);
+		for(uint32 c = 0; c < clusterCount; ++c)
+		{
+			XMVECTOR toCluster = XMLoadFloat3(&clusterCentroids[c]) - meshCentroid;
+			sortKeys[c] = XMVectorGetX(XMVector3Dot(toCluster, XMLoadFloat3(&clusterNormals[c])));
+			clusterOrder[c] = c;
+		}
+
+		std::stable_sort(clusterOrder.begin(), clusterOrder.end(),
+			[&](uint32 a, uint32 b) { return sortKeys[a] > sortKeys[b]; });
+
+		uint32 dst = 0;
+		for(uint32 c : clusterOrder)
+		{
+			for(uint32 t = clusterStarts[c]; t < clusterStarts[c+1]; ++t)
+			{
+				indices[dst++] = sorted[t*3+0];
+				indices[dst++] = sorted[t*3+1];
+				indices[dst++] = sorted[t*3+2];
+			}
+		}
+	}
+
+	template<typename Index>
+	void OptimizeVertexFetchImpl(Index* indices, uint32 indexCount,
+		uint32 vertexStart, uint32 vertexCount, std::vector<uint32>& remap)
+	{
+		remap.assign(vertexCount, NoVertex);
+
+		uint32 next = vertexStart;
+		for(uint32 i = 0; i < indexCount; ++i)
+		{
+			uint32 v = indices[i] - vertexStart;
+			if(remap[v] == NoVertex)
+				remap[v] = next++;
+
+			indices[i] = static_cast<Index>(remap[v]);
+		}
+
+		for(uint32 v = 0; v < vertexCount; ++v)
+		{
+			if(remap[v] == NoVertex)
+				remap[v] = next++;
+		}
+	}
+
+	template<typename Index>
+	void OptimizeSubsetImpl(Index* indices, uint32 indexCount,
+		uint32 vertexStart, uint32 vertexCount,
+		const XMFLOAT3* positions, uint32 positionStride,
+		std::vector<uint32>& remap,
+		MeshOptimizer::CacheStats* before, MeshOptimizer::CacheStats* after,
+		uint32 cacheSize)
+	{
+		MeshOptimizer::CacheStats inputStats = AnalyzeVertexCacheImpl(indices, indexCount,
+			vertexStart, vertexCount, cacheSize);
+
+		if(before != nullptr)
+			*before = inputStats;
+
+		std::vector<Index> inputIndices(indices, indices + indexCount);
+
+		OptimizeOverdrawImpl(indices, indexCount, vertexStart, vertexCount,
+			positions, positionStride, cacheSize, 1.05f);
+
+		// Keep the input order if it was better.
+		MeshOptimizer::CacheStats stats = AnalyzeVertexCacheImpl(indices, indexCount,
+			vertexStart, vertexCount, cacheSize);
+
+		if(stats.Acmr > inputStats.Acmr)
+			std::copy(inputIndices.begin(), inputIndices.end(), indices);
+
+		// Renumbering the vertices does not change the cache behavior.
+		OptimizeVertexFetchImpl(indices, indexCount, vertexStart, vertexCount, remap);
+
+		if(after != nullptr)
+			*after = stats.Acmr > inputStats.Acmr ? inputStats : stats;
+	}
+}
+
+MeshOptimizer::CacheStats MeshOptimizer::AnalyzeVertexCache(const uint32* indices, uint32 indexCount,
+	uint32 vertexStart, uint32 vertexCount, uint32 cacheSize)
+{
+	return AnalyzeVertexCacheImpl(indices, indexCount, vertexStart, vertexCount, cacheSize);
+}
+
+MeshOptimizer::CacheStats MeshOptimizer::AnalyzeVertexCache(const uint16* indices, uint32 indexCount,
+	uint32 vertexStart, uint32 vertexCount, uint32 cacheSize)
+{
+	return AnalyzeVertexCacheImpl(indices, indexCount, vertexStart, vertexCount, cacheSize);
+}
+
+void MeshOptimizer::OptimizeVertexCache(uint32* indices, uint32 indexCount,
+	uint32 vertexStart, uint32 vertexCount, uint32 cacheSize)
+{
+	OptimizeVertexCacheImpl(indices, indexCount, vertexStart, vertexCount, cacheSize);
+}
+
+void MeshOptimizer::OptimizeVertexCache(uint16* indices, uint32 indexCount,
+	uint32 vertexStart, uint32 vertexCount, uint32 cacheSize)
+{
+	OptimizeVertexCacheImpl(indices, indexCount, vertexStart, vertexCount, cacheSize);
+}
+
+void MeshOptimizer::OptimizeOverdraw(uint32* indices, uint32 indexCount,
+	uint32 vertexStart, uint32 vertexCount,
+	const XMFLOAT3* positions, uint32 positionStride,
+	uint32 cacheSize, float threshold)
+{
+	OptimizeOverdrawImpl(indices, indexCount, vertexStart, vertexCount,
+		positions, positionStride, cacheSize, threshold);
+}
+
+void MeshOptimizer::OptimizeOverdraw(uint16* indices, uint32 indexCount,
+	uint32 vertexStart, uint32 vertexCount,
+	const XMFLOAT3* positions, uint32 positionStride,
+	uint32 cacheSize, float threshold)
+{
+	OptimizeOverdrawImpl(indices, indexCount, vertexStart, vertexCount,
+		positions, positionStride, cacheSize, threshold);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(uint32* indices, uint32 indexCount,
+	uint32 vertexStart, uint32 vertexCount, std::vector<uint32>& remap)
+{
+	OptimizeVertexFetchImpl(indices, indexCount, vertexStart, vertexCount, remap);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(uint16* indices, uint32 indexCount,
+	uint32 vertexStart, uint32 vertexCount, std::vector<uint32>& remap)
+{
+	OptimizeVertexFetchImpl(indices, indexCount, vertexStart, vertexCount, remap);
+}
+
+void MeshOptimizer::OptimizeSubset(uint32* indices, uint32 indexCount,
+	uint32 vertexStart, uint32 vertexCount,
+	const XMFLOAT3* positions, uint32 positionStride,
+	std::vector<uint32>& remap, CacheStats* before, CacheStats* after, uint32 cacheSize)
+{
+	OptimizeSubsetImpl(indices, indexCount, vertexStart, vertexCount,
+		positions, positionStride, remap, before, after, cacheSize);
+}
+
+void MeshOptimizer::OptimizeSubset(uint16* indices, uint32 indexCount,
+	uint32 vertexStart, uint32 vertexCount,
+	const XMFLOAT3* positions, uint32 positionStride,
+	std::vector<uint32>& remap, CacheStats* before, CacheStats* after, uint32 cacheSize)
+{
+	OptimizeSubsetImpl(indices, indexCount, vertexStart, vertexCount,
+		positions, positionStride, remap, before, after, cacheSize);
+}
+
+void MeshOptimizer::OptimizeMesh(GeometryGenerator::MeshData& meshData,
+	CacheStats* before, CacheStats* after, uint32 cacheSize)
+{
+	if(meshData.Vertices.empty())
+		return;
+
+	std::vector<uint32> remap;
+	OptimizeSubset(meshData.Indices32.data(), (uint32)meshData.Indices32.size(),
+		0, (uint32)meshData.Vertices.size(),
+		&meshData.Vertices[0].Position, sizeof(GeometryGenerator::Vertex),
+		remap, before, after, cacheSize);
+
+	RemapVertices(meshData.Vertices, 0, remap);
+}
@@ -0,0 +1,721 @@
+//***************************************************************************************
+// MeshSimplifier.cpp
+//***************************************************************************************
+
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+#include <unordered_set>
+
+using namespace DirectX;
+
+namespace
+{
+	using uint32 = MeshSimplifier::uint32;
+	using uint64 = std::uint64_t;
+
+	const uint32 NoVertex = 0xffffffff;
+	const uint32 MixedSubsets = 0xfffffffe;
+
+	// How much more strongly an open border resists moving than a face does.
+	const double BorderWeight = 10.0;
+
+	// A collapse is rejected if it turns a triangle by more than about 75 degrees.
+	const float MinNormalDot = 0.25f;
+
+	enum class VertexKind
+	{
+		Manifold, // Free to collapse onto any neighbour.
+		Border,   // On an open border; only collapses along it.
+		Seam,     // One of two twins on an attribute seam; only collapses along it.
+		Locked    // Never moves.
+	};
+
+	// Sum of squared distances to a set of weighted planes.
+	struct Quadric
+	{
+		double A00 = 0.0, A01 = 0.0, A02 = 0.0, A11 = 0.0, A12 = 0.0, A22 = 0.0;
+		double B0 = 0.0, B1 = 0.0, B2 = 0.0;
+		double C = 0.0;
+		double W = 0.0;
+
+		void AddPlane(double nx, double ny, double nz, double d, double weight)
+		{
+			A00 += weight*nx*nx; A01 += weight*nx*ny; A02 += weight*nx*nz;
+			A11 += weight*ny*ny; A12 += weight*ny*nz; A22 += weight*nz*nz;
+			B0 += weight*nx*d; B1 += weight*ny*d; B2 += weight*nz*d;
+			C += weight*d*d;
+			W += weight;
+		}
+
+		void Add(const Quadric& q)
+		{
+			A00 += q.A00; A01 += q.A01; A02 += q.A02;
+			A11 += q.A11; A12 += q.A12; A22 += q.A22;
+			B0 += q.B0; B1 += q.B1; B2 += q.B2;
+			C += q.C;
+			W += q.W;
+		}
+
+		// Weighted mean of the squared distances of p to the planes.
+		double Error(const XMFLOAT3& p)const
+		{
+			double x = p.x, y = p.y, z = p.z;
+
+			double e =
+				A00*x*x + A11*y*y + A22*z*z +
+				2.0*(A01*x*y + A02*x*z + A12*y*z) +
+				2.0*(B0*x + B1*y + B2*z) + C;
+
+			return W > 0.0 ? std::max(e, 0.0) / W : 0.0;
+		}
+	};
+
+	struct Collapse
+	{
+		uint32 Source;
+		uint32 Target;
+		double Error;
+	};
+
+	uint64 EdgeKey(uint32 a, uint32 b)
+	{
+		return ((uint64)a << 32) | b;
+	}
+
+	class Simplifier
+	{
+	public:
+		Simplifier(const XMFLOAT3* positions, uint32 positionStride, uint32 vertexCount) :
+			mPositions(reinterpret_cast<const char*>(positions)),
+			mPositionStride(positionStride),
+			mVertexCount(vertexCount){}
+
+		float Run(const std::vector<uint32>& indices, const std::vector<MeshSimplifier::Subset>& subsets,
+			uint32 targetIndexCount, float targetError,
+			std::vector<uint32>& lodIndices, std::vector<MeshSimplifier::Subset>& lodSubsets);
+
+	private:
+		const XMFLOAT3& P(uint32 v)const
+		{
+			return *reinterpret_cast<const XMFLOAT3*>(mPositions + (size_t)v*mPositionStride);
+		}
+
+		void BuildPositionGroups();
+		void ClassifyVertices();
+		void BuildQuadrics();
+		void BuildAdjacency();
+
+		bool CanCollapse(uint32 v, uint32 t)const;
+		uint32 FindTwinTarget(uint32 w, uint32 t)const;
+		bool FlipsTriangle(uint32 v, uint32 t)const;
+		void UnlinkOpenEdge(uint32 v, uint32 t);
+
+	private:
+		const char* mPositions;
+		uint32 mPositionStride;
+		uint32 mVertexCount;
+
+		std::vector<uint32> mIndices;
+		std::vector<uint32> mTriSubsets;
+
+		// Vertices with the same position share a representative, which owns their
+		// quadric.  Referenced vertices at one position form a ring through mNextTwin.
+		std::vector<uint32> mPosRep;
+		std::vector<uint32> mNextTwin;
+		std::vector<uint32> mTwinCount;
+
+		std::vector<VertexKind> mKinds;
+
+		// Neighbours along the open edges of Border and Seam vertices.
+		std::vector<uint32> mOpenNext;
+		std::vector<uint32> mOpenPrev;
+
+		// Open edges that are also open in position space, as (a, b, triangle).
+		std::vector<uint32> mBorderEdges;
+
+		std::vector<Quadric> mQuadrics;
+
+		// Triangles around each vertex, rebuilt every pass.
+		std::vector<uint32> mAdjOffsets;
+		std::vector<uint32> mAdjTriangles;
+	};
+
+	void Simplifier::BuildPositionGroups()
+	{
+		std::vector<bool> referenced(mVertexCount, false);
+		for(uint32 v : mIndices)
+			referenced[v] = true;
+
+		std::vector<uint32> order;
+		order.reserve(mVertexCount);
+		for(uint32 v = 0; v < mVertexCount; ++v)
+		{
+			if(referenced[v])
+				order.push_back(v);
+		}
+
+		// Weld positions that differ only by rounding, such as the two sides of the
+		// texture seam of GeometryGenerator::CreateSphere, by comparing them on a
+		// grid a millionth of the mesh size apart.
+		XMVECTOR vMin = XMVectorReplicate(+FLT_MAX);
+		XMVECTOR vMax = XMVectorReplicate(-FLT_MAX);
+		for(uint32 v : order)
+		{
+			vMin = XMVectorMin(vMin, XMLoadFloat3(&P(v)));
+			vMax = XMVectorMax(vMax, XMLoadFloat3(&P(v)));
+		}
+
+		XMFLOAT3 size;
+		XMStoreFloat3(&size, vMax - vMin);
+		float cellSize = 1e-6f*std::max(size.x, std::max(size.y, size.z));
+		float invCellSize = cellSize > 0.0f ? 1.0f / cellSize : 0.0f;
+
+		std::vector<XMINT3> cells(mVertexCount);
+		for(uint32 v : order)
+		{
+			const XMFLOAT3& p = P(v);
+			cells[v] = XMINT3(
+				(int32_t)std::floor(p.x*invCellSize + 0.5f),
+				(int32_t)std::floor(p.y*invCellSize + 0.5f),
+				(int32_t)std::floor(p.z*invCellSize + 0.5f));
+		}
+
+		auto SameCell = [&cells](uint32 a, uint32 b)
+		{
+			return cells[a].x == cells[b].x && cells[a].y == cells[b].y && cells[a].z == cells[b].z;
+		};
+
+		std::sort(order.begin(), order.end(), [&cells](uint32 a, uint32 b)
+		{
+			if(cells[a].x != cells[b].x) return cells[a].x < cells[b].x;
+			if(cells[a].y != cells[b].y) return cells[a].y < cells[b].y;
+			if(cells[a].z != cells[b].z) return cells[a].z < cells[b].z;
+			return a < b;
+		});
+
+		mPosRep.assign(mVertexCount, NoVertex);
+		mNextTwin.assign(mVertexCount, NoVertex);
+		mTwinCount.assign(mVertexCount, 0);
+
+		for(size_t first = 0; first < order.size(); )
+		{
+			size_t last = first + 1;
+			while(last < order.size() && SameCell(order[first], order[last]))
+				++last;
+
+			uint32 rep = order[first];
+			for(size_t i = first; i < last; ++i)
+			{
+				mPosRep[order[i]] = rep;
+				mNextTwin[order[i]] = order[i + 1 < last ? i + 1 : first];
+			}
+
+			mTwinCount[rep] = (uint32)(last - first);
+			first = last;
+		}
+	}
+
+	void Simplifier::ClassifyVertices()
+	{
+		uint32 triCount = (uint32)mIndices.size() / 3;
+
+		// Directed edges, in index space and in position space.  An edge whose
+		// reverse is missing in index space is open: a border if it is also missing
+		// in position space, else an attribute seam.
+		std::unordered_set<uint64> edges;
+		std::unordered_set<uint64> posEdges;
+		edges.reserve(mIndices.size());
+		posEdges.reserve(mIndices.size());
+
+		for(uint32 i = 0; i < (uint32)mIndices.size(); ++i)
+		{
+			uint32 a = mIndices[i];
+			uint32 b = mIndices[i - i%3 + (i+1)%3];
+
+			edges.insert(EdgeKey(a, b));
+			posEdges.insert(EdgeKey(mPosRep[a], mPosRep[b]));
+		}
+
+		std::vector<uint32> openOut(mVertexCount, 0);
+		std::vector<uint32> openIn(mVertexCount, 0);
+		std::vector<uint32> borderEdges(mVertexCount, 0);
+
+		mOpenNext.assign(mVertexCount, NoVertex);
+		mOpenPrev.assign(mVertexCount, NoVertex);
+		mBorderEdges.clear();
+
+		for(uint32 i = 0; i < (uint32)mIndices.size(); ++i)
+		{
+			uint32 a = mIndices[i];
+			uint32 b = mIndices[i - i%3 + (i+1)%3];
+
+			if(a == b || edges.count(EdgeKey(b, a)) > 0)
+				continue;
+
+			++openOut[a];
+			++openIn[b];
+			mOpenNext[a] = b;
+			mOpenPrev[b] = a;
+
+			if(posEdges.count(EdgeKey(mPosRep[b], mPosRep[a])) == 0)
+			{
+				++borderEdges[a];
+				++borderEdges[b];
+
+				mBorderEdges.push_back(a);
+				mBorderEdges.push_back(b);
+				mBorderEdges.push_back(i / 3);
+			}
+		}
+
+		// Positions used by more than one subset never move.
+		std::vector<uint32> posSubset(mVertexCount, NoVertex);
+		for(uint32 t = 0; t < triCount; ++t)
+		{
+			for(uint32 k = 0; k < 3; ++k)
+			{
+				uint32 rep = mPosRep[mIndices[t*3+k]];
+				if(posSubset[rep] == NoVertex)
+					posSubset[rep] = mTriSubsets[t];
+				else if(posSubset[rep] != mTriSubsets[t])
+					posSubset[rep] = MixedSubsets;
+			}
+		}
+
+		mKinds.assign(mVertexCount, VertexKind::Locked);
+		for(uint32 v = 0; v < mVertexCount; ++v)
+		{
+			uint32 rep = mPosRep[v];
+			if(rep == NoVertex || posSubset[rep] == MixedSubsets)
+				continue;
+
+			uint32 twins = mTwinCount[rep];
+
+			if(openOut[v] == 0 && openIn[v] == 0)
+			{
+				if(twins == 1)
+					mKinds[v] = VertexKind::Manifold;
+			}
+			else if(openOut[v] == 1 && openIn[v] == 1)
+			{
+				if(twins == 1 && borderEdges[v] == 2)
+				{
+					mKinds[v] = VertexKind::Border;
+				}
+				else if(twins == 2 && borderEdges[v] == 0)
+				{
+					uint32 w = mNextTwin[v];
+					if(openOut[w] == 1 && openIn[w] == 1 && borderEdges[w] == 0)
+						mKinds[v] = VertexKind::Seam;
+				}
+			}
+		}
+	}
+
+	void Simplifier::BuildQuadrics()
+	{
+		mQuadrics.assign(mVertexCount, Quadric());
+
+		uint32 triCount = (uint32)mIndices.size() / 3;
+		for(uint32 t = 0; t < triCount; ++t)
+		{
+			uint32 i0 = mIndices[t*3+0];
+			uint32 i1 = mIndices[t*3+1];
+			uint32 i2 = mIndices[t*3+2];
+
+			XMVECTOR p0 = XMLoadFloat3(&P(i0));
+			XMVECTOR p1 = XMLoadFloat3(&P(i1));
+			XMVECTOR p2 = XMLoadFloat3(&P(i2));
+
+			XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+			float length = XMVectorGetX(XMVector3Length(n));
+			if(length <= 0.0f)
+				continue;
+
+			n /= length;
+
+			XMFLOAT3 nf;
+			XMStoreFloat3(&nf, n);
+			float d = -XMVectorGetX(XMVector3Dot(n, p0));
+
+			// Weight by area, so small triangles do not dominate.
+			double area = 0.5*length;
+			for(uint32 k = 0; k < 3; ++k)
+				mQuadrics[mPosRep[mIndices[t*3+k]]].AddPlane(nf.x, nf.y, nf.z, d, area);
+		}
+
+		// Open borders also get a plane through the edge, perpendicular to the
+		// triangle, so they resist moving inward.
+		for(size_t i = 0; i < mBorderEdges.size(); i += 3)
+		{
+			uint32 a = mBorderEdges[i+0];
+			uint32 b = mBorderEdges[i+1];
+			uint32 t = mBorderEdges[i+2];
+
+			XMVECTOR p0 = XMLoadFloat3(&P(mIndices[t*3+0]));
+			XMVECTOR p1 = XMLoadFloat3(&P(mIndices[t*3+1]));
+			XMVECTOR p2 = XMLoadFloat3(&P(mIndices[t*3+2]));
+			XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+
+			XMVECTOR pa = XMLoadFloat3(&P(a));
+			XMVECTOR edge = XMLoadFloat3(&P(b)) - pa;
+			float edgeLength = XMVectorGetX(XMVector3Length(edge));
+			if(edgeLength <= 0.0f || XMVector3Equal(n, XMVectorZero()))
+				continue;
+
+			XMVECTOR m = XMVector3Normalize(XMVector3Cross(edge, n));
+
+			XMFLOAT3 mf;
+			XMStoreFloat3(&mf, m);
+			float md = -XMVectorGetX(XMVector3Dot(m, pa));
+
+			double weight = BorderWeight*edgeLength*edgeLength;
+			mQuadrics[mPosRep[a]].AddPlane(mf.x, mf.y, mf.z, md, weight);
+			mQuadrics[mPosRep[b]].AddPlane(mf.x, mf.y, mf.z, md, weight);
+		}
+	}
+
+	void Simplifier::BuildAdjacency()
+	{
+		mAdjOffsets.assign(mVertexCount + 1, 0);
+		for(uint32 v : mIndices)
+			++mAdjOffsets[v + 1];
+
+		for(uint32 v = 0; v < mVertexCount; ++v)
+			mAdjOffsets[v+1] += mAdjOffsets[v];
+
+		std::vector<uint32> cursor(mAdjOffsets.begin(), mAdjOffsets.end() - 1);
+
+		mAdjTriangles.resize(mIndices.size());
+		for(uint32 i = 0; i < (uint32)mIndices.size(); ++i)
+			mAdjTriangles[cursor[mIndices[i]]++] = i / 3;
+	}
+
+	bool Simplifier::CanCollapse(uint32 v, uint32 t)const
+	{
+		switch(mKinds[v])
+		{
+		case VertexKind::Manifold:
+			return true;
+		case VertexKind::Border:
+		case VertexKind::Seam:
+			return t == mOpenNext[v] || t == mOpenPrev[v];
+		default:
+			return false;
+		}
+	}
+
+	// The vertex the seam twin w must collapse onto so the seam stays closed when its
+	// twin collapses onto t.
+	uint32 Simplifier::FindTwinTarget(uint32 w, uint32 t)const
+	{
+		if(mOpenNext[w] != NoVertex && mPosRep[mOpenNext[w]] == mPosRep[t])
+			return mOpenNext[w];
+
+		if(mOpenPrev[w] != NoVertex && mPosRep[mOpenPrev[w]] == mPosRep[t])
+			return mOpenPrev[w];
+
+		return NoVertex;
+	}
+
+	bool Simplifier::FlipsTriangle(uint32 v, uint32 t)const
+	{
+		XMVECTOR target = XMLoadFloat3(&P(t));
+
+		for(uint32 j = mAdjOffsets[v]; j < mAdjOffsets[v+1]; ++j)
+		{
+			uint32 tri = mAdjTriangles[j];
+
+			uint32 i0 = mIndices[tri*3+0];
+			uint32 i1 = mIndices[tri*3+1];
+			uint32 i2 = mIndices[tri*3+2];
+
+			// These triangles disappear.
+			if(i0 == t || i1 == t || i2 == t)
+				continue;
+
+			XMVECTOR p0 = XMLoadFloat3(&P(i0));
+			XMVECTOR p1 = XMLoadFloat3(&P(i1));
+			XMVECTOR p2 = XMLoadFloat3(&P(i2));
+
+			XMVECTOR nBefore = XMVector3Cross(p1 - p0, p2 - p0);
+
+			if(i0 == v) p0 = target;
+			if(i1 == v) p1 = target;
+			if(i2 == v) p2 = target;
+
+			XMVECTOR nAfter = XMVector3Cross(p1 - p0, p2 - p0);
+
+			float dot = XMVectorGetX(XMVector3Dot(nBefore, nAfter));
+			float lengths = XMVectorGetX(XMVector3Length(nBefore))*XMVectorGetX(XMVector3Length(nAfter));
+
+			if(dot < MinNormalDot*lengths || lengths <= 0.0f)
+				return true;
+		}
+
+		return false;
+	}
+
+	// v collapses onto t along an open edge: the open chain skips v.
+	void Simplifier::UnlinkOpenEdge(uint32 v, uint32 t)
+	{
+		if(t == mOpenNext[v])
+		{
+			uint32 prev = mOpenPrev[v];
+			if(prev != NoVertex)
+				mOpenNext[prev] = t;
+			mOpenPrev[t] = prev;
+		}
+		else
+		{
+			uint32 next = mOpenNext[v];
+			if(next != NoVertex)
+				mOpenPrev[next] = t;
+			mOpenNext[t] = next;
+		}
+	}
+
+	float Simplifier::Run(const std::vector<uint32>& indices, const std::vector<MeshSimplifier::Subset>& subsets,
+		uint32 targetIndexCount, float targetError,
+		std::vector<uint32>& lodIndices, std::vector<MeshSimplifier::Subset>& lodSubsets)
+	{
+		//
+		// Gather the triangles of the subsets in order.
+		//
+
+		mIndices.clear();
+		mTriSubsets.clear();
+		for(uint32 s = 0; s < (uint32)subsets.size(); ++s)
+		{
+			uint32 first = subsets[s].IndexStart;
+			uint32 count = subsets[s].IndexCount - subsets[s].IndexCount%3;
+
+			mIndices.insert(mIndices.end(), indices.begin() + first, indices.begin() + first + count);
+			mTriSubsets.insert(mTriSubsets.end(), count / 3, s);
+		}
+
+		BuildPositionGroups();
+		ClassifyVertices();
+		BuildQuadrics();
+
+		double errorLimit = (double)targetError*targetError;
+		double resultError = 0.0;
+
+		std::vector<Collapse> collapses;
+		std::vector<uint32> remap(mVertexCount);
+		std::vector<bool> locked(mVertexCount);
+
+		std::vector<uint32> newIndices;
+		std::vector<uint32> newTriSubsets;
+
+		while(mIndices.size() > targetIndexCount)
+		{
+			BuildAdjacency();
+
+			//
+			// The cheaper allowed direction of every edge.
+			//
+
+			collapses.clear();
+			for(uint32 i = 0; i < (uint32)mIndices.size(); ++i)
+			{
+				uint32 a = mIndices[i];
+				uint32 b = mIndices[i - i%3 + (i+1)%3];
+
+				Collapse c = { NoVertex, NoVertex, DBL_MAX };
+
+				if(CanCollapse(a, b))
+					c = { a, b, mQuadrics[mPosRep[a]].Error(P(b)) };
+
+				if(CanCollapse(b, a))
+				{
+					double error = mQuadrics[mPosRep[b]].Error(P(a));
+					if(error < c.Error)
+						c = { b, a, error };
+				}
+
+				if(c.Source != NoVertex)
+					collapses.push_back(c);
+			}
+
+			if(collapses.empty())
+				break;
+
+			std::sort(collapses.begin(), collapses.end(),
+				[](const Collapse& x, const Collapse& y) { return x.Error < y.Error; });
+
+			//
+			// Apply the cheapest ones.  A collapse locks the positions around its
+			// source for the rest of the pass, so every collapse in a pass sees the
+			// triangles as they were when the pass started.
+			//
+
+			std::iota(remap.begin(), remap.end(), 0);
+			std::fill(locked.begin(), locked.end(), false);
+
+			uint32 trianglesToRemove = (uint32)(mIndices.size() - targetIndexCount + 2) / 3;
+			uint32 trianglesRemoved = 0;
+			uint32 collapseCount = 0;
+
+			for(const Collapse& c : collapses)
+			{
+				if(c.Error > errorLimit || trianglesRemoved >= trianglesToRemove)
+					break;
+
+				uint32 v = c.Source;
+				uint32 t = c.Target;
+
+				if(locked[mPosRep[v]] || locked[mPosRep[t]])
+					continue;
+
+				uint32 w = NoVertex;
+				uint32 wt = NoVertex;
+				if(mKinds[v] == VertexKind::Seam)
+				{
+					w = mNextTwin[v];
+					wt = FindTwinTarget(w, t);
+					if(wt == NoVertex)
+						continue;
+				}
+
+				if(FlipsTriangle(v, t) || (w != NoVertex && FlipsTriangle(w, wt)))
+					continue;
+
+				uint32 sources[2] = { v, w };
+				uint32 targets[2] = { t, wt };
+				for(uint32 k = 0; k < 2 && sources[k] != NoVertex; ++k)
+				{
+					uint32 s = sources[k];
+					remap[s] = targets[k];
+
+					if(mKinds[s] != VertexKind::Manifold)
+						UnlinkOpenEdge(s, targets[k]);
+
+					for(uint32 j = mAdjOffsets[s]; j < mAdjOffsets[s+1]; ++j)
+					{
+						uint32 tri = mAdjTriangles[j];
+						bool removed = false;
+
+						for(uint32 m = 0; m < 3; ++m)
+						{
+							uint32 u = mIndices[tri*3+m];
+							locked[mPosRep[u]] = true;
+							removed = removed || u == targets[k];
+						}
+
+						if(removed)
+							++trianglesRemoved;
+					}
+				}
+
+				mQuadrics[mPosRep[t]].Add(mQuadrics[mPosRep[v]]);
+
+				resultError = std::max(resultError, c.Error);
+				++collapseCount;
+			}
+
+			if(collapseCount == 0)
+				break;
+
+			//
+			// Rewrite the triangles and drop the ones that collapsed.
+			//
+
+			newIndices.clear();
+			newTriSubsets.clear();
+
+			uint32 triCount = (uint32)mIndices.size() / 3;
+			for(uint32 tri = 0; tri < triCount; ++tri)
+			{
+				uint32 i0 = remap[mIndices[tri*3+0]];
+				uint32 i1 = remap[mIndices[tri*3+1]];
+				uint32 i2 = remap[mIndices[tri*3+2]];
+
+				if(i0 == i1 || i1 == i2 || i0 == i2)
+					continue;
+
+				newIndices.push_back(i0);
+				newIndices.push_back(i1);
+				newIndices.push_back(i2);
+				newTriSubsets.push_back(mTriSubsets[tri]);
+			}
+
+			mIndices.swap(newIndices);
+			mTriSubsets.swap(newTriSubsets);
+		}
+
+		lodIndices = mIndices;
+
+		lodSubsets.assign(subsets.size(), MeshSimplifier::Subset());
+		for(uint32 s : mTriSubsets)
+			lodSubsets[s].IndexCount += 3;
+
+		for(size_t s = 1; s < lodSubsets.size(); ++s)
+			lodSubsets[s].IndexStart = lodSubsets[s-1].IndexStart + lodSubsets[s-1].IndexCount;
+
+		return (float)std::sqrt(resultError);
+	}
+}
+
+float MeshSimplifier::Simplify(
+	const std::vector<uint32>& indices, const std::vector<Subset>& subsets,
+	const XMFLOAT3* positions, uint32 positionStride, uint32 vertexCount,
+	uint32 targetIndexCount, float targetError,
+	std::vector<uint32>& lodIndices, std::vector<Subset>& lodSubsets)
+{
+	Simplifier simplifier(positions, positionStride, vertexCount);
+	return simplifier.Run(indices, subsets, targetIndexCount, targetError, lodIndices, lodSubsets);
+}
+
+void MeshSimplifier::BuildLodChain(const GeometryGenerator::MeshData& meshData,
+	uint32 lodCount, float reduction, std::vector<Lod>& lods)
+{
+	lods.clear();
+	if(lodCount == 0 || meshData.Vertices.empty())
+		return;
+
+	Lod lod0;
+	lod0.Indices32 = meshData.Indices32;
+	lods.push_back(lod0);
+
+	std::vector<Subset> subsets(1);
+	subsets[0].IndexCount = (uint32)meshData.Indices32.size();
+
+	std::vector<Subset> lodSubsets;
+
+	// Simplify each level from the full mesh rather than from the level before, so
+	// the quadrics measure the error against the original surface.
+	float targetFraction = 1.0f;
+	for(uint32 i = 1; i < lodCount; ++i)
+	{
+		targetFraction *= reduction;
+		uint32 targetIndexCount = (uint32)(meshData.Indices32.size()*targetFraction) / 3 * 3;
+
+		Lod lod;
+		lod.Error = Simplify(meshData.Indices32, subsets,
+			&meshData.Vertices[0].Position, sizeof(GeometryGenerator::Vertex),
+			(uint32)meshData.Vertices.size(), targetIndexCount, FLT_MAX,
+			lod.Indices32, lodSubsets);
+
+		// Stop once the mesh cannot get any simpler.
+		if(lod.Indices32.size() >= lods.back().Indices32.size())
+			break;
+
+		lod.Error = std::max(lod.Error, lods.back().Error);
+		lods.push_back(std::move(lod));
+	}
+}
+
+MeshSimplifier::uint32 MeshSimplifier::SelectLod(const std::vector<Lod>& lods, float pixelsPerUnit, float maxPixelError)
+{
+	for(uint32 i = (uint32)lods.size(); i > 1; --i)
+	{
+		if(lods[i-1].Error*pixelsPerUnit <= maxPixelError)
+			return i - 1;
+	}
+
+	return 0;
+}
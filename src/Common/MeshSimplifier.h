@@ -0,0 +1,74 @@
+//***************************************************************************************
+// MeshSimplifier.h
+//
+// Generates levels of detail for an indexed triangle mesh by quadric error edge
+// collapse (Garland and Heckbert 1997).  Each collapse moves one vertex onto a
+// neighbouring vertex, so a level of detail is only a new index list over the
+// original vertex buffer; the vertices, and with them the normals and texture
+// coordinates, are never rewritten.
+//
+// Vertices that share a position but not their other attributes form a seam.  They
+// only collapse along the seam, together with their twin on the other side, so the
+// seam stays closed.  Open borders only collapse along the border, and vertices used
+// by more than one subset never move, so submeshes keep meeting where they did.
+//
+// The simplifier reads positions only and does not depend on Direct3D.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+#include "GeometryGenerator.h"
+
+class MeshSimplifier
+{
+public:
+
+    using uint32 = std::uint32_t;
+
+	// A range of triangles drawn together, such as one material of a model.
+	struct Subset
+	{
+		uint32 IndexStart = 0;
+		uint32 IndexCount = 0;
+	};
+
+	struct Lod
+	{
+		std::vector<uint32> Indices32;
+
+		// Distance in object space units the surface moved by, at most.  Zero for the
+		// full detail mesh.
+		float Error = 0.0f;
+	};
+
+	///<summary>
+	/// Collapses edges of the mesh until it has at most targetIndexCount indices or
+	/// the next collapse would move the surface by more than targetError.  Each
+	/// vertex position is read from positions + index*positionStride bytes.  The
+	/// result keeps the subsets in order; lodSubsets gives their new ranges.
+	/// Returns the error reached.
+	///</summary>
+	static float Simplify(
+		const std::vector<uint32>& indices, const std::vector<Subset>& subsets,
+		const DirectX::XMFLOAT3* positions, uint32 positionStride, uint32 vertexCount,
+		uint32 targetIndexCount, float targetError,
+		std::vector<uint32>& lodIndices, std::vector<Subset>& lodSubsets);
+
+	///<summary>
+	/// Builds lodCount levels of detail of a single subset mesh.  Level 0 is the mesh
+	/// itself, and each following level has about reduction times the triangles of
+	/// the one before.  All levels index meshData.Vertices.
+	///</summary>
+	static void BuildLodChain(const GeometryGenerator::MeshData& meshData,
+		uint32 lodCount, float reduction, std::vector<Lod>& lods);
+
+	///<summary>
+	/// Returns the coarsest level whose error covers at most maxPixelError pixels,
+	/// given the pixels per object space unit at the object (see
+	/// Camera::GetPixelsPerUnit, scaled by the object's world scale).
+	///</summary>
+	static uint32 SelectLod(const std::vector<Lod>& lods, float pixelsPerUnit, float maxPixelError = 1.0f);
+};
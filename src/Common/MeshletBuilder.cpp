@@ -0,0 +1,350 @@
+//***************************************************************************************
+// MeshletBuilder.cpp
+//***************************************************************************************
+
+#include "MeshletBuilder.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+const MeshletBuilder::uint32 MeshletBuilder::MaxVertices;
+const MeshletBuilder::uint32 MeshletBuilder::MaxTriangles;
+
+namespace
+{
+	using uint8 = MeshletBuilder::uint8;
+	using uint32 = MeshletBuilder::uint32;
+
+	// Local indices are stored in a byte.
+	const uint32 NotInMeshlet = 0xff;
+	const uint32 MaxLocalVertices = 255;
+
+	// Weight of the unused triangles around a candidate against its distance to the
+	// meshlet, relative to the meshlet's size.  Preferring triangles whose vertices
+	// have few unused triangles left finishes corners and strips instead of leaving
+	// them as fragments for small meshlets later.
+	const float LiveTriangleWeight = 0.1f;
+
+	struct Adjacency
+	{
+		// The triangles of vertex v are Triangles[Offsets[v]] to Triangles[Offsets[v+1]-1].
+		std::vector<uint32> Offsets;
+		std::vector<uint32> Triangles;
+	};
+
+	template<typename Index>
+	void BuildAdjacency(const Index* indices, uint32 indexCount,
+		uint32 vertexStart, uint32 vertexCount, Adjacency& adj)
+	{
+		adj.Offsets.assign(vertexCount + 1, 0);
+		for(uint32 i = 0; i < indexCount; ++i)
+			++adj.Offsets[indices[i] - vertexStart + 1];
+
+		for(uint32 v = 0; v < vertexCount; ++v)
+			adj.Offsets[v+1] += adj.Offsets[v];
+
+		std::vector<uint32> cursor(adj.Offsets.begin(), adj.Offsets.end() - 1);
+
+		adj.Triangles.resize(indexCount);
+		for(uint32 i = 0; i < indexCount; ++i)
+			adj.Triangles[cursor[indices[i] - vertexStart]++] = i / 3;
+	}
+
+	void ComputeBounds(const MeshletBuilder::MeshletData& meshlets, const MeshletBuilder::Meshlet& m,
+		const char* positions, uint32 positionStride, MeshletBuilder::MeshletBounds& bounds)
+	{
+		auto P = [&](uint32 v)
+		{
+			return XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(positions + (size_t)v*positionStride));
+		};
+
+		// Sphere around the center of the bounding box.
+		XMVECTOR vMin = XMVectorReplicate(+FLT_MAX);
+		XMVECTOR vMax = XMVectorReplicate(-FLT_MAX);
+		for(uint32 i = 0; i < m.VertexCount; ++i)
+		{
+			XMVECTOR p = P(meshlets.VertexIndices[m.VertexOffset + i]);
+			vMin = XMVectorMin(vMin, p);
+			vMax = XMVectorMax(vMax, p);
+		}
+
+		XMVECTOR center = 0.5f*(vMin + vMax);
+
+		float radiusSq = 0.0f;
+		for(uint32 i = 0; i < m.VertexCount; ++i)
+		{
+			XMVECTOR p = P(meshlets.VertexIndices[m.VertexOffset + i]);
+			radiusSq = std::max(radiusSq, XMVectorGetX(XMVector3LengthSq(p - center)));
+		}
+
+		XMStoreFloat3(&bounds.Center, center);
+		bounds.Radius = std::sqrt(radiusSq);
+
+		// Cone around the average of the triangle normals.
+		std::vector<XMVECTOR> normals;
+		normals.reserve(m.TriangleCount);
+
+		XMVECTOR axis = XMVectorZero();
+		for(uint32 t = m.TriangleOffset; t < m.TriangleOffset + m.TriangleCount; ++t)
+		{
+			XMVECTOR p0 = P(meshlets.VertexIndices[m.VertexOffset + meshlets.TriangleIndices[3*t + 0]]);
+			XMVECTOR p1 = P(meshlets.VertexIndices[m.VertexOffset + meshlets.TriangleIndices[3*t + 1]]);
+			XMVECTOR p2 = P(meshlets.VertexIndices[m.VertexOffset + meshlets.TriangleIndices[3*t + 2]]);
+
+			XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+
+			// Degenerate triangles are never drawn, so they do not widen the cone.
+			float length = XMVectorGetX(XMVector3Length(n));
+			if(length <= 0.0f)
+				continue;
+
+			n /= length;
+			normals.push_back(n);
+			axis += n;
+		}
+
+		bounds.ConeAxis = XMFLOAT3(0.0f, 0.0f, 1.0f);
+		bounds.ConeCutoff = 1.0f;
+
+		float axisLength = XMVectorGetX(XMVector3Length(axis));
+		if(normals.empty() || axisLength < 1e-6f)
+			return;
+
+		axis /= axisLength;
+
+		float minDot = 1.0f;
+		for(const XMVECTOR& n : normals)
+			minDot = std::min(minDot, XMVectorGetX(XMVector3Dot(axis, n)));
+
+		XMStoreFloat3(&bounds.ConeAxis, axis);
+
+		// Normals more than 90 degrees apart can never all face away.
+		if(minDot > 0.0f)
+			bounds.ConeCutoff = std::sqrt(1.0f - minDot*minDot);
+	}
+
+	template<typename Index>
+	void BuildImpl(const Index* indices, uint32 indexCount,
+		uint32 vertexStart, uint32 vertexCount,
+		const XMFLOAT3* positions, uint32 positionStride,
+		MeshletBuilder::MeshletData& meshlets,
+		uint32 maxVertices, uint32 maxTriangles)
+	{
+		meshlets.Meshlets.clear();
+		meshlets.Bounds.clear();
+		meshlets.VertexIndices.clear();
+		meshlets.TriangleIndices.clear();
+
+		maxVertices = std::min(std::max(maxVertices, 3u), MaxLocalVertices);
+		maxTriangles = std::max(maxTriangles, 1u);
+
+		const uint32 triangleCount = indexCount / 3;
+		if(triangleCount == 0)
+			return;
+
+		const char* positionBytes = reinterpret_cast<const char*>(positions);
+
+		Adjacency adj;
+		BuildAdjacency(indices, triangleCount*3, vertexStart, vertexCount, adj);
+
+		std::vector<XMFLOAT3> centroids(triangleCount);
+		for(uint32 t = 0; t < triangleCount; ++t)
+		{
+			XMVECTOR sum = XMVectorZero();
+			for(uint32 k = 0; k < 3; ++k)
+			{
+				sum += XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(
+					positionBytes + (size_t)indices[3*t + k]*positionStride));
+			}
+
+			XMStoreFloat3(&centroids[t], sum / 3.0f);
+		}
+
+		std::vector<bool> used(triangleCount, false);
+
+		// Unused triangles of each vertex.
+		std::vector<uint32> liveTriangles(vertexCount);
+		for(uint32 v = 0; v < vertexCount; ++v)
+			liveTriangles[v] = adj.Offsets[v+1] - adj.Offsets[v];
+
+		// Local index of each vertex in the meshlet being built.
+		std::vector<uint8> localIndex(vertexCount, (uint8)NotInMeshlet);
+
+		auto NewVertexCount = [&](uint32 t)
+		{
+			uint32 count = 0;
+			for(uint32 k = 0; k < 3; ++k)
+			{
+				uint32 v = indices[3*t + k] - vertexStart;
+
+				// A vertex repeated in a degenerate triangle is only new once.
+				bool repeated = (k > 0 && indices[3*t + k] == indices[3*t]) ||
+					(k > 1 && indices[3*t + k] == indices[3*t + 1]);
+
+				if(localIndex[v] == NotInMeshlet && !repeated)
+					++count;
+			}
+			return count;
+		};
+
+		uint32 nextSeed = 0;
+		for(;;)
+		{
+			// Seed each meshlet with the first triangle not yet used, which keeps an
+			// input ordered for the vertex cache roughly in order.
+			while(nextSeed < triangleCount && used[nextSeed])
+				++nextSeed;
+
+			if(nextSeed == triangleCount)
+				break;
+
+			MeshletBuilder::Meshlet m;
+			m.VertexOffset = (uint32)meshlets.VertexIndices.size();
+			m.TriangleOffset = (uint32)meshlets.TriangleIndices.size() / 3;
+
+			XMVECTOR centroidSum = XMVectorZero();
+
+			uint32 t = nextSeed;
+			while(t != triangleCount)
+			{
+				used[t] = true;
+				centroidSum += XMLoadFloat3(&centroids[t]);
+
+				for(uint32 k = 0; k < 3; ++k)
+				{
+					uint32 v = indices[3*t + k] - vertexStart;
+					--liveTriangles[v];
+
+					if(localIndex[v] == NotInMeshlet)
+					{
+						localIndex[v] = (uint8)m.VertexCount++;
+						meshlets.VertexIndices.push_back(indices[3*t + k]);
+					}
+
+					meshlets.TriangleIndices.push_back(localIndex[v]);
+				}
+
+				if(++m.TriangleCount == maxTriangles)
+					break;
+
+				// Grow into the unused triangle around the meshlet that adds the fewest
+				// vertices, and of those the one closest to the meshlet with the fewest
+				// unused triangles around it.
+				XMVECTOR center = centroidSum / (float)m.TriangleCount;
+
+				float radiusSq = 0.0f;
+				for(uint32 i = 0; i < m.VertexCount; ++i)
+				{
+					XMVECTOR p = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(
+						positionBytes + (size_t)meshlets.VertexIndices[m.VertexOffset + i]*positionStride));
+					radiusSq = std::max(radiusSq, XMVectorGetX(XMVector3LengthSq(p - center)));
+				}
+
+				float invRadiusSq = radiusSq > 0.0f ? 1.0f / radiusSq : 0.0f;
+
+				uint32 best = triangleCount;
+				uint32 bestNew = 4;
+				float bestScore = FLT_MAX;
+
+				for(uint32 i = 0; i < m.VertexCount; ++i)
+				{
+					uint32 v = meshlets.VertexIndices[m.VertexOffset + i] - vertexStart;
+					for(uint32 j = adj.Offsets[v]; j < adj.Offsets[v+1]; ++j)
+					{
+						uint32 candidate = adj.Triangles[j];
+						if(used[candidate])
+							continue;
+
+						uint32 newCount = NewVertexCount(candidate);
+						if(m.VertexCount + newCount > maxVertices || newCount > bestNew)
+							continue;
+
+						uint32 live = 0;
+						for(uint32 k = 0; k < 3; ++k)
+							live += liveTriangles[indices[3*candidate + k] - vertexStart];
+
+						float distSq = XMVectorGetX(XMVector3LengthSq(XMLoadFloat3(&centroids[candidate]) - center));
+						float score = distSq*invRadiusSq + LiveTriangleWeight*live;
+
+						if(newCount < bestNew || score < bestScore)
+						{
+							best = candidate;
+							bestNew = newCount;
+							bestScore = score;
+						}
+					}
+				}
+
+				t = best;
+			}
+
+			for(uint32 i = 0; i < m.VertexCount; ++i)
+				localIndex[meshlets.VertexIndices[m.VertexOffset + i] - vertexStart] = (uint8)NotInMeshlet;
+
+			MeshletBuilder::MeshletBounds bounds;
+			ComputeBounds(meshlets, m, positionBytes, positionStride, bounds);
+
+			meshlets.Meshlets.push_back(m);
+			meshlets.Bounds.push_back(bounds);
+		}
+	}
+}
+
+void MeshletBuilder::Build(const uint32* indices, uint32 indexCount,
+	uint32 vertexStart, uint32 vertexCount,
+	const XMFLOAT3* positions, uint32 positionStride,
+	MeshletData& meshlets, uint32 maxVertices, uint32 maxTriangles)
+{
+	BuildImpl(indices, indexCount, vertexStart, vertexCount, positions, positionStride,
+		meshlets, maxVertices, maxTriangles);
+}
+
+void MeshletBuilder::Build(const uint16* indices, uint32 indexCount,
+	uint32 vertexStart, uint32 vertexCount,
+	const XMFLOAT3* positions, uint32 positionStride,
+	MeshletData& meshlets, uint32 maxVertices, uint32 maxTriangles)
+{
+	BuildImpl(indices, indexCount, vertexStart, vertexCount, positions, positionStride,
+		meshlets, maxVertices, maxTriangles);
+}
+
+void MeshletBuilder::Build(const GeometryGenerator::MeshData& meshData, MeshletData& meshlets,
+	uint32 maxVertices, uint32 maxTriangles)
+{
+	if(meshData.Vertices.empty())
+	{
+		meshlets = MeshletData();
+		return;
+	}
+
+	BuildImpl(meshData.Indices32.data(), (uint32)meshData.Indices32.size(),
+		0, (uint32)meshData.Vertices.size(),
+		&meshData.Vertices[0].Position, sizeof(GeometryGenerator::Vertex),
+		meshlets, maxVertices, maxTriangles);
+}
+
+void MeshletBuilder::Cull(const MeshletData& meshlets, const BoundingFrustum& frustum,
+	FXMVECTOR eyePos, std::vector<uint32>& visible)
+{
+	for(uint32 i = 0; i < (uint32)meshlets.Meshlets.size(); ++i)
+	{
+		const MeshletBounds& b = meshlets.Bounds[i];
+
+		// The meshlet faces away if the direction from the eye to every point of the
+		// sphere is within 90 degrees less the cone angle of the axis.  Widening the
+		// cutoff by the radius at both ends of the sphere keeps the test conservative.
+		XMVECTOR toCenter = XMLoadFloat3(&b.Center) - eyePos;
+		float dist = XMVectorGetX(XMVector3Length(toCenter));
+		float axisDist = XMVectorGetX(XMVector3Dot(toCenter, XMLoadFloat3(&b.ConeAxis)));
+
+		if(b.ConeCutoff < 1.0f && axisDist >= b.ConeCutoff*(dist + b.Radius) + b.Radius)
+			continue;
+
+		if(frustum.Contains(BoundingSphere(b.Center, b.Radius)) == DISJOINT)
+			continue;
+
+		visible.push_back(i);
+	}
+}
@@ -0,0 +1,121 @@
+//***************************************************************************************
+// MeshletBuilder.h
+//
+// Splits an indexed triangle list into meshlets: small clusters of at most 64 vertices
+// and 126 triangles, the sizes mesh shader hardware favours.  Each meshlet lists the
+// vertices it uses, as indices into the vertex buffer, and its triangles as three
+// local indices into that list.
+//
+// A meshlet grows from a seed triangle by adding the neighbouring triangle that needs
+// the fewest new vertices, ties going to the one closest to the meshlet, so meshlets
+// come out compact.  It ends when it is full or has no unused neighbour left; it
+// never jumps across a hard edge, where the normal cone would open up.  Each gets a
+// bounding sphere and a cone bounding its triangle normals, with which Cull rejects
+// meshlets outside the frustum or facing away from the eye before any vertex is
+// transformed.
+//
+// Without mesh shaders, BuildIndexList writes the triangles in meshlet order so that
+// the visible meshlets can be drawn as ranges of an ordinary index buffer.
+//
+// The code only depends on the standard library and DirectXMath, so meshlets can be
+// built and culled offline on any platform.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include "GeometryGenerator.h"
+
+class MeshletBuilder
+{
+public:
+
+    using uint8 = std::uint8_t;
+    using uint16 = std::uint16_t;
+    using uint32 = std::uint32_t;
+
+	static const uint32 MaxVertices = 64;
+	static const uint32 MaxTriangles = 126;
+
+	struct Meshlet
+	{
+		// Range of MeshletData::VertexIndices.
+		uint32 VertexOffset = 0;
+		uint32 VertexCount = 0;
+
+		// Range of triangles; triangle i is MeshletData::TriangleIndices[3*i] to [3*i+2].
+		uint32 TriangleOffset = 0;
+		uint32 TriangleCount = 0;
+	};
+
+	struct MeshletBounds
+	{
+		DirectX::XMFLOAT3 Center = { 0.0f, 0.0f, 0.0f };
+		float Radius = 0.0f;
+
+		// Every triangle normal is within the cone around ConeAxis whose half angle
+		// has sine ConeCutoff.  A cutoff of 1 means the normals are too spread for the
+		// meshlet to ever face away as a whole.
+		DirectX::XMFLOAT3 ConeAxis = { 0.0f, 0.0f, 1.0f };
+		float ConeCutoff = 1.0f;
+	};
+
+	struct MeshletData
+	{
+		std::vector<Meshlet> Meshlets;
+		std::vector<MeshletBounds> Bounds;
+
+		// Vertex buffer indices used by the meshlets.
+		std::vector<uint32> VertexIndices;
+
+		// Three indices into the meshlet's vertices per triangle.
+		std::vector<uint8> TriangleIndices;
+	};
+
+	///<summary>
+	/// Builds the meshlets of one index range, such as an M3D subset, replacing the
+	/// contents of meshlets.  The vertex indices are absolute and must stay within
+	/// [vertexStart, vertexStart+vertexCount).  Each vertex position is read from
+	/// positions + index*positionStride bytes.  Triangles keep their winding.
+	///</summary>
+	static void Build(const uint32* indices, uint32 indexCount,
+		uint32 vertexStart, uint32 vertexCount,
+		const DirectX::XMFLOAT3* positions, uint32 positionStride,
+		MeshletData& meshlets,
+		uint32 maxVertices = MaxVertices, uint32 maxTriangles = MaxTriangles);
+	static void Build(const uint16* indices, uint32 indexCount,
+		uint32 vertexStart, uint32 vertexCount,
+		const DirectX::XMFLOAT3* positions, uint32 positionStride,
+		MeshletData& meshlets,
+		uint32 maxVertices = MaxVertices, uint32 maxTriangles = MaxTriangles);
+
+	static void Build(const GeometryGenerator::MeshData& meshData, MeshletData& meshlets,
+		uint32 maxVertices = MaxVertices, uint32 maxTriangles = MaxTriangles);
+
+	///<summary>
+	/// Appends the indices of the visible meshlets to visible.  frustum and eyePos
+	/// are in the space of the vertex positions.  The normal cones assume that space
+	/// is reached without non-uniform scaling.
+	///</summary>
+	static void Cull(const MeshletData& meshlets, const DirectX::BoundingFrustum& frustum,
+		DirectX::FXMVECTOR eyePos, std::vector<uint32>& visible);
+
+	///<summary>
+	/// Writes the triangles of all the meshlets, in order, as an index list with
+	/// absolute vertex indices.  Meshlet m starts at index 3*Meshlets[m].TriangleOffset.
+	///</summary>
+	template<typename Index>
+	static void BuildIndexList(const MeshletData& meshlets, std::vector<Index>& indices)
+	{
+		indices.resize(meshlets.TriangleIndices.size());
+
+		for(const Meshlet& m : meshlets.Meshlets)
+		{
+			for(uint32 i = 3*m.TriangleOffset; i < 3*(m.TriangleOffset + m.TriangleCount); ++i)
+				indices[i] = (Index)meshlets.VertexIndices[m.VertexOffset + meshlets.TriangleIndices[i]];
+		}
+	}
+};
@@ -0,0 +1,326 @@
+//***************************************************************************************
+// MipGenerator.cpp
+//***************************************************************************************
+
+#include "MipGenerator.h"
+#include <algorithm>
+#include <cmath>
+#include <ppl.h>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+	using uint8 = MipGenerator::uint8;
+	using uint32 = MipGenerator::uint32;
+
+	const float KaiserRadius = 3.0f;
+	const float KaiserAlpha = 4.0f;
+	const float Pi = 3.14159265f;
+
+	// The source pixels, and their weights, that make up each destination pixel
+	// along one axis.  Pixel i uses entries First[i] to First[i + 1] - 1.
+	struct Resampler
+	{
+		vector<uint32> First;
+		vector<uint32> Index;
+		vector<float> Weight;
+	};
+
+	// A level being filtered: linear RGBA, with normals in [-1, 1].
+	struct Level
+	{
+		uint32 Width = 0;
+		uint32 Height = 0;
+		vector<float> Pixels;
+	};
+
+	float BesselI0(float x)
+	{
+		// The power series converges quickly for the arguments the window uses.
+		float sum = 1.0f;
+		float term = 1.0f;
+		for(int k = 1; k < 20; ++k)
+		{
+			term *= (x*x) / (4.0f*k*k);
+			sum += term;
+		}
+		return sum;
+	}
+
+	float KaiserSinc(float t)
+	{
+		t = fabs(t);
+		if(t >= KaiserRadius)
+			return 0.0f;
+
+		float sinc = t < 1e-6f ? 1.0f : sin(Pi*t) / (Pi*t);
+		float r = t / KaiserRadius;
+		return sinc*BesselI0(KaiserAlpha*sqrt(1.0f - r*r)) / BesselI0(KaiserAlpha);
+	}
+
+	Resampler MakeResampler(uint32 srcSize, uint32 dstSize, MipGenerator::Filter filter, bool wrap)
+	{
+		Resampler resampler;
+		resampler.First.reserve(dstSize + 1);
+
+		// Filters are defined in destination pixels and stretched over the source.
+		const float scale = float(srcSize) / float(dstSize);
+		const float radius = (filter == MipGenerator::Filter::Box ? 0.5f : KaiserRadius)*scale;
+
+		for(uint32 i = 0; i < dstSize; ++i)
+		{
+			resampler.First.push_back(uint32(resampler.Index.size()));
+
+			const float center = (i + 0.5f)*scale;
+			const int first = int(floor(center - radius));
+			const int last = int(ceil(center + radius));
+
+			float sum = 0.0f;
+			for(int s = first; s < last; ++s)
+			{
+				float weight;
+				if(filter == MipGenerator::Filter::Box)
+					weight = min(float(s + 1), center + radius) - max(float(s), center - radius);
+				else
+					weight = KaiserSinc((s + 0.5f - center) / scale);
+
+				if(weight == 0.0f)
+					continue;
+
+				int index = wrap ? ((s % int(srcSize)) + int(srcSize)) % int(srcSize) : min(max(s, 0), int(srcSize) - 1);
+				resampler.Index.push_back(uint32(index));
+				resampler.Weight.push_back(weight);
+				sum += weight;
+			}
+
+			for(size_t k = resampler.First.back(); k < resampler.Weight.size(); ++k)
+				resampler.Weight[k] /= sum;
+		}
+
+		resampler.First.push_back(uint32(resampler.Index.size()));
+		return resampler;
+	}
+
+	float SRGBToLinear(float c)
+	{
+		return c <= 0.04045f ? c / 12.92f : pow((c + 0.055f) / 1.055f, 2.4f);
+	}
+
+	// Decodes and encodes 8-bit values.  Encoding looks up the linear values halfway
+	// between neighbouring sRGB codes, so every value rounds to the nearest code.
+	struct Codec
+	{
+		float ToLinear[256];
+		float Midpoints[255];
+
+		explicit Codec(bool srgb)
+		{
+			for(int i = 0; i < 256; ++i)
+				ToLinear[i] = srgb ? SRGBToLinear(i / 255.0f) : i / 255.0f;
+			for(int i = 0; i < 255; ++i)
+				Midpoints[i] = srgb ? SRGBToLinear((i + 0.5f) / 255.0f) : (i + 0.5f) / 255.0f;
+		}
+
+		uint8 Encode(float linear)const
+		{
+			return uint8(upper_bound(Midpoints, Midpoints + 255, linear) - Midpoints);
+		}
+	};
+
+	uint8 EncodeUnorm(float c)
+	{
+		return uint8(min(max(c, 0.0f), 1.0f)*255.0f + 0.5f);
+	}
+
+	Level Decode(const MipGenerator::Options& options, const Codec& codec, uint32 width, uint32 height, const uint8* pixels)
+	{
+		Level level;
+		level.Width = width;
+		level.Height = height;
+		level.Pixels.resize(size_t(width)*height*4);
+
+		concurrency::parallel_for(uint32(0), height, [&](uint32 y)
+		{
+			const size_t end = size_t(y + 1)*width*4;
+			for(size_t i = size_t(y)*width*4; i < end; i += 4)
+			{
+				for(int c = 0; c < 3; ++c)
+				{
+					level.Pixels[i + c] = options.NormalMap ? pixels[i + c]*(2.0f / 255.0f) - 1.0f :
+						codec.ToLinear[pixels[i + c]];
+				}
+				level.Pixels[i + 3] = pixels[i + 3] / 255.0f;
+			}
+		});
+
+		return level;
+	}
+
+	Level Downsample(const MipGenerator::Options& options, const Level& src, uint32 width, uint32 height)
+	{
+		const Resampler horizontal = MakeResampler(src.Width, width, options.Kernel, options.Wrap);
+		const Resampler vertical = MakeResampler(src.Height, height, options.Kernel, options.Wrap);
+
+		// Rows first, into a level that is already narrow, then columns.
+		vector<float> rows(size_t(width)*src.Height*4);
+		concurrency::parallel_for(uint32(0), src.Height, [&](uint32 y)
+		{
+			const float* in = src.Pixels.data() + size_t(y)*src.Width*4;
+			float* out = rows.data() + size_t(y)*width*4;
+			for(uint32 x = 0; x < width; ++x, out += 4)
+			{
+				float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+				for(uint32 k = horizontal.First[x]; k < horizontal.First[x + 1]; ++k)
+				{
+					const float* p = in + size_t(horizontal.Index[k])*4;
+					const float w = horizontal.Weight[k];
+					for(int c = 0; c < 4; ++c)
+						sum[c] += w*p[c];
+				}
+				for(int c = 0; c < 4; ++c)
+					out[c] = sum[c];
+			}
+		});
+
+		const float low = options.NormalMap ? -1.0f : 0.0f;
+
+		Level dst;
+		dst.Width = width;
+		dst.Height = height;
+		dst.Pixels.resize(size_t(width)*height*4);
+		concurrency::parallel_for(uint32(0), height, [&](uint32 y)
+		{
+			float* out = dst.Pixels.data() + size_t(y)*width*4;
+			const size_t count = size_t(width)*4;
+
+			// Whole rows at a time, which the compiler vectorizes.
+			for(uint32 k = vertical.First[y]; k < vertical.First[y + 1]; ++k)
+			{
+				const float* in = rows.data() + size_t(vertical.Index[k])*count;
+				const float w = vertical.Weight[k];
+				for(size_t i = 0; i < count; ++i)
+					out[i] += w*in[i];
+			}
+
+			// The Kaiser filter's negative lobes can overshoot.
+			for(size_t i = 0; i < count; i += 4)
+			{
+				for(int c = 0; c < 3; ++c)
+					out[i + c] = min(max(out[i + c], low), 1.0f);
+				out[i + 3] = min(max(out[i + 3], 0.0f), 1.0f);
+
+				if(options.NormalMap)
+				{
+					float length = sqrt(out[i]*out[i] + out[i + 1]*out[i + 1] + out[i + 2]*out[i + 2]);
+					if(length > 1e-6f)
+					{
+						out[i] /= length;
+						out[i + 1] /= length;
+						out[i + 2] /= length;
+					}
+					else
+					{
+						// Opposite normals cancelled out; fall back to facing outwards.
+						out[i] = 0.0f;
+						out[i + 1] = 0.0f;
+						out[i + 2] = 1.0f;
+					}
+				}
+			}
+		});
+
+		return dst;
+	}
+
+	float AlphaCoverage(const Level& level, float reference, float scale)
+	{
+		size_t passed = 0;
+		for(size_t i = 3; i < level.Pixels.size(); i += 4)
+		{
+			if(level.Pixels[i]*scale >= reference)
+				++passed;
+		}
+		return float(passed) / float(level.Pixels.size() / 4);
+	}
+
+	// The alpha scale that brings level's coverage closest to target.  Coverage
+	// only grows with the scale, so a bisection finds it.
+	float AlphaScale(const Level& level, float reference, float target)
+	{
+		float low = 0.0f;
+		float high = 64.0f;
+		float best = 1.0f;
+		float bestError = fabs(AlphaCoverage(level, reference, 1.0f) - target);
+
+		for(int i = 0; i < 16; ++i)
+		{
+			float scale = 0.5f*(low + high);
+			float coverage = AlphaCoverage(level, reference, scale);
+			float error = fabs(coverage - target);
+			if(error < bestError)
+			{
+				best = scale;
+				bestError = error;
+			}
+
+			if(coverage < target)
+				low = scale;
+			else
+				high = scale;
+		}
+
+		return best;
+	}
+
+	void Encode(const MipGenerator::Options& options, const Codec& codec, const Level& level, float alphaScale, uint8* pixels)
+	{
+		concurrency::parallel_for(uint32(0), level.Height, [&](uint32 y)
+		{
+			const size_t end = size_t(y + 1)*level.Width*4;
+			for(size_t i = size_t(y)*level.Width*4; i < end; i += 4)
+			{
+				for(int c = 0; c < 3; ++c)
+				{
+					pixels[i + c] = options.NormalMap ? EncodeUnorm(level.Pixels[i + c]*0.5f + 0.5f) :
+						codec.Encode(level.Pixels[i + c]);
+				}
+				pixels[i + 3] = EncodeUnorm(level.Pixels[i + 3]*alphaScale);
+			}
+		});
+	}
+}
+
+MipGenerator::uint32 MipGenerator::MipCount(uint32 width, uint32 height)
+{
+	uint32 count = 1;
+	while(width > 1 || height > 1)
+	{
+		width = max(width / 2, 1u);
+		height = max(height / 2, 1u);
+		++count;
+	}
+	return count;
+}
+
+void MipGenerator::Generate(const Options& options, uint32 width, uint32 height, uint32 mipCount, uint8* const* levels)
+{
+	if(mipCount < 2)
+		return;
+
+	const Codec codec(options.SRGB && !options.NormalMap);
+	Level level = Decode(options, codec, width, height, levels[0]);
+
+	const bool keepCoverage = options.AlphaReference > 0.0f && !options.NormalMap;
+	const float coverage = keepCoverage ? AlphaCoverage(level, options.AlphaReference, 1.0f) : 0.0f;
+
+	for(uint32 mip = 1; mip < mipCount; ++mip)
+	{
+		level = Downsample(options, level, max(width >> mip, 1u), max(height >> mip, 1u));
+
+		// Scale only what is written: the next level filters the unscaled alpha.
+		float alphaScale = keepCoverage ? AlphaScale(level, options.AlphaReference, coverage) : 1.0f;
+		Encode(options, codec, level, alphaScale, levels[mip]);
+	}
+}
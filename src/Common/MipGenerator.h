@@ -0,0 +1,64 @@
+//***************************************************************************************
+// MipGenerator.h
+//
+// Builds mip chains for 8-bit RGBA images on the CPU, for textures shipped without
+// one and for tools that rebuild them.  Each level is filtered from the one above it
+// in 32-bit float, so rounding never compounds down the chain, with a box or a
+// Kaiser-windowed sinc filter that also handles odd sizes.
+//
+// Three options make the result match how the texture is used:
+//   - sRGB textures are filtered in linear light, so mips do not darken.
+//   - Normal maps are filtered as vectors and renormalized at every level.
+//   - Alpha tested textures keep the fraction of pixels passing the alpha test,
+//     so foliage and fences do not thin out in the distance.
+//
+// Each pass is spread across rows with PPL.  The code only depends on the standard
+// library and PPL.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+
+class MipGenerator
+{
+public:
+
+    using uint8 = std::uint8_t;
+    using uint32 = std::uint32_t;
+
+	enum class Filter
+	{
+		Box,    // Averages the source pixels each destination pixel covers.
+		Kaiser  // Sharper: a sinc over three destination pixels each side.
+	};
+
+	struct Options
+	{
+		Filter Kernel = Filter::Box;
+
+		// RGB is sRGB encoded.  Alpha is always linear.
+		bool SRGB = false;
+
+		// RGB stores a unit vector as 0.5*n + 0.5.
+		bool NormalMap = false;
+
+		// Filter across opposite edges, for textures that tile.
+		bool Wrap = false;
+
+		// When above zero, each level's alpha is scaled so the share of pixels with
+		// alpha at or above this value matches level 0's.  Use the shader's clip
+		// threshold: the demos clip at 0.1.
+		float AlphaReference = 0.0f;
+	};
+
+	// Levels in a full chain down to 1x1.
+	static uint32 MipCount(uint32 width, uint32 height);
+
+	///<summary>
+	/// Fills levels 1 to mipCount-1 from level 0.  levels[i] points at level i, an
+	/// RGBA image of max(1, width >> i) by max(1, height >> i) pixels with rows
+	/// packed tightly, as D3D12 lays out R8G8B8A8 subresources in a DDS file.
+	///</summary>
+	static void Generate(const Options& options, uint32 width, uint32 height, uint32 mipCount, uint8* const* levels);
+};
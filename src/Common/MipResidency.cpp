@@ -0,0 +1,242 @@
+//***************************************************************************************
+// MipResidency.cpp
+//***************************************************************************************
+
+#include "MipResidency.h"
+#include <algorithm>
+#include <cassert>
+
+using uint32 = MipResidency::uint32;
+using uint64 = MipResidency::uint64;
+
+MipResidency::MipResidency(const Settings& settings) :
+	mSettings(settings)
+{
+	mSettings.MaxPendingChanges = std::max(mSettings.MaxPendingChanges, 1u);
+}
+
+uint32 MipResidency::AddTexture(const DDSParser::TextureDesc& desc, uint32 firstMip)
+{
+	assert(desc.MipLevels > 0);
+
+	TextureState t;
+	t.Width = desc.Width;
+	t.Height = desc.Height;
+
+	const bool blockCompressed = DDSParser::IsBlockCompressed(desc.Format);
+	for(uint32 mip = 0; mip < desc.MipLevels; ++mip)
+	{
+		DDSParser::Subresource sub = DDSParser::GetSubresource(desc, mip, 0);
+		t.MipBytes.push_back(sub.SlicePitch*sub.Depth*desc.ArraySize);
+
+		if(mip == 0 || !blockCompressed || (sub.Width % 4 == 0 && sub.Height % 4 == 0))
+			t.ValidFirstMips |= 1u << mip;
+	}
+
+	firstMip = std::min(firstMip, desc.MipLevels - 1);
+	t.ValidFirstMips |= 1u << firstMip;
+	t.TailMip = firstMip;
+	t.FirstMip = firstMip;
+	t.DesiredMip = firstMip;
+
+	mCommittedBytes += BytesFrom(t, firstMip);
+	mTextures.push_back(std::move(t));
+	return (uint32)mTextures.size() - 1;
+}
+
+void MipResidency::ReportUsage(uint32 texture, float uvPerPixel)
+{
+	TextureState& t = mTextures[texture];
+	if(t.UvPerPixel <= 0.0f || uvPerPixel < t.UvPerPixel)
+		t.UvPerPixel = std::max(uvPerPixel, 1e-12f);
+}
+
+uint64 MipResidency::BytesFrom(const TextureState& t, uint32 firstMip)const
+{
+	uint64 bytes = 0;
+	for(uint32 mip = firstMip; mip < (uint32)t.MipBytes.size(); ++mip)
+		bytes += t.MipBytes[mip];
+	return bytes;
+}
+
+uint32 MipResidency::FinestValidMip(const TextureState& t, uint32 mip)const
+{
+	while(mip > 0 && (t.ValidFirstMips & (1u << mip)) == 0)
+		--mip;
+	return mip;
+}
+
+uint32 MipResidency::DesiredMipOf(const TextureState& t)const
+{
+	// One texel per pixel at mip m when uvPerPixel*size/2^m is 1.
+	float texelsPerPixel = t.UvPerPixel*(float)std::max(t.Width, t.Height);
+	float lod = std::log2(texelsPerPixel) + mSettings.LodBias;
+
+	uint32 mip = lod > 0.0f ? (uint32)std::min(lod, 31.0f) : 0;
+	return FinestValidMip(t, std::min(mip, t.TailMip));
+}
+
+void MipResidency::Issue(uint32 texture, uint32 firstMip)
+{
+	TextureState& t = mTextures[texture];
+	assert(!t.Pending && firstMip != t.FirstMip);
+
+	Change change;
+	change.Texture = texture;
+	change.FirstMip = firstMip;
+	change.MaxSize = std::max(std::max(t.Width >> firstMip, t.Height >> firstMip), 1u);
+	change.IsLoad = firstMip < t.FirstMip;
+	mChanges.push_back(change);
+
+	mCommittedBytes = mCommittedBytes - BytesFrom(t, t.FirstMip) + BytesFrom(t, firstMip);
+	t.FirstMip = firstMip;
+	t.Pending = true;
+	++mPendingCount;
+}
+
+void MipResidency::Update()
+{
+	++mUpdateCount;
+	mChanges.clear();
+
+	for(auto& t : mTextures)
+	{
+		if(t.UvPerPixel > 0.0f)
+		{
+			t.DesiredMip = DesiredMipOf(t);
+			t.LastUsedUpdate = mUpdateCount;
+			t.UvPerPixel = 0.0f;
+		}
+	}
+
+	auto isIdle = [this](const TextureState& t)
+	{
+		return !t.Pending && t.ReadyUpdate <= mUpdateCount;
+	};
+
+	// Textures drawn this update that need finer mips, the largest shortfall first.
+	std::vector<uint32> loads;
+	for(uint32 i = 0; i < (uint32)mTextures.size(); ++i)
+	{
+		const TextureState& t = mTextures[i];
+		if(isIdle(t) && t.LastUsedUpdate == mUpdateCount && t.DesiredMip < t.FirstMip)
+			loads.push_back(i);
+	}
+
+	std::stable_sort(loads.begin(), loads.end(), [this](uint32 a, uint32 b)
+	{
+		const TextureState& ta = mTextures[a];
+		const TextureState& tb = mTextures[b];
+		return ta.FirstMip - ta.DesiredMip > tb.FirstMip - tb.DesiredMip;
+	});
+
+	for(uint32 texture : loads)
+	{
+		if(mPendingCount >= mSettings.MaxPendingChanges)
+			break;
+
+		// Mips that can go without hurting what is on screen: everything above the
+		// tail of textures not drawn this update, longest unused first, then what
+		// drawn textures hold beyond their need.
+		struct Victim
+		{
+			uint32 Texture;
+			uint32 FirstMip;
+			uint64 Bytes;
+		};
+
+		std::vector<Victim> victims;
+		for(uint32 i = 0; i < (uint32)mTextures.size(); ++i)
+		{
+			const TextureState& t = mTextures[i];
+			if(i == texture || !isIdle(t))
+				continue;
+
+			uint32 floorMip = t.LastUsedUpdate == mUpdateCount ? t.DesiredMip : t.TailMip;
+			if(t.FirstMip < floorMip)
+				victims.push_back({ i, floorMip, BytesFrom(t, t.FirstMip) - BytesFrom(t, floorMip) });
+		}
+
+		std::stable_sort(victims.begin(), victims.end(), [this](const Victim& a, const Victim& b)
+		{
+			uint64 usedA = mTextures[a.Texture].LastUsedUpdate;
+			uint64 usedB = mTextures[b.Texture].LastUsedUpdate;
+			return usedA != usedB ? usedA < usedB : a.Bytes > b.Bytes;
+		});
+
+		uint64 evictable = 0;
+		for(const Victim& v : victims)
+			evictable += v.Bytes;
+
+		// Settle for a coarser level than desired when even eviction cannot make
+		// room for it.
+		const TextureState& t = mTextures[texture];
+		uint32 target = t.DesiredMip;
+		uint64 cost = 0;
+		for(;;)
+		{
+			cost = BytesFrom(t, target) - BytesFrom(t, t.FirstMip);
+			if(mCommittedBytes + cost <= mSettings.Budget + evictable)
+				break;
+
+			uint32 next = target + 1;
+			while(next < t.FirstMip && (t.ValidFirstMips & (1u << next)) == 0)
+				++next;
+			if(next >= t.FirstMip)
+				break;
+			target = next;
+		}
+
+		if(mCommittedBytes + cost > mSettings.Budget + evictable)
+			continue;
+
+		// Evictions count against the changes in flight too.  When they use up the
+		// limit the load waits for a later update, which finds the room made.
+		for(const Victim& v : victims)
+		{
+			if(mCommittedBytes + cost <= mSettings.Budget || mPendingCount >= mSettings.MaxPendingChanges)
+				break;
+			Issue(v.Texture, v.FirstMip);
+		}
+
+		if(mCommittedBytes + cost > mSettings.Budget || mPendingCount >= mSettings.MaxPendingChanges)
+			continue;
+
+		Issue(texture, target);
+	}
+}
+
+const std::vector<MipResidency::Change>& MipResidency::GetChanges()const
+{
+	return mChanges;
+}
+
+void MipResidency::CompleteChange(uint32 texture)
+{
+	TextureState& t = mTextures[texture];
+	assert(t.Pending);
+
+	t.Pending = false;
+	t.ReadyUpdate = mUpdateCount + mSettings.ChangeDelay;
+	--mPendingCount;
+}
+
+uint32 MipResidency::GetFirstMip(uint32 texture)const
+{
+	return mTextures[texture].FirstMip;
+}
+
+uint32 MipResidency::GetDesiredMip(uint32 texture)const
+{
+	return mTextures[texture].DesiredMip;
+}
+
+uint64 MipResidency::GetCommittedBytes()const
+{
+	return mCommittedBytes;
+}
+
+uint32 MipResidency::GetPendingCount()const
+{
+	return mPendingCount;
+}
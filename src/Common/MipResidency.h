@@ -0,0 +1,187 @@
+//***************************************************************************************
+// MipResidency.h
+//
+// Decides which mip levels of each streamed texture should be resident.  Textures
+// start with only their tail: the small mips every texture keeps.  Each frame the
+// renderer reports how many texture coordinate units one pixel covers wherever a
+// texture is drawn, and Update turns the finest report into the mip that gives about
+// one texel per pixel.  Textures that need finer mips than they have are brought
+// in, the largest shortfall first, as long as the memory budget allows.  When it does
+// not, mips nobody currently needs are evicted first: textures that were not drawn,
+// longest unused first, then textures holding finer mips than they need.
+//
+// The class only makes decisions.  Update hands out changes, each giving a texture's
+// new finest mip; the app loads or drops mips to match and reports back when a change
+// is done.  A texture has at most one change in flight, and waits ChangeDelay
+// Updates after one completes before the next is issued, so an app that keeps two
+// descriptors per texture and alternates between them never rewrites one that a
+// frame in flight may still read.  Budgets count the bytes the mips take in the
+// file, which is close to, but below, what the GPU allocates for them.
+//
+// The code only depends on the standard library, DirectXMath and DDSParser, so the
+// policy can be driven without a GPU.
+//***************************************************************************************
+
+#pragma once
+
+#include "DDSParser.h"
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+
+class MipResidency
+{
+public:
+
+    using uint32 = std::uint32_t;
+    using uint64 = std::uint64_t;
+
+	struct Settings
+	{
+		// Bytes of mips that may be resident or on their way, tails included.
+		uint64 Budget = 64ull * 1024 * 1024;
+
+		// Updates to wait after a texture's change completes before issuing the
+		// next one.  At least the number of frames in flight.
+		uint32 ChangeDelay = 3;
+
+		// Changes issued but not yet completed, over all textures.
+		uint32 MaxPendingChanges = 4;
+
+		// Added to the computed level before it is rounded down; positive values
+		// trade sharpness for memory.
+		float LodBias = 0.0f;
+	};
+
+	struct Change
+	{
+		uint32 Texture = 0;
+
+		// The finest mip the texture holds once the change is done, and the
+		// matching largest dimension to load it with (see DDSParser::GetSubresources).
+		uint32 FirstMip = 0;
+		uint32 MaxSize = 0;
+
+		// True when mips are added rather than dropped.
+		bool IsLoad = false;
+	};
+
+	explicit MipResidency(const Settings& settings);
+	MipResidency(const MipResidency& rhs) = delete;
+	MipResidency& operator=(const MipResidency& rhs) = delete;
+
+	///<summary>
+	/// Registers a texture of the given layout that holds mips firstMip and coarser,
+	/// which become its tail.  Returns the id used everywhere else.
+	///</summary>
+	uint32 AddTexture(const DDSParser::TextureDesc& desc, uint32 firstMip);
+
+	///<summary>
+	/// Reports that texture is drawn where one pixel covers uvPerPixel texture
+	/// coordinate units.  Call for every draw of the texture; the finest report
+	/// since the last Update counts.
+	///</summary>
+	void ReportUsage(uint32 texture, float uvPerPixel);
+
+	///<summary>
+	/// Call once a frame, after reporting usage.  Works out the mip each texture
+	/// needs and issues the changes to get there; see GetChanges.
+	///</summary>
+	void Update();
+
+	///<summary>
+	/// The changes issued by the last Update, in the order they should be
+	/// carried out.  Report each with CompleteChange once its mips are in place.
+	///</summary>
+	const std::vector<Change>& GetChanges()const;
+	void CompleteChange(uint32 texture);
+
+	uint32 GetFirstMip(uint32 texture)const;
+	uint32 GetDesiredMip(uint32 texture)const;
+	uint64 GetCommittedBytes()const;
+	uint32 GetPendingCount()const;
+
+	///<summary>
+	/// Texture coordinate units per world unit over a triangle list: the square root
+	/// of its total UV area over its total surface area.  positions and texCoords
+	/// point at the first vertex and advance by stride bytes.  Multiply by the draw's
+	/// texture transform scale, divide by its world scale, and then by the world
+	/// units a pixel covers at the object's distance to get the uvPerPixel to report.
+	///</summary>
+	template<typename Index>
+	static float ComputeUvDensity(const DirectX::XMFLOAT3* positions, const DirectX::XMFLOAT2* texCoords,
+		std::size_t stride, const Index* indices, std::size_t indexCount);
+
+private:
+	struct TextureState
+	{
+		uint32 Width = 0;
+		uint32 Height = 0;
+		std::vector<uint64> MipBytes;
+
+		// Mips that may be the finest resident one; block compressed textures
+		// need sides that are multiples of 4 there.
+		uint32 ValidFirstMips = 0;
+
+		uint32 TailMip = 0;
+		uint32 FirstMip = 0;
+		uint32 DesiredMip = 0;
+		bool Pending = false;
+
+		// Update count from which the next change may be issued, and the last
+		// one the texture was drawn in.
+		uint64 ReadyUpdate = 0;
+		uint64 LastUsedUpdate = 0;
+
+		float UvPerPixel = 0.0f;
+	};
+
+	uint64 BytesFrom(const TextureState& t, uint32 firstMip)const;
+	uint32 DesiredMipOf(const TextureState& t)const;
+	uint32 FinestValidMip(const TextureState& t, uint32 mip)const;
+	void Issue(uint32 texture, uint32 firstMip);
+
+private:
+	Settings mSettings;
+	std::vector<TextureState> mTextures;
+	std::vector<Change> mChanges;
+
+	uint64 mUpdateCount = 0;
+	uint64 mCommittedBytes = 0;
+	uint32 mPendingCount = 0;
+};
+
+template<typename Index>
+float MipResidency::ComputeUvDensity(const DirectX::XMFLOAT3* positions, const DirectX::XMFLOAT2* texCoords,
+	std::size_t stride, const Index* indices, std::size_t indexCount)
+{
+	using namespace DirectX;
+
+	auto position = [&](Index i)
+	{
+		return XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(reinterpret_cast<const std::uint8_t*>(positions) + i*stride));
+	};
+	auto texCoord = [&](Index i)
+	{
+		return XMLoadFloat2(reinterpret_cast<const XMFLOAT2*>(reinterpret_cast<const std::uint8_t*>(texCoords) + i*stride));
+	};
+
+	float worldArea = 0.0f;
+	float uvArea = 0.0f;
+	for(std::size_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		XMVECTOR p0 = position(indices[i]);
+		XMVECTOR e0 = position(indices[i + 1]) - p0;
+		XMVECTOR e1 = position(indices[i + 2]) - p0;
+		worldArea += XMVectorGetX(XMVector3Length(XMVector3Cross(e0, e1)));
+
+		XMVECTOR t0 = texCoord(indices[i]);
+		XMVECTOR d0 = texCoord(indices[i + 1]) - t0;
+		XMVECTOR d1 = texCoord(indices[i + 2]) - t0;
+		uvArea += fabsf(XMVectorGetX(XMVector2Cross(d0, d1)));
+	}
+
+	return worldArea > 0.0f ? sqrtf(uvArea / worldArea) : 0.0f;
+}
@@ -0,0 +1,364 @@
+//***************************************************************************************
+// RayQuery.cpp
+//***************************************************************************************
+
+#include "RayQuery.h"
+#include <ppl.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	// Matches the depth limit TriangleBVH builds with.
+	const int MaxStackDepth = 64;
+
+	// Four rays in structure-of-arrays form, one ray per lane.
+	struct RayPacket
+	{
+		XMVECTOR Origin[3];
+		XMVECTOR Dir[3];
+		XMVECTOR InvDir[3];
+
+		// Closest hit found so far (or the ray's MaxDist) per lane.
+		XMVECTOR TMax;
+
+		// All bits set in lanes that carry a ray.
+		XMVECTOR Active;
+	};
+
+	struct StackEntry
+	{
+		XMVECTOR Entry;
+		RayQuery::uint32 Node;
+	};
+
+	bool AnyLane(FXMVECTOR mask)
+	{
+		return !XMComparisonAllTrue(XMVector4EqualIntR(mask, XMVectorFalseInt()));
+	}
+
+	float MinLane(FXMVECTOR v)
+	{
+		XMFLOAT4A f;
+		XMStoreFloat4A(&f, v);
+
+		return std::min(std::min(f.x, f.y), std::min(f.z, f.w));
+	}
+
+	// Slab test of all four rays against the box.  Returns the mask of active rays
+	// that enter the box before their current TMax, and the entry distance per lane
+	// (+infinity in lanes that miss).
+	// TriangleBVH::Node and SceneBVH::Node share the same bounds members.
+	template<typename NodeType>
+	XMVECTOR PacketBoxTest(const NodeType& node, const RayPacket& p, XMVECTOR& entry)
+	{
+		XMVECTOR tx0 = XMVectorMultiply(XMVectorSubtract(XMVectorReplicate(node.BoundsMin.x), p.Origin[0]), p.InvDir[0]);
+		XMVECTOR tx1 = XMVectorMultiply(XMVectorSubtract(XMVectorReplicate(node.BoundsMax.x), p.Origin[0]), p.InvDir[0]);
+		XMVECTOR ty0 = XMVectorMultiply(XMVectorSubtract(XMVectorReplicate(node.BoundsMin.y), p.Origin[1]), p.InvDir[1]);
+		XMVECTOR ty1 = XMVectorMultiply(XMVectorSubtract(XMVectorReplicate(node.BoundsMax.y), p.Origin[1]), p.InvDir[1]);
+		XMVECTOR tz0 = XMVectorMultiply(XMVectorSubtract(XMVectorReplicate(node.BoundsMin.z), p.Origin[2]), p.InvDir[2]);
+		XMVECTOR tz1 = XMVectorMultiply(XMVectorSubtract(XMVectorReplicate(node.BoundsMax.z), p.Origin[2]), p.InvDir[2]);
+
+		XMVECTOR tEnter = XMVectorMax(
+			XMVectorMax(XMVectorMin(tx0, tx1), XMVectorMin(ty0, ty1)),
+			XMVectorMax(XMVectorMin(tz0, tz1), XMVectorZero()));
+		XMVECTOR tExit = XMVectorMin(
+			XMVectorMin(XMVectorMax(tx0, tx1), XMVectorMax(ty0, ty1)),
+			XMVectorMin(XMVectorMax(tz0, tz1), p.TMax));
+
+		XMVECTOR mask = XMVectorAndInt(XMVectorLessOrEqual(tEnter, tExit), p.Active);
+		entry = XMVectorSelect(XMVectorSplatInfinity(), tEnter, mask);
+
+		return mask;
+	}
+
+	// Moller-Trumbore test of all four rays against one triangle.  Returns the mask
+	// of active rays that hit it closer than their current TMax, with the hit
+	// distance per lane in t.
+	XMVECTOR PacketTriangleTest(const TriangleBVH::Triangle& tri, const RayPacket& p, XMVECTOR& t)
+	{
+		XMVECTOR e1x = XMVectorReplicate(tri.E1.x);
+		XMVECTOR e1y = XMVectorReplicate(tri.E1.y);
+		XMVECTOR e1z = XMVectorReplicate(tri.E1.z);
+		XMVECTOR e2x = XMVectorReplicate(tri.E2.x);
+		XMVECTOR e2y = XMVectorReplicate(tri.E2.y);
+		XMVECTOR e2z = XMVectorReplicate(tri.E2.z);
+
+		// p = dir x e2
+		XMVECTOR px = XMVectorSubtract(XMVectorMultiply(p.Dir[1], e2z), XMVectorMultiply(p.Dir[2], e2y));
+		XMVECTOR py = XMVectorSubtract(XMVectorMultiply(p.Dir[2], e2x), XMVectorMultiply(p.Dir[0], e2z));
+		XMVECTOR pz = XMVectorSubtract(XMVectorMultiply(p.Dir[0], e2y), XMVectorMultiply(p.Dir[1], e2x));
+
+		XMVECTOR det = XMVectorMultiplyAdd(e1x, px, XMVectorMultiplyAdd(e1y, py, XMVectorMultiply(e1z, pz)));
+		XMVECTOR invDet = XMVectorReciprocal(det);
+
+		// s = origin - v0
+		XMVECTOR sx = XMVectorSubtract(p.Origin[0], XMVectorReplicate(tri.V0.x));
+		XMVECTOR sy = XMVectorSubtract(p.Origin[1], XMVectorReplicate(tri.V0.y));
+		XMVECTOR sz = XMVectorSubtract(p.Origin[2], XMVectorReplicate(tri.V0.z));
+
+		XMVECTOR u = XMVectorMultiply(
+			XMVectorMultiplyAdd(sx, px, XMVectorMultiplyAdd(sy, py, XMVectorMultiply(sz, pz))), invDet);
+
+		// q = s x e1
+		XMVECTOR qx = XMVectorSubtract(XMVectorMultiply(sy, e1z), XMVectorMultiply(sz, e1y));
+		XMVECTOR qy = XMVectorSubtract(XMVectorMultiply(sz, e1x), XMVectorMultiply(sx, e1z));
+		XMVECTOR qz = XMVectorSubtract(XMVectorMultiply(sx, e1y), XMVectorMultiply(sy, e1x));
+
+		XMVECTOR v = XMVectorMultiply(
+			XMVectorMultiplyAdd(p.Dir[0], qx, XMVectorMultiplyAdd(p.Dir[1], qy, XMVectorMultiply(p.Dir[2], qz))), invDet);
+
+		t = XMVectorMultiply(
+			XMVectorMultiplyAdd(e2x, qx, XMVectorMultiplyAdd(e2y, qy, XMVectorMultiply(e2z, qz))), invDet);
+
+		XMVECTOR zero = XMVectorZero();
+		XMVECTOR one = XMVectorSplatOne();
+
+		XMVECTOR mask = XMVectorGreater(XMVectorAbs(det), XMVectorReplicate(1e-12f));
+		mask = XMVectorAndInt(mask, XMVectorGreaterOrEqual(u, zero));
+		mask = XMVectorAndInt(mask, XMVectorGreaterOrEqual(v, zero));
+		mask = XMVectorAndInt(mask, XMVectorLessOrEqual(XMVectorAdd(u, v), one));
+		mask = XMVectorAndInt(mask, XMVectorGreaterOrEqual(t, zero));
+		mask = XMVectorAndInt(mask, XMVectorLess(t, p.TMax));
+
+		return XMVectorAndInt(mask, p.Active);
+	}
+
+	// Closest distance each lane may still hit at: the ray's MaxDist or the hit
+	// already found.  Unused lanes get a negative TMax, which no box or triangle
+	// test can pass, on top of being masked out.
+	XMVECTOR PacketTMax(const RayQuery::Ray* rays, RayQuery::uint32 rayCount, const RayQuery::Hit* hits)
+	{
+		XMFLOAT4A tMax(-1.0f, -1.0f, -1.0f, -1.0f);
+		float* tm = &tMax.x;
+		for(RayQuery::uint32 lane = 0; lane < rayCount; ++lane)
+			tm[lane] = std::min(rays[lane].MaxDist, hits[lane].Distance);
+
+		return XMLoadFloat4A(&tMax);
+	}
+
+	// Transposes up to four rays into SoA form.
+	void LoadPacket(const RayQuery::Ray* rays, RayQuery::uint32 rayCount, const RayQuery::Hit* hits, RayPacket& p)
+	{
+		XMFLOAT4A origin[3];
+		XMFLOAT4A dir[3];
+		XMFLOAT4A invDir[3];
+		XMUINT4 active = { 0, 0, 0, 0 };
+
+		float* o[3] = { &origin[0].x, &origin[1].x, &origin[2].x };
+		float* d[3] = { &dir[0].x, &dir[1].x, &dir[2].x };
+		float* id[3] = { &invDir[0].x, &invDir[1].x, &invDir[2].x };
+		std::uint32_t* act = &active.x;
+
+		for(RayQuery::uint32 lane = 0; lane < 4; ++lane)
+		{
+			const RayQuery::Ray& ray = rays[std::min(lane, rayCount - 1)];
+			const float rayOrigin[3] = { ray.Origin.x, ray.Origin.y, ray.Origin.z };
+			const float rayDir[3] = { ray.Direction.x, ray.Direction.y, ray.Direction.z };
+
+			for(int axis = 0; axis < 3; ++axis)
+			{
+				// Avoid 0*inf = NaN in the slab test for axis-aligned rays.
+				float safeDir = std::fabs(rayDir[axis]) > 1e-20f ? rayDir[axis] : 1e-20f;
+
+				o[axis][lane] = rayOrigin[axis];
+				d[axis][lane] = rayDir[axis];
+				id[axis][lane] = 1.0f / safeDir;
+			}
+
+			if(lane < rayCount)
+				act[lane] = 0xffffffff;
+		}
+
+		for(int axis = 0; axis < 3; ++axis)
+		{
+			p.Origin[axis] = XMLoadFloat4A(&origin[axis]);
+			p.Dir[axis] = XMLoadFloat4A(&dir[axis]);
+			p.InvDir[axis] = XMLoadFloat4A(&invDir[axis]);
+		}
+		p.TMax = PacketTMax(rays, rayCount, hits);
+		p.Active = XMLoadUInt4(&active);
+	}
+
+	// Walks a hierarchy of either node type front to back for the packet, calling
+	// visitLeaf on every leaf some ray reaches before its TMax.  visitLeaf may only
+	// lower p.TMax, which prunes the rest of the walk.
+	template<typename NodeType, typename VisitLeaf>
+	void TracePacket(const std::vector<NodeType>& nodes, RayPacket& p, VisitLeaf visitLeaf)
+	{
+		StackEntry stack[MaxStackDepth];
+		int stackSize = 0;
+
+		XMVECTOR rootEntry;
+		if(!AnyLane(PacketBoxTest(nodes[0], p, rootEntry)))
+			return;
+
+		stack[stackSize++] = { rootEntry, 0 };
+		while(stackSize > 0)
+		{
+			StackEntry e = stack[--stackSize];
+
+			// Skip the node if every ray that entered it has since found a closer hit.
+			if(!AnyLane(XMVectorLess(e.Entry, p.TMax)))
+				continue;
+
+			const NodeType& node = nodes[e.Node];
+			if(node.IsLeaf())
+			{
+				visitLeaf(node);
+				continue;
+			}
+
+			RayQuery::uint32 nearChild = node.LeftFirst;
+			RayQuery::uint32 farChild = node.LeftFirst + 1;
+
+			XMVECTOR nearEntry;
+			XMVECTOR farEntry;
+			bool nearHit = AnyLane(PacketBoxTest(nodes[nearChild], p, nearEntry));
+			bool farHit = AnyLane(PacketBoxTest(nodes[farChild], p, farEntry));
+
+			// Order the children by the closest entry over the packet.
+			if(nearHit && farHit && MinLane(farEntry) < MinLane(nearEntry))
+			{
+				std::swap(nearChild, farChild);
+				std::swap(nearEntry, farEntry);
+			}
+			else if(!nearHit)
+			{
+				std::swap(nearChild, farChild);
+				std::swap(nearEntry, farEntry);
+				std::swap(nearHit, farHit);
+			}
+
+			if(farHit)
+				stack[stackSize++] = { farEntry, farChild };
+			if(nearHit)
+				stack[stackSize++] = { nearEntry, nearChild };
+		}
+	}
+}
+
+void RayQuery::Intersect(const SceneBVH& scene, const Ray* rays, uint32 rayCount, Hit* hits)
+{
+	std::fill(hits, hits + rayCount, Hit());
+
+	const auto& nodes = scene.GetNodes();
+	const auto& itemIds = scene.GetItemIds();
+	if(nodes.empty())
+		return;
+
+	auto traceRange = [&](uint32 task)
+	{
+		uint32 first = task*RaysPerTask;
+		uint32 last = std::min(rayCount, first + RaysPerTask);
+
+		for(uint32 i = first; i < last; i += 4)
+		{
+			uint32 count = std::min(4u, last - i);
+
+			// The packet walks the scene hierarchy in world space, so only the items
+			// along the rays' paths are visited, nearest first.
+			RayPacket p;
+			LoadPacket(rays + i, count, hits + i, p);
+
+			TracePacket(nodes, p, [&](const SceneBVH::Node& node)
+			{
+				for(uint32 j = node.LeftFirst; j < node.LeftFirst + node.ItemCount; ++j)
+				{
+					uint32 id = itemIds[j];
+					const SceneBVH::Item& item = scene.GetItem(id);
+					if(!item.Enabled || item.Bvh == nullptr)
+						continue;
+
+					XMMATRIX invWorld = XMLoadFloat4x4(&item.InvWorld);
+
+					// Move the rays into the local space of the item.  The direction is
+					// deliberately not renormalized so that distances stay comparable
+					// across items with different scales.
+					Ray localRays[4];
+					for(uint32 k = 0; k < count; ++k)
+					{
+						XMVECTOR origin = XMLoadFloat3(&rays[i + k].Origin);
+						XMVECTOR dir = XMLoadFloat3(&rays[i + k].Direction);
+
+						XMStoreFloat3(&localRays[k].Origin, XMVector3TransformCoord(origin, invWorld));
+						XMStoreFloat3(&localRays[k].Direction, XMVector3TransformNormal(dir, invWorld));
+						localRays[k].MaxDist = rays[i + k].MaxDist;
+					}
+
+					IntersectPacket(*item.Bvh, id, localRays, count, hits + i);
+				}
+
+				// Hits on these items end the rays' search further along the scene.
+				p.TMax = PacketTMax(rays + i, count, hits + i);
+			});
+		}
+	};
+
+	uint32 taskCount = (rayCount + RaysPerTask - 1) / RaysPerTask;
+	if(taskCount <= 1)
+	{
+		if(taskCount == 1)
+			traceRange(0);
+	}
+	else
+	{
+		// Each task writes a disjoint range of hits, so no synchronization is needed.
+		concurrency::parallel_for(0u, taskCount, traceRange);
+	}
+}
+
+void RayQuery::IntersectPacket(const TriangleBVH& bvh, uint32 itemIndex,
+	const Ray* localRays, uint32 rayCount, Hit* hits)
+{
+	const auto& nodes = bvh.GetNodes();
+	const auto& tris = bvh.GetTriangles();
+	const auto& triIds = bvh.GetTriangleIds();
+
+	if(nodes.empty() || rayCount == 0)
+		return;
+
+	rayCount = std::min(rayCount, 4u);
+
+	RayPacket p;
+	LoadPacket(localRays, rayCount, hits, p);
+
+	uint32 hitTriangle[4] = { NoHit, NoHit, NoHit, NoHit };
+
+	TracePacket(nodes, p, [&](const TriangleBVH::Node& node)
+	{
+		for(uint32 i = node.LeftFirst; i < node.LeftFirst + node.TriCount; ++i)
+		{
+			XMVECTOR t;
+			XMVECTOR mask = PacketTriangleTest(tris[i], p, t);
+			if(!AnyLane(mask))
+				continue;
+
+			p.TMax = XMVectorSelect(p.TMax, t, mask);
+
+			std::uint32_t laneHit[4];
+			XMStoreInt4(laneHit, mask);
+			for(int lane = 0; lane < 4; ++lane)
+			{
+				if(laneHit[lane])
+					hitTriangle[lane] = triIds[i];
+			}
+		}
+	});
+
+	XMFLOAT4A tMax;
+	XMStoreFloat4A(&tMax, p.TMax);
+	const float* tm = &tMax.x;
+	for(uint32 lane = 0; lane < rayCount; ++lane)
+	{
+		if(hitTriangle[lane] != NoHit)
+		{
+			hits[lane].Distance = tm[lane];
+			hits[lane].Triangle = hitTriangle[lane];
+			hits[lane].Item = itemIndex;
+		}
+	}
+}
@@ -0,0 +1,67 @@
+//***************************************************************************************
+// RayQuery.h
+//
+// Batched ray casts against the render items of a SceneBVH.  This is the picking
+// code generalized to many rays per frame (line-of-sight checks, projectile tests,
+// etc.).  Rays are traced in packets of four, through the scene hierarchy and then
+// the TriangleBVH of every item a packet reaches, so that one node or triangle
+// fetch is shared by four rays, and the ray/box and ray/triangle tests run on all
+// four lanes of an XMVECTOR at once.  Large batches are split across cores.
+//***************************************************************************************
+
+#pragma once
+
+#include <cfloat>
+#include <cstdint>
+#include <DirectXMath.h>
+#include "SceneBVH.h"
+#include "TriangleBVH.h"
+
+class RayQuery
+{
+public:
+
+    using uint32 = std::uint32_t;
+
+	// Hit.Item and Hit.Triangle are set to this when a ray hits nothing.
+	static const uint32 NoHit = 0xffffffff;
+
+	// World space ray.  Distances are measured in multiples of Direction, so pass
+	// a unit length direction to get world space distances back.
+	struct Ray
+	{
+		DirectX::XMFLOAT3 Origin = { 0.0f, 0.0f, 0.0f };
+		float MaxDist = FLT_MAX;
+		DirectX::XMFLOAT3 Direction = { 0.0f, 0.0f, 1.0f };
+	};
+
+	struct Hit
+	{
+		float Distance = FLT_MAX;
+
+		// Triangle index relative to the index range the item's BVH was built from.
+		uint32 Triangle = NoHit;
+
+		// Id of the SceneBVH item that was hit.
+		uint32 Item = NoHit;
+	};
+
+	///<summary>
+	/// Finds the nearest hit of every ray over the enabled items of scene, as
+	/// scene.Intersects does for a single ray.  hits must have room for rayCount
+	/// entries.  Rays are processed in packets of four; the batch is
+	/// split into chunks that run in parallel when it is large enough to pay off.
+	///</summary>
+	static void Intersect(const SceneBVH& scene, const Ray* rays, uint32 rayCount, Hit* hits);
+
+	///<summary>
+	/// Traces up to four rays that are already in the local space of bvh.  Lanes
+	/// with a closer hit in hits[] are only replaced by closer hits, so this can be
+	/// called once per item to accumulate the nearest hit over a scene.
+	///</summary>
+	static void IntersectPacket(const TriangleBVH& bvh, uint32 itemIndex,
+		const Ray* localRays, uint32 rayCount, Hit* hits);
+
+	// Rays per parallel task.  Smaller batches run on the calling thread.
+	static const uint32 RaysPerTask = 64;
+};
@@ -0,0 +1,288 @@
+//***************************************************************************************
+// SceneBVH.cpp
+//***************************************************************************************
+
+#include "SceneBVH.h"
+#include <algorithm>
+#include <cfloat>
+
+using namespace DirectX;
+
+const SceneBVH::uint32 SceneBVH::NoItem;
+
+namespace
+{
+	// Items per leaf.  Item tests are expensive (a matrix transform and a descent
+	// into the item's own triangle hierarchy), so keep leaves small.
+	const SceneBVH::uint32 MaxItemsPerLeaf = 2;
+
+	const int MaxStackDepth = 64;
+
+	void GrowBounds(XMFLOAT3& vMin, XMFLOAT3& vMax, const BoundingBox& box)
+	{
+		XMVECTOR center = XMLoadFloat3(&box.Center);
+		XMVECTOR extents = XMLoadFloat3(&box.Extents);
+
+		XMStoreFloat3(&vMin, XMVectorMin(XMLoadFloat3(&vMin), XMVectorSubtract(center, extents)));
+		XMStoreFloat3(&vMax, XMVectorMax(XMLoadFloat3(&vMax), XMVectorAdd(center, extents)));
+	}
+
+	float GetAxis(const XMFLOAT3& v, int axis)
+	{
+		return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+	}
+}
+
+SceneBVH::uint32 SceneBVH::AddItem(const BoundingBox& localBounds, const TriangleBVH* bvh, FXMMATRIX world)
+{
+	Item item;
+	item.LocalBounds = localBounds;
+	item.Bvh = bvh;
+
+	mItems.push_back(item);
+	mNeedsBuild = true;
+
+	uint32 id = (uint32)mItems.size() - 1;
+	SetWorld(id, world);
+
+	return id;
+}
+
+void SceneBVH::SetWorld(uint32 item, FXMMATRIX world)
+{
+	Item& e = mItems[item];
+
+	XMVECTOR det = XMMatrixDeterminant(world);
+	XMMATRIX invWorld = XMMatrixInverse(&det, world);
+	XMStoreFloat4x4(&e.InvWorld, invWorld);
+
+	e.LocalBounds.Transform(e.WorldBounds, world);
+
+	if(!mNeedsBuild)
+		mMovedItems.push_back(item);
+}
+
+void SceneBVH::SetEnabled(uint32 item, bool enabled)
+{
+	mItems[item].Enabled = enabled;
+}
+
+void SceneBVH::Update()
+{
+	if(mNeedsBuild)
+	{
+		Build();
+		return;
+	}
+
+	// Walk from each moved item's leaf up to the root.  Ancestors shared by several
+	// moved items are refit more than once, which is still far cheaper than a
+	// full pass when only a few items move per frame.
+	for(uint32 item : mMovedItems)
+	{
+		for(uint32 n = mItemLeaf[item]; n != NoItem; n = mParents[n])
+			UpdateNodeBounds(n);
+	}
+
+	mMovedItems.clear();
+}
+
+void SceneBVH::Build()
+{
+	mNodes.clear();
+	mParents.clear();
+	mMovedItems.clear();
+	mNeedsBuild = false;
+
+	const uint32 itemCount = (uint32)mItems.size();
+
+	mItemIds.resize(itemCount);
+	mItemLeaf.assign(itemCount, NoItem);
+	for(uint32 i = 0; i < itemCount; ++i)
+		mItemIds[i] = i;
+
+	if(itemCount == 0)
+		return;
+
+	mNodes.reserve(2*itemCount);
+	mParents.reserve(2*itemCount);
+
+	Node root;
+	root.LeftFirst = 0;
+	root.ItemCount = itemCount;
+	mNodes.push_back(root);
+	mParents.push_back(NoItem);
+
+	// Object median splits on the longest centroid axis.  Item counts are small next
+	// to triangle counts, so this is quick and keeps the tree balanced, which bounds
+	// the query cost at O(log n) regardless of how the items are distributed.
+	std::vector<uint32> work;
+	work.push_back(0);
+	while(!work.empty())
+	{
+		uint32 nodeIndex = work.back();
+		work.pop_back();
+
+		uint32 first = mNodes[nodeIndex].LeftFirst;
+		uint32 count = mNodes[nodeIndex].ItemCount;
+
+		XMFLOAT3 cMin(+FLT_MAX, +FLT_MAX, +FLT_MAX);
+		XMFLOAT3 cMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for(uint32 i = first; i < first + count; ++i)
+		{
+			const XMFLOAT3& c = mItems[mItemIds[i]].WorldBounds.Center;
+			XMStoreFloat3(&cMin, XMVectorMin(XMLoadFloat3(&cMin), XMLoadFloat3(&c)));
+			XMStoreFloat3(&cMax, XMVectorMax(XMLoadFloat3(&cMax), XMLoadFloat3(&c)));
+		}
+
+		int axis = 0;
+		if(cMax.y - cMin.y > GetAxis(cMax, axis) - GetAxis(cMin, axis))
+			axis = 1;
+		if(cMax.z - cMin.z > GetAxis(cMax, axis) - GetAxis(cMin, axis))
+			axis = 2;
+
+		if(count <= MaxItemsPerLeaf)
+		{
+			for(uint32 i = first; i < first + count; ++i)
+				mItemLeaf[mItemIds[i]] = nodeIndex;
+			continue;
+		}
+
+		uint32 mid = first + count/2;
+		std::nth_element(mItemIds.begin() + first, mItemIds.begin() + mid, mItemIds.begin() + first + count,
+			[&](uint32 a, uint32 b)
+		{
+			return GetAxis(mItems[a].WorldBounds.Center, axis) < GetAxis(mItems[b].WorldBounds.Center, axis);
+		});
+
+		uint32 leftChild = (uint32)mNodes.size();
+
+		Node left;
+		left.LeftFirst = first;
+		left.ItemCount = mid - first;
+
+		Node right;
+		right.LeftFirst = mid;
+		right.ItemCount = first + count - mid;
+
+		mNodes.push_back(left);
+		mNodes.push_back(right);
+		mParents.push_back(nodeIndex);
+		mParents.push_back(nodeIndex);
+
+		mNodes[nodeIndex].LeftFirst = leftChild;
+		mNodes[nodeIndex].ItemCount = 0;
+
+		work.push_back(leftChild);
+		work.push_back(leftChild + 1);
+	}
+
+	// Children are always created after their parent, so a reverse pass computes
+	// the bounds bottom-up.
+	for(uint32 n = (uint32)mNodes.size(); n-- > 0;)
+		UpdateNodeBounds(n);
+}
+
+void SceneBVH::UpdateNodeBounds(uint32 nodeIndex)
+{
+	Node& node = mNodes[nodeIndex];
+	node.BoundsMin = XMFLOAT3(+FLT_MAX, +FLT_MAX, +FLT_MAX);
+	node.BoundsMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+	if(node.IsLeaf())
+	{
+		for(uint32 i = node.LeftFirst; i < node.LeftFirst + node.ItemCount; ++i)
+			GrowBounds(node.BoundsMin, node.BoundsMax, mItems[mItemIds[i]].WorldBounds);
+	}
+	else
+	{
+		for(uint32 c = node.LeftFirst; c < node.LeftFirst + 2; ++c)
+		{
+			XMStoreFloat3(&node.BoundsMin, XMVectorMin(XMLoadFloat3(&node.BoundsMin), XMLoadFloat3(&mNodes[c].BoundsMin)));
+			XMStoreFloat3(&node.BoundsMax, XMVectorMax(XMLoadFloat3(&node.BoundsMax), XMLoadFloat3(&mNodes[c].BoundsMax)));
+		}
+	}
+}
+
+bool SceneBVH::Intersects(FXMVECTOR rayOrigin, FXMVECTOR rayDir,
+	float& dist, uint32& item, uint32& triangle)const
+{
+	if(mNodes.empty())
+		return false;
+
+	XMVECTOR invDir = TriangleBVH::RayInvDirection(rayDir);
+
+	struct StackEntry
+	{
+		uint32 Node;
+		float Entry;
+	};
+
+	StackEntry stack[MaxStackDepth];
+	int stackSize = 0;
+
+	float closest = FLT_MAX;
+	bool hit = false;
+
+	float rootEntry = TriangleBVH::RayBoxEntry(mNodes[0].BoundsMin, mNodes[0].BoundsMax, rayOrigin, invDir, closest);
+	if(rootEntry == FLT_MAX)
+		return false;
+
+	stack[stackSize++] = { 0, rootEntry };
+	while(stackSize > 0)
+	{
+		StackEntry e = stack[--stackSize];
+		if(e.Entry >= closest)
+			continue;
+
+		const Node& node = mNodes[e.Node];
+		if(node.IsLeaf())
+		{
+			for(uint32 i = node.LeftFirst; i < node.LeftFirst + node.ItemCount; ++i)
+			{
+				uint32 id = mItemIds[i];
+				const Item& it = mItems[id];
+				if(!it.Enabled || it.Bvh == nullptr)
+					continue;
+
+				// Move the ray into the local space of the item with the cached inverse.
+				// The direction is not renormalized so that t is comparable across items.
+				XMMATRIX invWorld = XMLoadFloat4x4(&it.InvWorld);
+				XMVECTOR localOrigin = XMVector3TransformCoord(rayOrigin, invWorld);
+				XMVECTOR localDir = XMVector3TransformNormal(rayDir, invWorld);
+
+				float t = 0.0f;
+				uint32 tri = 0;
+				if(it.Bvh->Intersects(localOrigin, localDir, t, tri) && t < closest)
+				{
+					closest = t;
+					item = id;
+					triangle = tri;
+					hit = true;
+				}
+			}
+			continue;
+		}
+
+		uint32 nearChild = node.LeftFirst;
+		uint32 farChild = node.LeftFirst + 1;
+		float nearEntry = TriangleBVH::RayBoxEntry(mNodes[nearChild].BoundsMin, mNodes[nearChild].BoundsMax, rayOrigin, invDir, closest);
+		float farEntry = TriangleBVH::RayBoxEntry(mNodes[farChild].BoundsMin, mNodes[farChild].BoundsMax, rayOrigin, invDir, closest);
+
+		if(farEntry < nearEntry)
+		{
+			std::swap(nearChild, farChild);
+			std::swap(nearEntry, farEntry);
+		}
+
+		if(farEntry != FLT_MAX)
+			stack[stackSize++] = { farChild, farEntry };
+		if(nearEntry != FLT_MAX)
+			stack[stackSize++] = { nearChild, nearEntry };
+	}
+
+	if(hit)
+		dist = closest;
+
+	return hit;
+}
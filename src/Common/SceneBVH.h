@@ -0,0 +1,115 @@
+//***************************************************************************************
+// SceneBVH.h
+//
+// Broad phase for ray queries over many render items.  Each item is registered once
+// with its local bounds, world matrix and (optionally) a TriangleBVH.  The scene keeps
+// the world space bounds and the inverse world matrix of every item cached, and a
+// hierarchy over the world bounds so a ray only visits the items along its path.
+//
+// When an item moves, call SetWorld() and then Update() once per frame; only the
+// moved items and their ancestors in the hierarchy are touched.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include "TriangleBVH.h"
+
+class SceneBVH
+{
+public:
+
+    using uint32 = std::uint32_t;
+
+	static const uint32 NoItem = 0xffffffff;
+
+	// Same 32 byte layout as TriangleBVH::Node, over items instead of triangles.
+	struct Node
+	{
+		DirectX::XMFLOAT3 BoundsMin;
+
+		// Interior node: index of the left child (the right child follows it).
+		// Leaf node: offset of the first item in the leaf-ordered item id list.
+		uint32 LeftFirst;
+
+		DirectX::XMFLOAT3 BoundsMax;
+
+		// Zero for interior nodes.
+		uint32 ItemCount;
+
+		bool IsLeaf()const { return ItemCount > 0; }
+	};
+
+	struct Item
+	{
+		DirectX::BoundingBox LocalBounds;
+		DirectX::BoundingBox WorldBounds;
+
+		// Cached so queries never invert a matrix.
+		DirectX::XMFLOAT4X4 InvWorld;
+
+		// Triangles to test once the ray reaches the item.  Items without one are
+		// skipped by ray queries.
+		const TriangleBVH* Bvh = nullptr;
+
+		bool Enabled = true;
+	};
+
+	///<summary>
+	/// Registers an item and returns its id.  Ids are assigned in order starting at
+	/// zero.  The hierarchy is rebuilt by the next Update().
+	///</summary>
+	uint32 AddItem(const DirectX::BoundingBox& localBounds, const TriangleBVH* bvh, DirectX::FXMMATRIX world);
+
+	///<summary>
+	/// Records a new world matrix for the item.  The inverse and world bounds are
+	/// recomputed here; the hierarchy is refit by the next Update().
+	///</summary>
+	void SetWorld(uint32 item, DirectX::FXMMATRIX world);
+
+	// Disabled items stay in the hierarchy but are never reported as hit.
+	void SetEnabled(uint32 item, bool enabled);
+
+	///<summary>
+	/// Applies pending changes: a full build if items were added since the last one,
+	/// otherwise a refit of the boxes above the items that moved.
+	///</summary>
+	void Update();
+
+	///<summary>
+	/// Forces a full rebuild.  Refitting keeps queries correct but the hierarchy
+	/// degrades as items move far from where they were at build time.
+	///</summary>
+	void Build();
+
+	///<summary>
+	/// Finds the nearest triangle hit by a world space ray over all enabled items.
+	/// dist is in units of the ray direction length.
+	///</summary>
+	bool Intersects(DirectX::FXMVECTOR rayOrigin, DirectX::FXMVECTOR rayDir,
+		float& dist, uint32& item, uint32& triangle)const;
+
+	uint32 GetItemCount()const { return (uint32)mItems.size(); }
+	const Item& GetItem(uint32 item)const { return mItems[item]; }
+	const std::vector<Node>& GetNodes()const { return mNodes; }
+	const std::vector<uint32>& GetItemIds()const { return mItemIds; }
+
+private:
+	void UpdateNodeBounds(uint32 nodeIndex);
+
+private:
+	std::vector<Item> mItems;
+
+	std::vector<Node> mNodes;
+	std::vector<uint32> mParents;
+
+	// Item ids in leaf order, and the leaf that holds each item.
+	std::vector<uint32> mItemIds;
+	std::vector<uint32> mItemLeaf;
+
+	std::vector<uint32> mMovedItems;
+	bool mNeedsBuild = false;
+};
@@ -0,0 +1,438 @@
+//***************************************************************************************
+// SpatialHashGrid.cpp
+//***************************************************************************************
+
+#include "SpatialHashGrid.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace DirectX;
+
+namespace
+{
+	// Cell coordinates are packed into 21 bits each.
+	const int CoordBias = 1 << 20;
+	const int MaxCoord = CoordBias - 1;
+	const SpatialHashGrid::uint64 CoordMask = (1u << 21) - 1;
+
+	int ToCell(float v, float invCellSize)
+	{
+		float c = std::floor(v*invCellSize);
+		c = (std::max)(c, (float)-MaxCoord);
+		c = (std::min)(c, (float)+MaxCoord);
+		return (int)c;
+	}
+}
+
+bool SpatialHashGrid::CellRange::operator==(const CellRange& rhs)const
+{
+	return Min[0] == rhs.Min[0] && Min[1] == rhs.Min[1] && Min[2] == rhs.Min[2] &&
+		Max[0] == rhs.Max[0] && Max[1] == rhs.Max[1] && Max[2] == rhs.Max[2];
+}
+
+SpatialHashGrid::uint64 SpatialHashGrid::CellRange::GetCellCount()const
+{
+	uint64 count = 1;
+	for(int a = 0; a < 3; ++a)
+	{
+		if(Max[a] < Min[a])
+			return 0;
+		count *= (uint64)(Max[a] - Min[a] + 1);
+	}
+	return count;
+}
+
+SpatialHashGrid::SpatialHashGrid(float cellSize, uint32 maxCellsPerItem)
+	: mCellSize(cellSize),
+	mInvCellSize(1.0f / cellSize),
+	mMaxCellsPerItem(maxCellsPerItem)
+{
+}
+
+void SpatialHashGrid::Insert(uint32 item, const BoundingBox& worldBounds)
+{
+	if(item >= (uint32)mItems.size())
+		mItems.resize(item + 1);
+
+	ItemEntry& e = mItems[item];
+	e.Bounds = worldBounds;
+	e.Cells = GetCellRange(worldBounds);
+	e.Present = true;
+	AddToCells(item);
+
+	mItemCount++;
+}
+
+void SpatialHashGrid::Move(uint32 item, const BoundingBox& worldBounds)
+{
+	ItemEntry& e = mItems[item];
+	e.Bounds = worldBounds;
+
+	// Only touch the cells when the item crossed a cell boundary.
+	CellRange cells = GetCellRange(worldBounds);
+	if(cells == e.Cells)
+		return;
+
+	RemoveFromCells(item);
+	e.Cells = cells;
+	AddToCells(item);
+}
+
+void SpatialHashGrid::Remove(uint32 item)
+{
+	RemoveFromCells(item);
+	mItems[item].Present = false;
+
+	mItemCount--;
+}
+
+bool SpatialHashGrid::Contains(uint32 item)const
+{
+	return item < (uint32)mItems.size() && mItems[item].Present;
+}
+
+void SpatialHashGrid::QueryFrustum(const BoundingFrustum& worldFrustum, std::vector<uint32>& items)const
+{
+	XMFLOAT3 corners[BoundingFrustum::CORNER_COUNT];
+	worldFrustum.GetCorners(corners);
+
+	XMVECTOR vMin = XMLoadFloat3(&corners[0]);
+	XMVECTOR vMax = vMin;
+	for(std::size_t i = 1; i < BoundingFrustum::CORNER_COUNT; ++i)
+	{
+		vMin = XMVectorMin(vMin, XMLoadFloat3(&corners[i]));
+		vMax = XMVectorMax(vMax, XMLoadFloat3(&corners[i]));
+	}
+
+	XMFLOAT3 vMinf3, vMaxf3;
+	XMStoreFloat3(&vMinf3, vMin);
+	XMStoreFloat3(&vMaxf3, vMax);
+
+	QueryRange(GetCellRange(vMinf3, vMaxf3),
+		[&](const BoundingBox& box) { return worldFrustum.Contains(box); }, items);
+}
+
+void SpatialHashGrid::QuerySphere(const BoundingSphere& worldSphere, std::vector<uint32>& items)const
+{
+	const XMFLOAT3& c = worldSphere.Center;
+	const float r = worldSphere.Radius;
+
+	QueryRange(GetCellRange(XMFLOAT3(c.x - r, c.y - r, c.z - r), XMFLOAT3(c.x + r, c.y + r, c.z + r)),
+		[&](const BoundingBox& box) { return worldSphere.Contains(box); }, items);
+}
+
+void SpatialHashGrid::QueryRay(FXMVECTOR rayOrigin, FXMVECTOR rayDir, float maxDist, std::vector<uint32>& items)const
+{
+	XMVECTOR origin = rayOrigin;
+	XMVECTOR dir = rayDir;
+
+	auto test = [&](const BoundingBox& box)
+	{
+		float dist = 0.0f;
+		if(box.Intersects(origin, dir, dist) && dist <= maxDist)
+			return INTERSECTS;
+		return DISJOINT;
+	};
+
+	mCurrentStamp++;
+	QueryLargeItems(test, items);
+
+	if(!mHasOccupied)
+		return;
+
+	// Clip the ray to the occupied cells, then walk the cells it passes through
+	// in order (Amanatides and Woo).
+	XMFLOAT3 o, d;
+	XMStoreFloat3(&o, rayOrigin);
+	XMStoreFloat3(&d, rayDir);
+
+	const float orig[3] = { o.x, o.y, o.z };
+	const float dirs[3] = { d.x, d.y, d.z };
+
+	float t0 = 0.0f;
+	float t1 = maxDist;
+	for(int a = 0; a < 3; ++a)
+	{
+		float lo = mOccupied.Min[a] * mCellSize;
+		float hi = (mOccupied.Max[a] + 1) * mCellSize;
+
+		if(std::fabs(dirs[a]) < 1e-12f)
+		{
+			if(orig[a] < lo || orig[a] > hi)
+				return;
+			continue;
+		}
+
+		float ta = (lo - orig[a]) / dirs[a];
+		float tb = (hi - orig[a]) / dirs[a];
+		if(ta > tb)
+			std::swap(ta, tb);
+
+		t0 = (std::max)(t0, ta);
+		t1 = (std::min)(t1, tb);
+	}
+
+	if(t0 > t1)
+		return;
+
+	int cell[3];
+	int step[3];
+	float tNext[3];
+	float tDelta[3];
+	for(int a = 0; a < 3; ++a)
+	{
+		cell[a] = ToCell(orig[a] + dirs[a]*t0, mInvCellSize);
+		cell[a] = (std::max)(cell[a], mOccupied.Min[a]);
+		cell[a] = (std::min)(cell[a], mOccupied.Max[a]);
+
+		if(dirs[a] > 0.0f)
+		{
+			step[a] = 1;
+			tNext[a] = ((cell[a] + 1)*mCellSize - orig[a]) / dirs[a];
+			tDelta[a] = mCellSize / dirs[a];
+		}
+		else if(dirs[a] < 0.0f)
+		{
+			step[a] = -1;
+			tNext[a] = (cell[a]*mCellSize - orig[a]) / dirs[a];
+			tDelta[a] = -mCellSize / dirs[a];
+		}
+		else
+		{
+			step[a] = 0;
+			tNext[a] = FLT_MAX;
+			tDelta[a] = FLT_MAX;
+		}
+	}
+
+	for(;;)
+	{
+		auto it = mCells.find(CellKey(cell[0], cell[1], cell[2]));
+		if(it != mCells.end())
+			QueryCell(it->second, false, test, items);
+
+		int axis = 0;
+		if(tNext[1] < tNext[axis])
+			axis = 1;
+		if(tNext[2] < tNext[axis])
+			axis = 2;
+
+		if(tNext[axis] > t1)
+			break;
+
+		cell[axis] += step[axis];
+		if(cell[axis] < mOccupied.Min[axis] || cell[axis] > mOccupied.Max[axis])
+			break;
+
+		tNext[axis] += tDelta[axis];
+	}
+}
+
+template<typename Test>
+void SpatialHashGrid::QueryRange(CellRange range, const Test& test, std::vector<uint32>& items)const
+{
+	mCurrentStamp++;
+	QueryLargeItems(test, items);
+
+	if(!mHasOccupied)
+		return;
+
+	for(int a = 0; a < 3; ++a)
+	{
+		range.Min[a] = (std::max)(range.Min[a], mOccupied.Min[a]);
+		range.Max[a] = (std::min)(range.Max[a], mOccupied.Max[a]);
+	}
+
+	uint64 rangeCells = range.GetCellCount();
+	if(rangeCells == 0)
+		return;
+
+	auto visitCell = [&](int x, int y, int z, const std::vector<uint32>& cell)
+	{
+		// Every item listed in a cell overlaps it, so a cell inside the volume
+		// means its items intersect the volume too.
+		ContainmentType ct = test(GetCellBounds(x, y, z));
+		if(ct != DISJOINT)
+			QueryCell(cell, ct == CONTAINS, test, items);
+	};
+
+	// Large volumes over a sparse world would visit mostly empty cells, so walk
+	// whichever is smaller: the cells in range or the cells that exist.
+	if(rangeCells > (uint64)mCells.size())
+	{
+		for(const auto& c : mCells)
+		{
+			int x, y, z;
+			CellCoords(c.first, x, y, z);
+
+			if(x < range.Min[0] || x > range.Max[0] ||
+				y < range.Min[1] || y > range.Max[1] ||
+				z < range.Min[2] || z > range.Max[2])
+				continue;
+
+			visitCell(x, y, z, c.second);
+		}
+		return;
+	}
+
+	for(int z = range.Min[2]; z <= range.Max[2]; ++z)
+	{
+		for(int y = range.Min[1]; y <= range.Max[1]; ++y)
+		{
+			for(int x = range.Min[0]; x <= range.Max[0]; ++x)
+			{
+				auto it = mCells.find(CellKey(x, y, z));
+				if(it != mCells.end())
+					visitCell(x, y, z, it->second);
+			}
+		}
+	}
+}
+
+template<typename Test>
+void SpatialHashGrid::QueryCell(const std::vector<uint32>& cell, bool inside, const Test& test, std::vector<uint32>& items)const
+{
+	for(uint32 item : cell)
+	{
+		if(!MarkVisited(item))
+			continue;
+
+		if(inside || test(mItems[item].Bounds) != DISJOINT)
+			items.push_back(item);
+	}
+}
+
+template<typename Test>
+void SpatialHashGrid::QueryLargeItems(const Test& test, std::vector<uint32>& items)const
+{
+	for(uint32 item : mLargeItems)
+	{
+		if(test(mItems[item].Bounds) != DISJOINT)
+			items.push_back(item);
+	}
+}
+
+bool SpatialHashGrid::MarkVisited(uint32 item)const
+{
+	if(mVisitStamp.size() < mItems.size())
+		mVisitStamp.resize(mItems.size(), 0);
+
+	// On wrap around, old stamps could match the new ones; start over.
+	if(mCurrentStamp == 0)
+	{
+		std::fill(mVisitStamp.begin(), mVisitStamp.end(), 0);
+		mCurrentStamp = 1;
+	}
+
+	if(mVisitStamp[item] == mCurrentStamp)
+		return false;
+
+	mVisitStamp[item] = mCurrentStamp;
+	return true;
+}
+
+SpatialHashGrid::CellRange SpatialHashGrid::GetCellRange(const XMFLOAT3& vMin, const XMFLOAT3& vMax)const
+{
+	CellRange r;
+	r.Min[0] = ToCell(vMin.x, mInvCellSize);
+	r.Min[1] = ToCell(vMin.y, mInvCellSize);
+	r.Min[2] = ToCell(vMin.z, mInvCellSize);
+	r.Max[0] = ToCell(vMax.x, mInvCellSize);
+	r.Max[1] = ToCell(vMax.y, mInvCellSize);
+	r.Max[2] = ToCell(vMax.z, mInvCellSize);
+	return r;
+}
+
+SpatialHashGrid::CellRange SpatialHashGrid::GetCellRange(const BoundingBox& bounds)const
+{
+	const XMFLOAT3& c = bounds.Center;
+	const XMFLOAT3& e = bounds.Extents;
+
+	return GetCellRange(XMFLOAT3(c.x - e.x, c.y - e.y, c.z - e.z), XMFLOAT3(c.x + e.x, c.y + e.y, c.z + e.z));
+}
+
+SpatialHashGrid::uint64 SpatialHashGrid::CellKey(int x, int y, int z)
+{
+	return ((uint64)(x + CoordBias) & CoordMask) |
+		(((uint64)(y + CoordBias) & CoordMask) << 21) |
+		(((uint64)(z + CoordBias) & CoordMask) << 42);
+}
+
+void SpatialHashGrid::CellCoords(uint64 key, int& x, int& y, int& z)
+{
+	x = (int)(key & CoordMask) - CoordBias;
+	y = (int)((key >> 21) & CoordMask) - CoordBias;
+	z = (int)((key >> 42) & CoordMask) - CoordBias;
+}
+
+BoundingBox SpatialHashGrid::GetCellBounds(int x, int y, int z)const
+{
+	float h = 0.5f*mCellSize;
+	return BoundingBox(
+		XMFLOAT3((x + 0.5f)*mCellSize, (y + 0.5f)*mCellSize, (z + 0.5f)*mCellSize),
+		XMFLOAT3(h, h, h));
+}
+
+void SpatialHashGrid::AddToCells(uint32 item)
+{
+	ItemEntry& e = mItems[item];
+
+	e.Large = e.Cells.GetCellCount() > mMaxCellsPerItem;
+	if(e.Large)
+	{
+		mLargeItems.push_back(item);
+		return;
+	}
+
+	for(int z = e.Cells.Min[2]; z <= e.Cells.Max[2]; ++z)
+		for(int y = e.Cells.Min[1]; y <= e.Cells.Max[1]; ++y)
+			for(int x = e.Cells.Min[0]; x <= e.Cells.Max[0]; ++x)
+				mCells[CellKey(x, y, z)].push_back(item);
+
+	if(!mHasOccupied)
+	{
+		mOccupied = e.Cells;
+		mHasOccupied = true;
+		return;
+	}
+
+	for(int a = 0; a < 3; ++a)
+	{
+		mOccupied.Min[a] = (std::min)(mOccupied.Min[a], e.Cells.Min[a]);
+		mOccupied.Max[a] = (std::max)(mOccupied.Max[a], e.Cells.Max[a]);
+	}
+}
+
+void SpatialHashGrid::RemoveFromCells(uint32 item)
+{
+	ItemEntry& e = mItems[item];
+
+	if(e.Large)
+	{
+		auto it = std::find(mLargeItems.begin(), mLargeItems.end(), item);
+		*it = mLargeItems.back();
+		mLargeItems.pop_back();
+		return;
+	}
+
+	for(int z = e.Cells.Min[2]; z <= e.Cells.Max[2]; ++z)
+	{
+		for(int y = e.Cells.Min[1]; y <= e.Cells.Max[1]; ++y)
+		{
+			for(int x = e.Cells.Min[0]; x <= e.Cells.Max[0]; ++x)
+			{
+				auto cell = mCells.find(CellKey(x, y, z));
+				std::vector<uint32>& list = cell->second;
+
+				auto it = std::find(list.begin(), list.end(), item);
+				*it = list.back();
+				list.pop_back();
+
+				// Drop empty cells so the map only holds occupied ones.
+				if(list.empty())
+					mCells.erase(cell);
+			}
+		}
+	}
+}
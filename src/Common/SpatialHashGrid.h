@@ -0,0 +1,103 @@
+//***************************************************************************************
+// SpatialHashGrid.h
+//
+// Uniform grid of cubic cells where only the cells that hold items exist; they are
+// found by hashing the integer cell coordinates, so the world does not need to be
+// bounded up front.  An item is listed in every cell its bounds overlap, which makes
+// updates O(1) for items no larger than a few cells.  Items that would span more than
+// maxCellsPerItem cells are kept in a separate list that every query tests.
+//
+// Choose the cell size close to the size of a typical item.
+//***************************************************************************************
+
+#pragma once
+
+#include <unordered_map>
+#include "SpatialIndex.h"
+
+class SpatialHashGrid : public SpatialIndex
+{
+public:
+
+    using uint64 = std::uint64_t;
+
+	SpatialHashGrid(float cellSize, uint32 maxCellsPerItem = 64);
+	SpatialHashGrid(const SpatialHashGrid& rhs) = delete;
+	SpatialHashGrid& operator=(const SpatialHashGrid& rhs) = delete;
+
+	virtual void Insert(uint32 item, const DirectX::BoundingBox& worldBounds)override;
+	virtual void Move(uint32 item, const DirectX::BoundingBox& worldBounds)override;
+	virtual void Remove(uint32 item)override;
+
+	virtual bool Contains(uint32 item)const override;
+	virtual uint32 GetItemCount()const override { return mItemCount; }
+
+	virtual void QueryFrustum(const DirectX::BoundingFrustum& worldFrustum, std::vector<uint32>& items)const override;
+	virtual void QuerySphere(const DirectX::BoundingSphere& worldSphere, std::vector<uint32>& items)const override;
+	virtual void QueryRay(DirectX::FXMVECTOR rayOrigin, DirectX::FXMVECTOR rayDir, float maxDist,
+		std::vector<uint32>& items)const override;
+
+	float GetCellSize()const { return mCellSize; }
+	uint32 GetCellCount()const { return (uint32)mCells.size(); }
+
+private:
+	struct CellRange
+	{
+		int Min[3];
+		int Max[3];
+
+		bool operator==(const CellRange& rhs)const;
+		uint64 GetCellCount()const;
+	};
+
+	struct ItemEntry
+	{
+		DirectX::BoundingBox Bounds;
+		CellRange Cells;
+		bool Present = false;
+		bool Large = false;
+	};
+
+	CellRange GetCellRange(const DirectX::XMFLOAT3& vMin, const DirectX::XMFLOAT3& vMax)const;
+	CellRange GetCellRange(const DirectX::BoundingBox& bounds)const;
+	static uint64 CellKey(int x, int y, int z);
+	static void CellCoords(uint64 key, int& x, int& y, int& z);
+	DirectX::BoundingBox GetCellBounds(int x, int y, int z)const;
+
+	void AddToCells(uint32 item);
+	void RemoveFromCells(uint32 item);
+
+	// Tests the items of the cells in range (clamped to the occupied cells) and the
+	// large items.  Test returns the ContainmentType of a box.
+	template<typename Test>
+	void QueryRange(CellRange range, const Test& test, std::vector<uint32>& items)const;
+
+	template<typename Test>
+	void QueryCell(const std::vector<uint32>& cell, bool inside, const Test& test, std::vector<uint32>& items)const;
+
+	template<typename Test>
+	void QueryLargeItems(const Test& test, std::vector<uint32>& items)const;
+
+	// Marks an item as reported by the current query.  Returns false if it already was.
+	bool MarkVisited(uint32 item)const;
+
+private:
+	float mCellSize = 1.0f;
+	float mInvCellSize = 1.0f;
+	uint32 mMaxCellsPerItem = 64;
+
+	std::unordered_map<uint64, std::vector<uint32>> mCells;
+	std::vector<uint32> mLargeItems;
+
+	std::vector<ItemEntry> mItems;
+	uint32 mItemCount = 0;
+
+	// Bounds of every cell that has been occupied; queries never look outside it.
+	CellRange mOccupied;
+	bool mHasOccupied = false;
+
+	// An item spans several cells, so queries stamp the items they report to
+	// return each one once.
+	mutable std::vector<uint32> mVisitStamp;
+	mutable uint32 mCurrentStamp = 0;
+};
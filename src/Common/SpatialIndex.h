@@ -0,0 +1,55 @@
+//***************************************************************************************
+// SpatialIndex.h
+//
+// Interface shared by the spatial structures used to find render items (or instances)
+// near a region of the world without looping over all of them.  Items are identified
+// by a caller chosen id, typically the index of the item in the app's own array, and
+// are stored by their world space axis-aligned bounds.
+//
+// Two implementations are provided:
+//   -LooseOctree:     adapts to any distribution of items and item sizes.
+//   -SpatialHashGrid: constant time updates; best when items are of similar size
+//                     and spread over a large world.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+
+class SpatialIndex
+{
+public:
+
+    using uint32 = std::uint32_t;
+
+	virtual ~SpatialIndex() = default;
+
+	// Adds an item.  The id must not already be in the index.  Ids index an internal
+	// array, so keep them dense (0, 1, 2, ...).
+	virtual void Insert(uint32 item, const DirectX::BoundingBox& worldBounds) = 0;
+
+	// Updates the bounds of an item that is already in the index.
+	virtual void Move(uint32 item, const DirectX::BoundingBox& worldBounds) = 0;
+
+	virtual void Remove(uint32 item) = 0;
+
+	virtual bool Contains(uint32 item)const = 0;
+	virtual uint32 GetItemCount()const = 0;
+
+	///<summary>
+	/// Appends to items the id of every item whose bounds intersect or are inside the
+	/// world space volume.  Each id is appended once, in no particular order.
+	///</summary>
+	virtual void QueryFrustum(const DirectX::BoundingFrustum& worldFrustum, std::vector<uint32>& items)const = 0;
+	virtual void QuerySphere(const DirectX::BoundingSphere& worldSphere, std::vector<uint32>& items)const = 0;
+
+	///<summary>
+	/// Appends the id of every item whose bounds the ray enters before maxDist.  The
+	/// direction must be unit length.  Results are not sorted by distance.
+	///</summary>
+	virtual void QueryRay(DirectX::FXMVECTOR rayOrigin, DirectX::FXMVECTOR rayDir, float maxDist,
+		std::vector<uint32>& items)const = 0;
+};
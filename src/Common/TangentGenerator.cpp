@@ -0,0 +1,448 @@
+//***************************************************************************************
+// TangentGenerator.cpp
+//***************************************************************************************
+
+#include "TangentGenerator.h"
+#include <ppl.h>
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+using namespace DirectX;
+
+namespace
+{
+	using uint32 = TangentGenerator::uint32;
+	using Vertex = GeometryGenerator::Vertex;
+
+	const uint32 NoVertex = 0xffffffff;
+
+	// Triangles or vertices per parallel task.  Smaller meshes run on the calling thread.
+	const uint32 ItemsPerTask = 4096;
+
+	///<summary>
+	/// Calls processRange(first, last) over [0, count) in chunks of ItemsPerTask, in
+	/// parallel when there is more than one chunk.  Each item must write only its
+	/// own part of the output.
+	///</summary>
+	template<typename F>
+	void ForEachChunk(uint32 count, const F& processRange)
+	{
+		uint32 taskCount = (count + ItemsPerTask - 1) / ItemsPerTask;
+
+		auto processTask = [&](uint32 task)
+		{
+			uint32 first = task*ItemsPerTask;
+			processRange(first, std::min(first + ItemsPerTask, count));
+		};
+
+		if(taskCount == 1)
+			processTask(0);
+		else if(taskCount > 1)
+			concurrency::parallel_for(0u, taskCount, processTask);
+	}
+
+	// Lexicographic order on the first n floats of a and b.
+	bool LessFloats(const float* a, const float* b, int n)
+	{
+		for(int i = 0; i < n; ++i)
+		{
+			if(a[i] != b[i])
+				return a[i] < b[i];
+		}
+
+		return false;
+	}
+
+	bool EqualFloat3(const XMFLOAT3& a, const XMFLOAT3& b)
+	{
+		return a.x == b.x && a.y == b.y && a.z == b.z;
+	}
+
+	///<summary>
+	/// Returns, for every vertex, the lowest index of a vertex that less considers
+	/// equal to it.
+	///</summary>
+	template<typename Less>
+	std::vector<uint32> WeldVertices(uint32 vertexCount, const Less& less)
+	{
+		std::vector<uint32> order(vertexCount);
+		std::iota(order.begin(), order.end(), 0u);
+
+		std::sort(order.begin(), order.end(), [&](uint32 a, uint32 b)
+		{
+			return less(a, b) || (!less(b, a) && a < b);
+		});
+
+		std::vector<uint32> rep(vertexCount);
+		for(uint32 i = 0; i < vertexCount; ++i)
+		{
+			if(i > 0 && !less(order[i-1], order[i]))
+				rep[order[i]] = rep[order[i-1]];
+			else
+				rep[order[i]] = order[i];
+		}
+
+		return rep;
+	}
+
+	// The corners (index buffer positions) grouped by key, in index order.  The
+	// corners of key k are Corners[Offsets[k]] to Corners[Offsets[k+1]-1].
+	struct CornerLists
+	{
+		std::vector<uint32> Offsets;
+		std::vector<uint32> Corners;
+	};
+
+	CornerLists BuildCornerLists(const std::vector<uint32>& cornerKeys, uint32 keyCount)
+	{
+		CornerLists lists;
+		lists.Offsets.assign(keyCount + 1, 0);
+		lists.Corners.resize(cornerKeys.size());
+
+		for(uint32 key : cornerKeys)
+			++lists.Offsets[key + 1];
+
+		for(uint32 k = 0; k < keyCount; ++k)
+			lists.Offsets[k + 1] += lists.Offsets[k];
+
+		std::vector<uint32> next(lists.Offsets.begin(), lists.Offsets.end() - 1);
+		for(uint32 c = 0; c < (uint32)cornerKeys.size(); ++c)
+			lists.Corners[next[cornerKeys[c]]++] = c;
+
+		return lists;
+	}
+
+	// Unit length v, or zero if v is too short to normalize.
+	XMVECTOR SafeNormalize(FXMVECTOR v)
+	{
+		float length = XMVectorGetX(XMVector3Length(v));
+		return length > 1e-20f ? XMVectorScale(v, 1.0f / length) : XMVectorZero();
+	}
+
+	bool IsZero(FXMVECTOR v)
+	{
+		return XMVector3Equal(v, XMVectorZero());
+	}
+
+	// Some unit vector perpendicular to the unit vector n.
+	XMVECTOR AnyTangent(FXMVECTOR n)
+	{
+		XMVECTOR up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+		if(fabsf(XMVectorGetX(XMVector3Dot(n, up))) < 1.0f - 0.001f)
+			return XMVector3Normalize(XMVector3Cross(up, n));
+
+		up = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
+		return XMVector3Normalize(XMVector3Cross(n, up));
+	}
+
+	// Angle between the unit vectors a and b; zero if either is zero.
+	float AngleBetween(FXMVECTOR a, FXMVECTOR b)
+	{
+		float c = XMVectorGetX(XMVector3Dot(a, b));
+		return acosf(std::min(std::max(c, -1.0f), 1.0f));
+	}
+
+	// a projected into the plane with unit normal n.
+	XMVECTOR ProjectToPlane(FXMVECTOR a, FXMVECTOR n)
+	{
+		return XMVectorSubtract(a, XMVectorMultiply(XMVector3Dot(n, a), n));
+	}
+}
+
+void TangentGenerator::ComputeNormals(GeometryGenerator::MeshData& meshData, float smoothingAngle)
+{
+	std::vector<Vertex>& vertices = meshData.Vertices;
+	std::vector<uint32>& indices = meshData.Indices32;
+
+	const uint32 vertexCount = (uint32)vertices.size();
+	const uint32 cornerCount = (uint32)indices.size() / 3 * 3;
+	const uint32 faceCount = cornerCount / 3;
+	const float cosSmoothing = cosf(smoothingAngle);
+
+	// Unit face normals (zero for degenerate triangles) and the angle of each corner.
+	std::vector<XMFLOAT3> faceNormals(faceCount);
+	std::vector<float> cornerAngles(cornerCount);
+
+	ForEachChunk(faceCount, [&](uint32 first, uint32 last)
+	{
+		for(uint32 f = first; f < last; ++f)
+		{
+			XMVECTOR p[3];
+			for(uint32 k = 0; k < 3; ++k)
+				p[k] = XMLoadFloat3(&vertices[indices[3*f + k]].Position);
+
+			XMVECTOR n = XMVector3Cross(XMVectorSubtract(p[1], p[0]), XMVectorSubtract(p[2], p[0]));
+			XMStoreFloat3(&faceNormals[f], SafeNormalize(n));
+
+			for(uint32 k = 0; k < 3; ++k)
+			{
+				XMVECTOR e1 = SafeNormalize(XMVectorSubtract(p[(k + 1) % 3], p[k]));
+				XMVECTOR e2 = SafeNormalize(XMVectorSubtract(p[(k + 2) % 3], p[k]));
+				cornerAngles[3*f + k] = IsZero(e1) || IsZero(e2) ? 0.0f : AngleBetween(e1, e2);
+			}
+		}
+	});
+
+	// Gather the corners at each position.
+	std::vector<uint32> rep = WeldVertices(vertexCount, [&](uint32 a, uint32 b)
+	{
+		return LessFloats(&vertices[a].Position.x, &vertices[b].Position.x, 3);
+	});
+
+	std::vector<uint32> cornerKeys(cornerCount);
+	for(uint32 c = 0; c < cornerCount; ++c)
+		cornerKeys[c] = rep[indices[c]];
+
+	CornerLists lists = BuildCornerLists(cornerKeys, vertexCount);
+
+	// Every corner averages the triangles at its position that lie within the
+	// smoothing angle of its own.  Corners that average the same triangles sum them
+	// in the same order, so their normals compare equal below.
+	std::vector<XMFLOAT3> cornerNormals(cornerCount);
+
+	ForEachChunk(vertexCount, [&](uint32 first, uint32 last)
+	{
+		for(uint32 key = first; key < last; ++key)
+		{
+			const uint32* corners = lists.Corners.data() + lists.Offsets[key];
+			const uint32 count = lists.Offsets[key + 1] - lists.Offsets[key];
+
+			for(uint32 i = 0; i < count; ++i)
+			{
+				XMVECTOR own = XMLoadFloat3(&faceNormals[corners[i] / 3]);
+				bool ownDegenerate = IsZero(own);
+
+				XMVECTOR sum = XMVectorZero();
+				for(uint32 j = 0; j < count; ++j)
+				{
+					XMVECTOR other = XMLoadFloat3(&faceNormals[corners[j] / 3]);
+					if(ownDegenerate || XMVectorGetX(XMVector3Dot(own, other)) >= cosSmoothing)
+						sum = XMVectorAdd(sum, XMVectorScale(other, cornerAngles[corners[j]]));
+				}
+
+				XMVECTOR n = SafeNormalize(sum);
+				if(IsZero(n))
+					n = ownDegenerate ? XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f) : own;
+
+				XMStoreFloat3(&cornerNormals[corners[i]], n);
+			}
+		}
+	});
+
+	// Write the normals back, giving a vertex a copy for every further normal its
+	// corners need.  nextCopy chains each vertex to its copies.
+	std::vector<uint32> nextCopy(vertexCount, NoVertex);
+	std::vector<bool> assigned(vertexCount, false);
+
+	for(uint32 c = 0; c < cornerCount; ++c)
+	{
+		uint32 v = indices[c];
+		const XMFLOAT3& n = cornerNormals[c];
+
+		if(!assigned[v])
+		{
+			vertices[v].Normal = n;
+			assigned[v] = true;
+			continue;
+		}
+
+		uint32 w = v;
+		while(!EqualFloat3(vertices[w].Normal, n))
+		{
+			if(nextCopy[w] == NoVertex)
+			{
+				Vertex copy = vertices[v];
+				copy.Normal = n;
+				vertices.push_back(copy);
+				nextCopy.push_back(NoVertex);
+
+				nextCopy[w] = (uint32)vertices.size() - 1;
+			}
+
+			w = nextCopy[w];
+		}
+
+		indices[c] = w;
+	}
+}
+
+void TangentGenerator::ComputeTangents(GeometryGenerator::MeshData& meshData,
+	std::vector<float>* bitangentSigns)
+{
+	std::vector<Vertex>& vertices = meshData.Vertices;
+	std::vector<uint32>& indices = meshData.Indices32;
+
+	const uint32 vertexCount = (uint32)vertices.size();
+	const uint32 cornerCount = (uint32)indices.size() / 3 * 3;
+	const uint32 faceCount = cornerCount / 3;
+
+	// Unit direction of increasing u on each triangle, and whether its texture
+	// mapping keeps (Preserving) or mirrors the winding.  Valid is false where the
+	// texture coordinates or positions are degenerate.
+	struct FaceFrame
+	{
+		XMFLOAT3 Tangent;
+		bool Valid;
+		bool Preserving;
+	};
+
+	std::vector<FaceFrame> faces(faceCount);
+
+	ForEachChunk(faceCount, [&](uint32 first, uint32 last)
+	{
+		for(uint32 f = first; f < last; ++f)
+		{
+			const Vertex& v0 = vertices[indices[3*f + 0]];
+			const Vertex& v1 = vertices[indices[3*f + 1]];
+			const Vertex& v2 = vertices[indices[3*f + 2]];
+
+			XMVECTOR d1 = XMVectorSubtract(XMLoadFloat3(&v1.Position), XMLoadFloat3(&v0.Position));
+			XMVECTOR d2 = XMVectorSubtract(XMLoadFloat3(&v2.Position), XMLoadFloat3(&v0.Position));
+
+			float t21x = v1.TexC.x - v0.TexC.x;
+			float t21y = v1.TexC.y - v0.TexC.y;
+			float t31x = v2.TexC.x - v0.TexC.x;
+			float t31y = v2.TexC.y - v0.TexC.y;
+
+			float signedArea = t21x*t31y - t21y*t31x;
+
+			// dP/du up to the factor 1/signedArea, whose sign is restored below.
+			XMVECTOR t = XMVectorSubtract(XMVectorScale(d1, t31y), XMVectorScale(d2, t21y));
+			t = SafeNormalize(t);
+
+			FaceFrame& face = faces[f];
+			face.Preserving = signedArea > 0.0f;
+			face.Valid = signedArea != 0.0f && !IsZero(t);
+			XMStoreFloat3(&face.Tangent, face.Preserving ? t : XMVectorNegate(t));
+		}
+	});
+
+	// Merge vertices that agree in every attribute the frame depends on.
+	std::vector<uint32> rep = WeldVertices(vertexCount, [&](uint32 a, uint32 b)
+	{
+		const Vertex& va = vertices[a];
+		const Vertex& vb = vertices[b];
+
+		if(!EqualFloat3(va.Position, vb.Position))
+			return LessFloats(&va.Position.x, &vb.Position.x, 3);
+		if(!EqualFloat3(va.Normal, vb.Normal))
+			return LessFloats(&va.Normal.x, &vb.Normal.x, 3);
+
+		return LessFloats(&va.TexC.x, &vb.TexC.x, 2);
+	});
+
+	// Triangles with degenerate texture coordinates join the preserving frame of
+	// the vertex, or the mirrored one if that is all the vertex has.
+	std::vector<bool> hasPreserving(vertexCount, false);
+	std::vector<bool> hasMirrored(vertexCount, false);
+	for(uint32 c = 0; c < cornerCount; ++c)
+	{
+		const FaceFrame& face = faces[c / 3];
+		if(face.Valid)
+		{
+			if(face.Preserving)
+				hasPreserving[rep[indices[c]]] = true;
+			else
+				hasMirrored[rep[indices[c]]] = true;
+		}
+	}
+
+	// Key 2*v+1 is the preserving frame of merged vertex v and 2*v the mirrored one.
+	std::vector<uint32> cornerKeys(cornerCount);
+	for(uint32 c = 0; c < cornerCount; ++c)
+	{
+		uint32 v = rep[indices[c]];
+		const FaceFrame& face = faces[c / 3];
+
+		bool preserving = face.Valid ? face.Preserving : (hasPreserving[v] || !hasMirrored[v]);
+		cornerKeys[c] = 2*v + (preserving ? 1 : 0);
+	}
+
+	CornerLists lists = BuildCornerLists(cornerKeys, 2*vertexCount);
+
+	std::vector<XMFLOAT3> keyTangents(2*vertexCount);
+
+	ForEachChunk(2*vertexCount, [&](uint32 first, uint32 last)
+	{
+		for(uint32 key = first; key < last; ++key)
+		{
+			const uint32 begin = lists.Offsets[key];
+			const uint32 end = lists.Offsets[key + 1];
+			if(begin == end)
+				continue;
+
+			XMVECTOR n = SafeNormalize(XMLoadFloat3(&vertices[key / 2].Normal));
+
+			XMVECTOR sum = XMVectorZero();
+			for(uint32 i = begin; i < end; ++i)
+			{
+				uint32 c = lists.Corners[i];
+				const FaceFrame& face = faces[c / 3];
+				if(!face.Valid)
+					continue;
+
+				XMVECTOR t = SafeNormalize(ProjectToPlane(XMLoadFloat3(&face.Tangent), n));
+
+				// Weight by the angle of the triangle at the vertex, measured in the
+				// tangent plane.
+				uint32 f = c / 3;
+				uint32 k = c % 3;
+				XMVECTOR p = XMLoadFloat3(&vertices[indices[c]].Position);
+				XMVECTOR prev = XMLoadFloat3(&vertices[indices[3*f + (k + 2) % 3]].Position);
+				XMVECTOR next = XMLoadFloat3(&vertices[indices[3*f + (k + 1) % 3]].Position);
+
+				XMVECTOR e1 = SafeNormalize(ProjectToPlane(XMVectorSubtract(prev, p), n));
+				XMVECTOR e2 = SafeNormalize(ProjectToPlane(XMVectorSubtract(next, p), n));
+
+				sum = XMVectorAdd(sum, XMVectorScale(t, AngleBetween(e1, e2)));
+			}
+
+			XMVECTOR t = SafeNormalize(sum);
+			if(IsZero(t))
+				t = IsZero(n) ? XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f) : AnyTangent(n);
+
+			XMStoreFloat3(&keyTangents[key], t);
+		}
+	});
+
+	// Write the frames back.  A vertex whose corners need both frames gets a copy
+	// for the second one.
+	std::vector<uint32> vertexKey(vertexCount, NoVertex);
+	std::vector<uint32> copyOf(vertexCount, NoVertex);
+
+	for(uint32 c = 0; c < cornerCount; ++c)
+	{
+		uint32 v = indices[c];
+		uint32 key = cornerKeys[c];
+
+		if(vertexKey[v] == NoVertex)
+		{
+			vertexKey[v] = key;
+			vertices[v].TangentU = keyTangents[key];
+			continue;
+		}
+
+		if(vertexKey[v] == key)
+			continue;
+
+		if(copyOf[v] == NoVertex)
+		{
+			Vertex copy = vertices[v];
+			copy.TangentU = keyTangents[key];
+			vertices.push_back(copy);
+			vertexKey.push_back(key);
+
+			copyOf[v] = (uint32)vertices.size() - 1;
+		}
+
+		indices[c] = copyOf[v];
+	}
+
+	if(bitangentSigns != nullptr)
+	{
+		bitangentSigns->resize(vertices.size());
+		for(size_t v = 0; v < vertices.size(); ++v)
+			(*bitangentSigns)[v] = vertexKey[v] == NoVertex || (vertexKey[v] & 1) ? 1.0f : -1.0f;
+	}
+}
@@ -0,0 +1,56 @@
+//***************************************************************************************
+// TangentGenerator.h
+//
+// Builds vertex normals and tangent frames for meshes that come without them, such
+// as the models loaded from text files, so they can be lit and normal mapped like
+// the shapes GeometryGenerator makes.  Everything runs once at load time and splits
+// the work across cores.
+//
+// ComputeTangents follows MikkTSpace, the convention most content tools bake normal
+// maps against.  Vertices are first merged when their position, normal and texture
+// coordinates are all equal, so index buffer duplicates never disagree.  Each
+// triangle's direction of increasing u is projected into the tangent plane of the
+// vertex normal, and a vertex averages those of its triangles weighted by the angle
+// of the triangle at the vertex.  Triangles whose texture mapping is mirrored are
+// averaged separately from the others and get a bitangent sign of -1.  For a
+// vertex whose triangles form a single fan the result is the one MikkTSpace gives.
+// Two deliberate differences: triangles with degenerate texture coordinates only
+// pick up the frame of their neighbours, and a vertex with no usable triangle at
+// all gets some tangent perpendicular to its normal instead of a zero vector.
+//
+// Both functions may add vertices: a vertex is split when it needs two normals
+// (across a hard edge) or two tangent frames (across a mirror seam).  Call them
+// before GetIndices16 on the mesh.
+//
+// The code only depends on the standard library, DirectXMath and PPL.
+//***************************************************************************************
+
+#pragma once
+
+#include <vector>
+#include "GeometryGenerator.h"
+
+class TangentGenerator
+{
+public:
+
+    using uint32 = std::uint32_t;
+
+	///<summary>
+	/// Replaces the normal of every vertex with the angle weighted average of the
+	/// triangles around its position.  Only triangles that meet at less than
+	/// smoothingAngle (radians) are averaged, so sharper edges stay hard; pass
+	/// XM_PI to smooth everything.  Vertices at the same position share normals
+	/// even when their other attributes differ, so texture seams stay invisible.
+	///</summary>
+	static void ComputeNormals(GeometryGenerator::MeshData& meshData, float smoothingAngle);
+
+	///<summary>
+	/// Sets TangentU of every vertex from its normal and texture coordinates.  When
+	/// bitangentSigns is given it receives one value per vertex, +1 or -1, to scale
+	/// cross(N, T) by; the book's shaders assume +1, which holds unless the texture
+	/// mapping is mirrored somewhere.
+	///</summary>
+	static void ComputeTangents(GeometryGenerator::MeshData& meshData,
+		std::vector<float>* bitangentSigns = nullptr);
+};
@@ -0,0 +1,408 @@
+//***************************************************************************************
+// TerrainStreamer.cpp
+//***************************************************************************************
+
+#include "TerrainStreamer.h"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+
+using namespace DirectX;
+
+const TerrainStreamer::uint32 TerrainStreamer::StitchNorth;
+const TerrainStreamer::uint32 TerrainStreamer::StitchEast;
+const TerrainStreamer::uint32 TerrainStreamer::StitchSouth;
+const TerrainStreamer::uint32 TerrainStreamer::StitchWest;
+const TerrainStreamer::uint32 TerrainStreamer::StitchMaskCount;
+
+namespace
+{
+	using uint32 = TerrainStreamer::uint32;
+	using uint64 = TerrainStreamer::uint64;
+
+	uint64 ChunkKey(int x, int z)
+	{
+		return (uint64)(uint32)x << 32 | (uint32)z;
+	}
+
+	uint32 Ring(int dx, int dz)
+	{
+		return (uint32)std::max(std::abs(dx), std::abs(dz));
+	}
+}
+
+TerrainStreamer::TerrainStreamer(const Settings& settings, HeightFunction height) :
+	mSettings(settings),
+	mHeight(std::move(height))
+{
+	assert(mSettings.QuadsPerChunk >= 4 && (mSettings.QuadsPerChunk & (mSettings.QuadsPerChunk - 1)) == 0);
+	assert(mSettings.LodRingWidth >= 1);
+
+	// Keep the coarsest level at 4 quads a side or more, so that its border strips
+	// still have an inner row to stitch to.
+	uint32 maxLodCount = 1;
+	while((mSettings.QuadsPerChunk >> maxLodCount) >= 4)
+		++maxLodCount;
+	mSettings.LodCount = std::min(std::max(mSettings.LodCount, 1u), maxLodCount);
+
+	mVerticesPerSide = mSettings.QuadsPerChunk + 1;
+	assert(mVerticesPerSide*mVerticesPerSide <= 0x10000);
+
+	// Every chunk in range, plus the chunks of a ring crossing for each update a
+	// released slot waits out, so that steady movement never runs out of slots.
+	uint32 side = 2*mSettings.ViewRadius + 1;
+	mSlotCount = side*side + side*(mSettings.RecycleDelay + 1);
+
+	mSlotVertices.resize((size_t)mSlotCount*GetVerticesPerChunk());
+	mSlotBounds.resize(mSlotCount);
+
+	mFreeSlots.reserve(mSlotCount);
+	for(uint32 i = mSlotCount; i > 0; --i)
+		mFreeSlots.push_back(i - 1);
+
+	BuildOffsets();
+	BuildIndexPatterns();
+}
+
+TerrainStreamer::~TerrainStreamer()
+{
+	mTasks.wait();
+}
+
+TerrainStreamer::uint32 TerrainStreamer::LodOfRing(uint32 ring)const
+{
+	return std::min(ring / mSettings.LodRingWidth, mSettings.LodCount - 1);
+}
+
+void TerrainStreamer::BuildOffsets()
+{
+	int r = (int)mSettings.ViewRadius;
+
+	for(int dz = -r; dz <= r; ++dz)
+	{
+		for(int dx = -r; dx <= r; ++dx)
+		{
+			Offset o;
+			o.DX = dx;
+			o.DZ = dz;
+			o.Lod = LodOfRing(Ring(dx, dz));
+
+			// Levels depend only on the offset, so the stitching does too.
+			if(LodOfRing(Ring(dx, dz + 1)) > o.Lod) o.StitchMask |= StitchNorth;
+			if(LodOfRing(Ring(dx + 1, dz)) > o.Lod) o.StitchMask |= StitchEast;
+			if(LodOfRing(Ring(dx, dz - 1)) > o.Lod) o.StitchMask |= StitchSouth;
+			if(LodOfRing(Ring(dx - 1, dz)) > o.Lod) o.StitchMask |= StitchWest;
+
+			mOffsets.push_back(o);
+		}
+	}
+
+	std::sort(mOffsets.begin(), mOffsets.end(), [](const Offset& a, const Offset& b)
+	{
+		return a.DX*a.DX + a.DZ*a.DZ < b.DX*b.DX + b.DZ*b.DZ;
+	});
+}
+
+void TerrainStreamer::BuildIndexPatterns()
+{
+	uint32 q = mSettings.QuadsPerChunk;
+	uint32 rowPitch = mVerticesPerSide;
+
+	// Emits a triangle of (row, column) grid points, turning it clockwise seen from
+	// above: rows run south, so that is counterclockwise in (column, row).
+	auto emit = [&](uint32 r0, uint32 c0, uint32 r1, uint32 c1, uint32 r2, uint32 c2)
+	{
+		int cross = ((int)c1 - (int)c0)*((int)r2 - (int)r0) - ((int)r1 - (int)r0)*((int)c2 - (int)c0);
+		if(cross == 0)
+			return;
+
+		if(cross < 0)
+		{
+			std::swap(r1, r2);
+			std::swap(c1, c2);
+		}
+
+		mIndices.push_back((uint16)(r0*rowPitch + c0));
+		mIndices.push_back((uint16)(r1*rowPitch + c1));
+		mIndices.push_back((uint16)(r2*rowPitch + c2));
+	};
+
+	mDrawRanges.resize(mSettings.LodCount*StitchMaskCount);
+
+	for(uint32 lod = 0; lod < mSettings.LodCount; ++lod)
+	{
+		uint32 step = 1u << lod;
+		uint32 n = q / step;
+
+		for(uint32 mask = 0; mask < StitchMaskCount; ++mask)
+		{
+			DrawRange& range = mDrawRanges[lod*StitchMaskCount + mask];
+			range.StartIndexLocation = (uint32)mIndices.size();
+
+			// Interior quads, one cell in from every edge.
+			for(uint32 i = 1; i + 1 < n; ++i)
+			{
+				for(uint32 j = 1; j + 1 < n; ++j)
+				{
+					uint32 r = i*step;
+					uint32 c = j*step;
+					emit(r, c, r, c + step, r + step, c);
+					emit(r + step, c, r, c + step, r + step, c + step);
+				}
+			}
+
+			// The border: a strip along each side between the edge and the first
+			// inner row, which together with the interior tile the chunk.  The edge
+			// takes every other vertex when it is stitched to a coarser neighbour.
+			// The strip is zipped by advancing along whichever row is behind.
+			const uint32 sides[4] = { StitchNorth, StitchEast, StitchSouth, StitchWest };
+			for(uint32 sideFlag : sides)
+			{
+				// Grid point at distance t along the side, depth rows in from the edge.
+				auto point = [&](uint32 t, uint32 depth, uint32& r, uint32& c)
+				{
+					switch(sideFlag)
+					{
+					case StitchNorth: r = depth*step;     c = t*step;         break;
+					case StitchSouth: r = q - depth*step; c = t*step;         break;
+					case StitchWest:  r = t*step;         c = depth*step;     break;
+					default:          r = t*step;         c = q - depth*step; break;
+					}
+				};
+
+				uint32 outerStride = (mask & sideFlag) ? 2 : 1;
+				uint32 outer = 0;
+				uint32 inner = 1;
+
+				while(outer < n || inner < n - 1)
+				{
+					uint32 r0, c0, r1, c1, r2, c2;
+					point(outer, 0, r0, c0);
+					point(inner, 1, r1, c1);
+
+					if(inner == n - 1 || (outer < n && outer + outerStride <= inner + 1))
+					{
+						point(outer + outerStride, 0, r2, c2);
+						outer += outerStride;
+					}
+					else
+					{
+						point(inner + 1, 1, r2, c2);
+						inner += 1;
+					}
+
+					emit(r0, c0, r1, c1, r2, c2);
+				}
+			}
+
+			range.IndexCount = (uint32)mIndices.size() - range.StartIndexLocation;
+		}
+	}
+}
+
+void TerrainStreamer::GenerateChunk(int x, int z, uint32 slot)
+{
+	uint32 q = mSettings.QuadsPerChunk;
+	uint32 side = mVerticesPerSide;
+	float spacing = mSettings.ChunkSize / q;
+
+	// Heights with a border of one vertex for the normals.  Positions come from the
+	// global vertex index, so chunks agree exactly on the vertices they share.
+	uint32 apronSide = side + 2;
+	std::vector<float> heights((size_t)apronSide*apronSide);
+
+	int64_t firstColumn = (int64_t)x*q - 1;
+	int64_t firstRow = (int64_t)(z + 1)*q + 1;
+	for(uint32 r = 0; r < apronSide; ++r)
+	{
+		float pz = (float)(firstRow - r)*spacing;
+		for(uint32 c = 0; c < apronSide; ++c)
+			heights[r*apronSide + c] = mHeight((float)(firstColumn + c)*spacing, pz);
+	}
+
+	Vertex* vertices = &mSlotVertices[(size_t)slot*GetVerticesPerChunk()];
+	XMVECTOR vMin = XMVectorReplicate(+FLT_MAX);
+	XMVECTOR vMax = XMVectorReplicate(-FLT_MAX);
+
+	for(uint32 r = 0; r < side; ++r)
+	{
+		for(uint32 c = 0; c < side; ++c)
+		{
+			const float* h = &heights[(r + 1)*apronSide + c + 1];
+
+			Vertex& v = vertices[r*side + c];
+			v.Pos = XMFLOAT3(
+				(float)(firstColumn + 1 + c)*spacing,
+				h[0],
+				(float)(firstRow - 1 - r)*spacing);
+
+			// Central differences: (-dh/dx, 1, -dh/dz) scaled by twice the spacing.
+			// The row above is north, the larger z.
+			XMVECTOR n = XMVectorSet(h[-1] - h[1], 2.0f*spacing, h[apronSide] - h[-(int)apronSide], 0.0f);
+			XMStoreFloat3(&v.Normal, XMVector3Normalize(n));
+
+			XMVECTOR p = XMLoadFloat3(&v.Pos);
+			vMin = XMVectorMin(vMin, p);
+			vMax = XMVectorMax(vMax, p);
+		}
+	}
+
+	BoundingBox::CreateFromPoints(mSlotBounds[slot], vMin, vMax);
+
+	std::lock_guard<std::mutex> lock(mCompletedMutex);
+	mCompleted.push_back(std::make_pair(ChunkKey(x, z), slot));
+}
+
+void TerrainStreamer::ReleaseSlot(uint32 slot)
+{
+	mRetiringSlots.push_back(std::make_pair(slot, mUpdateCount));
+}
+
+void TerrainStreamer::Update(const XMFLOAT3& cameraPos)
+{
+	++mUpdateCount;
+	mUpdatedSlots.clear();
+
+	// Slots released long enough ago that no frame in flight can still use them.
+	for(size_t i = 0; i < mRetiringSlots.size(); )
+	{
+		if(mRetiringSlots[i].second + mSettings.RecycleDelay <= mUpdateCount)
+		{
+			mFreeSlots.push_back(mRetiringSlots[i].first);
+			mRetiringSlots[i] = mRetiringSlots.back();
+			mRetiringSlots.pop_back();
+		}
+		else
+			++i;
+	}
+
+	mCenterX = (int)std::floor(cameraPos.x / mSettings.ChunkSize);
+	mCenterZ = (int)std::floor(cameraPos.z / mSettings.ChunkSize);
+
+	auto inRange = [this](int x, int z)
+	{
+		return Ring(x - mCenterX, z - mCenterZ) <= mSettings.ViewRadius;
+	};
+
+	// Collect the chunks the workers finished.
+	std::vector<std::pair<uint64, uint32>> completed;
+	{
+		std::lock_guard<std::mutex> lock(mCompletedMutex);
+		completed.swap(mCompleted);
+	}
+
+	for(const auto& done : completed)
+	{
+		--mPendingCount;
+
+		auto it = mResidents.find(done.first);
+		assert(it != mResidents.end());
+		it->second.Ready = true;
+
+		int x = (int)(uint32)(done.first >> 32);
+		int z = (int)(uint32)done.first;
+		if(inRange(x, z))
+			mUpdatedSlots.push_back(done.second);
+	}
+
+	// Release the generated chunks that are out of range, including any that went
+	// out of range while they were generated.  Pending ones wait until they finish.
+	for(auto it = mResidents.begin(); it != mResidents.end(); )
+	{
+		int x = (int)(uint32)(it->first >> 32);
+		int z = (int)(uint32)it->first;
+
+		if(it->second.Ready && !inRange(x, z))
+		{
+			ReleaseSlot(it->second.Slot);
+			it = mResidents.erase(it);
+		}
+		else
+			++it;
+	}
+
+	// Start the missing chunks, nearest first, and list the ready ones.
+	mChunks.clear();
+	for(const Offset& o : mOffsets)
+	{
+		int x = mCenterX + o.DX;
+		int z = mCenterZ + o.DZ;
+		uint64 key = ChunkKey(x, z);
+
+		auto it = mResidents.find(key);
+		if(it == mResidents.end())
+		{
+			if(mPendingCount >= mSettings.MaxPendingChunks || mFreeSlots.empty())
+				continue;
+
+			Resident resident;
+			resident.Slot = mFreeSlots.back();
+			mFreeSlots.pop_back();
+			mResidents[key] = resident;
+
+			++mPendingCount;
+			uint32 slot = resident.Slot;
+			mTasks.run([this, x, z, slot]() { GenerateChunk(x, z, slot); });
+			continue;
+		}
+
+		if(!it->second.Ready)
+			continue;
+
+		Chunk chunk;
+		chunk.X = x;
+		chunk.Z = z;
+		chunk.Slot = it->second.Slot;
+		chunk.Lod = o.Lod;
+		chunk.StitchMask = o.StitchMask;
+		chunk.Bounds = mSlotBounds[chunk.Slot];
+		mChunks.push_back(chunk);
+	}
+}
+
+void TerrainStreamer::WaitForPending()
+{
+	mTasks.wait();
+}
+
+const std::vector<TerrainStreamer::Chunk>& TerrainStreamer::GetChunks()const
+{
+	return mChunks;
+}
+
+const std::vector<TerrainStreamer::uint32>& TerrainStreamer::GetUpdatedSlots()const
+{
+	return mUpdatedSlots;
+}
+
+const TerrainStreamer::Vertex* TerrainStreamer::GetSlotVertices(uint32 slot)const
+{
+	return &mSlotVertices[(size_t)slot*GetVerticesPerChunk()];
+}
+
+TerrainStreamer::uint32 TerrainStreamer::GetSlotCount()const
+{
+	return mSlotCount;
+}
+
+TerrainStreamer::uint32 TerrainStreamer::GetVerticesPerChunk()const
+{
+	return mVerticesPerSide*mVerticesPerSide;
+}
+
+TerrainStreamer::uint32 TerrainStreamer::GetPendingCount()const
+{
+	return mPendingCount;
+}
+
+const std::vector<TerrainStreamer::uint16>& TerrainStreamer::GetIndices()const
+{
+	return mIndices;
+}
+
+TerrainStreamer::DrawRange TerrainStreamer::GetDrawRange(uint32 lod, uint32 stitchMask)const
+{
+	return mDrawRanges[std::min(lod, mSettings.LodCount - 1)*StitchMaskCount + stitchMask];
+}
@@ -0,0 +1,197 @@
+//***************************************************************************************
+// TerrainStreamer.h
+//
+// Streams an unbounded heightfield around the camera as square chunks.  Chunks come
+// into range as the camera moves, are generated on worker threads, and drop out
+// again behind it.  Their vertices live in a fixed pool of equally sized slots, so
+// memory stays constant however far the camera travels; the app keeps one vertex
+// buffer of GetSlotCount()*GetVerticesPerChunk() vertices and draws chunk c with
+// BaseVertexLocation c.Slot*GetVerticesPerChunk().
+//
+// Level of detail is geomipmapping: every chunk stores its full resolution grid and
+// coarser levels only skip vertices, so they share one set of index patterns and
+// switching level costs nothing.  The level steps down once per LodRingWidth rings
+// of chunks out from the camera, so neighbours differ by at most one level.  Where
+// a chunk borders a coarser one, the pattern for its stitch mask drops every other
+// vertex along that edge to match the neighbour, leaving no cracks.
+//
+// North is +z and east +x.  Triangles wind clockwise seen from above, like
+// GeometryGenerator::CreateGrid.
+//
+// The code only depends on the standard library, DirectXMath and PPL.
+//***************************************************************************************
+
+#pragma once
+
+#include <ppl.h>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+
+class TerrainStreamer
+{
+public:
+
+    using uint16 = std::uint16_t;
+    using uint32 = std::uint32_t;
+    using uint64 = std::uint64_t;
+
+	// Sides of a chunk that border a coarser chunk.
+	static const uint32 StitchNorth = 1;
+	static const uint32 StitchEast = 2;
+	static const uint32 StitchSouth = 4;
+	static const uint32 StitchWest = 8;
+	static const uint32 StitchMaskCount = 16;
+
+	struct Settings
+	{
+		// Side of a chunk in world units, and the quads along it at full detail.
+		// QuadsPerChunk is a power of two.
+		float ChunkSize = 64.0f;
+		uint32 QuadsPerChunk = 32;
+
+		// Each level halves the quads along a side; the coarsest keeps at least 4.
+		uint32 LodCount = 4;
+
+		// Rings of chunks, counted out from the camera's chunk, per level.
+		uint32 LodRingWidth = 2;
+
+		// Rings of chunks kept around the camera's chunk.
+		uint32 ViewRadius = 8;
+
+		// Updates a released slot waits before it is reused, so that frames the
+		// GPU may still be drawing never see it overwritten.  At least the number
+		// of frames in flight.
+		uint32 RecycleDelay = 3;
+
+		// Chunks generated at the same time.
+		uint32 MaxPendingChunks = 16;
+	};
+
+	struct Vertex
+	{
+		DirectX::XMFLOAT3 Pos;
+		DirectX::XMFLOAT3 Normal;
+	};
+
+	struct Chunk
+	{
+		// Chunk coordinates; the chunk covers [X, X+1)*ChunkSize by [Z, Z+1)*ChunkSize.
+		int X = 0;
+		int Z = 0;
+
+		uint32 Slot = 0;
+		uint32 Lod = 0;
+		uint32 StitchMask = 0;
+
+		DirectX::BoundingBox Bounds;
+	};
+
+	struct DrawRange
+	{
+		uint32 IndexCount = 0;
+		uint32 StartIndexLocation = 0;
+	};
+
+	// Height at (x, z).  Called from worker threads, so it must be thread safe.
+	using HeightFunction = std::function<float(float x, float z)>;
+
+	TerrainStreamer(const Settings& settings, HeightFunction height);
+	TerrainStreamer(const TerrainStreamer& rhs) = delete;
+	TerrainStreamer& operator=(const TerrainStreamer& rhs) = delete;
+	~TerrainStreamer();
+
+	///<summary>
+	/// Call once a frame.  Collects the chunks finished since the last call,
+	/// releases chunks that left the view radius, and starts generating those that
+	/// entered it, nearest first, as slots and pending slots allow.
+	///</summary>
+	void Update(const DirectX::XMFLOAT3& cameraPos);
+
+	///<summary>
+	/// Blocks until every chunk being generated is finished.  The next Update
+	/// collects them.
+	///</summary>
+	void WaitForPending();
+
+	///<summary>
+	/// The generated chunks in range after the last Update, nearest first, with the
+	/// level and stitch mask to draw them with.
+	///</summary>
+	const std::vector<Chunk>& GetChunks()const;
+
+	///<summary>
+	/// Slots filled by the last Update, whose vertices must be copied to the GPU
+	/// before their chunks are drawn.
+	///</summary>
+	const std::vector<uint32>& GetUpdatedSlots()const;
+	const Vertex* GetSlotVertices(uint32 slot)const;
+
+	uint32 GetSlotCount()const;
+	uint32 GetVerticesPerChunk()const;
+	uint32 GetPendingCount()const;
+
+	///<summary>
+	/// Index patterns for every level and stitch mask, relative to the first vertex
+	/// of a slot.  A chunk has at most 65536 vertices, so 16 bits always suffice.
+	///</summary>
+	const std::vector<uint16>& GetIndices()const;
+	DrawRange GetDrawRange(uint32 lod, uint32 stitchMask)const;
+
+private:
+	struct Resident
+	{
+		uint32 Slot = 0;
+		bool Ready = false;
+	};
+
+	// Chunk position relative to the camera's chunk, nearest first.
+	struct Offset
+	{
+		int DX = 0;
+		int DZ = 0;
+		uint32 Lod = 0;
+		uint32 StitchMask = 0;
+	};
+
+	uint32 LodOfRing(uint32 ring)const;
+	void BuildOffsets();
+	void BuildIndexPatterns();
+	void GenerateChunk(int x, int z, uint32 slot);
+	void ReleaseSlot(uint32 slot);
+
+private:
+	Settings mSettings;
+	HeightFunction mHeight;
+
+	uint32 mVerticesPerSide = 0;
+	uint32 mSlotCount = 0;
+	std::vector<Vertex> mSlotVertices;
+	std::vector<DirectX::BoundingBox> mSlotBounds;
+
+	std::vector<uint32> mFreeSlots;
+	std::vector<std::pair<uint32, uint64>> mRetiringSlots;
+	uint64 mUpdateCount = 0;
+
+	std::unordered_map<uint64, Resident> mResidents;
+	std::vector<Offset> mOffsets;
+	int mCenterX = 0;
+	int mCenterZ = 0;
+	uint32 mPendingCount = 0;
+
+	std::vector<Chunk> mChunks;
+	std::vector<uint32> mUpdatedSlots;
+
+	std::vector<uint16> mIndices;
+	std::vector<DrawRange> mDrawRanges;
+
+	// Chunks finished by the workers and not yet collected by Update.
+	std::mutex mCompletedMutex;
+	std::vector<std::pair<uint64, uint32>> mCompleted;
+
+	concurrency::task_group mTasks;
+};
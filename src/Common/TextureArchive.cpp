@@ -0,0 +1,341 @@
+//***************************************************************************************
+// TextureArchive.cpp
+//***************************************************************************************
+
+#include "TextureArchive.h"
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+using uint32 = TextureArchive::uint32;
+using uint64 = TextureArchive::uint64;
+
+namespace
+{
+	const uint32 ArchiveMagic = 0x4B415054; // "TPAK"
+	const uint32 ArchiveVersion = 1;
+
+	struct FileHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint32 EntryCount;
+		uint32 BucketCount;
+		uint32 Alignment;
+		uint32 Reserved;
+		uint64 NamesSize;
+	};
+
+	static_assert(sizeof(FileHeader) == 32, "The header is part of the file format.");
+
+	uint64 AlignUp(uint64 value, uint64 alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	// Buckets for count entries: a power of two, at most half full.
+	uint32 BucketCountFor(uint32 count)
+	{
+		uint32 buckets = 1;
+		while(buckets < 2 * count)
+			buckets *= 2;
+		return buckets;
+	}
+
+	void WriteZeros(std::ostream& out, uint64 count)
+	{
+		static const char zeros[4096] = {};
+		while(count > 0)
+		{
+			uint64 n = count < sizeof(zeros) ? count : sizeof(zeros);
+			out.write(zeros, (std::streamsize)n);
+			count -= n;
+		}
+	}
+}
+
+struct TextureArchive::FileEntry
+{
+	uint64 NameHash;
+	uint64 ContentHash;
+	uint64 Offset;
+	uint64 Size;
+	uint32 NameOffset;
+	uint32 NameLength;
+};
+
+bool TextureArchive::Open(const std::wstring& fileName)
+{
+	Close();
+
+	if(!mFile.Open(fileName))
+		return false;
+
+	const std::uint8_t* data = mFile.GetData();
+	const uint64 size = mFile.GetSize();
+
+	FileHeader header;
+	if(size < sizeof(header))
+	{
+		Close();
+		return false;
+	}
+	std::memcpy(&header, data, sizeof(header));
+
+	static_assert(sizeof(FileEntry) == 40, "Entries are part of the file format.");
+	if(header.Magic != ArchiveMagic || header.Version != ArchiveVersion ||
+		header.BucketCount == 0 || (header.BucketCount & (header.BucketCount - 1)) != 0 ||
+		header.BucketCount <= header.EntryCount)
+	{
+		Close();
+		return false;
+	}
+
+	const uint64 entriesOffset = sizeof(FileHeader);
+	const uint64 bucketsOffset = entriesOffset + (uint64)header.EntryCount * sizeof(FileEntry);
+	const uint64 namesOffset = bucketsOffset + (uint64)header.BucketCount * sizeof(uint32);
+	if(namesOffset > size || header.NamesSize > size - namesOffset)
+	{
+		Close();
+		return false;
+	}
+
+	// The header and entries are multiples of 8 bytes and the mapping starts on a
+	// page, so the table can be read in place.
+	mFileEntries = reinterpret_cast<const FileEntry*>(data + entriesOffset);
+	mBuckets = reinterpret_cast<const uint32*>(data + bucketsOffset);
+	mBucketCount = header.BucketCount;
+	mNames = reinterpret_cast<const char*>(data + namesOffset);
+
+	mEntries.resize(header.EntryCount);
+	for(uint32 i = 0; i < header.EntryCount; ++i)
+	{
+		const FileEntry& e = mFileEntries[i];
+		if(e.Offset > size || e.Size > size - e.Offset ||
+			(uint64)e.NameOffset + e.NameLength > header.NamesSize)
+		{
+			Close();
+			return false;
+		}
+
+		mEntries[i].Data = data + e.Offset;
+		mEntries[i].Size = (std::size_t)e.Size;
+		mEntries[i].ContentHash = e.ContentHash;
+	}
+
+	for(uint32 i = 0; i < mBucketCount; ++i)
+	{
+		if(mBuckets[i] > header.EntryCount)
+		{
+			Close();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void TextureArchive::Close()
+{
+	mFile.Close();
+	mEntries.clear();
+	mFileEntries = nullptr;
+	mBuckets = nullptr;
+	mBucketCount = 0;
+	mNames = nullptr;
+}
+
+bool TextureArchive::IsOpen()const
+{
+	return mBuckets != nullptr;
+}
+
+const TextureArchive::Entry* TextureArchive::Find(const std::string& name)const
+{
+	if(mBucketCount == 0)
+		return nullptr;
+
+	const uint64 hash = Hash(name.data(), name.size());
+	uint32 bucket = (uint32)hash & (mBucketCount - 1);
+
+	// Linear probing.  Tables are written at most half full, so an empty bucket
+	// ends the search quickly; the count only guards against damaged files.
+	for(uint32 probe = 0; probe < mBucketCount; ++probe)
+	{
+		uint32 index = mBuckets[bucket];
+		if(index == 0)
+			return nullptr;
+
+		const FileEntry& e = mFileEntries[index - 1];
+		if(e.NameHash == hash && e.NameLength == name.size() &&
+			std::memcmp(mNames + e.NameOffset, name.data(), name.size()) == 0)
+		{
+			return &mEntries[index - 1];
+		}
+
+		bucket = (bucket + 1) & (mBucketCount - 1);
+	}
+
+	return nullptr;
+}
+
+TextureArchive::uint32 TextureArchive::GetEntryCount()const
+{
+	return (uint32)mEntries.size();
+}
+
+bool TextureArchive::Write(std::ostream& out, const std::vector<SourceFile>& files, uint32 alignment)
+{
+	if(alignment == 0 || (alignment & (alignment - 1)) != 0)
+		return false;
+
+	const uint32 count = (uint32)files.size();
+	const uint32 bucketCount = BucketCountFor(count + 1);
+
+	std::vector<FileEntry> entries(count);
+	std::vector<uint32> buckets(bucketCount, 0);
+	std::string names;
+
+	std::unordered_set<std::string> seenNames;
+	for(uint32 i = 0; i < count; ++i)
+	{
+		std::string name = NormalizeName(files[i].Name);
+		if(!seenNames.insert(name).second)
+			return false;
+
+		FileEntry& e = entries[i];
+		e.NameHash = Hash(name.data(), name.size());
+		e.ContentHash = Hash(files[i].Data, files[i].Size);
+		e.Size = files[i].Size;
+		e.NameOffset = (uint32)names.size();
+		e.NameLength = (uint32)name.size();
+		names += name;
+
+		uint32 bucket = (uint32)e.NameHash & (bucketCount - 1);
+		while(buckets[bucket] != 0)
+			bucket = (bucket + 1) & (bucketCount - 1);
+		buckets[bucket] = i + 1;
+	}
+
+	// Lay out the data, storing identical files once.
+	const uint64 tocSize = sizeof(FileHeader) + (uint64)count * sizeof(FileEntry) +
+		(uint64)bucketCount * sizeof(uint32) + names.size();
+
+	std::unordered_multimap<uint64, uint32> stored;
+	std::vector<uint32> order;
+	uint64 offset = AlignUp(tocSize, alignment);
+	for(uint32 i = 0; i < count; ++i)
+	{
+		FileEntry& e = entries[i];
+
+		bool duplicate = false;
+		auto range = stored.equal_range(e.ContentHash);
+		for(auto it = range.first; it != range.second; ++it)
+		{
+			const SourceFile& other = files[it->second];
+			if(other.Size == files[i].Size &&
+				(other.Size == 0 || std::memcmp(other.Data, files[i].Data, other.Size) == 0))
+			{
+				e.Offset = entries[it->second].Offset;
+				duplicate = true;
+				break;
+			}
+		}
+
+		if(!duplicate)
+		{
+			e.Offset = offset;
+			offset = AlignUp(offset + e.Size, alignment);
+			stored.insert(std::make_pair(e.ContentHash, i));
+			order.push_back(i);
+		}
+	}
+
+	FileHeader header = {};
+	header.Magic = ArchiveMagic;
+	header.Version = ArchiveVersion;
+	header.EntryCount = count;
+	header.BucketCount = bucketCount;
+	header.Alignment = alignment;
+	header.NamesSize = names.size();
+
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char*>(entries.data()), (std::streamsize)(entries.size() * sizeof(FileEntry)));
+	out.write(reinterpret_cast<const char*>(buckets.data()), (std::streamsize)(buckets.size() * sizeof(uint32)));
+	out.write(names.data(), (std::streamsize)names.size());
+
+	uint64 written = tocSize;
+	for(uint32 i : order)
+	{
+		WriteZeros(out, entries[i].Offset - written);
+		out.write(reinterpret_cast<const char*>(files[i].Data), (std::streamsize)files[i].Size);
+		written = entries[i].Offset + entries[i].Size;
+	}
+
+	return out.good();
+}
+
+std::string TextureArchive::NormalizeName(const std::wstring& path)
+{
+	std::size_t start = path.find_last_of(L"/\\");
+	start = start == std::wstring::npos ? 0 : start + 1;
+
+	std::string name;
+	for(std::size_t i = start; i < path.size(); ++i)
+	{
+		uint32 c = (uint32)path[i];
+		if(c < 0x80)
+		{
+			name += (char)(c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c);
+		}
+		else if(c < 0x800)
+		{
+			name += (char)(0xC0 | (c >> 6));
+			name += (char)(0x80 | (c & 0x3F));
+		}
+		else if(c < 0x10000)
+		{
+			name += (char)(0xE0 | (c >> 12));
+			name += (char)(0x80 | ((c >> 6) & 0x3F));
+			name += (char)(0x80 | (c & 0x3F));
+		}
+		else
+		{
+			name += (char)(0xF0 | (c >> 18));
+			name += (char)(0x80 | ((c >> 12) & 0x3F));
+			name += (char)(0x80 | ((c >> 6) & 0x3F));
+			name += (char)(0x80 | (c & 0x3F));
+		}
+	}
+
+	return name;
+}
+
+std::string TextureArchive::NormalizeName(const std::string& path)
+{
+	std::size_t start = path.find_last_of("/\\");
+	start = start == std::string::npos ? 0 : start + 1;
+
+	std::string name = path.substr(start);
+	for(char& c : name)
+	{
+		if(c >= 'A' && c <= 'Z')
+			c = (char)(c + ('a' - 'A'));
+	}
+
+	return name;
+}
+
+uint64 TextureArchive::Hash(const void* data, std::size_t size, uint64 seed)
+{
+	const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+
+	uint64 hash = seed;
+	for(std::size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
@@ -0,0 +1,101 @@
+//***************************************************************************************
+// TextureArchive.h
+//
+// Packs many texture files into one file, so an app maps a single file at startup
+// instead of opening every texture it uses.  The table of contents comes first,
+// followed by the file data with every entry aligned (to 4096 bytes by default, a
+// page), so an entry can be handed to the loader straight out of the mapping.
+//
+// Entries are looked up by name in O(1) through an open addressed hash table stored
+// in the archive.  Names are file names without their directory, lowercased, so
+// L"../../Textures/Bricks.dds" finds "bricks.dds".  Every entry records a 64-bit
+// hash of its contents; files with the same contents are stored once, and callers
+// can use the hash to share what they create from them (see TextureCache).
+//
+// Layout, all values little endian:
+//   Header
+//   Entry[EntryCount]
+//   uint32 Buckets[BucketCount]   entry index + 1, 0 when empty
+//   char Names[NamesSize]         not null terminated
+//   data, each entry at a multiple of Alignment
+//
+// The code only depends on the standard library and MappedFile.
+//***************************************************************************************
+
+#pragma once
+
+#include "MappedFile.h"
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class TextureArchive
+{
+public:
+
+    using uint32 = std::uint32_t;
+    using uint64 = std::uint64_t;
+
+	struct Entry
+	{
+		const std::uint8_t* Data = nullptr;
+		std::size_t Size = 0;
+		uint64 ContentHash = 0;
+	};
+
+	// A file to pack, already in memory.
+	struct SourceFile
+	{
+		std::string Name;
+		const std::uint8_t* Data = nullptr;
+		std::size_t Size = 0;
+	};
+
+	///<summary>
+	/// Maps an archive and validates its table of contents.  Returns false, with
+	/// the archive closed, when the file cannot be mapped or is not a valid archive.
+	///</summary>
+	bool Open(const std::wstring& fileName);
+	void Close();
+	bool IsOpen()const;
+
+	///<summary>
+	/// Finds the entry called name (see NormalizeName), or returns nullptr.  The
+	/// entry's data stays valid until the archive is closed.
+	///</summary>
+	const Entry* Find(const std::string& name)const;
+
+	uint32 GetEntryCount()const;
+
+	///<summary>
+	/// Writes an archive of files, storing files with identical contents once.
+	/// Names are normalized first.  Returns false when two files have the same
+	/// name or the stream fails.  alignment must be a power of two.
+	///</summary>
+	static bool Write(std::ostream& out, const std::vector<SourceFile>& files, uint32 alignment = 4096);
+
+	///<summary>
+	/// The name an archive knows a file by: its path after the last slash or
+	/// backslash, with ASCII letters lowercased, in UTF-8.
+	///</summary>
+	static std::string NormalizeName(const std::wstring& path);
+	static std::string NormalizeName(const std::string& path);
+
+	// 64-bit FNV-1a.
+	static uint64 Hash(const void* data, std::size_t size, uint64 seed = 14695981039346656037ull);
+
+private:
+	struct FileEntry;
+
+	MappedFile mFile;
+
+	// Resolved from the table of contents when the archive is opened; the rest
+	// is read in place.
+	std::vector<Entry> mEntries;
+	const FileEntry* mFileEntries = nullptr;
+	const uint32* mBuckets = nullptr;
+	uint32 mBucketCount = 0;
+	const char* mNames = nullptr;
+};
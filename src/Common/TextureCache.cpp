@@ -0,0 +1,94 @@
+//***************************************************************************************
+// TextureCache.cpp
+//***************************************************************************************
+
+#include "TextureCache.h"
+#include "DDSTextureLoader.h"
+#include "MappedFile.h"
+#include <cstring>
+
+using Microsoft::WRL::ComPtr;
+
+TextureCache::TextureCache(ID3D12Device* device) :
+	mDevice(device)
+{
+}
+
+bool TextureCache::OpenArchive(const std::wstring& fileName)
+{
+	// Opening another archive would unmap the data earlier loads are compared with.
+	if(mArchiveLoadCount > 0)
+		return false;
+
+	return mArchive.Open(fileName);
+}
+
+void TextureCache::Load(ID3D12GraphicsCommandList* cmdList, Texture& texture)
+{
+	auto known = mPaths.find(texture.Filename);
+	if(known != mPaths.end())
+	{
+		texture.Resource = known->second;
+		return;
+	}
+
+	const std::string name = TextureArchive::NormalizeName(texture.Filename);
+	const TextureArchive::Entry* entry = mArchive.IsOpen() ? mArchive.Find(name) : nullptr;
+	if(entry != nullptr)
+	{
+		ContentKey key = { entry->ContentHash, entry->Size };
+		texture.Resource = Create(cmdList, key, entry->Data, true, texture);
+		mPaths[texture.Filename] = texture.Resource;
+		++mArchiveLoadCount;
+		return;
+	}
+
+	MappedFile file;
+	if(!file.Open(texture.Filename))
+	{
+		throw DxException(HRESULT_FROM_WIN32(GetLastError()), L"TextureCache loading " + texture.Filename,
+			AnsiToWString(__FILE__), __LINE__);
+	}
+
+	ContentKey key = { TextureArchive::Hash(file.GetData(), file.GetSize()), file.GetSize() };
+	texture.Resource = Create(cmdList, key, file.GetData(), false, texture);
+	mPaths[texture.Filename] = texture.Resource;
+	++mFileLoadCount;
+}
+
+ComPtr<ID3D12Resource> TextureCache::Create(ID3D12GraphicsCommandList* cmdList,
+	const ContentKey& key, const uint8_t* data, bool inArchive, Texture& texture)
+{
+	// The key only finds candidates; a 64-bit hash can still collide.
+	std::vector<SharedResource>& candidates = mResources[key];
+	for(const SharedResource& shared : candidates)
+	{
+		if(SameContents(shared, data, key.Size))
+			return shared.Resource;
+	}
+
+	// The loader copies the pixels into the upload heap before returning, so the
+	// data only has to outlive this call.
+	ComPtr<ID3D12Resource> resource;
+	ThrowIfFailed(DirectX::CreateDDSTextureFromMemory12(mDevice.Get(), cmdList,
+		data, key.Size, resource, texture.UploadHeap));
+
+	SharedResource shared = { resource, inArchive ? data : nullptr, inArchive ? std::wstring() : texture.Filename };
+	candidates.push_back(shared);
+	++mResourceCount;
+	return resource;
+}
+
+bool TextureCache::SameContents(const SharedResource& shared, const uint8_t* data, size_t size)
+{
+	// The archive stores identical files once, so their entries share data.
+	if(shared.ArchiveData != nullptr)
+		return shared.ArchiveData == data || std::memcmp(shared.ArchiveData, data, size) == 0;
+
+	// A file that has changed or gone since it was loaded matches nothing.
+	MappedFile file;
+	if(!file.Open(shared.Filename) || file.GetSize() != size)
+		return false;
+
+	return size == 0 || std::memcmp(file.GetData(), data, size) == 0;
+}
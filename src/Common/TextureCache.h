@@ -0,0 +1,89 @@
+//***************************************************************************************
+// TextureCache.h
+//
+// Creates each distinct texture once.  Textures are looked up by a hash of their
+// file contents and share a resource only when their bytes match, so two names for
+// the same pixels, or the same file loaded by several materials, share one resource
+// while files that merely hash alike do not.  When a TextureArchive is open, textures come out
+// of it and no file is opened per texture; names the archive lacks, or every name
+// when no archive was found, fall back to the loose file.
+//
+// Shared textures get the same Resource; only the first keeps the UploadHeap, which
+// like any other upload heap must live until the commands copying from it have run.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "TextureArchive.h"
+#include <unordered_map>
+#include <vector>
+
+class TextureCache
+{
+public:
+	explicit TextureCache(ID3D12Device* device);
+	TextureCache(const TextureCache& rhs) = delete;
+	TextureCache& operator=(const TextureCache& rhs) = delete;
+
+	///<summary>
+	/// Opens the archive later loads look in first.  Returns false, leaving loads
+	/// to the loose files, when it cannot be opened, or when textures have already
+	/// come out of an archive: later loads compare their bytes with its data.
+	///</summary>
+	bool OpenArchive(const std::wstring& fileName);
+
+	///<summary>
+	/// Sets texture.Resource to the texture texture.Filename names, recording its
+	/// upload on cmdList the first time its contents are seen.  Throws DxException
+	/// when the texture can be found neither in the archive nor on disk.
+	///</summary>
+	void Load(ID3D12GraphicsCommandList* cmdList, Texture& texture);
+
+	// Loads served from the archive and from loose files, and resources created.
+	UINT GetArchiveLoadCount()const { return mArchiveLoadCount; }
+	UINT GetFileLoadCount()const { return mFileLoadCount; }
+	UINT GetResourceCount()const { return mResourceCount; }
+
+private:
+	struct ContentKey
+	{
+		TextureArchive::uint64 Hash;
+		size_t Size;
+
+		bool operator==(const ContentKey& rhs)const { return Hash == rhs.Hash && Size == rhs.Size; }
+	};
+
+	struct ContentKeyHash
+	{
+		size_t operator()(const ContentKey& key)const { return (size_t)key.Hash; }
+	};
+
+	// A resource and where its bytes are: in the archive, or in a loose file that
+	// is mapped again when another file's key matches.
+	struct SharedResource
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+		const uint8_t* ArchiveData;
+		std::wstring Filename;
+	};
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> Create(ID3D12GraphicsCommandList* cmdList,
+		const ContentKey& key, const uint8_t* data, bool inArchive, Texture& texture);
+	static bool SameContents(const SharedResource& shared, const uint8_t* data, size_t size);
+
+private:
+	Microsoft::WRL::ComPtr<ID3D12Device> mDevice;
+	TextureArchive mArchive;
+
+	// Usually one resource per key; more only when different files hash alike.
+	std::unordered_map<ContentKey, std::vector<SharedResource>, ContentKeyHash> mResources;
+
+	// Paths already loaded, as given, so a repeated path is not hashed again.
+	// Files of the same name in different directories are told apart by content.
+	std::unordered_map<std::wstring, Microsoft::WRL::ComPtr<ID3D12Resource>> mPaths;
+
+	UINT mArchiveLoadCount = 0;
+	UINT mFileLoadCount = 0;
+	UINT mResourceCount = 0;
+};
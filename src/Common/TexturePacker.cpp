@@ -0,0 +1,372 @@
+//***************************************************************************************
+// TexturePacker.cpp
+//***************************************************************************************
+
+#include "TexturePacker.h"
+#include "DDSParser.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+using namespace std;
+
+namespace
+{
+	using uint8 = uint8_t;
+	using uint32 = TexturePacker::uint32;
+
+	const uint32 MaxTextureSize = 16384; // D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION
+
+	struct ParsedFile
+	{
+		DDSParser::TextureDesc Desc;
+		const uint8* Data = nullptr;
+	};
+
+	// Parses every file and checks they are 2D textures of one format.
+	bool ParseFiles(const vector<TexturePacker::SourceFile>& files, vector<ParsedFile>& parsed, string& error)
+	{
+		if(files.empty())
+		{
+			error = "no textures to pack";
+			return false;
+		}
+
+		parsed.resize(files.size());
+		for(size_t i = 0; i < files.size(); ++i)
+		{
+			if(DDSParser::Parse(files[i].Data, files[i].Size, parsed[i].Desc) != DDSParser::Result::Ok)
+			{
+				error = files[i].Name + " is not a valid DDS file";
+				return false;
+			}
+
+			const DDSParser::TextureDesc& desc = parsed[i].Desc;
+			if(desc.Dimension != DDSParser::ResourceDimension::Texture2D || desc.IsCubeMap)
+			{
+				error = files[i].Name + " is not a 2D texture";
+				return false;
+			}
+
+			if(desc.Format != parsed[0].Desc.Format)
+			{
+				error = files[i].Name + " has a different format from " + files[0].Name;
+				return false;
+			}
+
+			if(!DDSParser::IsBlockCompressed(desc.Format) && DDSParser::BitsPerPixel(desc.Format) % 8 != 0)
+			{
+				error = files[i].Name + " has a format that cannot be packed";
+				return false;
+			}
+
+			parsed[i].Data = files[i].Data;
+		}
+
+		return true;
+	}
+
+	// Formats are copied in elements: 4x4 blocks for block compressed formats,
+	// otherwise single pixels.
+	uint32 ElementSize(DXGI_FORMAT format)
+	{
+		return DDSParser::IsBlockCompressed(format) ? 4 : 1;
+	}
+
+	uint32 ElementBytes(DXGI_FORMAT format)
+	{
+		if(!DDSParser::IsBlockCompressed(format))
+			return DDSParser::BitsPerPixel(format) / 8;
+
+		DDSParser::uint64 bytes = 0;
+		DDSParser::GetSurfaceInfo(4, 4, format, &bytes, nullptr, nullptr);
+		return uint32(bytes);
+	}
+
+	int WrapIndex(int i, int count)
+	{
+		return ((i % count) + count) % count;
+	}
+
+	// Where each texture goes in the atlas, in pixels of the top level, padding
+	// included.
+	struct Cell
+	{
+		size_t File = 0;
+		uint32 Width = 0;
+		uint32 Height = 0;
+		uint32 X = 0;
+		uint32 Y = 0;
+	};
+
+	// Shelf packing: the tallest cells first, left to right along rows as tall as
+	// their first cell.  Returns the atlas height.
+	uint32 PackShelves(vector<Cell>& cells, uint32 atlasWidth)
+	{
+		vector<Cell*> order;
+		for(Cell& cell : cells)
+			order.push_back(&cell);
+		stable_sort(order.begin(), order.end(), [](const Cell* a, const Cell* b) { return a->Height > b->Height; });
+
+		uint32 x = 0;
+		uint32 y = 0;
+		uint32 shelfHeight = 0;
+		for(Cell* cell : order)
+		{
+			if(x + cell->Width > atlasWidth)
+			{
+				x = 0;
+				y += shelfHeight;
+				shelfHeight = 0;
+			}
+
+			cell->X = x;
+			cell->Y = y;
+			x += cell->Width;
+			shelfHeight = max(shelfHeight, cell->Height);
+		}
+
+		return y + shelfHeight;
+	}
+}
+
+bool TexturePacker::BuildArray(const vector<SourceFile>& files, vector<uint8_t>& file,
+	vector<Entry>& entries, string& error)
+{
+	vector<ParsedFile> parsed;
+	if(!ParseFiles(files, parsed, error))
+		return false;
+
+	DDSParser::TextureDesc desc = parsed[0].Desc;
+	desc.ArraySize = 0;
+	for(size_t i = 0; i < parsed.size(); ++i)
+	{
+		if(parsed[i].Desc.Width != desc.Width || parsed[i].Desc.Height != desc.Height)
+		{
+			error = files[i].Name + " has a different size from " + files[0].Name;
+			return false;
+		}
+
+		desc.MipLevels = min(desc.MipLevels, parsed[i].Desc.MipLevels);
+		desc.ArraySize += parsed[i].Desc.ArraySize;
+	}
+
+	if(DDSParser::InitFile(desc, file) != DDSParser::Result::Ok)
+	{
+		error = "the array cannot be stored as a DDS file";
+		return false;
+	}
+
+	entries.clear();
+	uint32 slice = 0;
+	for(size_t i = 0; i < parsed.size(); ++i)
+	{
+		Entry entry;
+		entry.Name = files[i].Name;
+		entry.ArraySlice = slice;
+		entries.push_back(entry);
+
+		// Same format and size, so every subresource has the same layout in both.
+		for(uint32 sourceSlice = 0; sourceSlice < parsed[i].Desc.ArraySize; ++sourceSlice, ++slice)
+		{
+			for(uint32 mip = 0; mip < desc.MipLevels; ++mip)
+			{
+				DDSParser::Subresource src = DDSParser::GetSubresource(parsed[i].Desc, mip, sourceSlice);
+				DDSParser::Subresource dst = DDSParser::GetSubresource(desc, mip, slice);
+				memcpy(file.data() + dst.Offset, parsed[i].Data + src.Offset, size_t(src.SlicePitch));
+			}
+		}
+	}
+
+	return true;
+}
+
+bool TexturePacker::BuildAtlas(const vector<SourceFile>& files, uint32 padding, Padding mode,
+	vector<uint8_t>& file, vector<Entry>& entries, string& error)
+{
+	vector<ParsedFile> parsed;
+	if(!ParseFiles(files, parsed, error))
+		return false;
+
+	const DXGI_FORMAT format = parsed[0].Desc.Format;
+	const uint32 elementSize = ElementSize(format);
+	const uint32 elementBytes = ElementBytes(format);
+
+	if(padding % elementSize != 0)
+	{
+		error = "padding must be a multiple of 4 for block compressed formats";
+		return false;
+	}
+
+	for(size_t i = 0; i < parsed.size(); ++i)
+	{
+		if(parsed[i].Desc.Width % elementSize != 0 || parsed[i].Desc.Height % elementSize != 0)
+		{
+			error = files[i].Name + " is not a whole number of blocks";
+			return false;
+		}
+	}
+
+	// Keep the next mip while every texture has it and its position, size and
+	// padding there all remain whole elements, with some padding left.
+	uint32 mipLevels = 1;
+	for(;;)
+	{
+		const uint32 granule = elementSize << mipLevels;
+		bool keep = padding % granule == 0 && granule <= MaxTextureSize;
+		for(const ParsedFile& p : parsed)
+		{
+			keep = keep && p.Desc.MipLevels > mipLevels &&
+				p.Desc.Width % granule == 0 && p.Desc.Height % granule == 0;
+		}
+
+		if(!keep)
+			break;
+		++mipLevels;
+	}
+
+	const uint32 granule = elementSize << (mipLevels - 1);
+
+	vector<Cell> cells(parsed.size());
+	DDSParser::uint64 area = 0;
+	uint32 widest = 0;
+	for(size_t i = 0; i < parsed.size(); ++i)
+	{
+		cells[i].File = i;
+		cells[i].Width = parsed[i].Desc.Width + 2*padding;
+		cells[i].Height = parsed[i].Desc.Height + 2*padding;
+		area += DDSParser::uint64(cells[i].Width)*cells[i].Height;
+		widest = max(widest, cells[i].Width);
+	}
+
+	// Try every width, in steps that keep mips whole, from the widest cell to
+	// twice the side of a square holding them all, and keep the smallest atlas,
+	// the squarest of equal ones.
+	const uint32 first = (widest + granule - 1) / granule*granule;
+	const uint32 last = min(MaxTextureSize, max(first, 2*uint32(sqrt(double(area))) + granule));
+
+	uint32 atlasWidth = 0;
+	uint32 atlasHeight = 0;
+	for(uint32 width = first; width <= last; width += granule)
+	{
+		uint32 height = (PackShelves(cells, width) + granule - 1) / granule*granule;
+		DDSParser::uint64 size = DDSParser::uint64(width)*height;
+		DDSParser::uint64 best = DDSParser::uint64(atlasWidth)*atlasHeight;
+		if(atlasWidth == 0 || size < best || (size == best && max(width, height) < max(atlasWidth, atlasHeight)))
+		{
+			atlasWidth = width;
+			atlasHeight = height;
+		}
+	}
+
+	PackShelves(cells, atlasWidth);
+	if(atlasWidth == 0 || atlasWidth > MaxTextureSize || atlasHeight > MaxTextureSize)
+	{
+		error = "the textures do not fit in a 16384x16384 atlas";
+		return false;
+	}
+
+	DDSParser::TextureDesc desc = parsed[0].Desc;
+	desc.Width = atlasWidth;
+	desc.Height = atlasHeight;
+	desc.MipLevels = mipLevels;
+	desc.ArraySize = 1;
+	if(DDSParser::InitFile(desc, file) != DDSParser::Result::Ok)
+	{
+		error = "the atlas cannot be stored as a DDS file";
+		return false;
+	}
+
+	for(uint32 mip = 0; mip < mipLevels; ++mip)
+	{
+		DDSParser::Subresource dst = DDSParser::GetSubresource(desc, mip, 0);
+		const int pad = int((padding >> mip) / elementSize);
+
+		for(const Cell& cell : cells)
+		{
+			const ParsedFile& p = parsed[cell.File];
+			DDSParser::Subresource src = DDSParser::GetSubresource(p.Desc, mip, 0);
+			const int columns = int(src.Width / elementSize);
+			const int rows = int(src.Height / elementSize);
+			const uint32 x0 = (cell.X >> mip) / elementSize;
+			const uint32 y0 = (cell.Y >> mip) / elementSize;
+
+			for(int y = -pad; y < rows + pad; ++y)
+			{
+				const int sy = mode == Padding::Wrap ? WrapIndex(y, rows) : min(max(y, 0), rows - 1);
+				const uint8* in = p.Data + src.Offset + size_t(sy)*src.RowPitch;
+				uint8* out = file.data() + dst.Offset + size_t(y0 + pad + y)*dst.RowPitch + size_t(x0)*elementBytes;
+
+				for(int x = -pad; x < 0; ++x, out += elementBytes)
+				{
+					const int sx = mode == Padding::Wrap ? WrapIndex(x, columns) : 0;
+					memcpy(out, in + size_t(sx)*elementBytes, elementBytes);
+				}
+
+				memcpy(out, in, size_t(columns)*elementBytes);
+				out += size_t(columns)*elementBytes;
+
+				for(int x = columns; x < columns + pad; ++x, out += elementBytes)
+				{
+					const int sx = mode == Padding::Wrap ? WrapIndex(x, columns) : columns - 1;
+					memcpy(out, in + size_t(sx)*elementBytes, elementBytes);
+				}
+			}
+		}
+	}
+
+	entries.assign(files.size(), Entry());
+	for(const Cell& cell : cells)
+	{
+		Entry& entry = entries[cell.File];
+		entry.Name = files[cell.File].Name;
+		entry.UVScale[0] = float(parsed[cell.File].Desc.Width) / atlasWidth;
+		entry.UVScale[1] = float(parsed[cell.File].Desc.Height) / atlasHeight;
+		entry.UVOffset[0] = float(cell.X + padding) / atlasWidth;
+		entry.UVOffset[1] = float(cell.Y + padding) / atlasHeight;
+	}
+
+	return true;
+}
+
+bool TexturePacker::WriteTable(const wstring& fileName, const vector<Entry>& entries)
+{
+	ofstream out(MappedFile::ToNativePath(fileName), ios::trunc);
+	out << "# name slice uScale vScale uOffset vOffset\n" << setprecision(9);
+	for(const Entry& entry : entries)
+	{
+		out << entry.Name << ' ' << entry.ArraySlice << ' ' << entry.UVScale[0] << ' ' << entry.UVScale[1]
+			<< ' ' << entry.UVOffset[0] << ' ' << entry.UVOffset[1] << '\n';
+	}
+
+	return bool(out);
+}
+
+bool TexturePacker::ReadTable(const wstring& fileName, vector<Entry>& entries)
+{
+	ifstream in(MappedFile::ToNativePath(fileName));
+	if(!in)
+		return false;
+
+	entries.clear();
+	string line;
+	while(getline(in, line))
+	{
+		if(line.empty() || line[0] == '#')
+			continue;
+
+		Entry entry;
+		istringstream fields(line);
+		if(!(fields >> entry.Name >> entry.ArraySlice >> entry.UVScale[0] >> entry.UVScale[1]
+			>> entry.UVOffset[0] >> entry.UVOffset[1]))
+			return false;
+
+		entries.push_back(entry);
+	}
+
+	return true;
+}
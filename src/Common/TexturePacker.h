@@ -0,0 +1,86 @@
+//***************************************************************************************
+// TexturePacker.h
+//
+// Combines textures of one format into a single resource so materials can share one
+// descriptor: either a texture array, one slice per texture, or an atlas, textures
+// side by side with a padding border around each.  The result is a DDS file plus
+// a table giving, for each texture, the array slice and the transform that maps the
+// texture's own [0,1] UVs into the packed resource:
+//
+//   packedUV = uv*UVScale + UVOffset, sampled from slice ArraySlice.
+//
+// Packing copies the stored bytes, so block compressed textures are never decoded
+// or recompressed.  Atlas padding repeats each texture's edge (or, for textures
+// that tile, its opposite edge) so bilinear filtering at the border does not pick
+// up a neighbour; for block compressed formats whole 4x4 blocks are repeated.  An
+// atlas only keeps the mips at which every texture still starts on a whole block
+// and has some padding left, usually far fewer than an array keeps.
+//
+// The table is a text file, one texture per line:
+//
+//   name slice uScale vScale uOffset vOffset
+//
+// The code only depends on the standard library, DDSParser and MappedFile.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class TexturePacker
+{
+public:
+
+    using uint32 = std::uint32_t;
+
+	// A DDS file to pack, already in memory.
+	struct SourceFile
+	{
+		std::string Name;
+		const std::uint8_t* Data = nullptr;
+		std::size_t Size = 0;
+	};
+
+	struct Entry
+	{
+		std::string Name;
+		uint32 ArraySlice = 0;
+		float UVScale[2] = { 1.0f, 1.0f };
+		float UVOffset[2] = { 0.0f, 0.0f };
+	};
+
+	enum class Padding
+	{
+		Clamp, // Repeat the edge, for textures sampled with clamp addressing.
+		Wrap   // Repeat the opposite edge, for textures that tile.
+	};
+
+	///<summary>
+	/// Packs files into a texture array.  Every file must be a 2D texture (arrays
+	/// allowed, cube maps not) of the same format, width and height; the array
+	/// keeps the mips all of them have.  A file that is itself an array adds all
+	/// its slices and its entry names the first.  Returns false with a reason in
+	/// error when the files cannot be packed.
+	///</summary>
+	static bool BuildArray(const std::vector<SourceFile>& files, std::vector<std::uint8_t>& file,
+		std::vector<Entry>& entries, std::string& error);
+
+	///<summary>
+	/// Packs the top slice of each file into one atlas with padding pixels around
+	/// every texture.  Every file must be a 2D texture of the same format; block
+	/// compressed textures need sizes and padding that are multiples of 4.
+	///</summary>
+	static bool BuildAtlas(const std::vector<SourceFile>& files, uint32 padding, Padding mode,
+		std::vector<std::uint8_t>& file, std::vector<Entry>& entries, std::string& error);
+
+	static bool WriteTable(const std::wstring& fileName, const std::vector<Entry>& entries);
+
+	///<summary>
+	/// Reads a table WriteTable wrote.  Returns false when the file cannot be
+	/// opened or a line does not parse.
+	///</summary>
+	static bool ReadTable(const std::wstring& fileName, std::vector<Entry>& entries);
+};
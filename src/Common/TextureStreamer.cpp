@@ -0,0 +1,242 @@
+//***************************************************************************************
+// TextureStreamer.cpp
+//***************************************************************************************
+
+#include "TextureStreamer.h"
+#include "MappedFile.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	HRESULT ParseResultToHResult(DDSParser::Result result)
+	{
+		switch(result)
+		{
+		case DDSParser::Result::Ok:           return S_OK;
+		case DDSParser::Result::InvalidData:  return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+		case DDSParser::Result::NotSupported: return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+		case DDSParser::Result::EndOfFile:    return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+		default:                              return E_FAIL;
+		}
+	}
+}
+
+TextureStreamer::TextureStreamer(ID3D12Device* device, UINT uploadRetireDelay) :
+	mDevice(device),
+	mUploadRetireDelay(uploadRetireDelay)
+{
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	// Workers still running take nothing more off the queue.
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mRequests = decltype(mRequests)();
+	}
+
+	mTasks.wait();
+}
+
+void TextureStreamer::Load(Texture* texture, int priority, LoadedCallback onLoaded, UINT maxSize)
+{
+	assert(texture != nullptr);
+
+	Request request;
+	request.Target = texture;
+	request.Filename = texture->Filename;
+	request.Priority = priority;
+	request.MaxSize = maxSize;
+	request.OnLoaded = std::move(onLoaded);
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		request.Sequence = mNextSequence++;
+		mRequests.push(std::move(request));
+	}
+
+	++mPendingCount;
+
+	// Every task reads whichever request is on top when it starts, not necessarily
+	// the one it was started for, so priorities hold however the tasks are scheduled.
+	mTasks.run([this] { ReadNext(); });
+}
+
+void TextureStreamer::ReadNext()
+{
+	ReadTexture texture;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if(mRequests.empty())
+			return;
+
+		texture.Source = mRequests.top();
+		mRequests.pop();
+	}
+
+	texture.Result = Read(texture.Source.Filename, texture.Source.MaxSize, texture);
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	mRead.push_back(std::move(texture));
+}
+
+HRESULT TextureStreamer::Read(const std::wstring& filename, UINT maxSize, ReadTexture& texture)const
+{
+	MappedFile file;
+	if(!file.Open(filename))
+		return HRESULT_FROM_WIN32(GetLastError());
+
+	DDSParser::TextureDesc dds;
+	HRESULT hr = ParseResultToHResult(DDSParser::Parse(file.GetData(), file.GetSize(), dds));
+	if(FAILED(hr))
+		return hr;
+
+	if(dds.Dimension != DDSParser::ResourceDimension::Texture2D)
+		return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+	// Leave out the mips above maxSize, but always keep one.
+	UINT firstMip = 0;
+	DDSParser::Subresource top = DDSParser::GetSubresource(dds, 0, 0);
+	while(maxSize != 0 && firstMip + 1 < dds.MipLevels && (top.Width > maxSize || top.Height > maxSize))
+		top = DDSParser::GetSubresource(dds, ++firstMip, 0);
+
+	if(DDSParser::IsBlockCompressed(dds.Format))
+	{
+		while(firstMip > 0 && (top.Width % 4 != 0 || top.Height % 4 != 0))
+			top = DDSParser::GetSubresource(dds, --firstMip, 0);
+	}
+
+	const UINT mipLevels = dds.MipLevels - firstMip;
+	D3D12_RESOURCE_DESC texDesc = CD3DX12_RESOURCE_DESC::Tex2D(dds.Format,
+		top.Width, top.Height, (UINT16)dds.ArraySize, (UINT16)mipLevels);
+
+	hr = mDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT),
+		D3D12_HEAP_FLAG_NONE,
+		&texDesc,
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(texture.Resource.GetAddressOf()));
+	if(FAILED(hr))
+		return hr;
+
+	const UINT subresourceCount = mipLevels*dds.ArraySize;
+	texture.Footprints.resize(subresourceCount);
+
+	UINT64 uploadSize = 0;
+	mDevice->GetCopyableFootprints(&texDesc, 0, subresourceCount, 0,
+		texture.Footprints.data(), nullptr, nullptr, &uploadSize);
+
+	hr = mDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(uploadSize),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(texture.UploadHeap.GetAddressOf()));
+	if(FAILED(hr))
+		return hr;
+
+	BYTE* mappedData = nullptr;
+	hr = texture.UploadHeap->Map(0, nullptr, reinterpret_cast<void**>(&mappedData));
+	if(FAILED(hr))
+		return hr;
+
+	// D3D12 numbers subresources slice by slice, mips in order inside each.  Rows
+	// are copied one by one because the upload heap pads them to
+	// D3D12_TEXTURE_DATA_PITCH_ALIGNMENT.
+	for(UINT i = 0; i < subresourceCount; ++i)
+	{
+		const DDSParser::Subresource src = DDSParser::GetSubresource(dds, firstMip + i % mipLevels, i / mipLevels);
+		const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& dst = texture.Footprints[i];
+
+		const BYTE* srcRow = file.GetData() + src.Offset;
+		BYTE* dstRow = mappedData + dst.Offset;
+		for(UINT row = 0; row < src.RowCount; ++row)
+		{
+			memcpy(dstRow, srcRow, src.RowPitch);
+			srcRow += src.RowPitch;
+			dstRow += dst.Footprint.RowPitch;
+		}
+	}
+
+	texture.UploadHeap->Unmap(0, nullptr);
+	texture.File = dds;
+	return S_OK;
+}
+
+void TextureStreamer::Update(ID3D12GraphicsCommandList* cmdList)
+{
+	++mUpdateCount;
+
+	// Upload heaps and replaced resources no frame in flight can still be using.
+	for(size_t i = 0; i < mRetiringResources.size(); )
+	{
+		if(mRetiringResources[i].second + mUploadRetireDelay <= mUpdateCount)
+		{
+			mRetiringResources[i] = std::move(mRetiringResources.back());
+			mRetiringResources.pop_back();
+		}
+		else
+			++i;
+	}
+
+	std::vector<ReadTexture> read;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		read.swap(mRead);
+	}
+
+	if(read.empty())
+		return;
+
+	std::vector<D3D12_RESOURCE_BARRIER> barriers;
+	barriers.reserve(read.size());
+
+	for(auto& texture : read)
+	{
+		if(FAILED(texture.Result))
+		{
+			throw DxException(texture.Result, L"TextureStreamer loading " + texture.Source.Filename,
+				AnsiToWString(__FILE__), __LINE__);
+		}
+
+		for(UINT i = 0; i < (UINT)texture.Footprints.size(); ++i)
+		{
+			CD3DX12_TEXTURE_COPY_LOCATION dst(texture.Resource.Get(), i);
+			CD3DX12_TEXTURE_COPY_LOCATION src(texture.UploadHeap.Get(), texture.Footprints[i]);
+			cmdList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+		}
+
+		barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(texture.Resource.Get(),
+			D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+
+		mRetiringResources.push_back(std::make_pair(std::move(texture.UploadHeap), mUpdateCount));
+	}
+
+	cmdList->ResourceBarrier((UINT)barriers.size(), barriers.data());
+
+	for(auto& texture : read)
+	{
+		--mPendingCount;
+
+		Texture* target = texture.Source.Target;
+		if(target->Resource != nullptr)
+			mRetiringResources.push_back(std::make_pair(std::move(target->Resource), mUpdateCount));
+
+		target->Resource = std::move(texture.Resource);
+		if(texture.Source.OnLoaded)
+			texture.Source.OnLoaded(*target, texture.File);
+	}
+}
+
+void TextureStreamer::WaitForPending()
+{
+	mTasks.wait();
+}
+
+UINT TextureStreamer::GetPendingCount()const
+{
+	return mPendingCount;
+}
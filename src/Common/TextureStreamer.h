@@ -0,0 +1,125 @@
+//***************************************************************************************
+// TextureStreamer.h
+//
+// Loads DDS textures on worker threads so an app can draw its first frame before its
+// textures have arrived.  A request names the Texture to fill and a priority; workers
+// always take the highest priority request waiting, and equal priorities go in the
+// order they were made.  A worker maps the file, creates the default heap texture and
+// its upload heap, and copies the pixels into the upload heap.  Update, called once a
+// frame on the render thread, records the GPU copies for every texture that is ready
+// and then runs its completion callback, which is where the app points its
+// descriptors or materials at the texture instead of a placeholder.
+//
+// A request may leave out the mips larger than a given size, which is how
+// MipResidency's changes are carried out: the texture is loaded again with its new
+// finest mip, and the resource it replaces is released once no frame in flight can
+// use it.
+//
+// Only 2D textures, 2D texture arrays and cube maps are supported, which covers the
+// textures the demos use.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "DDSParser.h"
+#include <ppl.h>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <vector>
+
+class TextureStreamer
+{
+public:
+	// Runs on the render thread, inside Update, once texture.Resource is set.  file
+	// describes the whole texture in the file; the resource holds its mips from
+	// file.MipLevels - Resource->GetDesc().MipLevels on.
+	using LoadedCallback = std::function<void(Texture& texture, const DDSParser::TextureDesc& file)>;
+
+	///<summary>
+	/// Upload heaps, and resources replaced by a new load, are released
+	/// uploadRetireDelay Updates after the commands using them were recorded, so it
+	/// must be at least the number of frames in flight.
+	///</summary>
+	TextureStreamer(ID3D12Device* device, UINT uploadRetireDelay);
+	TextureStreamer(const TextureStreamer& rhs) = delete;
+	TextureStreamer& operator=(const TextureStreamer& rhs) = delete;
+	~TextureStreamer();
+
+	///<summary>
+	/// Queues texture->Filename.  Call from the render thread.  texture must stay
+	/// alive until its callback has run; its Resource is left alone until then.
+	/// When maxSize is nonzero, mips with a side above it are left out, except that
+	/// block compressed textures keep a top level whose sides are multiples of 4.
+	///</summary>
+	void Load(Texture* texture, int priority, LoadedCallback onLoaded = nullptr, UINT maxSize = 0);
+
+	///<summary>
+	/// Call once a frame on the render thread, with a command list that has been
+	/// reset and is executed before the frame's draws.  Records the copies for the
+	/// textures read since the last call, transitions them to
+	/// PIXEL_SHADER_RESOURCE and runs their callbacks.  Throws DxException for a
+	/// texture that could not be loaded.
+	///</summary>
+	void Update(ID3D12GraphicsCommandList* cmdList);
+
+	///<summary>
+	/// Blocks until every queued texture has been read.  The next Update uploads
+	/// them.
+	///</summary>
+	void WaitForPending();
+
+	// Textures queued whose callbacks have not run yet.
+	UINT GetPendingCount()const;
+
+private:
+	struct Request
+	{
+		Texture* Target = nullptr;
+		std::wstring Filename;
+		int Priority = 0;
+		UINT MaxSize = 0;
+		UINT64 Sequence = 0;
+		LoadedCallback OnLoaded;
+	};
+
+	// Orders the queue so its top is the highest priority, earliest request.
+	struct RequestOrder
+	{
+		bool operator()(const Request& a, const Request& b)const
+		{
+			return a.Priority != b.Priority ? a.Priority < b.Priority : a.Sequence > b.Sequence;
+		}
+	};
+
+	struct ReadTexture
+	{
+		Request Source;
+		HRESULT Result = S_OK;
+		DDSParser::TextureDesc File;
+		Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+		Microsoft::WRL::ComPtr<ID3D12Resource> UploadHeap;
+		std::vector<D3D12_PLACED_SUBRESOURCE_FOOTPRINT> Footprints;
+	};
+
+	void ReadNext();
+	HRESULT Read(const std::wstring& filename, UINT maxSize, ReadTexture& texture)const;
+
+private:
+	Microsoft::WRL::ComPtr<ID3D12Device> mDevice;
+	UINT mUploadRetireDelay = 0;
+
+	// Requests not yet taken by a worker, and textures read but not yet uploaded.
+	std::mutex mMutex;
+	std::priority_queue<Request, std::vector<Request>, RequestOrder> mRequests;
+	std::vector<ReadTexture> mRead;
+	UINT64 mNextSequence = 0;
+
+	// Render thread only.
+	UINT mPendingCount = 0;
+	UINT64 mUpdateCount = 0;
+	std::vector<std::pair<Microsoft::WRL::ComPtr<ID3D12Resource>, UINT64>> mRetiringResources;
+
+	concurrency::task_group mTasks;
+};
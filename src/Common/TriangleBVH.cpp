@@ -0,0 +1,438 @@
+//***************************************************************************************
+// TriangleBVH.cpp
+//***************************************************************************************
+
+#include "TriangleBVH.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <utility>
+
+using namespace DirectX;
+
+namespace
+{
+	// Number of centroid bins evaluated per axis when looking for the best split.
+	const int BinCount = 16;
+
+	// Traversal stack size.  The build stops splitting at this depth, and a
+	// depth-first traversal never holds more than one entry per level plus one.
+	const int MaxStackDepth = 64;
+
+	struct Bin
+	{
+		XMFLOAT3 BoundsMin = { +FLT_MAX, +FLT_MAX, +FLT_MAX };
+		XMFLOAT3 BoundsMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		TriangleBVH::uint32 TriCount = 0;
+	};
+
+	// Half the surface area of the box, which is all the SAH needs.
+	float HalfArea(const XMFLOAT3& vMin, const XMFLOAT3& vMax)
+	{
+		float dx = vMax.x - vMin.x;
+		float dy = vMax.y - vMin.y;
+		float dz = vMax.z - vMin.z;
+
+		return dx*dy + dy*dz + dz*dx;
+	}
+
+	void GrowBounds(XMFLOAT3& vMin, XMFLOAT3& vMax, const XMFLOAT3& pMin, const XMFLOAT3& pMax)
+	{
+		XMStoreFloat3(&vMin, XMVectorMin(XMLoadFloat3(&vMin), XMLoadFloat3(&pMin)));
+		XMStoreFloat3(&vMax, XMVectorMax(XMLoadFloat3(&vMax), XMLoadFloat3(&pMax)));
+	}
+
+	float GetAxis(const XMFLOAT3& v, int axis)
+	{
+		return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+	}
+
+	// Moller-Trumbore ray/triangle test.  Both sides of the triangle are hit, to
+	// match TriangleTests::Intersects which the picking code used before.
+	bool RayTriangle(FXMVECTOR rayOrigin, FXMVECTOR rayDir, const TriangleBVH::Triangle& tri, float& t)
+	{
+		XMVECTOR e1 = XMLoadFloat3(&tri.E1);
+		XMVECTOR e2 = XMLoadFloat3(&tri.E2);
+
+		XMVECTOR p = XMVector3Cross(rayDir, e2);
+		float det = XMVectorGetX(XMVector3Dot(e1, p));
+		if(std::fabs(det) < 1e-12f)
+			return false;
+
+		float invDet = 1.0f / det;
+
+		XMVECTOR s = XMVectorSubtract(rayOrigin, XMLoadFloat3(&tri.V0));
+		float u = XMVectorGetX(XMVector3Dot(s, p)) * invDet;
+		if(u < 0.0f || u > 1.0f)
+			return false;
+
+		XMVECTOR q = XMVector3Cross(s, e1);
+		float v = XMVectorGetX(XMVector3Dot(rayDir, q)) * invDet;
+		if(v < 0.0f || u + v > 1.0f)
+			return false;
+
+		t = XMVectorGetX(XMVector3Dot(e2, q)) * invDet;
+
+		return t >= 0.0f;
+	}
+
+	template<typename IndexT>
+	void GatherTriangles(const XMFLOAT3* positions, TriangleBVH::uint32 positionStride,
+		const IndexT* indices, TriangleBVH::uint32 triCount, int baseVertex,
+		std::vector<TriangleBVH::Triangle>& tris)
+	{
+		const char* base = reinterpret_cast<const char*>(positions);
+
+		tris.resize(triCount);
+		for(TriangleBVH::uint32 i = 0; i < triCount; ++i)
+		{
+			XMVECTOR v[3];
+			for(int k = 0; k < 3; ++k)
+			{
+				size_t vertex = static_cast<size_t>(baseVertex + static_cast<int>(indices[i*3 + k]));
+				v[k] = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(base + vertex*positionStride));
+			}
+
+			XMStoreFloat3(&tris[i].V0, v[0]);
+			XMStoreFloat3(&tris[i].E1, XMVectorSubtract(v[1], v[0]));
+			XMStoreFloat3(&tris[i].E2, XMVectorSubtract(v[2], v[0]));
+		}
+	}
+}
+
+void TriangleBVH::Build(const XMFLOAT3* positions, uint32 positionStride,
+	const uint32* indices, uint32 triCount, int baseVertex)
+{
+	GatherTriangles(positions, positionStride, indices, triCount, baseVertex, mTris);
+	BuildTree();
+}
+
+void TriangleBVH::Build(const XMFLOAT3* positions, uint32 positionStride,
+	const uint16* indices, uint32 triCount, int baseVertex)
+{
+	GatherTriangles(positions, positionStride, indices, triCount, baseVertex, mTris);
+	BuildTree();
+}
+
+void TriangleBVH::BuildTree()
+{
+	mNodes.clear();
+	mTriIds.clear();
+
+	const uint32 triCount = (uint32)mTris.size();
+	if(triCount == 0)
+		return;
+
+	// Per-triangle bounds and centroids, indexed by original triangle id.  The build
+	// only permutes mTriIds; the triangles are reordered to match once it is done.
+	std::vector<XMFLOAT3> triMin(triCount);
+	std::vector<XMFLOAT3> triMax(triCount);
+	std::vector<XMFLOAT3> centroids(triCount);
+
+	mTriIds.resize(triCount);
+	for(uint32 i = 0; i < triCount; ++i)
+	{
+		XMVECTOR v0 = XMLoadFloat3(&mTris[i].V0);
+		XMVECTOR v1 = XMVectorAdd(v0, XMLoadFloat3(&mTris[i].E1));
+		XMVECTOR v2 = XMVectorAdd(v0, XMLoadFloat3(&mTris[i].E2));
+
+		XMStoreFloat3(&triMin[i], XMVectorMin(v0, XMVectorMin(v1, v2)));
+		XMStoreFloat3(&triMax[i], XMVectorMax(v0, XMVectorMax(v1, v2)));
+		XMStoreFloat3(&centroids[i], XMVectorScale(XMVectorAdd(v0, XMVectorAdd(v1, v2)), 1.0f / 3.0f));
+
+		mTriIds[i] = i;
+	}
+
+	// A binary tree with leaves of at least one triangle has at most 2N-1 nodes.
+	mNodes.reserve(2*triCount);
+
+	Node root;
+	root.LeftFirst = 0;
+	root.TriCount = triCount;
+	mNodes.push_back(root);
+	UpdateNodeBounds(0, triMin, triMax);
+
+	// Split nodes with an explicit work list rather than recursion so
+	// that degenerate input cannot overflow the call stack.
+	std::vector<std::pair<uint32, int>> work;
+	work.push_back({ 0, 0 });
+	while(!work.empty())
+	{
+		uint32 nodeIndex = work.back().first;
+		int depth = work.back().second;
+		work.pop_back();
+
+		if(depth >= MaxStackDepth - 2)
+			continue;
+
+		Subdivide(nodeIndex, triMin, triMax, centroids);
+
+		if(!mNodes[nodeIndex].IsLeaf())
+		{
+			work.push_back({ mNodes[nodeIndex].LeftFirst, depth + 1 });
+			work.push_back({ mNodes[nodeIndex].LeftFirst + 1, depth + 1 });
+		}
+	}
+
+	mNodes.shrink_to_fit();
+
+	// Bake the triangles in leaf order so a leaf reads one contiguous range.
+	std::vector<Triangle> ordered(triCount);
+	for(uint32 i = 0; i < triCount; ++i)
+		ordered[i] = mTris[mTriIds[i]];
+
+	mTris.swap(ordered);
+}
+
+void TriangleBVH::UpdateNodeBounds(uint32 nodeIndex, const std::vector<XMFLOAT3>& triMin,
+	const std::vector<XMFLOAT3>& triMax)
+{
+	Node& node = mNodes[nodeIndex];
+	node.BoundsMin = XMFLOAT3(+FLT_MAX, +FLT_MAX, +FLT_MAX);
+	node.BoundsMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+	for(uint32 i = 0; i < node.TriCount; ++i)
+	{
+		uint32 id = mTriIds[node.LeftFirst + i];
+		GrowBounds(node.BoundsMin, node.BoundsMax, triMin[id], triMax[id]);
+	}
+}
+
+void TriangleBVH::Subdivide(uint32 nodeIndex, const std::vector<XMFLOAT3>& triMin,
+	const std::vector<XMFLOAT3>& triMax, const std::vector<XMFLOAT3>& centroids)
+{
+	const uint32 first = mNodes[nodeIndex].LeftFirst;
+	const uint32 count = mNodes[nodeIndex].TriCount;
+
+	if(count <= 2)
+		return;
+
+	// Bin on the centroid bounds rather than the node bounds so that large triangles
+	// do not squeeze the centroids into a few bins.
+	XMFLOAT3 cMin(+FLT_MAX, +FLT_MAX, +FLT_MAX);
+	XMFLOAT3 cMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for(uint32 i = 0; i < count; ++i)
+	{
+		const XMFLOAT3& c = centroids[mTriIds[first + i]];
+		GrowBounds(cMin, cMax, c, c);
+	}
+
+	int bestAxis = -1;
+	int bestSplit = 0;
+	float bestCost = FLT_MAX;
+
+	for(int axis = 0; axis < 3; ++axis)
+	{
+		float axisMin = GetAxis(cMin, axis);
+		float axisMax = GetAxis(cMax, axis);
+		if(axisMax <= axisMin)
+			continue;
+
+		Bin bins[BinCount];
+		float scale = BinCount / (axisMax - axisMin);
+		for(uint32 i = 0; i < count; ++i)
+		{
+			uint32 id = mTriIds[first + i];
+			int b = std::min(BinCount - 1, (int)((GetAxis(centroids[id], axis) - axisMin) * scale));
+
+			bins[b].TriCount++;
+			GrowBounds(bins[b].BoundsMin, bins[b].BoundsMax, triMin[id], triMax[id]);
+		}
+
+		// Sweep from both ends to get the area and count on each side of every plane.
+		float leftArea[BinCount - 1];
+		float rightArea[BinCount - 1];
+		uint32 leftCount[BinCount - 1];
+		uint32 rightCount[BinCount - 1];
+
+		Bin leftBox;
+		Bin rightBox;
+		uint32 leftSum = 0;
+		uint32 rightSum = 0;
+		for(int i = 0; i < BinCount - 1; ++i)
+		{
+			leftSum += bins[i].TriCount;
+			leftCount[i] = leftSum;
+			GrowBounds(leftBox.BoundsMin, leftBox.BoundsMax, bins[i].BoundsMin, bins[i].BoundsMax);
+			leftArea[i] = leftSum > 0 ? HalfArea(leftBox.BoundsMin, leftBox.BoundsMax) : 0.0f;
+
+			rightSum += bins[BinCount - 1 - i].TriCount;
+			rightCount[BinCount - 2 - i] = rightSum;
+			GrowBounds(rightBox.BoundsMin, rightBox.BoundsMax, bins[BinCount - 1 - i].BoundsMin, bins[BinCount - 1 - i].BoundsMax);
+			rightArea[BinCount - 2 - i] = rightSum > 0 ? HalfArea(rightBox.BoundsMin, rightBox.BoundsMax) : 0.0f;
+		}
+
+		for(int i = 0; i < BinCount - 1; ++i)
+		{
+			if(leftCount[i] == 0 || rightCount[i] == 0)
+				continue;
+
+			float cost = leftCount[i]*leftArea[i] + rightCount[i]*rightArea[i];
+			if(cost < bestCost)
+			{
+				bestAxis = axis;
+				bestSplit = i;
+				bestCost = cost;
+			}
+		}
+	}
+
+	// Stop if no split beats intersecting every triangle in this node.
+	const Node& node = mNodes[nodeIndex];
+	float leafCost = count * HalfArea(node.BoundsMin, node.BoundsMax);
+	if(bestAxis < 0 || bestCost >= leafCost)
+		return;
+
+	// Partition the triangle ids in place about the chosen bin plane.
+	float axisMin = GetAxis(cMin, bestAxis);
+	float scale = BinCount / (GetAxis(cMax, bestAxis) - axisMin);
+
+	uint32 i = first;
+	uint32 j = first + count;
+	while(i < j)
+	{
+		int b = std::min(BinCount - 1, (int)((GetAxis(centroids[mTriIds[i]], bestAxis) - axisMin) * scale));
+		if(b <= bestSplit)
+			++i;
+		else
+			std::swap(mTriIds[i], mTriIds[--j]);
+	}
+
+	uint32 leftCount = i - first;
+	if(leftCount == 0 || leftCount == count)
+		return;
+
+	uint32 leftChild = (uint32)mNodes.size();
+
+	Node left;
+	left.LeftFirst = first;
+	left.TriCount = leftCount;
+
+	Node right;
+	right.LeftFirst = i;
+	right.TriCount = count - leftCount;
+
+	mNodes.push_back(left);
+	mNodes.push_back(right);
+
+	// Convert this node to an interior node.  Note mNodes may have reallocated, so
+	// index it again rather than using the reference from above.
+	mNodes[nodeIndex].LeftFirst = leftChild;
+	mNodes[nodeIndex].TriCount = 0;
+
+	UpdateNodeBounds(leftChild, triMin, triMax);
+	UpdateNodeBounds(leftChild + 1, triMin, triMax);
+}
+
+bool TriangleBVH::Intersects(FXMVECTOR rayOrigin, FXMVECTOR rayDir, float& dist, uint32& triangle)const
+{
+	if(mNodes.empty())
+		return false;
+
+	XMVECTOR invDir = RayInvDirection(rayDir);
+
+	struct StackEntry
+	{
+		uint32 Node;
+		float Entry;
+	};
+
+	StackEntry stack[MaxStackDepth];
+	int stackSize = 0;
+
+	float closest = FLT_MAX;
+	bool hit = false;
+
+	float rootEntry = RayBoxEntry(mNodes[0].BoundsMin, mNodes[0].BoundsMax, rayOrigin, invDir, closest);
+	if(rootEntry == FLT_MAX)
+		return false;
+
+	stack[stackSize++] = { 0, rootEntry };
+	while(stackSize > 0)
+	{
+		StackEntry e = stack[--stackSize];
+
+		// A closer hit may have been found since this node was pushed.
+		if(e.Entry >= closest)
+			continue;
+
+		const Node& node = mNodes[e.Node];
+		if(node.IsLeaf())
+		{
+			for(uint32 i = node.LeftFirst; i < node.LeftFirst + node.TriCount; ++i)
+			{
+				float t = 0.0f;
+				if(RayTriangle(rayOrigin, rayDir, mTris[i], t) && t < closest)
+				{
+					closest = t;
+					triangle = mTriIds[i];
+					hit = true;
+				}
+			}
+			continue;
+		}
+
+		uint32 nearChild = node.LeftFirst;
+		uint32 farChild = node.LeftFirst + 1;
+		float nearEntry = RayBoxEntry(mNodes[nearChild].BoundsMin, mNodes[nearChild].BoundsMax, rayOrigin, invDir, closest);
+		float farEntry = RayBoxEntry(mNodes[farChild].BoundsMin, mNodes[farChild].BoundsMax, rayOrigin, invDir, closest);
+
+		if(farEntry < nearEntry)
+		{
+			std::swap(nearChild, farChild);
+			std::swap(nearEntry, farEntry);
+		}
+
+		// Push the far child first so the near child is visited first.
+		if(farEntry != FLT_MAX)
+			stack[stackSize++] = { farChild, farEntry };
+		if(nearEntry != FLT_MAX)
+			stack[stackSize++] = { nearChild, nearEntry };
+	}
+
+	if(hit)
+		dist = closest;
+
+	return hit;
+}
+
+float TriangleBVH::RayBoxEntry(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax,
+	FXMVECTOR rayOrigin, FXMVECTOR invDir, float tMax)
+{
+	XMVECTOR t0 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&boundsMin), rayOrigin), invDir);
+	XMVECTOR t1 = XMVectorMultiply(XMVectorSubtract(XMLoadFloat3(&boundsMax), rayOrigin), invDir);
+
+	XMFLOAT3 tNear;
+	XMFLOAT3 tFar;
+	XMStoreFloat3(&tNear, XMVectorMin(t0, t1));
+	XMStoreFloat3(&tFar, XMVectorMax(t0, t1));
+
+	float tEnter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+	float tExit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+
+	return tEnter <= tExit ? tEnter : FLT_MAX;
+}
+
+XMVECTOR TriangleBVH::RayInvDirection(FXMVECTOR rayDir)
+{
+	// Avoid 0*inf = NaN in the slab test for axis-aligned rays.
+	XMFLOAT3 d;
+	XMStoreFloat3(&d, rayDir);
+	d.x = std::fabs(d.x) > 1e-20f ? d.x : 1e-20f;
+	d.y = std::fabs(d.y) > 1e-20f ? d.y : 1e-20f;
+	d.z = std::fabs(d.z) > 1e-20f ? d.z : 1e-20f;
+
+	return XMVectorReciprocal(XMLoadFloat3(&d));
+}
+
+BoundingBox TriangleBVH::GetBounds()const
+{
+	BoundingBox box;
+	if(!mNodes.empty())
+	{
+		BoundingBox::CreateFromPoints(box,
+			XMLoadFloat3(&mNodes[0].BoundsMin), XMLoadFloat3(&mNodes[0].BoundsMax));
+	}
+
+	return box;
+}
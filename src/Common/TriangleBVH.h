@@ -0,0 +1,100 @@
+//***************************************************************************************
+// TriangleBVH.h
+//
+// Bounding volume hierarchy over the triangles of an indexed triangle list.  It is
+// built once on the CPU (binned surface area heuristic) from the system memory copy
+// of a mesh and answers nearest-hit ray queries in logarithmic time, which is what
+// picking needs on dense meshes where a linear loop over all triangles is too slow.
+//
+// Triangles are baked into the hierarchy in leaf order, so the source vertex and
+// index buffers are not referenced after Build() returns.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+
+class TriangleBVH
+{
+public:
+
+    using uint16 = std::uint16_t;
+    using uint32 = std::uint32_t;
+
+	// 32 bytes so that two siblings share a cache line.
+	struct Node
+	{
+		DirectX::XMFLOAT3 BoundsMin;
+
+		// Interior node: index of the left child (the right child follows it).
+		// Leaf node: index of the first triangle in the leaf.
+		uint32 LeftFirst;
+
+		DirectX::XMFLOAT3 BoundsMax;
+
+		// Zero for interior nodes.
+		uint32 TriCount;
+
+		bool IsLeaf()const { return TriCount > 0; }
+	};
+
+	// Triangle stored in the form the Moller-Trumbore ray test wants it.
+	struct Triangle
+	{
+		DirectX::XMFLOAT3 V0;
+		DirectX::XMFLOAT3 E1; // V1 - V0
+		DirectX::XMFLOAT3 E2; // V2 - V0
+	};
+
+	///<summary>
+	/// Builds the hierarchy over triCount triangles read from the index list.  Each
+	/// vertex position is read from positions + (baseVertex + index)*positionStride
+	/// bytes, so an interleaved vertex buffer with the position first can be passed directly.
+	///</summary>
+	void Build(const DirectX::XMFLOAT3* positions, uint32 positionStride,
+		const uint32* indices, uint32 triCount, int baseVertex = 0);
+	void Build(const DirectX::XMFLOAT3* positions, uint32 positionStride,
+		const uint16* indices, uint32 triCount, int baseVertex = 0);
+
+	///<summary>
+	/// Finds the nearest triangle hit by the ray.  The ray direction does not need
+	/// to be unit length; dist is returned in units of the direction length.  On a
+	/// hit, triangle is the index of the triangle relative to the start of the
+	/// index list passed to Build().
+	///</summary>
+	bool Intersects(DirectX::FXMVECTOR rayOrigin, DirectX::FXMVECTOR rayDir,
+		float& dist, uint32& triangle)const;
+
+	///<summary>
+	/// Slab test shared with the other ray query code.  Returns the distance at which
+	/// the ray enters the box, or FLT_MAX if it misses it or only enters it beyond tMax.
+	/// invDir is the reciprocal of the ray direction as returned by RayInvDirection().
+	///</summary>
+	static float RayBoxEntry(const DirectX::XMFLOAT3& boundsMin, const DirectX::XMFLOAT3& boundsMax,
+		DirectX::FXMVECTOR rayOrigin, DirectX::FXMVECTOR invDir, float tMax);
+	static DirectX::XMVECTOR RayInvDirection(DirectX::FXMVECTOR rayDir);
+
+	bool Empty()const { return mNodes.empty(); }
+	DirectX::BoundingBox GetBounds()const;
+
+	const std::vector<Node>& GetNodes()const { return mNodes; }
+	const std::vector<Triangle>& GetTriangles()const { return mTris; }
+	const std::vector<uint32>& GetTriangleIds()const { return mTriIds; }
+
+private:
+	void BuildTree();
+	void UpdateNodeBounds(uint32 nodeIndex, const std::vector<DirectX::XMFLOAT3>& triMin,
+		const std::vector<DirectX::XMFLOAT3>& triMax);
+	void Subdivide(uint32 nodeIndex, const std::vector<DirectX::XMFLOAT3>& triMin,
+		const std::vector<DirectX::XMFLOAT3>& triMax, const std::vector<DirectX::XMFLOAT3>& centroids);
+
+private:
+	std::vector<Node> mNodes;
+
+	// Triangles in leaf order, and the original index of each one.
+	std::vector<Triangle> mTris;
+	std::vector<uint32> mTriIds;
+};
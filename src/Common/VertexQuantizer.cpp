@@ -0,0 +1,272 @@
+//***************************************************************************************
+// VertexQuantizer.cpp
+//***************************************************************************************
+
+#include "VertexQuantizer.h"
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace
+{
+	using int16 = VertexQuantizer::int16;
+	using uint16 = VertexQuantizer::uint16;
+	using uint32 = VertexQuantizer::uint32;
+
+	uint16 QuantizeUnorm16(float v)
+	{
+		v = std::min(std::max(v, 0.0f), 1.0f);
+		return (uint16)std::lround(v*65535.0f);
+	}
+
+	float DequantizeUnorm16(uint16 q)
+	{
+		return q / 65535.0f;
+	}
+
+	// The input assembler maps -32768 and -32767 both to -1.
+	float DequantizeSnorm16(int16 q)
+	{
+		return std::max(q / 32767.0f, -1.0f);
+	}
+
+	template<typename T>
+	const T& Attribute(const T* first, uint32 stride, uint32 i)
+	{
+		return *reinterpret_cast<const T*>(reinterpret_cast<const char*>(first) + (size_t)i*stride);
+	}
+
+	float AngleDegrees(FXMVECTOR original, FXMVECTOR decoded)
+	{
+		float length = XMVectorGetX(XMVector3Length(original));
+		if(length <= 0.0f)
+			return 0.0f;
+
+		// acos loses the small angles to rounding; atan2 of the sine and cosine does not.
+		XMVECTOR a = original / length;
+		XMVECTOR b = XMVector3Normalize(decoded);
+		float s = XMVectorGetX(XMVector3Length(XMVector3Cross(a, b)));
+		float c = XMVectorGetX(XMVector3Dot(a, b));
+		return XMConvertToDegrees(std::atan2(s, c));
+	}
+}
+
+VertexQuantizer::PositionQuantization VertexQuantizer::QuantizationFromBounds(const BoundingBox& bounds, bool uniformScale)
+{
+	PositionQuantization q;
+	q.Scale = XMFLOAT3(2.0f*bounds.Extents.x, 2.0f*bounds.Extents.y, 2.0f*bounds.Extents.z);
+
+	if(uniformScale)
+	{
+		float s = std::max(q.Scale.x, std::max(q.Scale.y, q.Scale.z));
+		q.Scale = XMFLOAT3(s, s, s);
+	}
+
+	q.Bias = XMFLOAT3(
+		bounds.Center.x - 0.5f*q.Scale.x,
+		bounds.Center.y - 0.5f*q.Scale.y,
+		bounds.Center.z - 0.5f*q.Scale.z);
+
+	return q;
+}
+
+XMMATRIX VertexQuantizer::DequantizeTransform(const PositionQuantization& q)
+{
+	return XMMatrixScaling(q.Scale.x, q.Scale.y, q.Scale.z) *
+		XMMatrixTranslation(q.Bias.x, q.Bias.y, q.Bias.z);
+}
+
+void VertexQuantizer::QuantizePosition(FXMVECTOR p, const PositionQuantization& q, uint16 out[4])
+{
+	XMFLOAT3 v;
+	XMStoreFloat3(&v, p);
+
+	const float* scale = &q.Scale.x;
+	const float* bias = &q.Bias.x;
+	const float* pv = &v.x;
+
+	for(int i = 0; i < 3; ++i)
+		out[i] = scale[i] > 0.0f ? QuantizeUnorm16((pv[i] - bias[i]) / scale[i]) : 0;
+
+	out[3] = 0;
+}
+
+XMVECTOR VertexQuantizer::DequantizePosition(const uint16 in[4], const PositionQuantization& q)
+{
+	XMVECTOR u = XMVectorSet(DequantizeUnorm16(in[0]), DequantizeUnorm16(in[1]), DequantizeUnorm16(in[2]), 0.0f);
+	return u*XMLoadFloat3(&q.Scale) + XMLoadFloat3(&q.Bias);
+}
+
+void VertexQuantizer::EncodeOctahedral(FXMVECTOR v, int16 out[2])
+{
+	XMFLOAT3 n;
+	XMStoreFloat3(&n, v);
+
+	float l1 = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+	if(l1 <= 0.0f)
+	{
+		out[0] = out[1] = 0;
+		return;
+	}
+
+	// Project onto the octahedron |x|+|y|+|z| = 1 and fold the lower half over the
+	// diagonals of the square.
+	float ex = n.x / l1;
+	float ey = n.y / l1;
+	if(n.z < 0.0f)
+	{
+		float fx = (1.0f - std::fabs(ey)) * (ex >= 0.0f ? 1.0f : -1.0f);
+		float fy = (1.0f - std::fabs(ex)) * (ey >= 0.0f ? 1.0f : -1.0f);
+		ex = fx;
+		ey = fy;
+	}
+
+	// Rounding each coordinate on its own is not always closest on the sphere, so
+	// try both neighbours of each.
+	float bx = std::floor(std::min(std::max(ex, -1.0f), 1.0f)*32767.0f);
+	float by = std::floor(std::min(std::max(ey, -1.0f), 1.0f)*32767.0f);
+
+	XMVECTOR unit = XMVector3Normalize(v);
+	float bestDot = -2.0f;
+	for(int i = 0; i < 4; ++i)
+	{
+		int16 candidate[2] = {
+			(int16)std::min(bx + (i & 1), 32767.0f),
+			(int16)std::min(by + (i >> 1), 32767.0f) };
+
+		float d = XMVectorGetX(XMVector3Dot(unit, DecodeOctahedral(candidate)));
+		if(d > bestDot)
+		{
+			bestDot = d;
+			out[0] = candidate[0];
+			out[1] = candidate[1];
+		}
+	}
+}
+
+XMVECTOR VertexQuantizer::DecodeOctahedral(const int16 in[2])
+{
+	float x = DequantizeSnorm16(in[0]);
+	float y = DequantizeSnorm16(in[1]);
+	float z = 1.0f - std::fabs(x) - std::fabs(y);
+
+	// Unfold the lower half.
+	float t = std::max(-z, 0.0f);
+	x += x >= 0.0f ? -t : t;
+	y += y >= 0.0f ? -t : t;
+
+	return XMVector3Normalize(XMVectorSet(x, y, z, 0.0f));
+}
+
+void VertexQuantizer::QuantizeTexC(const XMFLOAT2& texC, TexCFormat format, uint16 out[2])
+{
+	if(format == TexCFormat::Unorm16)
+	{
+		out[0] = QuantizeUnorm16(texC.x);
+		out[1] = QuantizeUnorm16(texC.y);
+	}
+	else
+	{
+		out[0] = XMConvertFloatToHalf(texC.x);
+		out[1] = XMConvertFloatToHalf(texC.y);
+	}
+}
+
+XMFLOAT2 VertexQuantizer::DequantizeTexC(const uint16 in[2], TexCFormat format)
+{
+	if(format == TexCFormat::Unorm16)
+		return XMFLOAT2(DequantizeUnorm16(in[0]), DequantizeUnorm16(in[1]));
+
+	return XMFLOAT2(XMConvertHalfToFloat(in[0]), XMConvertHalfToFloat(in[1]));
+}
+
+void VertexQuantizer::Compress(const XMFLOAT3* positions, const XMFLOAT3* normals,
+	const XMFLOAT2* texCs, uint32 stride, uint32 count,
+	const PositionQuantization& q, TexCFormat texCFormat, CompactVertex* out)
+{
+	for(uint32 i = 0; i < count; ++i)
+	{
+		QuantizePosition(XMLoadFloat3(&Attribute(positions, stride, i)), q, out[i].Pos);
+		EncodeOctahedral(XMLoadFloat3(&Attribute(normals, stride, i)), out[i].Normal);
+		QuantizeTexC(Attribute(texCs, stride, i), texCFormat, out[i].TexC);
+	}
+}
+
+void VertexQuantizer::Compress(const XMFLOAT3* positions, const XMFLOAT3* normals,
+	const XMFLOAT3* tangents, const XMFLOAT2* texCs, uint32 stride, uint32 count,
+	const PositionQuantization& q, TexCFormat texCFormat, CompactTangentVertex* out)
+{
+	for(uint32 i = 0; i < count; ++i)
+	{
+		QuantizePosition(XMLoadFloat3(&Attribute(positions, stride, i)), q, out[i].Pos);
+		EncodeOctahedral(XMLoadFloat3(&Attribute(normals, stride, i)), out[i].Normal);
+		EncodeOctahedral(XMLoadFloat3(&Attribute(tangents, stride, i)), out[i].TangentU);
+		QuantizeTexC(Attribute(texCs, stride, i), texCFormat, out[i].TexC);
+	}
+}
+
+void VertexQuantizer::Compress(const GeometryGenerator::MeshData& meshData,
+	const PositionQuantization& q, TexCFormat texCFormat, std::vector<CompactTangentVertex>& out)
+{
+	out.resize(meshData.Vertices.size());
+	if(out.empty())
+		return;
+
+	const GeometryGenerator::Vertex& v = meshData.Vertices[0];
+	Compress(&v.Position, &v.Normal, &v.TangentU, &v.TexC, sizeof(GeometryGenerator::Vertex),
+		(uint32)out.size(), q, texCFormat, out.data());
+}
+
+VertexQuantizer::ErrorStats VertexQuantizer::MeasureError(const CompactVertex* compact,
+	const XMFLOAT3* positions, const XMFLOAT3* normals,
+	const XMFLOAT2* texCs, uint32 stride, uint32 count,
+	const PositionQuantization& q, TexCFormat texCFormat)
+{
+	ErrorStats stats;
+	for(uint32 i = 0; i < count; ++i)
+	{
+		XMVECTOR p = XMLoadFloat3(&Attribute(positions, stride, i));
+		float positionError = XMVectorGetX(XMVector3Length(DequantizePosition(compact[i].Pos, q) - p));
+		stats.MaxPositionError = std::max(stats.MaxPositionError, positionError);
+
+		float normalError = AngleDegrees(XMLoadFloat3(&Attribute(normals, stride, i)), DecodeOctahedral(compact[i].Normal));
+		stats.MaxNormalError = std::max(stats.MaxNormalError, normalError);
+
+		const XMFLOAT2& texC = Attribute(texCs, stride, i);
+		XMFLOAT2 decoded = DequantizeTexC(compact[i].TexC, texCFormat);
+		stats.MaxTexCError = std::max(stats.MaxTexCError,
+			std::max(std::fabs(decoded.x - texC.x), std::fabs(decoded.y - texC.y)));
+	}
+
+	return stats;
+}
+
+VertexQuantizer::ErrorStats VertexQuantizer::MeasureError(const CompactTangentVertex* compact,
+	const XMFLOAT3* positions, const XMFLOAT3* normals,
+	const XMFLOAT3* tangents, const XMFLOAT2* texCs, uint32 stride, uint32 count,
+	const PositionQuantization& q, TexCFormat texCFormat)
+{
+	ErrorStats stats;
+	for(uint32 i = 0; i < count; ++i)
+	{
+		XMVECTOR p = XMLoadFloat3(&Attribute(positions, stride, i));
+		float positionError = XMVectorGetX(XMVector3Length(DequantizePosition(compact[i].Pos, q) - p));
+		stats.MaxPositionError = std::max(stats.MaxPositionError, positionError);
+
+		float normalError = AngleDegrees(XMLoadFloat3(&Attribute(normals, stride, i)), DecodeOctahedral(compact[i].Normal));
+		stats.MaxNormalError = std::max(stats.MaxNormalError, normalError);
+
+		float tangentError = AngleDegrees(XMLoadFloat3(&Attribute(tangents, stride, i)), DecodeOctahedral(compact[i].TangentU));
+		stats.MaxTangentError = std::max(stats.MaxTangentError, tangentError);
+
+		const XMFLOAT2& texC = Attribute(texCs, stride, i);
+		XMFLOAT2 decoded = DequantizeTexC(compact[i].TexC, texCFormat);
+		stats.MaxTexCError = std::max(stats.MaxTexCError,
+			std::max(std::fabs(decoded.x - texC.x), std::fabs(decoded.y - texC.y)));
+	}
+
+	return stats;
+}
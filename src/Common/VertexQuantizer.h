@@ -0,0 +1,139 @@
+//***************************************************************************************
+// VertexQuantizer.h
+//
+// Packs vertices into compact formats the input assembler expands back to floats:
+//
+//   position  R16G16B16A16_UNORM  relative to the bounds of the mesh; the dequantize
+//                                 transform maps it back and can be folded into the
+//                                 world matrix.
+//   normal    R16G16_SNORM        octahedral: the unit sphere folded onto a square.
+//   tangent   R16G16_SNORM        octahedral.
+//   texC      R16G16_FLOAT        or R16G16_UNORM for coordinates within [0, 1].
+//
+// A vertex of position, normal and texture coordinates shrinks from 32 bytes to 16,
+// and GeometryGenerator::Vertex from 44 bytes to 20.  Positions are within half a
+// step of 1/65535 of the bounds per axis, normals within about 0.01 degrees, and
+// unorm texture coordinates within half a step of 1/65535.  Half floats keep 11
+// significant bits, so coordinates that tile far outside [0, 1] lose precision.
+//
+// Octahedral vectors are decoded in the vertex shader with
+//
+//   float3 v = float3(e, 1.0f - abs(e.x) - abs(e.y));
+//   float t = saturate(-v.z);
+//   v.xy += (v.xy >= 0.0f) ? -t : t;
+//   v = normalize(v);
+//
+// The code only depends on the standard library and DirectXMath.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <DirectXMath.h>
+#include <DirectXCollision.h>
+#include "GeometryGenerator.h"
+
+class VertexQuantizer
+{
+public:
+
+    using int16 = std::int16_t;
+    using uint16 = std::uint16_t;
+    using uint32 = std::uint32_t;
+
+	enum class TexCFormat
+	{
+		Float16, // R16G16_FLOAT; any range.
+		Unorm16  // R16G16_UNORM; [0, 1] only, but evenly precise.
+	};
+
+	// Position, normal, texture coordinates.  16 bytes.
+	struct CompactVertex
+	{
+		uint16 Pos[4];
+		int16 Normal[2];
+		uint16 TexC[2];
+	};
+
+	// Position, normal, tangent, texture coordinates.  20 bytes.
+	struct CompactTangentVertex
+	{
+		uint16 Pos[4];
+		int16 Normal[2];
+		int16 TangentU[2];
+		uint16 TexC[2];
+	};
+
+	// A quantized position q in [0, 1] per axis stands for q*Scale + Bias.
+	struct PositionQuantization
+	{
+		DirectX::XMFLOAT3 Scale = { 1.0f, 1.0f, 1.0f };
+		DirectX::XMFLOAT3 Bias = { 0.0f, 0.0f, 0.0f };
+	};
+
+	struct ErrorStats
+	{
+		// Largest distance between a position and its decoded value.
+		float MaxPositionError = 0.0f;
+
+		// Largest angle, in degrees, between a normal or tangent and its decoded value.
+		float MaxNormalError = 0.0f;
+		float MaxTangentError = 0.0f;
+
+		// Largest difference in a texture coordinate.
+		float MaxTexCError = 0.0f;
+	};
+
+	///<summary>
+	/// Quantization that covers the bounds.  With uniformScale every axis gets the
+	/// scale of the longest one, so the dequantize transform scales uniformly and can
+	/// be folded into a world matrix that also transforms the normals.
+	///</summary>
+	static PositionQuantization QuantizationFromBounds(const DirectX::BoundingBox& bounds, bool uniformScale = false);
+
+	///<summary>
+	/// Matrix taking quantized positions, as the input assembler expands them, to
+	/// the space the bounds were in.  Concatenate it ahead of the world matrix.
+	///</summary>
+	static DirectX::XMMATRIX DequantizeTransform(const PositionQuantization& q);
+
+	static void QuantizePosition(DirectX::FXMVECTOR p, const PositionQuantization& q, uint16 out[4]);
+	static DirectX::XMVECTOR DequantizePosition(const uint16 in[4], const PositionQuantization& q);
+
+	///<summary>
+	/// Encodes a unit vector, choosing among the four nearest codes the one that
+	/// decodes closest to v.
+	///</summary>
+	static void EncodeOctahedral(DirectX::FXMVECTOR v, int16 out[2]);
+	static DirectX::XMVECTOR DecodeOctahedral(const int16 in[2]);
+
+	static void QuantizeTexC(const DirectX::XMFLOAT2& texC, TexCFormat format, uint16 out[2]);
+	static DirectX::XMFLOAT2 DequantizeTexC(const uint16 in[2], TexCFormat format);
+
+	///<summary>
+	/// Packs count vertices whose attributes are read stride bytes apart, starting
+	/// at the given pointers, as in an array of the app's own Vertex structure.
+	///</summary>
+	static void Compress(const DirectX::XMFLOAT3* positions, const DirectX::XMFLOAT3* normals,
+		const DirectX::XMFLOAT2* texCs, uint32 stride, uint32 count,
+		const PositionQuantization& q, TexCFormat texCFormat, CompactVertex* out);
+	static void Compress(const DirectX::XMFLOAT3* positions, const DirectX::XMFLOAT3* normals,
+		const DirectX::XMFLOAT3* tangents, const DirectX::XMFLOAT2* texCs, uint32 stride, uint32 count,
+		const PositionQuantization& q, TexCFormat texCFormat, CompactTangentVertex* out);
+
+	static void Compress(const GeometryGenerator::MeshData& meshData,
+		const PositionQuantization& q, TexCFormat texCFormat, std::vector<CompactTangentVertex>& out);
+
+	///<summary>
+	/// Compares packed vertices with the vertices they were packed from.
+	///</summary>
+	static ErrorStats MeasureError(const CompactVertex* compact,
+		const DirectX::XMFLOAT3* positions, const DirectX::XMFLOAT3* normals,
+		const DirectX::XMFLOAT2* texCs, uint32 stride, uint32 count,
+		const PositionQuantization& q, TexCFormat texCFormat);
+	static ErrorStats MeasureError(const CompactTangentVertex* compact,
+		const DirectX::XMFLOAT3* positions, const DirectX::XMFLOAT3* normals,
+		const DirectX::XMFLOAT3* tangents, const DirectX::XMFLOAT2* texCs, uint32 stride, uint32 count,
+		const PositionQuantization& q, TexCFormat texCFormat);
+};
@@ -28,6 +28,7 @@
 #include "d3dx12.h"
 #include "DDSTextureLoader.h"
 #include "MathHelper.h"
+#include "TriangleBVH.h"
 
 extern const int gNumFrameResources;
 
@@ -184,6 +185,10 @@ struct MeshGeometry
 	// the Submeshes individually.
 	std::unordered_map<std::string, SubmeshGeometry> DrawArgs;
 
+	// Optional CPU ray query acceleration structures over the system memory copies,
+	// keyed the same as DrawArgs.  Built once at load time for meshes that are picked.
+	std::unordered_map<std::string, std::unique_ptr<TriangleBVH>> TriangleBvhs;
+
 	D3D12_VERTEX_BUFFER_VIEW VertexBufferView()const
 	{
 		D3D12_VERTEX_BUFFER_VIEW vbv;
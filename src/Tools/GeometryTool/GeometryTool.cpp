@@ -0,0 +1,766 @@
+//***************************************************************************************
+// GeometryTool.cpp
+//
+// Offline checks and measurements for the demos' geometry code.
+//
+//   GeometryTool rays [itemCount] [rayCount]
+//       Scatters itemCount spheres and boxes (10000 by default) and casts rayCount
+//       rays (262144 by default) at them, once as a camera's coherent primary
+//       rays and once in random directions.  Each set is traced ray by ray with
+//       SceneBVH::Intersects, as PickingApp picks, and as one RayQuery batch;
+//       the tool reports both times and any ray whose hits disagree.
+//
+//   GeometryTool spatial [itemCount ...]
+//       Times a LooseOctree and a SpatialHashGrid on a dense and a sparse scene of
+//       itemCount boxes (10000, 100000 and 1000000 by default): inserting every
+//       item, moving a tenth of them, and frustum, sphere and ray queries.  Query
+//       results are checked against testing every item, and items a query
+//       returns twice, misses or should not return are counted as mismatches.
+//
+//   GeometryTool mesh-stats file ...
+//       Runs MeshOptimizer over each subset of a model, as the demos do when they
+//       load it, and reports the ACMR and ATVR of a 16 entry FIFO cache before and
+//       after.  Reads the demos' .txt models, such as skull.txt, which are one
+//       subset, and .m3d models, such as soldier.m3d.  The optimized subsets are
+//       checked to draw the same triangles.
+//
+//   GeometryTool indices file ...
+//       Encodes the triangles of each model with IndexCodec, in the file's order
+//       and after MeshOptimizer, and reports the bytes per triangle and the decode
+//       time.  The decoded triangles are checked against the originals, and the
+//       encoding cut short by a byte must fail to decode.
+//***************************************************************************************
+
+#include "../../Common/GeometryGenerator.h"
+#include "../../Common/IndexCodec.h"
+#include "../../Common/LooseOctree.h"
+#include "../../Common/MeshOptimizer.h"
+#include "../../Common/RayQuery.h"
+#include "../../Common/SceneBVH.h"
+#include "../../Common/SpatialHashGrid.h"
+#include "../../Common/TriangleBVH.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <ppl.h>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace DirectX;
+
+namespace
+{
+	using Clock = chrono::steady_clock;
+	using uint32 = uint32_t;
+
+	double SecondsSince(Clock::time_point start)
+	{
+		return chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	// A mesh and the hierarchy the scene's items share.
+	struct Shape
+	{
+		GeometryGenerator::MeshData Mesh;
+		TriangleBVH Bvh;
+		BoundingBox Bounds;
+	};
+
+	void BuildShape(Shape& shape)
+	{
+		const auto& vertices = shape.Mesh.Vertices;
+		const auto& indices = shape.Mesh.Indices32;
+
+		shape.Bvh.Build(&vertices[0].Position, sizeof(GeometryGenerator::Vertex),
+			indices.data(), (uint32)indices.size() / 3);
+		BoundingBox::CreateFromPoints(shape.Bounds, vertices.size(), &vertices[0].Position,
+			sizeof(GeometryGenerator::Vertex));
+	}
+
+	// Counts the rays whose batch hit differs from the single ray hit.  The batch
+	// tests triangles four rays at a time with differently rounded arithmetic, so
+	// a ray along an edge shared by two triangles can pass between them in one
+	// test and not in the other; expect a few such rays per million.
+	uint32 CountMismatches(const SceneBVH& scene, const vector<RayQuery::Ray>& rays,
+		const vector<RayQuery::Hit>& hits, uint32& hitCount)
+	{
+		uint32 mismatches = 0;
+		hitCount = 0;
+		for(size_t i = 0; i < rays.size(); ++i)
+		{
+			float dist = 0.0f;
+			uint32 item = RayQuery::NoHit;
+			uint32 triangle = RayQuery::NoHit;
+			bool hit = scene.Intersects(XMLoadFloat3(&rays[i].Origin), XMLoadFloat3(&rays[i].Direction),
+				dist, item, triangle);
+
+			if(hit)
+				++hitCount;
+
+			bool same = hit ? hits[i].Item == item && hits[i].Triangle == triangle :
+				hits[i].Item == RayQuery::NoHit;
+
+			// Two triangles at the same distance, such as along a shared edge, are
+			// both the nearest hit.
+			if(!same && hit && hits[i].Item != RayQuery::NoHit)
+				same = fabs(hits[i].Distance - dist) <= 1e-4f*max(1.0f, dist);
+
+			if(!same)
+				++mismatches;
+		}
+
+		return mismatches;
+	}
+
+	void TraceRays(const wchar_t* name, const SceneBVH& scene, const vector<RayQuery::Ray>& rays)
+	{
+		const uint32 rayCount = (uint32)rays.size();
+		const uint32 taskCount = (rayCount + RayQuery::RaysPerTask - 1) / RayQuery::RaysPerTask;
+
+		// Single rays get the same split across cores as the batch, so the times
+		// compare the traversals.
+		Clock::time_point start = Clock::now();
+		concurrency::parallel_for(0u, taskCount, [&](uint32 task)
+		{
+			uint32 last = min(rayCount, (task + 1)*RayQuery::RaysPerTask);
+			for(uint32 i = task*RayQuery::RaysPerTask; i < last; ++i)
+			{
+				float dist;
+				uint32 item;
+				uint32 triangle;
+				scene.Intersects(XMLoadFloat3(&rays[i].Origin), XMLoadFloat3(&rays[i].Direction),
+					dist, item, triangle);
+			}
+		});
+		double singleSeconds = SecondsSince(start);
+
+		vector<RayQuery::Hit> hits(rays.size());
+		start = Clock::now();
+		RayQuery::Intersect(scene, rays.data(), rayCount, hits.data());
+		double batchSeconds = SecondsSince(start);
+
+		uint32 hitCount = 0;
+		uint32 mismatches = CountMismatches(scene, rays, hits, hitCount);
+
+		wcout << name << L": " << hitCount << L" of " << rayCount << L" rays hit, single "
+			<< singleSeconds*1000.0 << L" ms, batch " << batchSeconds*1000.0 << L" ms ("
+			<< singleSeconds / batchSeconds << L"x), " << mismatches << L" mismatches" << endl;
+	}
+
+	int Rays(const vector<wstring>& args)
+	{
+		const uint32 itemCount = args.size() > 0 ? (uint32)stoul(args[0]) : 10000;
+		const uint32 rayCount = args.size() > 1 ? (uint32)stoul(args[1]) : 262144;
+
+		GeometryGenerator geoGen;
+		Shape shapes[2];
+		shapes[0].Mesh = geoGen.CreateGeosphere(0.5f, 3);
+		shapes[1].Mesh = geoGen.CreateBox(1.0f, 1.0f, 1.0f, 2);
+		for(Shape& shape : shapes)
+			BuildShape(shape);
+
+		// About one item per 4x4x4 cell, in random orientations and sizes.
+		const float side = 4.0f*cbrt(float(itemCount));
+		mt19937 rng(1);
+		uniform_real_distribution<float> position(-0.5f*side, 0.5f*side);
+		uniform_real_distribution<float> scale(0.5f, 2.0f);
+		uniform_real_distribution<float> angle(-XM_PI, XM_PI);
+		uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+		auto randomDirection = [&]()
+		{
+			XMVECTOR v;
+			do
+			{
+				v = XMVectorSet(unit(rng), unit(rng), unit(rng), 0.0f);
+			} while(XMVectorGetX(XMVector3LengthSq(v)) < 1e-4f);
+
+			return XMVector3Normalize(v);
+		};
+
+		Clock::time_point start = Clock::now();
+
+		SceneBVH scene;
+		for(uint32 i = 0; i < itemCount; ++i)
+		{
+			const Shape& shape = shapes[i % 2];
+			XMMATRIX world = XMMatrixScaling(scale(rng), scale(rng), scale(rng)) *
+				XMMatrixRotationAxis(randomDirection(), angle(rng)) *
+				XMMatrixTranslation(position(rng), position(rng), position(rng));
+			scene.AddItem(shape.Bounds, &shape.Bvh, world);
+		}
+		scene.Update();
+
+		wcout << L"built a scene of " << itemCount << L" items in " << SecondsSince(start)*1000.0 << L" ms" << endl;
+
+		// Primary rays of a 90 degree camera outside the scene, looking at its center.
+		vector<RayQuery::Ray> rays(rayCount);
+		const uint32 width = (uint32)ceil(sqrt(double(rayCount)));
+		const XMVECTOR eye = XMVectorSet(0.0f, 0.25f*side, -side, 1.0f);
+		const XMMATRIX invView = XMMatrixInverse(nullptr,
+			XMMatrixLookAtLH(eye, XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)));
+		for(uint32 i = 0; i < rayCount; ++i)
+		{
+			float x = 2.0f*(i % width + 0.5f) / width - 1.0f;
+			float y = 1.0f - 2.0f*(i / width + 0.5f) / width;
+			XMStoreFloat3(&rays[i].Origin, eye);
+			XMStoreFloat3(&rays[i].Direction,
+				XMVector3Normalize(XMVector3TransformNormal(XMVectorSet(x, y, 1.0f, 0.0f), invView)));
+		}
+		TraceRays(L"coherent", scene, rays);
+
+		// Rays from random points inside the scene in random directions, as line of
+		// sight checks between objects scattered over it would be.
+		for(RayQuery::Ray& ray : rays)
+		{
+			ray.Origin = XMFLOAT3(position(rng), position(rng), position(rng));
+			XMStoreFloat3(&ray.Direction, randomDirection());
+		}
+		TraceRays(L"random", scene, rays);
+
+		return 0;
+	}
+
+	struct SpatialQueries
+	{
+		vector<BoundingFrustum> Frustums;
+		vector<BoundingSphere> Spheres;
+		vector<RayQuery::Ray> Rays;
+	};
+
+	// Queries whose results are compared with testing every item.
+	const size_t CheckedQueries = 16;
+
+	// What a query may return, found by testing every item.  Indices test items
+	// with Contains, and BoundingFrustum::Contains only tests the frustum's planes,
+	// so it passes some boxes near the frustum's edges that are outside it.  An
+	// index may leave those out when it has culled all the cells or nodes around
+	// them, so every item that intersects the volume is required and the rest
+	// Contains passes are allowed.
+	struct ExpectedItems
+	{
+		vector<uint32> Required[3];
+		vector<uint32> Allowed[3];
+	};
+
+	void QueryAll(const vector<BoundingBox>& bounds, const SpatialQueries& queries, size_t query,
+		ExpectedItems& expected)
+	{
+		const BoundingFrustum& frustum = queries.Frustums[query];
+		const BoundingSphere& sphere = queries.Spheres[query];
+		const RayQuery::Ray& ray = queries.Rays[query];
+
+		for(uint32 i = 0; i < (uint32)bounds.size(); ++i)
+		{
+			if(frustum.Intersects(bounds[i]))
+				expected.Required[0].push_back(i);
+			if(frustum.Contains(bounds[i]) != DISJOINT)
+				expected.Allowed[0].push_back(i);
+
+			if(sphere.Contains(bounds[i]) != DISJOINT)
+				expected.Required[1].push_back(i);
+
+			float dist = 0.0f;
+			if(bounds[i].Intersects(XMLoadFloat3(&ray.Origin), XMLoadFloat3(&ray.Direction), dist) && dist <= ray.MaxDist)
+				expected.Required[2].push_back(i);
+		}
+
+		expected.Allowed[1] = expected.Required[1];
+		expected.Allowed[2] = expected.Required[2];
+	}
+
+	void TimeSpatialIndex(const wchar_t* name, SpatialIndex& index, const vector<BoundingBox>& bounds,
+		const vector<BoundingBox>& moved, const SpatialQueries& queries,
+		const vector<ExpectedItems>& expected)
+	{
+		const uint32 itemCount = (uint32)bounds.size();
+
+		Clock::time_point start = Clock::now();
+		for(uint32 i = 0; i < itemCount; ++i)
+			index.Insert(i, bounds[i]);
+		double insertSeconds = SecondsSince(start);
+
+		start = Clock::now();
+		for(uint32 i = 0; i < itemCount; i += 10)
+			index.Move(i, moved[i]);
+		double moveSeconds = SecondsSince(start);
+
+		// Each query appends to a cleared vector, as a frame's culling would.
+		vector<uint32> items;
+		double querySeconds[3] = {};
+		size_t resultCount[3] = {};
+		uint32 mismatches = 0;
+		for(size_t q = 0; q < queries.Rays.size(); ++q)
+		{
+			const RayQuery::Ray& ray = queries.Rays[q];
+			for(int type = 0; type < 3; ++type)
+			{
+				items.clear();
+				start = Clock::now();
+				if(type == 0)
+					index.QueryFrustum(queries.Frustums[q], items);
+				else if(type == 1)
+					index.QuerySphere(queries.Spheres[q], items);
+				else
+					index.QueryRay(XMLoadFloat3(&ray.Origin), XMLoadFloat3(&ray.Direction), ray.MaxDist, items);
+				querySeconds[type] += SecondsSince(start);
+				resultCount[type] += items.size();
+
+				if(q < expected.size())
+				{
+					sort(items.begin(), items.end());
+					const ExpectedItems& e = expected[q];
+					if(adjacent_find(items.begin(), items.end()) != items.end() ||
+						!includes(items.begin(), items.end(), e.Required[type].begin(), e.Required[type].end()) ||
+						!includes(e.Allowed[type].begin(), e.Allowed[type].end(), items.begin(), items.end()))
+						++mismatches;
+				}
+			}
+		}
+
+		const double queryCount = double(queries.Rays.size());
+		wcout << L"  " << name << L": insert " << insertSeconds*1000.0 << L" ms, move " << moveSeconds*1000.0
+			<< L" ms, per query: frustum " << querySeconds[0]*1e6 / queryCount << L" us ("
+			<< resultCount[0] / queries.Rays.size() << L" items), sphere " << querySeconds[1]*1e6 / queryCount
+			<< L" us (" << resultCount[1] / queries.Rays.size() << L"), ray " << querySeconds[2]*1e6 / queryCount
+			<< L" us (" << resultCount[2] / queries.Rays.size() << L"), " << mismatches << L" mismatches" << endl;
+	}
+
+	// Boxes about a unit across, one in a hundred up to 32 units, spread over a cube
+	// that holds one item per spacing^3.
+	void TimeSpatialScene(const wchar_t* name, uint32 itemCount, float spacing)
+	{
+		const float side = spacing*cbrt(float(itemCount));
+		mt19937 rng(1);
+		uniform_real_distribution<float> position(-0.5f*side, 0.5f*side);
+		uniform_real_distribution<float> halfSize(0.25f, 1.0f);
+		uniform_real_distribution<float> largeHalfSize(4.0f, 16.0f);
+		uniform_real_distribution<float> offset(-1.0f, 1.0f);
+		uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		uniform_real_distribution<float> angle(-XM_PI, XM_PI);
+
+		vector<BoundingBox> bounds(itemCount);
+		vector<BoundingBox> moved(itemCount);
+		for(uint32 i = 0; i < itemCount; ++i)
+		{
+			float h = i % 100 == 99 ? largeHalfSize(rng) : halfSize(rng);
+			bounds[i] = BoundingBox(XMFLOAT3(position(rng), position(rng), position(rng)), XMFLOAT3(h, h, h));
+			moved[i] = bounds[i];
+			if(i % 10 == 0)
+			{
+				moved[i].Center.x += offset(rng);
+				moved[i].Center.y += offset(rng);
+				moved[i].Center.z += offset(rng);
+			}
+		}
+
+		// A 60 degree camera that sees 100 units, a 10 unit sphere and a 100 unit
+		// ray at random places in the scene.
+		const BoundingFrustum viewFrustum(XMMatrixPerspectiveFovLH(XM_PI / 3.0f, 16.0f / 9.0f, 1.0f, 100.0f));
+		SpatialQueries queries;
+		for(int q = 0; q < 64; ++q)
+		{
+			XMMATRIX world = XMMatrixRotationY(angle(rng)) *
+				XMMatrixTranslation(position(rng), position(rng), position(rng));
+			BoundingFrustum frustum;
+			viewFrustum.Transform(frustum, world);
+			queries.Frustums.push_back(frustum);
+
+			queries.Spheres.push_back(BoundingSphere(XMFLOAT3(position(rng), position(rng), position(rng)), 10.0f));
+
+			RayQuery::Ray ray;
+			ray.Origin = XMFLOAT3(position(rng), position(rng), position(rng));
+			XMVECTOR dir;
+			do
+			{
+				dir = XMVectorSet(unit(rng), unit(rng), unit(rng), 0.0f);
+			} while(XMVectorGetX(XMVector3LengthSq(dir)) < 1e-4f);
+			XMStoreFloat3(&ray.Direction, XMVector3Normalize(dir));
+			ray.MaxDist = 100.0f;
+			queries.Rays.push_back(ray);
+		}
+
+		vector<ExpectedItems> expected(CheckedQueries);
+		for(size_t q = 0; q < CheckedQueries; ++q)
+			QueryAll(moved, queries, q, expected[q]);
+
+		wcout << name << L" scene of " << itemCount << L" items, " << side << L" units across" << endl;
+
+		{
+			// Ten levels take the cells of the widest scene down to the size of the
+			// smallest items.
+			LooseOctree octree(XMFLOAT3(0.0f, 0.0f, 0.0f), 0.5f*side, 10);
+			TimeSpatialIndex(L"octree", octree, bounds, moved, queries, expected);
+		}
+
+		{
+			SpatialHashGrid grid(2.0f);
+			TimeSpatialIndex(L"grid", grid, bounds, moved, queries, expected);
+		}
+	}
+
+	int Spatial(const vector<wstring>& args)
+	{
+		vector<uint32> itemCounts;
+		for(const wstring& arg : args)
+			itemCounts.push_back((uint32)stoul(arg));
+		if(itemCounts.empty())
+			itemCounts = { 10000, 100000, 1000000 };
+
+		for(uint32 itemCount : itemCounts)
+		{
+			TimeSpatialScene(L"dense", itemCount, 2.0f);
+			TimeSpatialScene(L"sparse", itemCount, 20.0f);
+		}
+
+		return 0;
+	}
+
+	// Just what the cache statistics need from a model file.
+	struct MeshSubset
+	{
+		uint32 VertexStart = 0;
+		uint32 VertexCount = 0;
+		uint32 FaceStart = 0;
+		uint32 FaceCount = 0;
+	};
+
+	struct MeshFile
+	{
+		vector<XMFLOAT3> Positions;
+		vector<uint32> Indices;
+		vector<MeshSubset> Subsets;
+	};
+
+	// The format the demos read in BuildSkullGeometry and BuildCarGeometry.
+	bool LoadTxtModel(const wstring& fileName, MeshFile& mesh)
+	{
+		ifstream fin(fileName);
+		if(!fin)
+			return false;
+
+		uint32 vcount = 0;
+		uint32 tcount = 0;
+		string ignore;
+
+		fin >> ignore >> vcount;
+		fin >> ignore >> tcount;
+		fin >> ignore >> ignore >> ignore >> ignore;
+
+		mesh.Positions.resize(vcount);
+		for(uint32 i = 0; i < vcount; ++i)
+		{
+			XMFLOAT3 normal;
+			fin >> mesh.Positions[i].x >> mesh.Positions[i].y >> mesh.Positions[i].z;
+			fin >> normal.x >> normal.y >> normal.z;
+		}
+
+		fin >> ignore;
+		fin >> ignore;
+		fin >> ignore;
+
+		mesh.Indices.resize(3*tcount);
+		for(uint32 i = 0; i < 3*tcount; ++i)
+			fin >> mesh.Indices[i];
+
+		MeshSubset subset;
+		subset.VertexCount = vcount;
+		subset.FaceCount = tcount;
+		mesh.Subsets.push_back(subset);
+
+		return !fin.fail();
+	}
+
+	// Reads the subset table, the vertex positions and the triangles of an .m3d
+	// file, skipping the materials, the other vertex attributes and the skeleton.
+	bool LoadM3dModel(const wstring& fileName, MeshFile& mesh)
+	{
+		ifstream fin(fileName);
+		if(!fin)
+			return false;
+
+		uint32 materialCount = 0;
+		uint32 vertexCount = 0;
+		uint32 triangleCount = 0;
+		string ignore;
+
+		fin >> ignore;
+		fin >> ignore >> materialCount;
+		fin >> ignore >> vertexCount;
+		fin >> ignore >> triangleCount;
+
+		string line;
+		while(getline(fin, line) && line.find("SubsetTable") == string::npos)
+		{
+		}
+
+		mesh.Subsets.resize(materialCount);
+		for(auto& subset : mesh.Subsets)
+		{
+			fin >> ignore >> ignore;
+			fin >> ignore >> subset.VertexStart;
+			fin >> ignore >> subset.VertexCount;
+			fin >> ignore >> subset.FaceStart;
+			fin >> ignore >> subset.FaceCount;
+		}
+
+		mesh.Positions.reserve(vertexCount);
+		while(getline(fin, line) && line.find("Triangles") == string::npos)
+		{
+			istringstream ls(line);
+			string key;
+			XMFLOAT3 p;
+			if(ls >> key && key == "Position:" && ls >> p.x >> p.y >> p.z)
+				mesh.Positions.push_back(p);
+		}
+
+		mesh.Indices.resize(3*triangleCount);
+		for(uint32 i = 0; i < 3*triangleCount; ++i)
+			fin >> mesh.Indices[i];
+
+		return !fin.fail() && mesh.Positions.size() == vertexCount;
+	}
+
+	// Rotates a triangle to start at its smallest index, which keeps its winding.
+	void RotateToSmallest(uint32* t)
+	{
+		while(t[0] > t[1] || t[0] > t[2])
+			rotate(t, t + 1, t + 3);
+	}
+
+	// The triangles of indices with each vertex index mapped through remap, rotated
+	// to start at their smallest index so the winding is kept, in sorted order.
+	vector<uint32> SortedTriangles(const uint32* indices, uint32 indexCount, uint32 vertexStart,
+		const vector<uint32>* remap)
+	{
+		vector<uint32> triangles(indices, indices + indexCount);
+		if(remap)
+		{
+			for(uint32& index : triangles)
+				index = (*remap)[index - vertexStart];
+		}
+
+		for(uint32 i = 0; i < indexCount; i += 3)
+			RotateToSmallest(&triangles[i]);
+
+		vector<array<uint32, 3>> sorted(indexCount / 3);
+		for(size_t i = 0; i < sorted.size(); ++i)
+			sorted[i] = { triangles[3*i], triangles[3*i + 1], triangles[3*i + 2] };
+		sort(sorted.begin(), sorted.end());
+
+		for(size_t i = 0; i < sorted.size(); ++i)
+			copy(sorted[i].begin(), sorted[i].end(), &triangles[3*i]);
+
+		return triangles;
+	}
+
+	void PrintCacheStats(const MeshOptimizer::CacheStats& stats)
+	{
+		wcout << L"ACMR " << stats.Acmr << L", ATVR " << stats.Atvr;
+	}
+
+	int MeshStats(const vector<wstring>& args)
+	{
+		if(args.empty())
+		{
+			wcerr << L"mesh-stats needs a model file" << endl;
+			return 1;
+		}
+
+		int result = 0;
+		wcout.precision(3);
+		for(const wstring& fileName : args)
+		{
+			MeshFile mesh;
+			bool m3d = fileName.size() > 4 && fileName.compare(fileName.size() - 4, 4, L".m3d") == 0;
+			if(!(m3d ? LoadM3dModel(fileName, mesh) : LoadTxtModel(fileName, mesh)))
+			{
+				wcerr << fileName << L": cannot read the model" << endl;
+				result = 1;
+				continue;
+			}
+
+			wcout << fileName << L": " << mesh.Positions.size() << L" vertices, "
+				<< mesh.Indices.size() / 3 << L" triangles" << endl;
+
+			MeshOptimizer::CacheStats total[2];
+			for(size_t s = 0; s < mesh.Subsets.size(); ++s)
+			{
+				const MeshSubset& subset = mesh.Subsets[s];
+				uint32* indices = &mesh.Indices[subset.FaceStart*3];
+				const uint32 indexCount = subset.FaceCount*3;
+
+				vector<uint32> before = SortedTriangles(indices, indexCount, subset.VertexStart, nullptr);
+
+				MeshOptimizer::CacheStats stats[2];
+				vector<uint32> remap;
+				Clock::time_point start = Clock::now();
+				MeshOptimizer::OptimizeSubset(indices, indexCount, subset.VertexStart, subset.VertexCount,
+					mesh.Positions.data(), sizeof(XMFLOAT3), remap, &stats[0], &stats[1]);
+				double seconds = SecondsSince(start);
+
+				// Renumbering the vertices of the original triangles must give the
+				// optimized ones.
+				vector<uint32> remapped = SortedTriangles(before.data(), indexCount, subset.VertexStart, &remap);
+				bool same = remapped == SortedTriangles(indices, indexCount, subset.VertexStart, nullptr);
+
+				wcout << L"  subset " << s << L", " << subset.FaceCount << L" triangles: ";
+				PrintCacheStats(stats[0]);
+				wcout << L" -> ";
+				PrintCacheStats(stats[1]);
+				wcout << L", " << seconds*1000.0 << L" ms" << (same ? L"" : L", TRIANGLES CHANGED") << endl;
+
+				if(!same)
+					result = 1;
+
+				for(int i = 0; i < 2; ++i)
+				{
+					total[i].TriangleCount += stats[i].TriangleCount;
+					total[i].TransformCount += stats[i].TransformCount;
+				}
+			}
+
+			// Reordering keeps each subset's vertices in its range, so the vertices
+			// referenced can be counted once for the whole model.
+			vector<bool> referenced(mesh.Positions.size(), false);
+			for(uint32 index : mesh.Indices)
+				referenced[index] = true;
+			const size_t referencedCount = count(referenced.begin(), referenced.end(), true);
+
+			for(auto& stats : total)
+			{
+				stats.Acmr = float(stats.TransformCount) / max(stats.TriangleCount, 1u);
+				stats.Atvr = float(stats.TransformCount) / max<size_t>(referencedCount, 1);
+			}
+
+			wcout << L"  total: ";
+			PrintCacheStats(total[0]);
+			wcout << L" -> ";
+			PrintCacheStats(total[1]);
+			wcout << endl;
+		}
+
+		return result;
+	}
+
+	// Encodes the indices and decodes them back, checking that every triangle
+	// comes back in place, up to rotation.  Returns false on a mismatch.
+	bool TimeIndexCodec(const wchar_t* name, const vector<uint32>& indices)
+	{
+		const uint32 indexCount = (uint32)indices.size();
+
+		vector<uint8_t> encoded;
+		IndexCodec::Encode(indices.data(), indexCount, encoded);
+
+		// Decode about ten million indices so the time is measurable.
+		const uint32 repeats = max(1u, 10000000u / max(indexCount, 1u));
+		vector<uint32> decoded(indexCount);
+		bool decodes = true;
+		Clock::time_point start = Clock::now();
+		for(uint32 r = 0; r < repeats; ++r)
+			decodes &= IndexCodec::Decode(encoded.data(), encoded.size(), indexCount, decoded.data());
+		double seconds = SecondsSince(start) / repeats;
+
+		vector<uint32> expected = indices;
+		for(uint32 i = 0; i < indexCount; i += 3)
+		{
+			RotateToSmallest(&expected[i]);
+			RotateToSmallest(&decoded[i]);
+		}
+
+		bool same = decodes && decoded == expected;
+		bool truncatedFails = encoded.empty() ||
+			!IndexCodec::Decode(encoded.data(), encoded.size() - 1, indexCount, decoded.data());
+
+		wcout << L"  " << name << L": " << encoded.size() << L" bytes, "
+			<< float(encoded.size()) / max(indexCount / 3, 1u) << L" per triangle, decoded in "
+			<< seconds*1000.0 << L" ms" << (same ? L"" : L", TRIANGLES CHANGED")
+			<< (truncatedFails ? L"" : L", TRUNCATED DATA DECODED") << endl;
+
+		return same && truncatedFails;
+	}
+
+	int Indices(const vector<wstring>& args)
+	{
+		if(args.empty())
+		{
+			wcerr << L"indices needs a model file" << endl;
+			return 1;
+		}
+
+		int result = 0;
+		wcout.precision(3);
+		for(const wstring& fileName : args)
+		{
+			MeshFile mesh;
+			bool m3d = fileName.size() > 4 && fileName.compare(fileName.size() - 4, 4, L".m3d") == 0;
+			if(!(m3d ? LoadM3dModel(fileName, mesh) : LoadTxtModel(fileName, mesh)))
+			{
+				wcerr << fileName << L": cannot read the model" << endl;
+				result = 1;
+				continue;
+			}
+
+			const uint32 triangleCount = (uint32)mesh.Indices.size() / 3;
+			wcout << fileName << L": " << triangleCount << L" triangles, "
+				<< (mesh.Positions.size() <= 65536 ? 6 : 12) << L" bytes per triangle as an index buffer" << endl;
+
+			if(!TimeIndexCodec(L"file order", mesh.Indices))
+				result = 1;
+
+			for(const MeshSubset& subset : mesh.Subsets)
+			{
+				vector<uint32> remap;
+				MeshOptimizer::OptimizeSubset(&mesh.Indices[subset.FaceStart*3], subset.FaceCount*3,
+					subset.VertexStart, subset.VertexCount,
+					mesh.Positions.data(), sizeof(XMFLOAT3), remap);
+			}
+
+			if(!TimeIndexCodec(L"optimized", mesh.Indices))
+				result = 1;
+		}
+
+		return result;
+	}
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+	if(argc < 2)
+	{
+		wcerr << L"usage: GeometryTool rays [itemCount] [rayCount]" << endl;
+		wcerr << L"       GeometryTool spatial [itemCount ...]" << endl;
+		wcerr << L"       GeometryTool mesh-stats file ..." << endl;
+		wcerr << L"       GeometryTool indices file ..." << endl;
+		return 1;
+	}
+
+	wstring command = argv[1];
+	vector<wstring> args(argv + 2, argv + argc);
+
+	try
+	{
+		if(command == L"rays")
+			return Rays(args);
+		if(command == L"spatial")
+			return Spatial(args);
+		if(command == L"mesh-stats")
+			return MeshStats(args);
+		if(command == L"indices")
+			return Indices(args);
+	}
+	catch(const exception& e)
+	{
+		cerr << e.what() << endl;
+		return 1;
+	}
+
+	wcerr << L"unknown command " << command << endl;
+	return 1;
+}
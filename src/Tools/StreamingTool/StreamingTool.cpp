@@ -0,0 +1,511 @@
+//***************************************************************************************
+// StreamingTool.cpp
+//
+// Measurements of the demos' texture streaming, run without a window.
+//
+//   StreamingTool ttff [textures directory] [runs]
+//       Measures SkinnedMesh's time to first frame: from the start of its texture
+//       loading to the end of its first frame on the GPU.  It runs once with every
+//       texture loaded before the first frame, as LoadTextures used to, and once
+//       as SkinnedMeshApp loads them now, with the placeholders loaded up front
+//       and the rest streamed by TextureStreamer, 2D textures with their tail mips
+//       only.  The streamed run also reports when the last texture arrived.  Each
+//       is run 5 times by default and the median reported; the first run of the
+//       first mode may include reading the files from disk.  The textures
+//       directory defaults to the demos' ../../Textures.
+//
+//   StreamingTool cache-check [textures directory]
+//       Checks that TextureCache shares a resource between two textures exactly
+//       when their files hold the same bytes.  It loads every texture in the
+//       directory twice, then copies of them from a scratch directory in %TEMP%:
+//       each under a new name, and each under the name of the next texture, so a
+//       name no longer says what the file holds.  It then packs the originals and
+//       the renamed copies into an archive and loads them again through it.  The
+//       scratch directory is removed afterwards.
+//
+// No window or swap chain is created.  A frame is a command list that records the
+// texture uploads, executed and waited for, so the times leave out drawing, which
+// is the same with and without streaming.
+//***************************************************************************************
+
+#include "../../Common/d3dUtil.h"
+#include "../../Common/MappedFile.h"
+#include "../../Common/TextureCache.h"
+#include "../../Common/TextureStreamer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#pragma comment(lib,"d3dcompiler.lib")
+#pragma comment(lib, "D3D12.lib")
+#pragma comment(lib, "dxgi.lib")
+
+using Microsoft::WRL::ComPtr;
+using namespace std;
+
+namespace
+{
+	using Clock = chrono::steady_clock;
+
+	double SecondsSince(Clock::time_point start)
+	{
+		return chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	// Names of the files in directory matching pattern, sorted so the output does
+	// not depend on the file system's order.
+	vector<wstring> ListFiles(const wstring& directory, const wstring& pattern)
+	{
+		vector<wstring> names;
+
+		WIN32_FIND_DATAW findData;
+		HANDLE find = FindFirstFileW((directory + L"\\" + pattern).c_str(), &findData);
+		if(find == INVALID_HANDLE_VALUE)
+			return names;
+
+		do
+		{
+			if((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
+				names.push_back(findData.cFileName);
+		} while(FindNextFileW(find, &findData));
+
+		FindClose(find);
+		sort(names.begin(), names.end());
+		return names;
+	}
+
+	// The textures SkinnedMeshApp::LoadTextures loads, soldier.m3d's included, with
+	// the priorities it streams them at.  Placeholders are always loaded up front.
+	struct TextureFile
+	{
+		const wchar_t* Name;
+		bool IsPlaceholder;
+		int Priority;
+		bool IsCubeMap;
+	};
+
+	const TextureFile SkinnedMeshTextures[] =
+	{
+		{ L"bricks2.dds", false, 2, false },
+		{ L"bricks2_nmap.dds", false, 0, false },
+		{ L"tile.dds", false, 2, false },
+		{ L"tile_nmap.dds", false, 0, false },
+		{ L"white1x1.dds", true, 0, false },
+		{ L"default_nmap.dds", true, 0, false },
+		{ L"desertcube1024.dds", false, 1, true },
+		{ L"head_diff.dds", false, 3, false },
+		{ L"head_norm.dds", false, 0, false },
+		{ L"jacket_diff.dds", false, 3, false },
+		{ L"jacket_norm.dds", false, 0, false },
+		{ L"pants_diff.dds", false, 3, false },
+		{ L"pants_norm.dds", false, 0, false },
+		{ L"upBody_diff.dds", false, 3, false },
+		{ L"upBody_norm.dds", false, 0, false }
+	};
+
+	// gTextureTailSize and gNumFrameResources in SkinnedMeshApp.
+	const UINT TextureTailSize = 64;
+	const UINT FrameResourceCount = 3;
+
+	// The parts of D3DApp that a frame of texture uploads needs.
+	class HeadlessDevice
+	{
+	public:
+		HeadlessDevice()
+		{
+			ComPtr<IDXGIFactory4> factory;
+			ThrowIfFailed(CreateDXGIFactory1(IID_PPV_ARGS(&factory)));
+
+			// Try the default adapter, then WARP, as D3DApp::InitDirect3D does.
+			if(FAILED(D3D12CreateDevice(nullptr, D3D_FEATURE_LEVEL_12_0, IID_PPV_ARGS(&mDevice))))
+			{
+				ComPtr<IDXGIAdapter> warpAdapter;
+				ThrowIfFailed(factory->EnumWarpAdapter(IID_PPV_ARGS(&warpAdapter)));
+				ThrowIfFailed(D3D12CreateDevice(warpAdapter.Get(), D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS(&mDevice)));
+			}
+
+			ThrowIfFailed(mDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&mFence)));
+
+			D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+			queueDesc.Type = D3D12_COMMAND_LIST_TYPE_DIRECT;
+			ThrowIfFailed(mDevice->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&mCommandQueue)));
+
+			ThrowIfFailed(mDevice->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT,
+				IID_PPV_ARGS(&mCommandAllocator)));
+
+			ThrowIfFailed(mDevice->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT,
+				mCommandAllocator.Get(), nullptr, IID_PPV_ARGS(&mCommandList)));
+			ThrowIfFailed(mCommandList->Close());
+		}
+
+		ID3D12Device* Device() { return mDevice.Get(); }
+		ID3D12GraphicsCommandList* CommandList() { return mCommandList.Get(); }
+
+		void BeginFrame()
+		{
+			ThrowIfFailed(mCommandAllocator->Reset());
+			ThrowIfFailed(mCommandList->Reset(mCommandAllocator.Get(), nullptr));
+		}
+
+		// Executes the frame's commands and waits for the GPU to finish them.
+		void EndFrame()
+		{
+			ThrowIfFailed(mCommandList->Close());
+			ID3D12CommandList* cmdsLists[] = { mCommandList.Get() };
+			mCommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+
+			ThrowIfFailed(mCommandQueue->Signal(mFence.Get(), ++mCurrentFence));
+			if(mFence->GetCompletedValue() < mCurrentFence)
+			{
+				HANDLE eventHandle = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
+				ThrowIfFailed(mFence->SetEventOnCompletion(mCurrentFence, eventHandle));
+				WaitForSingleObject(eventHandle, INFINITE);
+				CloseHandle(eventHandle);
+			}
+		}
+
+	private:
+		ComPtr<ID3D12Device> mDevice;
+		ComPtr<ID3D12Fence> mFence;
+		UINT64 mCurrentFence = 0;
+		ComPtr<ID3D12CommandQueue> mCommandQueue;
+		ComPtr<ID3D12CommandAllocator> mCommandAllocator;
+		ComPtr<ID3D12GraphicsCommandList> mCommandList;
+	};
+
+	void LoadNow(HeadlessDevice& d3d, Texture& texture)
+	{
+		ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(d3d.Device(), d3d.CommandList(),
+			texture.Filename.c_str(), texture.Resource, texture.UploadHeap));
+	}
+
+	vector<Texture> MakeTextures(const wstring& directory)
+	{
+		vector<Texture> textures(_countof(SkinnedMeshTextures));
+		for(size_t i = 0; i < textures.size(); ++i)
+			textures[i].Filename = directory + L"\\" + SkinnedMeshTextures[i].Name;
+		return textures;
+	}
+
+	// Seconds to the end of the first frame with every texture loaded before it.
+	double LoadUpFront(HeadlessDevice& d3d, const wstring& directory)
+	{
+		vector<Texture> textures = MakeTextures(directory);
+
+		Clock::time_point start = Clock::now();
+		d3d.BeginFrame();
+		for(Texture& texture : textures)
+			LoadNow(d3d, texture);
+		d3d.EndFrame();
+
+		return SecondsSince(start);
+	}
+
+	struct StreamedTimes
+	{
+		double FirstFrame = 0.0;
+		double AllLoaded = 0.0;
+		UINT Frames = 0;
+	};
+
+	// Times to the end of the first frame and of the frame that uploaded the last
+	// streamed texture.
+	StreamedTimes LoadStreamed(HeadlessDevice& d3d, const wstring& directory)
+	{
+		vector<Texture> textures = MakeTextures(directory);
+		TextureStreamer streamer(d3d.Device(), FrameResourceCount);
+		StreamedTimes times;
+
+		Clock::time_point start = Clock::now();
+		d3d.BeginFrame();
+		for(size_t i = 0; i < textures.size(); ++i)
+		{
+			const TextureFile& file = SkinnedMeshTextures[i];
+			if(file.IsPlaceholder)
+				LoadNow(d3d, textures[i]);
+			else
+				streamer.Load(&textures[i], file.Priority, nullptr, file.IsCubeMap ? 0 : TextureTailSize);
+		}
+
+		// SkinnedMeshApp loads the placeholders in Initialize's command list and starts
+		// every Draw with an Update; both go in the first frame here.
+		streamer.Update(d3d.CommandList());
+		d3d.EndFrame();
+		times.FirstFrame = SecondsSince(start);
+		times.Frames = 1;
+
+		while(streamer.GetPendingCount() > 0)
+		{
+			d3d.BeginFrame();
+			streamer.Update(d3d.CommandList());
+			d3d.EndFrame();
+			++times.Frames;
+		}
+		times.AllLoaded = SecondsSince(start);
+
+		return times;
+	}
+
+	double Median(vector<double> values)
+	{
+		sort(values.begin(), values.end());
+		return values[values.size() / 2];
+	}
+
+	int TimeToFirstFrame(const vector<wstring>& args)
+	{
+		const wstring directory = args.size() > 0 ? args[0] : L"..\\..\\Textures";
+		const int runs = args.size() > 1 ? max(stoi(args[1]), 1) : 5;
+
+		HeadlessDevice d3d;
+
+		vector<double> upFront;
+		for(int run = 0; run < runs; ++run)
+		{
+			upFront.push_back(LoadUpFront(d3d, directory));
+			wcout << L"up front: first frame " << upFront.back()*1000.0 << L" ms" << endl;
+		}
+
+		vector<double> firstFrame;
+		vector<double> allLoaded;
+		for(int run = 0; run < runs; ++run)
+		{
+			StreamedTimes times = LoadStreamed(d3d, directory);
+			firstFrame.push_back(times.FirstFrame);
+			allLoaded.push_back(times.AllLoaded);
+			wcout << L"streamed: first frame " << times.FirstFrame*1000.0 << L" ms, all textures "
+				<< times.AllLoaded*1000.0 << L" ms (" << times.Frames << L" frames)" << endl;
+		}
+
+		wcout << L"median of " << runs << L": up front " << Median(upFront)*1000.0 << L" ms, streamed "
+			<< Median(firstFrame)*1000.0 << L" ms to the first frame and " << Median(allLoaded)*1000.0
+			<< L" ms to the last texture" << endl;
+		return 0;
+	}
+
+	// Loads textures through cache in one frame.
+	void LoadCached(HeadlessDevice& d3d, TextureCache& cache, vector<Texture>& textures)
+	{
+		d3d.BeginFrame();
+		for(Texture& texture : textures)
+			cache.Load(d3d.CommandList(), texture);
+		d3d.EndFrame();
+	}
+
+	// Compares every pair of textures: they must share a resource exactly when
+	// their files hold the same bytes, and the cache must have created one
+	// resource per distinct file.  Returns the number of failures.
+	int CheckSharing(const wstring& label, const TextureCache& cache, const vector<Texture>& textures)
+	{
+		vector<MappedFile> files(textures.size());
+		for(size_t i = 0; i < textures.size(); ++i)
+		{
+			if(!files[i].Open(textures[i].Filename))
+			{
+				wcerr << label << L": cannot open " << textures[i].Filename << endl;
+				return 1;
+			}
+		}
+
+		int failures = 0;
+		UINT distinctCount = 0;
+		for(size_t i = 0; i < textures.size(); ++i)
+		{
+			bool seen = false;
+			for(size_t j = 0; j < i; ++j)
+			{
+				const bool same = files[i].GetSize() == files[j].GetSize() &&
+					memcmp(files[i].GetData(), files[j].GetData(), files[i].GetSize()) == 0;
+				const bool shared = textures[i].Resource == textures[j].Resource;
+				seen = seen || same;
+
+				if(same != shared)
+				{
+					wcerr << label << L": " << textures[j].Filename << L" and " << textures[i].Filename
+						<< (same ? L" match but do not share" : L" differ but share") << L" a resource" << endl;
+					++failures;
+				}
+			}
+
+			if(!seen)
+				++distinctCount;
+		}
+
+		if(cache.GetResourceCount() != distinctCount)
+		{
+			wcerr << label << L": " << cache.GetResourceCount() << L" resources for " << distinctCount
+				<< L" distinct files" << endl;
+			++failures;
+		}
+
+		wcout << label << L": " << textures.size() << L" loads, " << cache.GetFileLoadCount() << L" from files, "
+			<< cache.GetArchiveLoadCount() << L" from the archive, " << cache.GetResourceCount()
+			<< L" resources for " << distinctCount << L" distinct files" << endl;
+		return failures;
+	}
+
+	int CacheCheck(const vector<wstring>& args)
+	{
+		const wstring directory = args.size() > 0 ? args[0] : L"..\\..\\Textures";
+
+		vector<wstring> names = ListFiles(directory, L"*.dds");
+		if(names.size() < 2)
+		{
+			wcerr << L"cache-check needs at least two .dds files in " << directory << endl;
+			return 1;
+		}
+
+		wchar_t tempPath[MAX_PATH + 1];
+		if(GetTempPathW(_countof(tempPath), tempPath) == 0)
+		{
+			wcerr << L"cannot find the temporary directory" << endl;
+			return 1;
+		}
+
+		const wstring scratch = wstring(tempPath) + L"StreamingToolCacheCheck";
+		CreateDirectoryW(scratch.c_str(), nullptr);
+
+		// copy_<name> holds name's bytes; name holds the next texture's.
+		vector<wstring> scratchFiles;
+		for(size_t i = 0; i < names.size(); ++i)
+		{
+			const wstring original = directory + L"\\" + names[i];
+			const wstring next = directory + L"\\" + names[(i + 1) % names.size()];
+			scratchFiles.push_back(scratch + L"\\copy_" + names[i]);
+			CopyFileW(original.c_str(), scratchFiles.back().c_str(), FALSE);
+			scratchFiles.push_back(scratch + L"\\" + names[i]);
+			CopyFileW(next.c_str(), scratchFiles.back().c_str(), FALSE);
+		}
+
+		HeadlessDevice d3d;
+		int failures = 0;
+
+		{
+			// The originals twice, so repeated paths are covered too.
+			vector<Texture> textures;
+			for(int pass = 0; pass < 2; ++pass)
+			{
+				for(const wstring& name : names)
+				{
+					textures.emplace_back();
+					textures.back().Filename = directory + L"\\" + name;
+				}
+			}
+			for(const wstring& fileName : scratchFiles)
+			{
+				textures.emplace_back();
+				textures.back().Filename = fileName;
+			}
+
+			TextureCache cache(d3d.Device());
+			LoadCached(d3d, cache, textures);
+			failures += CheckSharing(L"loose files", cache, textures);
+		}
+
+		{
+			// An archive cannot hold two files of the same name, so it gets the
+			// originals and the copies under new names.
+			vector<Texture> textures;
+			for(const wstring& name : names)
+			{
+				textures.emplace_back();
+				textures.back().Filename = directory + L"\\" + name;
+				textures.emplace_back();
+				textures.back().Filename = scratch + L"\\copy_" + name;
+			}
+
+			vector<MappedFile> files(textures.size());
+			vector<TextureArchive::SourceFile> sources(textures.size());
+			for(size_t i = 0; i < textures.size(); ++i)
+			{
+				if(!files[i].Open(textures[i].Filename))
+				{
+					wcerr << L"cannot open " << textures[i].Filename << endl;
+					return 1;
+				}
+
+				sources[i].Name = TextureArchive::NormalizeName(textures[i].Filename);
+				sources[i].Data = files[i].GetData();
+				sources[i].Size = files[i].GetSize();
+			}
+
+			const wstring archiveName = scratch + L"\\Textures.pak";
+			{
+				ofstream out(archiveName, ios::binary | ios::trunc);
+				if(!out || !TextureArchive::Write(out, sources))
+				{
+					wcerr << L"cannot write " << archiveName << endl;
+					return 1;
+				}
+			}
+
+			TextureCache cache(d3d.Device());
+			if(!cache.OpenArchive(archiveName))
+			{
+				wcerr << L"cannot open " << archiveName << endl;
+				return 1;
+			}
+
+			LoadCached(d3d, cache, textures);
+			failures += CheckSharing(L"archive", cache, textures);
+
+			if(cache.GetArchiveLoadCount() != textures.size())
+			{
+				wcerr << L"archive: " << textures.size() - cache.GetArchiveLoadCount()
+					<< L" textures were not found in the archive" << endl;
+				++failures;
+			}
+		}
+
+		for(const wstring& name : ListFiles(scratch, L"*"))
+			DeleteFileW((scratch + L"\\" + name).c_str());
+		RemoveDirectoryW(scratch.c_str());
+
+		if(failures > 0)
+		{
+			wcout << failures << L" checks FAILED" << endl;
+			return 1;
+		}
+
+		wcout << L"every texture shares a resource with exactly the textures whose files match" << endl;
+		return 0;
+	}
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+	if(argc < 2)
+	{
+		wcerr << L"usage: StreamingTool ttff [textures directory] [runs]" << endl;
+		wcerr << L"       StreamingTool cache-check [textures directory]" << endl;
+		return 1;
+	}
+
+	wstring command = argv[1];
+	vector<wstring> args(argv + 2, argv + argc);
+
+	try
+	{
+		if(command == L"ttff")
+			return TimeToFirstFrame(args);
+		if(command == L"cache-check")
+			return CacheCheck(args);
+	}
+	catch(const DxException& e)
+	{
+		wcerr << e.ToString() << endl;
+		return 1;
+	}
+	catch(const exception& e)
+	{
+		cerr << e.what() << endl;
+		return 1;
+	}
+
+	wcerr << L"unknown command " << command << endl;
+	return 1;
+}
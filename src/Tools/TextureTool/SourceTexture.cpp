@@ -0,0 +1,212 @@
+//***************************************************************************************
+// SourceTexture.cpp
+//***************************************************************************************
+
+#include "SourceTexture.h"
+#include "../../Common/MappedFile.h"
+#include <algorithm>
+#include <cstring>
+#include <cwctype>
+
+using namespace std;
+
+namespace
+{
+	uint32_t ReadUint32(const uint8_t* p)
+	{
+		return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+	}
+
+	uint16_t ReadUint16(const uint8_t* p)
+	{
+		return uint16_t(p[0] | (p[1] << 8));
+	}
+
+	bool LoadBmp(const uint8_t* data, size_t size, SourceTexture& texture, string& error)
+	{
+		// BITMAPFILEHEADER followed by at least a BITMAPINFOHEADER.
+		if(size < 54 || data[0] != 'B' || data[1] != 'M')
+		{
+			error = "not a BMP file";
+			return false;
+		}
+
+		const uint32_t pixelOffset = ReadUint32(data + 10);
+		const int32_t width = int32_t(ReadUint32(data + 18));
+		const int32_t height = int32_t(ReadUint32(data + 22));
+		const uint16_t bitCount = ReadUint16(data + 28);
+		const uint32_t compression = ReadUint32(data + 30);
+
+		// BI_RGB, or BI_BITFIELDS with the masks BI_RGB implies.
+		const bool bitfields = compression == 3 && size >= 66 &&
+			ReadUint32(data + 54) == 0x00ff0000 && ReadUint32(data + 58) == 0x0000ff00 && ReadUint32(data + 62) == 0x000000ff;
+		if((compression != 0 && !bitfields) || (bitCount != 24 && bitCount != 32))
+		{
+			error = "only uncompressed 24 and 32 bit BMP files are supported";
+			return false;
+		}
+
+		const uint32_t w = uint32_t(width);
+		const uint32_t h = uint32_t(height < 0 ? -int64_t(height) : height);
+		if(width <= 0 || h == 0 || w > 16384 || h > 16384)
+		{
+			error = "bad BMP dimensions";
+			return false;
+		}
+
+		const size_t bytesPerPixel = bitCount / 8;
+		const size_t rowPitch = (w*bytesPerPixel + 3) & ~size_t(3);
+		if(pixelOffset > size || rowPitch*h > size - pixelOffset)
+		{
+			error = "BMP file is truncated";
+			return false;
+		}
+
+		Image image;
+		image.Width = w;
+		image.Height = h;
+		image.Pixels.resize(size_t(w)*h*4);
+
+		// 32 bit files usually leave the fourth byte zero; it is only taken as
+		// alpha when some pixel sets it.
+		bool alphaStored = false;
+		for(uint32_t y = 0; y < h && bytesPerPixel == 4; ++y)
+		{
+			const uint8_t* row = data + pixelOffset + y*rowPitch;
+			for(uint32_t x = 0; x < w && !alphaStored; ++x)
+				alphaStored = row[4*x + 3] != 0;
+		}
+
+		// Rows are stored bottom up unless the height is negative.
+		for(uint32_t y = 0; y < h; ++y)
+		{
+			const uint8_t* src = data + pixelOffset + (height < 0 ? y : h - 1 - y)*rowPitch;
+			uint8_t* dst = image.Pixels.data() + size_t(y)*w*4;
+			for(uint32_t x = 0; x < w; ++x, src += bytesPerPixel, dst += 4)
+			{
+				dst[0] = src[2];
+				dst[1] = src[1];
+				dst[2] = src[0];
+				dst[3] = alphaStored ? src[3] : 255;
+			}
+		}
+
+		texture.Desc = DDSParser::TextureDesc();
+		texture.Desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		texture.Desc.Dimension = DDSParser::ResourceDimension::Texture2D;
+		texture.Desc.Width = w;
+		texture.Desc.Height = h;
+		texture.Desc.Depth = 1;
+		texture.Desc.MipLevels = 1;
+		texture.Desc.ArraySize = 1;
+		texture.Images.assign(1, move(image));
+		return true;
+	}
+
+	bool LoadDds(const uint8_t* data, size_t size, SourceTexture& texture, string& error)
+	{
+		DDSParser::TextureDesc desc;
+		if(DDSParser::Parse(data, size, desc) != DDSParser::Result::Ok)
+		{
+			error = "not a DDS file this tool can read";
+			return false;
+		}
+
+		if(desc.Dimension != DDSParser::ResourceDimension::Texture2D)
+		{
+			error = "only 2D textures are supported";
+			return false;
+		}
+
+		bool bgr = false;
+		bool opaque = false;
+		switch(desc.Format)
+		{
+		case DXGI_FORMAT_R8G8B8A8_UNORM:
+		case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+			break;
+		case DXGI_FORMAT_B8G8R8A8_UNORM:
+		case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+			bgr = true;
+			break;
+		case DXGI_FORMAT_B8G8R8X8_UNORM:
+		case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+			bgr = opaque = true;
+			break;
+		default:
+			error = DDSParser::IsBlockCompressed(desc.Format) ? "already block compressed" : "unsupported pixel format";
+			return false;
+		}
+
+		texture.Desc = desc;
+		texture.Images.clear();
+		for(uint32_t slice = 0; slice < desc.ArraySize; ++slice)
+		{
+			for(uint32_t mip = 0; mip < desc.MipLevels; ++mip)
+			{
+				DDSParser::Subresource sub = DDSParser::GetSubresource(desc, mip, slice);
+
+				Image image;
+				image.Width = sub.Width;
+				image.Height = sub.Height;
+				image.Pixels.resize(size_t(sub.Width)*sub.Height*4);
+
+				for(uint32_t y = 0; y < sub.Height; ++y)
+				{
+					const uint8_t* src = data + sub.Offset + size_t(y)*sub.RowPitch;
+					uint8_t* dst = image.Pixels.data() + size_t(y)*sub.Width*4;
+					for(uint32_t x = 0; x < sub.Width; ++x, src += 4, dst += 4)
+					{
+						dst[0] = src[bgr ? 2 : 0];
+						dst[1] = src[1];
+						dst[2] = src[bgr ? 0 : 2];
+						dst[3] = opaque ? 255 : src[3];
+					}
+				}
+
+				texture.Images.push_back(move(image));
+			}
+		}
+
+		return true;
+	}
+}
+
+bool SourceTexture::IsSRGB()const
+{
+	return Desc.Format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB ||
+		Desc.Format == DXGI_FORMAT_B8G8R8A8_UNORM_SRGB ||
+		Desc.Format == DXGI_FORMAT_B8G8R8X8_UNORM_SRGB;
+}
+
+bool LoadSourceTexture(const wstring& fileName, SourceTexture& texture, string& error)
+{
+	MappedFile file;
+	if(!file.Open(fileName))
+	{
+		error = "cannot open the file";
+		return false;
+	}
+
+	const size_t dot = fileName.find_last_of(L'.');
+	wstring extension = dot == wstring::npos ? L"" : fileName.substr(dot + 1);
+	transform(extension.begin(), extension.end(), extension.begin(), towlower);
+
+	bool loaded = extension == L"bmp" ? LoadBmp(file.GetData(), file.GetSize(), texture, error) :
+		extension == L"dds" ? LoadDds(file.GetData(), file.GetSize(), texture, error) : false;
+	if(!loaded)
+	{
+		if(error.empty())
+			error = "not a .bmp or .dds file";
+		return false;
+	}
+
+	texture.HasAlpha = false;
+	for(const Image& image : texture.Images)
+	{
+		for(size_t i = 3; i < image.Pixels.size() && !texture.HasAlpha; i += 4)
+			texture.HasAlpha = image.Pixels[i] != 255;
+	}
+
+	return true;
+}
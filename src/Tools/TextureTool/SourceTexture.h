@@ -0,0 +1,44 @@
+//***************************************************************************************
+// SourceTexture.h
+//
+// Reads the uncompressed textures the tool works on into 8-bit RGBA images: BMP
+// files (24 or 32 bits per pixel) and 2D DDS textures, arrays and cube maps included,
+// stored as R8G8B8A8, B8G8R8A8 or B8G8R8X8.
+//***************************************************************************************
+
+#pragma once
+
+#include "../../Common/DDSParser.h"
+#include <string>
+#include <vector>
+
+struct Image
+{
+	std::uint32_t Width = 0;
+	std::uint32_t Height = 0;
+
+	// Width*Height RGBA pixels, row by row from the top.
+	std::vector<std::uint8_t> Pixels;
+};
+
+struct SourceTexture
+{
+	// The layout as read: Format is the file's, and BMP files come out as a
+	// single mip of R8G8B8A8_UNORM.
+	DDSParser::TextureDesc Desc;
+
+	// Every mip of every array slice, slice by slice with mips in order inside
+	// each, the order DDSParser and D3D12 number subresources in.
+	std::vector<Image> Images;
+
+	// True when some pixel has alpha below 255.
+	bool HasAlpha = false;
+
+	bool IsSRGB()const;
+};
+
+///<summary>
+/// Reads fileName, a .bmp or .dds file.  Returns false with a reason in error when
+/// the file cannot be read or holds a format other than those above.
+///</summary>
+bool LoadSourceTexture(const std::wstring& fileName, SourceTexture& texture, std::string& error);
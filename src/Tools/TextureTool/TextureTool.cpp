@@ -0,0 +1,1225 @@
+//***************************************************************************************
+// TextureTool.cpp
+//
+// Offline processing for the demos' textures.
+//
+//   TextureTool pack <directory> <archive> [alignment]
+//       Packs every .dds file in directory into one TextureArchive.
+//
+//   TextureTool compress <input directory> <output directory> [auto|bc1|bc3|bc5|bc7 ...]
+//       Block compresses every uncompressed .bmp and .dds file in the input
+//       directory, all mips and array slices, and reports the quality and speed
+//       of each format.  "auto", the default, picks BC5 for normal maps (names
+//       ending in _nmap or _norm; shaders must rebuild z), BC3 for textures
+//       with alpha and BC1 for the rest.  With several formats each output
+//       file's name ends in the format's.
+//
+//   TextureTool mips <input directory> <output directory> [box|kaiser] [srgb] [wrap]
+//       Rebuilds the full mip chain of every .bmp and .dds file compress reads,
+//       from the top level, and writes them as R8G8B8A8.  Normal maps are
+//       renormalized, alpha tested textures keep their coverage, and sRGB
+//       textures, or all color textures with "srgb", are filtered in linear
+//       light.  "wrap" filters across edges, for tiling textures.  Run compress
+//       on the output to get compressed textures with mips.
+//
+//   TextureTool array <output.dds> <input.dds> ...
+//   TextureTool atlas <output.dds> <padding> <clamp|wrap> <input.dds> ...
+//       Packs textures of one format into a texture array or a padded atlas
+//       (see TexturePacker), writing output.dds and the table output.txt that
+//       maps each texture, named after its file, to a slice and UV transform.
+//
+//   TextureTool blur <input> <output.dds> [blurCount]
+//       Blurs a .bmp or .dds image on the CPU exactly as the Blur demo's compute
+//       shaders blur the back buffer (see ImageBlur), 4 times by default.
+//
+//   TextureTool sobel <input> <output.dds> [composite]
+//       Writes the Sobel demo's edge map of a .bmp or .dds image (see ImageSobel),
+//       or with composite the image darkened along its edges as the demo draws it.
+//
+//   TextureTool dds-check <directory> [mutations]
+//       Times DDSParser::Parse on every .dds file in directory, then feeds it each
+//       file cut short at every length through the headers and a few lengths in
+//       the pixel data, and mutations copies (1000 by default) with random header
+//       bytes and fields overwritten.  Whenever Parse accepts a file, every
+//       subresource it describes must lie inside the data; any that does not is
+//       reported and the command fails.
+//
+//   TextureTool residency-sim <directory> [budget MB ...]
+//       Drives MipResidency as SkinnedMeshApp does, with the mipmapped 2D .dds
+//       files in directory on a row of quads, along synthetic camera paths: a
+//       fly-by, an approach from afar, random jumps and a still camera.  Changes
+//       complete a few frames after they are issued.  Each path runs with each
+//       budget, by default the app's 32 MB and a quarter of what every mip of
+//       every texture takes.  The budget, the limits on changes in flight and
+//       the delay between a texture's changes are checked every frame, and the
+//       still camera must settle and stop issuing changes.  Reports the loads,
+//       evictions, peak bytes committed and how often a texture on screen was
+//       blurrier than wanted.
+//
+// The project runs "pack" on src/Textures after every build, producing the
+// Textures.pak the demos open through TextureCache.
+//***************************************************************************************
+
+#include <windows.h>
+#include "../../Common/BCEncoder.h"
+#include "../../Common/DDSParser.h"
+#include "../../Common/ImageBlur.h"
+#include "../../Common/ImageSobel.h"
+#include "../../Common/MappedFile.h"
+#include "../../Common/MipResidency.h"
+#include "../../Common/MipGenerator.h"
+#include "../../Common/TextureArchive.h"
+#include "../../Common/TexturePacker.h"
+#include "SourceTexture.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cwctype>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <ppl.h>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+	using Clock = chrono::steady_clock;
+
+	double SecondsSince(Clock::time_point start)
+	{
+		return chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	// Names of the files in directory matching pattern, sorted so the output does
+	// not depend on the file system's order.
+	vector<wstring> ListFiles(const wstring& directory, const wstring& pattern)
+	{
+		vector<wstring> names;
+
+		WIN32_FIND_DATAW findData;
+		HANDLE find = FindFirstFileW((directory + L"\\" + pattern).c_str(), &findData);
+		if(find == INVALID_HANDLE_VALUE)
+			return names;
+
+		do
+		{
+			if((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
+				names.push_back(findData.cFileName);
+		} while(FindNextFileW(find, &findData));
+
+		FindClose(find);
+		sort(names.begin(), names.end());
+		return names;
+	}
+
+	int Pack(const vector<wstring>& args)
+	{
+		if(args.size() < 2)
+		{
+			wcerr << L"usage: TextureTool pack <directory> <archive> [alignment]" << endl;
+			return 1;
+		}
+
+		const wstring& directory = args[0];
+		const wstring& archiveName = args[1];
+		const TextureArchive::uint32 alignment = args.size() > 2 ? (TextureArchive::uint32)stoul(args[2]) : 4096;
+
+		Clock::time_point start = Clock::now();
+
+		vector<wstring> names = ListFiles(directory, L"*.dds");
+		vector<MappedFile> files(names.size());
+		vector<TextureArchive::SourceFile> sources(names.size());
+
+		size_t inputBytes = 0;
+		for(size_t i = 0; i < names.size(); ++i)
+		{
+			if(!files[i].Open(directory + L"\\" + names[i]))
+			{
+				wcerr << L"cannot open " << names[i] << endl;
+				return 1;
+			}
+
+			sources[i].Name = TextureArchive::NormalizeName(names[i]);
+			sources[i].Data = files[i].GetData();
+			sources[i].Size = files[i].GetSize();
+			inputBytes += files[i].GetSize();
+		}
+
+		{
+			ofstream out(archiveName, ios::binary | ios::trunc);
+			if(!out || !TextureArchive::Write(out, sources, alignment))
+			{
+				wcerr << L"cannot write " << archiveName << endl;
+				return 1;
+			}
+		}
+
+		TextureArchive archive;
+		if(!archive.Open(archiveName))
+		{
+			wcerr << L"cannot read back " << archiveName << endl;
+			return 1;
+		}
+
+		// Count the distinct contents the archive ended up storing.
+		vector<const uint8_t*> stored;
+		for(const auto& source : sources)
+			stored.push_back(archive.Find(source.Name)->Data);
+		sort(stored.begin(), stored.end());
+		size_t uniqueCount = unique(stored.begin(), stored.end()) - stored.begin();
+
+		ifstream packed(archiveName, ios::binary | ios::ate);
+		wcout << L"packed " << names.size() << L" files (" << uniqueCount << L" distinct), "
+			<< inputBytes << L" bytes into " << (size_t)packed.tellg() << L" bytes in "
+			<< SecondsSince(start) << L" s" << endl;
+		return 0;
+	}
+
+	bool EndsWith(const wstring& s, const wstring& suffix)
+	{
+		return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+	}
+
+	// The demos name their normal maps *_nmap and *_norm.
+	bool IsNormalMap(const wstring& stem)
+	{
+		wstring name = stem;
+		transform(name.begin(), name.end(), name.begin(), towlower);
+		return EndsWith(name, L"_nmap") || EndsWith(name, L"_norm");
+	}
+
+	wstring FullPath(const wstring& path)
+	{
+		wchar_t buffer[MAX_PATH];
+		DWORD length = GetFullPathNameW(path.c_str(), MAX_PATH, buffer, nullptr);
+		wstring full = length > 0 && length < MAX_PATH ? wstring(buffer, length) : path;
+		while(!full.empty() && (full.back() == L'\\' || full.back() == L'/'))
+			full.pop_back();
+		transform(full.begin(), full.end(), full.begin(), towlower);
+		return full;
+	}
+
+	// Creates the directory commands write to.  Output names can equal input names
+	// (head_diff.dds), so it must not be the directory being read.
+	bool PrepareOutputDirectory(const wstring& inputDirectory, const wstring& outputDirectory)
+	{
+		if(FullPath(inputDirectory) == FullPath(outputDirectory))
+		{
+			wcerr << L"the output directory must differ from the input directory" << endl;
+			return false;
+		}
+
+		if(!CreateDirectoryW(outputDirectory.c_str(), nullptr) && GetLastError() != ERROR_ALREADY_EXISTS)
+		{
+			wcerr << L"cannot create " << outputDirectory << endl;
+			return false;
+		}
+
+		return true;
+	}
+
+	// The .bmp and .dds files in directory, sorted.
+	vector<wstring> ListSourceFiles(const wstring& directory)
+	{
+		vector<wstring> names = ListFiles(directory, L"*.bmp");
+		vector<wstring> ddsNames = ListFiles(directory, L"*.dds");
+		names.insert(names.end(), ddsNames.begin(), ddsNames.end());
+		sort(names.begin(), names.end());
+		return names;
+	}
+
+	struct CompressFormat
+	{
+		const wchar_t* Name;
+		DXGI_FORMAT Format; // DXGI_FORMAT_UNKNOWN picks one per texture.
+	};
+
+	const CompressFormat CompressFormats[] =
+	{
+		{ L"auto", DXGI_FORMAT_UNKNOWN },
+		{ L"bc1", DXGI_FORMAT_BC1_UNORM },
+		{ L"bc3", DXGI_FORMAT_BC3_UNORM },
+		{ L"bc5", DXGI_FORMAT_BC5_UNORM },
+		{ L"bc7", DXGI_FORMAT_BC7_UNORM },
+	};
+
+	// Totals for one requested format over every file it compressed.
+	struct CompressStats
+	{
+		size_t Files = 0;
+		double Pixels = 0.0;
+		double Seconds = 0.0;
+		double SquaredError = 0.0;
+		double Samples = 0.0;
+	};
+
+	DXGI_FORMAT ChooseFormat(const wstring& stem, const SourceTexture& texture)
+	{
+		if(IsNormalMap(stem))
+			return DXGI_FORMAT_BC5_UNORM;
+
+		return texture.HasAlpha ? DXGI_FORMAT_BC3_UNORM : DXGI_FORMAT_BC1_UNORM;
+	}
+
+	const wchar_t* FormatName(DXGI_FORMAT format)
+	{
+		switch(format)
+		{
+		case DXGI_FORMAT_BC1_UNORM: return L"BC1_UNORM";
+		case DXGI_FORMAT_BC1_UNORM_SRGB: return L"BC1_UNORM_SRGB";
+		case DXGI_FORMAT_BC3_UNORM: return L"BC3_UNORM";
+		case DXGI_FORMAT_BC3_UNORM_SRGB: return L"BC3_UNORM_SRGB";
+		case DXGI_FORMAT_BC5_UNORM: return L"BC5_UNORM";
+		case DXGI_FORMAT_BC7_UNORM: return L"BC7_UNORM";
+		case DXGI_FORMAT_BC7_UNORM_SRGB: return L"BC7_UNORM_SRGB";
+		default: return L"?";
+		}
+	}
+
+	// Peak signal to noise ratio in dB of a mean squared error over 8-bit samples.
+	wstring Psnr(double squaredError, double samples)
+	{
+		if(squaredError == 0.0)
+			return L"exact";
+
+		return to_wstring(10.0*log10(255.0*255.0*samples / squaredError)) + L" dB";
+	}
+
+	int Compress(const vector<wstring>& args)
+	{
+		if(args.size() < 2)
+		{
+			wcerr << L"usage: TextureTool compress <input directory> <output directory> [auto|bc1|bc3|bc5|bc7 ...]" << endl;
+			return 1;
+		}
+
+		const wstring& inputDirectory = args[0];
+		const wstring& outputDirectory = args[1];
+
+		vector<const CompressFormat*> requested;
+		for(size_t i = 2; i < args.size(); ++i)
+		{
+			const CompressFormat* match = nullptr;
+			for(const CompressFormat& format : CompressFormats)
+			{
+				if(args[i] == format.Name)
+					match = &format;
+			}
+
+			if(match == nullptr)
+			{
+				wcerr << L"unknown format " << args[i] << endl;
+				return 1;
+			}
+
+			requested.push_back(match);
+		}
+
+		if(requested.empty())
+			requested.push_back(&CompressFormats[0]);
+
+		if(!PrepareOutputDirectory(inputDirectory, outputDirectory))
+			return 1;
+
+		vector<wstring> names = ListSourceFiles(inputDirectory);
+
+		vector<CompressStats> stats(requested.size());
+		size_t skipped = 0;
+
+		for(const wstring& name : names)
+		{
+			SourceTexture source;
+			string error;
+			if(!LoadSourceTexture(inputDirectory + L"\\" + name, source, error))
+			{
+				wcout << name << L": skipped, " << wstring(error.begin(), error.end()) << endl;
+				++skipped;
+				continue;
+			}
+
+			// Direct3D 12 requires block compressed textures to start at a whole
+			// number of blocks; smaller mips may end in partial ones.
+			if(source.Desc.Width % 4 != 0 || source.Desc.Height % 4 != 0)
+			{
+				wcout << name << L": skipped, " << source.Desc.Width << L"x" << source.Desc.Height
+					<< L" is not a multiple of 4" << endl;
+				++skipped;
+				continue;
+			}
+
+			const wstring stem = name.substr(0, name.find_last_of(L'.'));
+
+			for(size_t f = 0; f < requested.size(); ++f)
+			{
+				DXGI_FORMAT format = requested[f]->Format != DXGI_FORMAT_UNKNOWN ?
+					requested[f]->Format : ChooseFormat(stem, source);
+
+				// Keep sRGB sources sRGB; BC5 has no sRGB variant.
+				if(source.IsSRGB())
+					format = DDSParser::MakeSRGB(format);
+
+				DDSParser::TextureDesc desc = source.Desc;
+				desc.Format = format;
+
+				vector<uint8_t> file;
+				if(DDSParser::InitFile(desc, file) != DDSParser::Result::Ok)
+				{
+					wcout << name << L": skipped, cannot describe it as " << FormatName(format) << endl;
+					continue;
+				}
+
+				const int channels = format == DXGI_FORMAT_BC5_UNORM ? 2 : 4;
+				double pixels = 0.0;
+				double seconds = 0.0;
+				double squaredError = 0.0;
+
+				vector<uint8_t> decoded;
+				for(size_t i = 0; i < source.Images.size(); ++i)
+				{
+					const Image& image = source.Images[i];
+					DDSParser::Subresource sub = DDSParser::GetSubresource(desc,
+						DDSParser::uint32(i % desc.MipLevels), DDSParser::uint32(i / desc.MipLevels));
+
+					decoded.resize(image.Pixels.size());
+
+					Clock::time_point start = Clock::now();
+					BCEncoder::EncodeSurface(format, image.Pixels.data(), image.Width, image.Height, image.Width*4,
+						file.data() + sub.Offset, sub.RowPitch, decoded.data(), image.Width*4);
+					seconds += SecondsSince(start);
+
+					for(size_t p = 0; p < image.Pixels.size(); p += 4)
+					{
+						for(int c = 0; c < channels; ++c)
+						{
+							double d = double(image.Pixels[p + c]) - double(decoded[p + c]);
+							squaredError += d*d;
+						}
+					}
+
+					pixels += double(image.Width)*image.Height;
+				}
+
+				wstring outputName = stem + (requested.size() > 1 ? wstring(L"_") + requested[f]->Name : wstring()) + L".dds";
+				{
+					ofstream out(outputDirectory + L"\\" + outputName, ios::binary | ios::trunc);
+					if(!out || !out.write((const char*)file.data(), file.size()))
+					{
+						wcerr << L"cannot write " << outputName << endl;
+						return 1;
+					}
+				}
+
+				wcout << name << L" -> " << outputName << L": " << FormatName(format) << L", "
+					<< Psnr(squaredError, pixels*channels) << L", " << pixels / 1.0e6 / seconds << L" Mpix/s" << endl;
+
+				CompressStats& total = stats[f];
+				total.Files++;
+				total.Pixels += pixels;
+				total.Seconds += seconds;
+				total.SquaredError += squaredError;
+				total.Samples += pixels*channels;
+			}
+		}
+
+		for(size_t f = 0; f < requested.size(); ++f)
+		{
+			const CompressStats& total = stats[f];
+			if(total.Files == 0)
+				continue;
+
+			wcout << requested[f]->Name << L": " << total.Files << L" files, " << total.Pixels / 1.0e6 << L" Mpix, "
+				<< Psnr(total.SquaredError, total.Samples) << L", " << total.Pixels / 1.0e6 / total.Seconds << L" Mpix/s" << endl;
+		}
+
+		if(skipped > 0)
+			wcout << skipped << L" files skipped" << endl;
+
+		return 0;
+	}
+
+	// Whether alpha looks like a cutout mask, as on the demos' foliage and fences:
+	// a sizeable share of pixels is fully clear.  Alpha that only scales something
+	// else rarely reaches zero.
+	bool IsAlphaTested(const SourceTexture& texture)
+	{
+		if(!texture.HasAlpha)
+			return false;
+
+		size_t clear = 0;
+		size_t total = 0;
+		for(size_t i = 0; i < texture.Images.size(); i += texture.Desc.MipLevels)
+		{
+			const vector<uint8_t>& pixels = texture.Images[i].Pixels;
+			for(size_t p = 3; p < pixels.size(); p += 4)
+			{
+				if(pixels[p] == 0)
+					++clear;
+			}
+			total += pixels.size() / 4;
+		}
+
+		return clear*20 >= total;
+	}
+
+	int Mips(const vector<wstring>& args)
+	{
+		if(args.size() < 2)
+		{
+			wcerr << L"usage: TextureTool mips <input directory> <output directory> [box|kaiser] [srgb] [wrap]" << endl;
+			return 1;
+		}
+
+		const wstring& inputDirectory = args[0];
+		const wstring& outputDirectory = args[1];
+
+		MipGenerator::Options options;
+		bool forceSRGB = false;
+		for(size_t i = 2; i < args.size(); ++i)
+		{
+			if(args[i] == L"box")
+				options.Kernel = MipGenerator::Filter::Box;
+			else if(args[i] == L"kaiser")
+				options.Kernel = MipGenerator::Filter::Kaiser;
+			else if(args[i] == L"srgb")
+				forceSRGB = true;
+			else if(args[i] == L"wrap")
+				options.Wrap = true;
+			else
+			{
+				wcerr << L"unknown option " << args[i] << endl;
+				return 1;
+			}
+		}
+
+		if(!PrepareOutputDirectory(inputDirectory, outputDirectory))
+			return 1;
+
+		size_t skipped = 0;
+		for(const wstring& name : ListSourceFiles(inputDirectory))
+		{
+			SourceTexture source;
+			string error;
+			if(!LoadSourceTexture(inputDirectory + L"\\" + name, source, error))
+			{
+				wcout << name << L": skipped, " << wstring(error.begin(), error.end()) << endl;
+				++skipped;
+				continue;
+			}
+
+			const wstring stem = name.substr(0, name.find_last_of(L'.'));
+
+			MipGenerator::Options textureOptions = options;
+			textureOptions.NormalMap = IsNormalMap(stem);
+			textureOptions.SRGB = !textureOptions.NormalMap && (forceSRGB || source.IsSRGB());
+
+			// The demos' alpha tested shaders clip below 0.1.
+			textureOptions.AlphaReference = !textureOptions.NormalMap && IsAlphaTested(source) ? 0.1f : 0.0f;
+
+			// Written as R8G8B8A8, the layout the generator works in, replacing any
+			// chain the source had with one down to 1x1.
+			DDSParser::TextureDesc desc = source.Desc;
+			desc.Format = source.IsSRGB() ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+			desc.MipLevels = MipGenerator::MipCount(desc.Width, desc.Height);
+
+			vector<uint8_t> file;
+			if(DDSParser::InitFile(desc, file) != DDSParser::Result::Ok)
+			{
+				wcout << name << L": skipped, cannot describe its mip chain" << endl;
+				++skipped;
+				continue;
+			}
+
+			const uint32_t slices = desc.ArraySize;
+			const uint32_t mipCount = desc.MipLevels;
+
+			Clock::time_point start = Clock::now();
+			concurrency::parallel_for(uint32_t(0), slices, [&](uint32_t slice)
+			{
+				vector<uint8_t*> levels(mipCount);
+				for(uint32_t mip = 0; mip < mipCount; ++mip)
+					levels[mip] = file.data() + DDSParser::GetSubresource(desc, mip, slice).Offset;
+
+				const Image& top = source.Images[size_t(slice)*source.Desc.MipLevels];
+				copy(top.Pixels.begin(), top.Pixels.end(), levels[0]);
+
+				MipGenerator::Generate(textureOptions, desc.Width, desc.Height, mipCount, levels.data());
+			});
+			double seconds = SecondsSince(start);
+
+			const wstring outputName = stem + L".dds";
+			{
+				ofstream out(outputDirectory + L"\\" + outputName, ios::binary | ios::trunc);
+				if(!out || !out.write((const char*)file.data(), file.size()))
+				{
+					wcerr << L"cannot write " << outputName << endl;
+					return 1;
+				}
+			}
+
+			wcout << name << L" -> " << outputName << L": " << desc.Width << L"x" << desc.Height;
+			if(slices > 1)
+				wcout << L"x" << slices;
+			wcout << L", " << mipCount << L" levels"
+				<< (textureOptions.SRGB ? L", sRGB" : L"")
+				<< (textureOptions.NormalMap ? L", normal map" : L"")
+				<< (textureOptions.AlphaReference > 0.0f ? L", alpha coverage" : L"")
+				<< L", " << seconds*1000.0 << L" ms" << endl;
+		}
+
+		if(skipped > 0)
+			wcout << skipped << L" files skipped" << endl;
+
+		return 0;
+	}
+
+	// Packs the listed files with TexturePacker::BuildArray or BuildAtlas and
+	// writes the DDS file and, beside it, its table.
+	int PackTextures(const wstring& outputName, const vector<wstring>& inputs, bool atlas,
+		TexturePacker::uint32 padding, TexturePacker::Padding mode)
+	{
+		Clock::time_point start = Clock::now();
+
+		vector<MappedFile> files(inputs.size());
+		vector<TexturePacker::SourceFile> sources(inputs.size());
+		for(size_t i = 0; i < inputs.size(); ++i)
+		{
+			if(!files[i].Open(inputs[i]))
+			{
+				wcerr << L"cannot open " << inputs[i] << endl;
+				return 1;
+			}
+
+			// Entries are named after the file, without directory or extension.
+			string name = TextureArchive::NormalizeName(inputs[i]);
+			sources[i].Name = name.substr(0, name.find_last_of('.'));
+			sources[i].Data = files[i].GetData();
+			sources[i].Size = files[i].GetSize();
+		}
+
+		vector<uint8_t> file;
+		vector<TexturePacker::Entry> entries;
+		string error;
+		bool built = atlas ? TexturePacker::BuildAtlas(sources, padding, mode, file, entries, error) :
+			TexturePacker::BuildArray(sources, file, entries, error);
+		if(!built)
+		{
+			cerr << error << endl;
+			return 1;
+		}
+
+		const wstring tableName = outputName.substr(0, outputName.find_last_of(L'.')) + L".txt";
+		{
+			ofstream out(outputName, ios::binary | ios::trunc);
+			if(!out || !out.write((const char*)file.data(), file.size()))
+			{
+				wcerr << L"cannot write " << outputName << endl;
+				return 1;
+			}
+		}
+
+		if(!TexturePacker::WriteTable(tableName, entries))
+		{
+			wcerr << L"cannot write " << tableName << endl;
+			return 1;
+		}
+
+		DDSParser::TextureDesc desc;
+		DDSParser::Parse(file.data(), file.size(), desc);
+		wcout << L"packed " << inputs.size() << L" textures into a " << desc.Width << L"x" << desc.Height;
+		if(desc.ArraySize > 1)
+			wcout << L"x" << desc.ArraySize;
+		wcout << (atlas ? L" atlas" : L" array") << L" with " << desc.MipLevels << L" mips, "
+			<< file.size() << L" bytes, in " << SecondsSince(start) << L" s" << endl;
+		return 0;
+	}
+
+	int Array(const vector<wstring>& args)
+	{
+		if(args.size() < 2)
+		{
+			wcerr << L"usage: TextureTool array <output.dds> <input.dds> ..." << endl;
+			return 1;
+		}
+
+		return PackTextures(args[0], vector<wstring>(args.begin() + 1, args.end()), false, 0, TexturePacker::Padding::Clamp);
+	}
+
+	int Atlas(const vector<wstring>& args)
+	{
+		if(args.size() < 4 || (args[2] != L"clamp" && args[2] != L"wrap"))
+		{
+			wcerr << L"usage: TextureTool atlas <output.dds> <padding> <clamp|wrap> <input.dds> ..." << endl;
+			return 1;
+		}
+
+		const TexturePacker::uint32 padding = (TexturePacker::uint32)stoul(args[1]);
+		const TexturePacker::Padding mode = args[2] == L"wrap" ? TexturePacker::Padding::Wrap : TexturePacker::Padding::Clamp;
+		return PackTextures(args[0], vector<wstring>(args.begin() + 3, args.end()), true, padding, mode);
+	}
+
+	// Writes an RGBA image as a single level R8G8B8A8 DDS file.
+	bool WriteImage(const wstring& fileName, const Image& image, bool srgb)
+	{
+		DDSParser::TextureDesc desc;
+		desc.Format = srgb ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+		desc.Dimension = DDSParser::ResourceDimension::Texture2D;
+		desc.Width = image.Width;
+		desc.Height = image.Height;
+		desc.Depth = 1;
+		desc.MipLevels = 1;
+		desc.ArraySize = 1;
+
+		vector<uint8_t> file;
+		if(DDSParser::InitFile(desc, file) != DDSParser::Result::Ok)
+			return false;
+
+		copy(image.Pixels.begin(), image.Pixels.end(), file.begin() + size_t(desc.DataOffset));
+
+		ofstream out(fileName, ios::binary | ios::trunc);
+		return out && out.write((const char*)file.data(), file.size());
+	}
+
+	int Blur(const vector<wstring>& args)
+	{
+		if(args.size() < 2)
+		{
+			wcerr << L"usage: TextureTool blur <input> <output.dds> [blurCount]" << endl;
+			return 1;
+		}
+
+		const int blurCount = args.size() > 2 ? stoi(args[2]) : 4;
+
+		SourceTexture source;
+		string error;
+		if(!LoadSourceTexture(args[0], source, error))
+		{
+			cerr << error << endl;
+			return 1;
+		}
+
+		// The top level of the first slice, blurred the way the Blur demo blurs
+		// its back buffer.
+		Image& image = source.Images[0];
+		Clock::time_point start = Clock::now();
+		ImageBlur::Blur(DXGI_FORMAT_R8G8B8A8_UNORM, image.Pixels.data(), image.Width, image.Height, image.Width*4,
+			ImageBlur::CalcGaussWeights(2.5f), blurCount);
+		double seconds = SecondsSince(start);
+
+		if(!WriteImage(args[1], image, source.IsSRGB()))
+		{
+			wcerr << L"cannot write " << args[1] << endl;
+			return 1;
+		}
+
+		wcout << L"blurred " << image.Width << L"x" << image.Height << L" " << blurCount << L" times in "
+			<< seconds*1000.0 << L" ms, " << double(image.Width)*image.Height*blurCount / 1.0e6 / seconds << L" Mpix/s" << endl;
+		return 0;
+	}
+
+	int Sobel(const vector<wstring>& args)
+	{
+		if(args.size() < 2 || (args.size() > 2 && args[2] != L"composite"))
+		{
+			wcerr << L"usage: TextureTool sobel <input> <output.dds> [composite]" << endl;
+			return 1;
+		}
+
+		const bool composite = args.size() > 2;
+
+		SourceTexture source;
+		string error;
+		if(!LoadSourceTexture(args[0], source, error))
+		{
+			cerr << error << endl;
+			return 1;
+		}
+
+		const Image& image = source.Images[0];
+		Image output = image;
+		Clock::time_point start = Clock::now();
+		if(composite)
+			ImageSobel::Composite(DXGI_FORMAT_R8G8B8A8_UNORM, image.Pixels.data(), image.Width, image.Height, image.Width*4,
+				output.Pixels.data(), output.Width*4);
+		else
+			ImageSobel::EdgeMap(DXGI_FORMAT_R8G8B8A8_UNORM, image.Pixels.data(), image.Width, image.Height, image.Width*4,
+				output.Pixels.data(), output.Width*4);
+		double seconds = SecondsSince(start);
+
+		// An edge map holds edge values, not colors.
+		if(!WriteImage(args[1], output, composite && source.IsSRGB()))
+		{
+			wcerr << L"cannot write " << args[1] << endl;
+			return 1;
+		}
+
+		wcout << (composite ? L"composited " : L"edge mapped ") << image.Width << L"x" << image.Height << L" in "
+			<< seconds*1000.0 << L" ms, " << double(image.Width)*image.Height / 1.0e6 / seconds << L" Mpix/s" << endl;
+		return 0;
+	}
+
+	// What Parse promises once it accepts a file.
+	bool LayoutInside(const DDSParser::TextureDesc& desc, size_t size)
+	{
+		for(DDSParser::uint32 slice = 0; slice < desc.ArraySize; ++slice)
+		{
+			for(DDSParser::uint32 mip = 0; mip < desc.MipLevels; ++mip)
+			{
+				DDSParser::Subresource sub = DDSParser::GetSubresource(desc, mip, slice);
+				if(sub.Offset > size || sub.SlicePitch*sub.Depth > size - sub.Offset)
+					return false;
+			}
+		}
+
+		return true;
+	}
+
+	struct ParseCounts
+	{
+		size_t Results[5] = {};
+		size_t BadLayouts = 0;
+	};
+
+	void CheckedParse(const uint8_t* data, size_t size, ParseCounts& counts)
+	{
+		DDSParser::TextureDesc desc;
+		DDSParser::Result result = DDSParser::Parse(data, size, desc);
+		++counts.Results[(int)result];
+
+		if(result == DDSParser::Result::Ok && !LayoutInside(desc, size))
+			++counts.BadLayouts;
+	}
+
+	int DdsCheck(const vector<wstring>& args)
+	{
+		if(args.empty())
+		{
+			wcerr << L"usage: TextureTool dds-check <directory> [mutations]" << endl;
+			return 1;
+		}
+
+		const wstring& directory = args[0];
+		const size_t mutations = args.size() > 1 ? stoul(args[1]) : 1000;
+
+		// Magic number, DDS_HEADER and DDS_HEADER_DXT10.
+		const size_t headerSize = 4 + 124 + 20;
+
+		// Field values that sit on the edges of the parser's checks.
+		const uint32_t edgeValues[] = { 0, 1, 2, 3, 4, 6, 15, 16, 2048, 16384, 16385,
+			0x7fffffff, 0x80000000, 0xfffffffe, 0xffffffff };
+
+		vector<wstring> names = ListFiles(directory, L"*.dds");
+		mt19937 rng(1);
+		ParseCounts fuzzed;
+		int result = 0;
+
+		for(const wstring& name : names)
+		{
+			MappedFile file;
+			if(!file.Open(directory + L"\\" + name))
+			{
+				wcerr << L"cannot open " << name << endl;
+				return 1;
+			}
+
+			const uint8_t* data = file.GetData();
+			const size_t size = file.GetSize();
+
+			// Run Parse for about a tenth of a second.
+			DDSParser::TextureDesc desc;
+			DDSParser::Result parsed = DDSParser::Parse(data, size, desc);
+			size_t parseCount = 0;
+			Clock::time_point start = Clock::now();
+			do
+			{
+				for(int i = 0; i < 1000; ++i)
+					DDSParser::Parse(data, size, desc);
+				parseCount += 1000;
+			} while(SecondsSince(start) < 0.1);
+			double parseSeconds = SecondsSince(start) / parseCount;
+
+			if(parsed != DDSParser::Result::Ok || !LayoutInside(desc, size))
+			{
+				wcout << name << L": rejected (" << (int)parsed << L")" << endl;
+				result = 1;
+				continue;
+			}
+
+			wcout << name << L": " << desc.Width << L"x" << desc.Height << L"x" << desc.Depth << L", "
+				<< desc.MipLevels << L" mips, " << desc.ArraySize << L" slices, format " << desc.Format
+				<< L", parsed in " << parseSeconds*1.0e9 << L" ns" << endl;
+
+			// Every length through the headers, copied so reading past the end of the
+			// data touches memory past the end of the copy, and a few lengths inside
+			// the pixel data.
+			for(size_t length = 0; length <= min(size, headerSize); ++length)
+			{
+				vector<uint8_t> prefix(data, data + length);
+				CheckedParse(prefix.data(), length, fuzzed);
+			}
+
+			for(size_t length : { size / 2, size - size / 4, size - 1 })
+			{
+				if(length > headerSize && length < size)
+					CheckedParse(data, length, fuzzed);
+			}
+
+			// Overwrite a few bytes or 32-bit fields of the headers, parse, and put
+			// the original bytes back.
+			vector<uint8_t> copy(data, data + size);
+			const size_t mutableSize = min(size, headerSize);
+			for(size_t m = 0; m < mutations; ++m)
+			{
+				int edits = 1 + rng() % 4;
+				for(int e = 0; e < edits; ++e)
+				{
+					size_t offset = rng() % mutableSize;
+					if(rng() % 2 == 0 || offset + 4 > mutableSize)
+					{
+						copy[offset] = (uint8_t)rng();
+					}
+					else
+					{
+						uint32_t value = edgeValues[rng() % (sizeof(edgeValues) / sizeof(edgeValues[0]))];
+						memcpy(&copy[offset & ~size_t(3)], &value, sizeof(value));
+					}
+				}
+
+				CheckedParse(copy.data(), copy.size(), fuzzed);
+				memcpy(copy.data(), data, mutableSize);
+			}
+		}
+
+		size_t total = 0;
+		for(size_t count : fuzzed.Results)
+			total += count;
+
+		wcout << L"fuzzed " << total << L" files: " << fuzzed.Results[(int)DDSParser::Result::Ok] << L" ok, "
+			<< fuzzed.Results[(int)DDSParser::Result::InvalidFile] << L" invalid file, "
+			<< fuzzed.Results[(int)DDSParser::Result::InvalidData] << L" invalid data, "
+			<< fuzzed.Results[(int)DDSParser::Result::NotSupported] << L" not supported, "
+			<< fuzzed.Results[(int)DDSParser::Result::EndOfFile] << L" end of file, "
+			<< fuzzed.BadLayouts << L" accepted with subresources outside the data" << endl;
+
+		return fuzzed.BadLayouts == 0 ? result : 1;
+	}
+
+	// A texture of the residency simulation, drawn on a 4x4 quad it covers once.
+	struct SimTexture
+	{
+		wstring Name;
+		DDSParser::TextureDesc Desc;
+		MipResidency::uint32 TailMip = 0;
+		float X = 0.0f;
+
+		// The finest mip loaded, which lags MipResidency's while a change is in
+		// flight, and when the change in flight completes.
+		MipResidency::uint32 ResidentMip = 0;
+		bool Pending = false;
+		int CompleteFrame = 0;
+		int ReadyFrame = 0;
+	};
+
+	const float SimQuadSize = 4.0f;
+	const float SimQuadSpacing = 6.0f;
+
+	// As SkinnedMesh sees the scene: the demos' window and camera lens.
+	const float SimScreenHeight = 600.0f;
+	const float SimAspect = 800.0f / 600.0f;
+	const float SimFovY = 0.25f*3.1415926535f;
+	const float SimNearZ = 1.0f;
+
+	// Frames a change takes to load, and that MipResidency waits after it.
+	const int SimLoadFrames = 4;
+	const int SimChangeDelay = 3;
+
+	// Where a camera path puts the eye at a frame.  The camera looks down +z at
+	// the row of quads along the x axis.
+	struct CameraPath
+	{
+		const wchar_t* Name;
+		int FrameCount;
+		function<void(int frame, float& x, float& z)> Eye;
+	};
+
+	vector<CameraPath> MakeCameraPaths(float rowLength)
+	{
+		vector<CameraPath> paths;
+
+		paths.push_back({ L"fly-by", 600, [rowLength](int frame, float& x, float& z)
+		{
+			x = -10.0f + (rowLength + 20.0f)*frame / 600.0f;
+			z = -3.0f;
+		} });
+
+		paths.push_back({ L"approach", 800, [rowLength](int frame, float& x, float& z)
+		{
+			x = 0.5f*rowLength;
+			z = -200.0f + 198.5f*min(frame, 600) / 600.0f;
+		} });
+
+		// A second in front of one quad, then the next, in a fixed random order.
+		vector<float> stops;
+		mt19937 rng(1);
+		for(int i = 0; i < 10; ++i)
+			stops.push_back(uniform_real_distribution<float>(0.0f, rowLength)(rng));
+		paths.push_back({ L"jumps", 600, [stops](int frame, float& x, float& z)
+		{
+			x = stops[(frame / 60) % stops.size()];
+			z = -2.0f;
+		} });
+
+		paths.push_back({ L"still", 600, [rowLength](int frame, float& x, float& z)
+		{
+			x = 0.5f*rowLength;
+			z = -3.0f;
+		} });
+
+		return paths;
+	}
+
+	// Runs one path and returns the number of broken rules.
+	int SimulateResidency(const CameraPath& path, vector<SimTexture> textures, MipResidency::uint64 budget)
+	{
+		MipResidency::Settings settings;
+		settings.Budget = budget;
+		settings.ChangeDelay = SimChangeDelay;
+		MipResidency residency(settings);
+
+		for(auto& t : textures)
+		{
+			residency.AddTexture(t.Desc, t.TailMip);
+			t.ResidentMip = t.TailMip;
+		}
+		const MipResidency::uint64 tailBytes = residency.GetCommittedBytes();
+
+		const float pixelSpread = 2.0f*tan(0.5f*SimFovY) / SimScreenHeight;
+		const float halfWidth = tan(0.5f*SimFovY)*SimAspect;
+
+		int loads = 0;
+		int evictions = 0;
+		int blurry = 0;
+		int drawn = 0;
+		int lastShortFrame = -1;
+		int lastChangeFrame = -1;
+		int errors = 0;
+		MipResidency::uint64 peakBytes = 0;
+
+		auto fail = [&](int frame, const wstring& what)
+		{
+			if(errors++ < 10)
+				wcout << L"    frame " << frame << L": " << what << endl;
+		};
+
+		for(int frame = 0; frame < path.FrameCount; ++frame)
+		{
+			float eyeX = 0.0f;
+			float eyeZ = 0.0f;
+			path.Eye(frame, eyeX, eyeZ);
+
+			// Quads in front of the camera and inside its horizontal field of view,
+			// reported as UpdateTextureResidency reports render items.
+			vector<bool> visible(textures.size(), false);
+			for(size_t i = 0; i < textures.size(); ++i)
+			{
+				float dz = -eyeZ;
+				float dx = textures[i].X - eyeX;
+				if(dz <= 0.0f || fabs(dx) > dz*halfWidth + 0.5f*SimQuadSize)
+					continue;
+
+				float distance = sqrt(dx*dx + dz*dz) - 0.5f*SimQuadSize*sqrt(2.0f);
+				float uvPerPixel = pixelSpread*max(distance, SimNearZ) / SimQuadSize;
+				residency.ReportUsage((MipResidency::uint32)i, uvPerPixel);
+				visible[i] = true;
+			}
+
+			residency.Update();
+
+			for(const auto& change : residency.GetChanges())
+			{
+				SimTexture& t = textures[change.Texture];
+				if(t.Pending)
+					fail(frame, t.Name + L" has two changes in flight");
+				if(frame < t.ReadyFrame)
+					fail(frame, t.Name + L" changed too soon after its last change");
+				if(change.FirstMip > t.TailMip || change.FirstMip != residency.GetFirstMip(change.Texture))
+					fail(frame, t.Name + L" was given a bad first mip");
+
+				t.Pending = true;
+				t.CompleteFrame = frame + SimLoadFrames;
+				lastChangeFrame = frame;
+				++(change.IsLoad ? loads : evictions);
+			}
+
+			if(residency.GetPendingCount() > settings.MaxPendingChanges)
+				fail(frame, L"too many changes in flight");
+			if(residency.GetCommittedBytes() > max(budget, tailBytes))
+				fail(frame, L"over budget");
+			peakBytes = max(peakBytes, residency.GetCommittedBytes());
+
+			for(size_t i = 0; i < textures.size(); ++i)
+			{
+				SimTexture& t = textures[i];
+				if(visible[i])
+				{
+					++drawn;
+					if(t.ResidentMip > residency.GetDesiredMip((MipResidency::uint32)i))
+					{
+						++blurry;
+						lastShortFrame = frame;
+					}
+				}
+
+				// The app completes changes in the frame's Draw, after the Update.
+				if(t.Pending && t.CompleteFrame == frame)
+				{
+					t.ResidentMip = residency.GetFirstMip((MipResidency::uint32)i);
+					t.Pending = false;
+					t.ReadyFrame = frame + SimChangeDelay;
+					residency.CompleteChange((MipResidency::uint32)i);
+				}
+			}
+		}
+
+		// A camera that stops moving must leave the textures alone once they are
+		// loaded, and get every mip it wants when the budget holds them all.
+		if(wstring(path.Name) == L"still")
+		{
+			MipResidency::uint64 wantedBytes = 0;
+			for(size_t i = 0; i < textures.size(); ++i)
+			{
+				const SimTexture& t = textures[i];
+				for(MipResidency::uint32 mip = residency.GetDesiredMip((MipResidency::uint32)i); mip < t.Desc.MipLevels; ++mip)
+				{
+					DDSParser::Subresource sub = DDSParser::GetSubresource(t.Desc, mip, 0);
+					wantedBytes += sub.SlicePitch*sub.Depth*t.Desc.ArraySize;
+				}
+			}
+
+			if(lastChangeFrame >= path.FrameCount / 2)
+				fail(lastChangeFrame, L"still changing textures with the camera still");
+			if(wantedBytes <= budget && lastShortFrame >= path.FrameCount / 2)
+				fail(lastShortFrame, L"never settled");
+		}
+
+		wcout << L"  " << path.Name << L": " << loads << L" loads, " << evictions << L" evictions, peak "
+			<< peakBytes / 1024 << L" KB, " << blurry << L" of " << drawn << L" texture-frames blurrier than wanted, "
+			<< L"last at frame " << lastShortFrame << (errors ? L", FAILED" : L"") << endl;
+
+		return errors;
+	}
+
+	int ResidencySim(const vector<wstring>& args)
+	{
+		if(args.empty())
+		{
+			wcerr << L"usage: TextureTool residency-sim <directory> [budget MB ...]" << endl;
+			return 1;
+		}
+
+		const wstring& directory = args[0];
+
+		// Mipmapped 2D textures, with the tail SkinnedMesh streams them in with.
+		vector<SimTexture> textures;
+		MipResidency::uint64 fullBytes = 0;
+		for(const wstring& name : ListFiles(directory, L"*.dds"))
+		{
+			MappedFile file;
+			SimTexture t;
+			if(!file.Open(directory + L"\\" + name) ||
+				DDSParser::Parse(file.GetData(), file.GetSize(), t.Desc) != DDSParser::Result::Ok)
+			{
+				wcerr << L"cannot read " << name << endl;
+				return 1;
+			}
+
+			if(t.Desc.Dimension != DDSParser::ResourceDimension::Texture2D || t.Desc.IsCubeMap || t.Desc.MipLevels < 2)
+				continue;
+
+			vector<DDSParser::Subresource> subresources(t.Desc.MipLevels*t.Desc.ArraySize);
+			t.TailMip = DDSParser::GetSubresources(t.Desc, 64, subresources.data());
+			t.Name = name;
+			t.X = SimQuadSpacing*textures.size();
+			textures.push_back(t);
+
+			fullBytes += t.Desc.SliceSize*t.Desc.ArraySize;
+		}
+
+		if(textures.empty())
+		{
+			wcerr << L"no mipmapped 2D textures in " << directory << endl;
+			return 1;
+		}
+
+		vector<MipResidency::uint64> budgets;
+		for(size_t i = 1; i < args.size(); ++i)
+			budgets.push_back(MipResidency::uint64(stod(args[i])*1024.0*1024.0));
+		if(budgets.empty())
+			budgets = { 32ull*1024*1024, fullBytes / 4 };
+
+		wcout << textures.size() << L" textures, " << fullBytes / 1024 << L" KB with every mip" << endl;
+
+		int errors = 0;
+		for(MipResidency::uint64 budget : budgets)
+		{
+			wcout << L"budget " << budget / 1024 << L" KB" << endl;
+			for(const CameraPath& path : MakeCameraPaths(SimQuadSpacing*(textures.size() - 1)))
+				errors += SimulateResidency(path, textures, budget);
+		}
+
+		return errors == 0 ? 0 : 1;
+	}
+}
+
+int wmain(int argc, wchar_t* argv[])
+{
+	if(argc < 2)
+	{
+		wcerr << L"usage: TextureTool pack <directory> <archive> [alignment]" << endl;
+		wcerr << L"       TextureTool compress <input directory> <output directory> [auto|bc1|bc3|bc5|bc7 ...]" << endl;
+		wcerr << L"       TextureTool mips <input directory> <output directory> [box|kaiser] [srgb] [wrap]" << endl;
+		wcerr << L"       TextureTool array <output.dds> <input.dds> ..." << endl;
+		wcerr << L"       TextureTool atlas <output.dds> <padding> <clamp|wrap> <input.dds> ..." << endl;
+		wcerr << L"       TextureTool blur <input> <output.dds> [blurCount]" << endl;
+		wcerr << L"       TextureTool sobel <input> <output.dds> [composite]" << endl;
+		wcerr << L"       TextureTool dds-check <directory> [mutations]" << endl;
+		wcerr << L"       TextureTool residency-sim <directory> [budget MB ...]" << endl;
+		return 1;
+	}
+
+	wstring command = argv[1];
+	vector<wstring> args(argv + 2, argv + argc);
+
+	try
+	{
+		if(command == L"pack")
+			return Pack(args);
+		if(command == L"compress")
+			return Compress(args);
+		if(command == L"mips")
+			return Mips(args);
+		if(command == L"array")
+			return Array(args);
+		if(command == L"atlas")
+			return Atlas(args);
+		if(command == L"blur")
+			return Blur(args);
+		if(command == L"sobel")
+			return Sobel(args);
+		if(command == L"dds-check")
+			return DdsCheck(args);
+		if(command == L"residency-sim")
+			return ResidencySim(args);
+	}
+	catch(const exception& e)
+	{
+		cerr << e.what() << endl;
+		return 1;
+	}
+
+	wcerr << L"unknown command " << command << endl;
+	return 1;
+}